@@ -0,0 +1,266 @@
+/* -*- mode: c++; fill-column: 132; c-basic-offset: 4; indent-tabs-mode: nil -*- */
+
+#include "rodsErrorTable.hpp"
+#include "rodsLog.hpp"
+#include "irods_error.hpp"
+
+#include "gsseapAdmission.hpp"
+#include "gsseapShm.hpp"
+#include "gsseapUtil.hpp"
+
+#include <map>
+
+#include <errno.h>
+#include <limits.h>
+#include <signal.h>
+#include <string.h>
+#include <sys/time.h>
+#include <sys/types.h>
+#include <time.h>
+#include <unistd.h>
+
+static const unsigned int gsseap_admission_max_slots = 1024;
+static const long gsseap_admission_default_timeout = 5000;   // ms a login may wait in the queue
+static const long gsseap_admission_poll_interval = 100;      // ms between checks for agents that died holding a slot
+static const long gsseap_admission_default_lease = 120;      // s a slot may run before it is taken back
+
+enum {
+    GSSEAP_SLOT_FREE = 0,
+    GSSEAP_SLOT_QUEUED,
+    GSSEAP_SLOT_RUNNING
+};
+
+typedef struct {
+    pid_t pid;
+    int state;
+    unsigned int key;
+    struct timeval since;
+} gsseap_admission_slot_t;
+
+typedef struct {
+    gsseap_shm_header_t header;
+    pthread_cond_t changed;
+    gsseap_admission_slot_t slots[gsseap_admission_max_slots];
+} gsseap_admission_t;
+
+static gsseap_admission_t* gsseap_admission = NULL;
+static int gsseap_admission_own_slot = -1;
+
+static void gsseap_admission_init( void* _addr ) {
+    gsseap_admission_t* admission = ( gsseap_admission_t* ) _addr;
+    pthread_condattr_t attr;
+
+    pthread_condattr_init( &attr );
+    pthread_condattr_setpshared( &attr, PTHREAD_PROCESS_SHARED );
+    pthread_cond_init( &admission->changed, &attr );
+    pthread_condattr_destroy( &attr );
+    memset( admission->slots, 0, sizeof( admission->slots ) );
+}
+
+static long gsseap_admission_max_running() {
+    long max_running = gsseap_env_long( "GSSEAP_MAX_HANDSHAKES", 0 );
+    return max_running > ( long ) gsseap_admission_max_slots ? ( long ) gsseap_admission_max_slots : max_running;
+}
+
+bool gsseap_admission_enabled() {
+    return gsseap_admission_max_running() > 0;
+}
+
+static unsigned int gsseap_admission_hash( const char* _key ) {
+    unsigned int hash = 2166136261u;
+    for ( ; *_key != '\0'; _key++ ) {
+        hash ^= ( unsigned char ) *_key;
+        hash *= 16777619u;
+    }
+    return hash;
+}
+
+/// @brief Free the slots of agents that exited without releasing them, and of handshakes running past their lease, e.g.
+/// because the agent never got to agent_start; the caller holds the lock
+static void gsseap_admission_reap() {
+    long lease = gsseap_env_long( "GSSEAP_HANDSHAKE_SLOT_LEASE", gsseap_admission_default_lease );
+    struct timeval now;
+    unsigned int i;
+    bool reaped = false;
+
+    gettimeofday( &now, NULL );
+    for ( i = 0; i < gsseap_admission_max_slots; i++ ) {
+        gsseap_admission_slot_t* slot = &gsseap_admission->slots[i];
+        if ( slot->state == GSSEAP_SLOT_FREE ) {
+            continue;
+        }
+        if ( ( kill( slot->pid, 0 ) != 0 && errno == ESRCH ) ||
+                ( slot->state == GSSEAP_SLOT_RUNNING && lease > 0 && now.tv_sec - slot->since.tv_sec > lease ) ) {
+            slot->state = GSSEAP_SLOT_FREE;
+            reaped = true;
+        }
+    }
+    if ( reaped ) {
+        pthread_cond_broadcast( &gsseap_admission->changed );
+    }
+}
+
+/// @brief The queued slot to run next: the one whose key has the fewest running handshakes, oldest first
+static int gsseap_admission_next() {
+    std::map<unsigned int, int> running;
+    unsigned int i;
+    int next = -1;
+    int next_running = INT_MAX;
+
+    for ( i = 0; i < gsseap_admission_max_slots; i++ ) {
+        if ( gsseap_admission->slots[i].state == GSSEAP_SLOT_RUNNING ) {
+            running[gsseap_admission->slots[i].key]++;
+        }
+    }
+    for ( i = 0; i < gsseap_admission_max_slots; i++ ) {
+        gsseap_admission_slot_t* slot = &gsseap_admission->slots[i];
+        if ( slot->state != GSSEAP_SLOT_QUEUED ) {
+            continue;
+        }
+        int key_running = running.count( slot->key ) ? running[slot->key] : 0;
+        if ( next < 0 || key_running < next_running ||
+                ( key_running == next_running && timercmp( &slot->since, &gsseap_admission->slots[next].since, < ) ) ) {
+            next = i;
+            next_running = key_running;
+        }
+    }
+    return next;
+}
+
+irods::error gsseap_admission_acquire(
+    const char* _key ) {
+    irods::error result = SUCCESS();
+    long max_running = gsseap_admission_max_running();
+    long max_queued = gsseap_env_long( "GSSEAP_MAX_QUEUED_HANDSHAKES", max_running * 4 );
+    long timeout = gsseap_env_long( "GSSEAP_HANDSHAKE_QUEUE_TIMEOUT", gsseap_admission_default_timeout );
+    unsigned int key = gsseap_admission_hash( _key );
+    unsigned int i;
+    int free_slot = -1;
+    long running = 0;
+    long queued = 0;
+    long key_queued = 0;
+    std::map<unsigned int, int> queued_keys;
+
+    if ( max_running <= 0 || gsseap_admission_own_slot >= 0 ) {
+        return result;
+    }
+    if ( gsseap_admission == NULL ) {
+        gsseap_admission = ( gsseap_admission_t* ) gsseap_shm_map( "admission", sizeof( gsseap_admission_t ), gsseap_admission_init );
+        if ( gsseap_admission == NULL ) {
+            // never turn a shared memory problem into a login outage
+            return result;
+        }
+    }
+    if ( gsseap_shm_lock( &gsseap_admission->header ) != 0 ) {
+        return result;
+    }
+
+    gsseap_admission_reap();
+    for ( i = 0; i < gsseap_admission_max_slots; i++ ) {
+        gsseap_admission_slot_t* slot = &gsseap_admission->slots[i];
+        if ( slot->state == GSSEAP_SLOT_RUNNING ) {
+            running++;
+        }
+        else if ( slot->state == GSSEAP_SLOT_QUEUED ) {
+            queued++;
+            queued_keys[slot->key] = 1;
+            if ( slot->key == key ) {
+                key_queued++;
+            }
+        }
+        else if ( free_slot < 0 ) {
+            free_slot = i;
+        }
+    }
+
+    // a client address may hold at most its fair share of the queue, so one busy client cannot starve the others
+    long share = max_queued / ( long )( queued_keys.size() + ( queued_keys.count( key ) ? 0 : 1 ) );
+    if ( share < 1 ) {
+        share = 1;
+    }
+
+    if ( running < max_running && queued == 0 && free_slot >= 0 ) {
+        gsseap_admission->slots[free_slot].state = GSSEAP_SLOT_RUNNING;
+    }
+    else if ( free_slot < 0 || queued >= max_queued || key_queued >= share ) {
+        result = ERROR( SYS_MAX_CONNECT_COUNT_EXCEEDED, "Too many GSSEAP logins in progress, retry later." );
+        rodsLog( LOG_NOTICE, "gsseap_admission_acquire: refusing login for %s, %ld running, %ld queued, %ld queued for it",
+                 _key, running, queued, key_queued );
+    }
+    else {
+        gsseap_admission_slot_t* slot = &gsseap_admission->slots[free_slot];
+        struct timeval now;
+        struct timeval deadline;
+        struct timeval wait;
+
+        slot->state = GSSEAP_SLOT_QUEUED;
+        slot->pid = getpid();
+        slot->key = key;
+        gettimeofday( &slot->since, NULL );
+
+        wait.tv_sec = timeout / 1000;
+        wait.tv_usec = ( timeout % 1000 ) * 1000;
+        timeradd( &slot->since, &wait, &deadline );
+
+        while ( slot->state == GSSEAP_SLOT_QUEUED ) {
+            gsseap_admission_reap();
+
+            running = 0;
+            for ( i = 0; i < gsseap_admission_max_slots; i++ ) {
+                if ( gsseap_admission->slots[i].state == GSSEAP_SLOT_RUNNING ) {
+                    running++;
+                }
+            }
+            if ( running < max_running && gsseap_admission_next() == free_slot ) {
+                slot->state = GSSEAP_SLOT_RUNNING;
+                break;
+            }
+
+            gettimeofday( &now, NULL );
+            if ( !timercmp( &now, &deadline, < ) ) {
+                slot->state = GSSEAP_SLOT_FREE;
+                result = ERROR( SYS_MAX_CONNECT_COUNT_EXCEEDED, "Timed out waiting for a GSSEAP login slot, retry later." );
+                rodsLog( LOG_NOTICE, "gsseap_admission_acquire: login for %s timed out after %ld ms in the queue", _key, timeout );
+                break;
+            }
+
+            struct timespec until;
+            wait.tv_sec = gsseap_admission_poll_interval / 1000;
+            wait.tv_usec = ( gsseap_admission_poll_interval % 1000 ) * 1000;
+            timeradd( &now, &wait, &now );
+            if ( timercmp( &deadline, &now, < ) ) {
+                now = deadline;
+            }
+            until.tv_sec = now.tv_sec;
+            until.tv_nsec = now.tv_usec * 1000;
+            if ( pthread_cond_timedwait( &gsseap_admission->changed, &gsseap_admission->header.lock, &until ) == EOWNERDEAD ) {
+                pthread_mutex_consistent( &gsseap_admission->header.lock );
+            }
+        }
+    }
+
+    if ( result.ok() ) {
+        gsseap_admission->slots[free_slot].pid = getpid();
+        gsseap_admission->slots[free_slot].key = key;
+        gettimeofday( &gsseap_admission->slots[free_slot].since, NULL );
+        gsseap_admission_own_slot = free_slot;
+    }
+
+    gsseap_shm_unlock( &gsseap_admission->header );
+    return result;
+}
+
+void gsseap_admission_release() {
+    if ( gsseap_admission == NULL || gsseap_admission_own_slot < 0 ) {
+        return;
+    }
+    if ( gsseap_shm_lock( &gsseap_admission->header ) == 0 ) {
+        gsseap_admission_slot_t* slot = &gsseap_admission->slots[gsseap_admission_own_slot];
+        if ( slot->pid == getpid() ) {
+            slot->state = GSSEAP_SLOT_FREE;
+        }
+        pthread_cond_broadcast( &gsseap_admission->changed );
+        gsseap_shm_unlock( &gsseap_admission->header );
+    }
+    gsseap_admission_own_slot = -1;
+}
@@ -0,0 +1,44 @@
+/* -*- mode: c++; fill-column: 132; c-basic-offset: 4; indent-tabs-mode: nil -*- */
+/* gsseapAdmission.hpp
+ * Server-wide admission control for GSS-EAP handshakes.  Every accept loop may
+ * block on the AAA backend, so the number of handshakes in flight across all
+ * agents is bounded, excess logins wait in a bounded queue served fairly per
+ * client address, and logins beyond the queue are refused at once with a
+ * retryable error.
+ */
+
+#ifndef GSSEAP_ADMISSION_HPP
+#define GSSEAP_ADMISSION_HPP
+
+#include "irods_error.hpp"
+
+/// @brief Whether admission control is configured (GSSEAP_MAX_HANDSHAKES)
+bool gsseap_admission_enabled();
+
+/// @brief Wait for a handshake slot, _key groups logins for fairness (the client address, which the client cannot choose)
+irods::error gsseap_admission_acquire(
+    const char* _key );
+
+/// @brief Give back the slot held by this agent, if any
+void gsseap_admission_release();
+
+/// @brief Gives back the slot held by this agent when it goes out of scope, unless it is kept for the next operation
+class gsseap_admission_guard {
+public:
+    gsseap_admission_guard() : keep_( false ) {}
+    ~gsseap_admission_guard() {
+        if ( !keep_ ) {
+            gsseap_admission_release();
+        }
+    }
+
+    /// @brief The handshake goes on in agent_start, which releases the slot
+    void keep() {
+        keep_ = true;
+    }
+
+private:
+    bool keep_;
+};
+
+#endif  /* GSSEAP_ADMISSION_HPP */
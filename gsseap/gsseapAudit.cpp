@@ -0,0 +1,251 @@
+/* -*- mode: c++; fill-column: 132; c-basic-offset: 4; indent-tabs-mode: nil -*- */
+
+#include "rodsLog.hpp"
+
+#include "gsseapAudit.hpp"
+#include "gsseapUtil.hpp"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/types.h>
+#include <time.h>
+#include <unistd.h>
+
+static const unsigned long gsseap_audit_queue_size = 256;         // a power of two
+static const long gsseap_audit_default_flush_interval = 100;      // ms between batches
+static const long gsseap_audit_tick = 10;                         // ms the writer sleeps between checks for exit
+static const size_t gsseap_audit_batch_size = 65536;              // bytes written at once
+static const size_t gsseap_audit_record_max = 2048;               // longest formatted record
+
+// A bounded multi-producer queue: a producer claims a cell by advancing the head,
+// fills it, then publishes it by setting its sequence; only the writer thread consumes.
+typedef struct {
+    volatile unsigned long seq;
+    gsseap_audit_record_t record;
+} gsseap_audit_cell_t;
+
+static gsseap_audit_cell_t gsseap_audit_queue[gsseap_audit_queue_size];
+static volatile unsigned long gsseap_audit_head = 0;
+static unsigned long gsseap_audit_tail = 0;
+static volatile unsigned long gsseap_audit_dropped = 0;
+
+static pthread_mutex_t gsseap_audit_start_mutex = PTHREAD_MUTEX_INITIALIZER;
+static volatile pid_t gsseap_audit_writer_pid = 0;  // the process whose writer thread is running
+static pthread_t gsseap_audit_writer;
+static volatile int gsseap_audit_stop = 0;
+static int gsseap_audit_fd = -1;
+
+bool gsseap_audit_enabled() {
+    return gsseap_env_string( "GSSEAP_AUDIT_LOG" ) != NULL;
+}
+
+int gsseap_audit_log_level() {
+    return gsseap_audit_enabled() ? LOG_DEBUG : LOG_NOTICE;
+}
+
+/// @brief Copy _in to _out, replacing quotes, backslashes and control characters so a record stays one parseable line
+static void gsseap_audit_escape(
+    const char* _in,
+    char* _out,
+    size_t _size ) {
+    size_t i;
+    for ( i = 0; _in[i] != '\0' && i + 1 < _size; i++ ) {
+        unsigned char c = _in[i];
+        _out[i] = ( c < 0x20 || c == 0x7f || c == '"' || c == '\\' ) ? '?' : c;
+    }
+    _out[i] = '\0';
+}
+
+static size_t gsseap_audit_format(
+    const gsseap_audit_record_t* _record,
+    char* _buf,
+    size_t _size ) {
+    char identity[GSSEAP_AUDIT_NAME_SIZE];
+    char realm[GSSEAP_AUDIT_NAME_SIZE];
+    char user[GSSEAP_AUDIT_NAME_SIZE];
+    char message[GSSEAP_AUDIT_MESSAGE_SIZE];
+    char when[32];
+    struct tm tm;
+    time_t t = _record->time;
+
+    gsseap_audit_escape( _record->identity, identity, sizeof( identity ) );
+    gsseap_audit_escape( _record->realm, realm, sizeof( realm ) );
+    gsseap_audit_escape( _record->user, user, sizeof( user ) );
+    gsseap_audit_escape( _record->message, message, sizeof( message ) );
+    gmtime_r( &t, &tm );
+    strftime( when, sizeof( when ), "%Y-%m-%dT%H:%M:%SZ", &tm );
+
+    int len = snprintf( _buf, _size,
+                        "time=%s pid=%d outcome=%s status=%d path=%s mech=%s identity=\"%s\" realm=\"%s\" user=\"%s\" client=%s "
+                        "wall_us=%llu mech_us=%llu wait_us=%llu map_us=%llu round_trips=%u message=\"%s\"\n",
+                        when, ( int ) getpid(), _record->status == 0 ? "ok" : "failed", _record->status,
+                        _record->path != NULL ? _record->path : "none", _record->mech[0] != '\0' ? _record->mech : "-",
+                        identity, realm, user,
+                        _record->client_addr[0] != '\0' ? _record->client_addr : "-",
+                        _record->wall_us, _record->mech_us, _record->wait_us, _record->map_us, _record->round_trips, message );
+    return len < 0 ? 0 : ( ( size_t ) len >= _size ? _size - 1 : ( size_t ) len );
+}
+
+static void gsseap_audit_write(
+    const char* _buf,
+    size_t _len ) {
+    while ( _len > 0 ) {
+        ssize_t n = write( gsseap_audit_fd, _buf, _len );
+        if ( n < 0 ) {
+            if ( errno == EINTR ) {
+                continue;
+            }
+            rodsLog( LOG_ERROR, "gsseap_audit_write: writing the audit log failed, errno %d", errno );
+            return;
+        }
+        _buf += n;
+        _len -= n;
+    }
+}
+
+/// @brief Format and write everything queued, only called by one thread at a time
+static void gsseap_audit_drain() {
+    static char batch[gsseap_audit_batch_size];
+    size_t len = 0;
+
+    for ( ;; ) {
+        gsseap_audit_cell_t* cell = &gsseap_audit_queue[gsseap_audit_tail & ( gsseap_audit_queue_size - 1 )];
+        if ( cell->seq != gsseap_audit_tail + 1 ) {
+            break;
+        }
+        __sync_synchronize();
+        if ( gsseap_audit_batch_size - len < gsseap_audit_record_max ) {
+            gsseap_audit_write( batch, len );
+            len = 0;
+        }
+        len += gsseap_audit_format( &cell->record, batch + len, gsseap_audit_batch_size - len );
+        __sync_synchronize();
+        cell->seq = gsseap_audit_tail + gsseap_audit_queue_size;
+        gsseap_audit_tail++;
+    }
+
+    unsigned long dropped = __sync_fetch_and_and( &gsseap_audit_dropped, 0 );
+    if ( dropped > 0 ) {
+        int n = snprintf( batch + len, gsseap_audit_batch_size - len, "pid=%d dropped=%lu\n", ( int ) getpid(), dropped );
+        len += n > 0 ? n : 0;
+    }
+    if ( len > 0 ) {
+        gsseap_audit_write( batch, len );
+    }
+}
+
+static void* gsseap_audit_writer_main( void* ) {
+    long interval = gsseap_env_long( "GSSEAP_AUDIT_FLUSH_INTERVAL", gsseap_audit_default_flush_interval );
+    long slept = 0;
+    struct timespec tick;
+
+    tick.tv_sec = 0;
+    tick.tv_nsec = gsseap_audit_tick * 1000000;
+    while ( !gsseap_audit_stop ) {
+        nanosleep( &tick, NULL );
+        slept += gsseap_audit_tick;
+        if ( slept >= interval ) {
+            gsseap_audit_drain();
+            slept = 0;
+        }
+    }
+    gsseap_audit_drain();
+    return NULL;
+}
+
+void gsseap_audit_flush() {
+    if ( gsseap_audit_writer_pid != getpid() ) {
+        return;
+    }
+    gsseap_audit_stop = 1;
+    pthread_join( gsseap_audit_writer, NULL );
+    gsseap_audit_writer_pid = 0;
+    gsseap_audit_stop = 0;
+}
+
+/// @brief Start the writer of this process, false if the audit log cannot be written
+static bool gsseap_audit_start() {
+    bool started = true;
+    pid_t pid = getpid();
+
+    if ( gsseap_audit_writer_pid == pid ) {
+        return true;
+    }
+
+    pthread_mutex_lock( &gsseap_audit_start_mutex );
+    if ( gsseap_audit_writer_pid != pid ) {
+        // a forked agent starts over with an empty queue of its own
+        unsigned long i;
+        for ( i = 0; i < gsseap_audit_queue_size; i++ ) {
+            gsseap_audit_queue[i].seq = i;
+        }
+        gsseap_audit_head = 0;
+        gsseap_audit_tail = 0;
+        gsseap_audit_dropped = 0;
+        gsseap_audit_stop = 0;
+
+        if ( gsseap_audit_fd < 0 ) {
+            const char* path = gsseap_env_string( "GSSEAP_AUDIT_LOG" );
+            gsseap_audit_fd = open( path, O_WRONLY | O_APPEND | O_CREAT | O_CLOEXEC, 0600 );
+            if ( gsseap_audit_fd < 0 ) {
+                rodsLog( LOG_ERROR, "gsseap_audit_start: cannot open audit log %s, errno %d", path, errno );
+            }
+        }
+        if ( gsseap_audit_fd < 0 || pthread_create( &gsseap_audit_writer, NULL, gsseap_audit_writer_main, NULL ) != 0 ) {
+            started = false;
+        }
+        else {
+            static bool registered = false;
+            if ( !registered ) {
+                atexit( gsseap_audit_flush );
+                registered = true;
+            }
+            gsseap_audit_writer_pid = pid;
+        }
+    }
+    pthread_mutex_unlock( &gsseap_audit_start_mutex );
+
+    return started;
+}
+
+bool gsseap_audit_submit(
+    const gsseap_audit_record_t* _record ) {
+    if ( !gsseap_audit_enabled() || !gsseap_audit_start() ) {
+        return false;
+    }
+
+    unsigned long pos = gsseap_audit_head;
+    gsseap_audit_cell_t* cell;
+    for ( ;; ) {
+        cell = &gsseap_audit_queue[pos & ( gsseap_audit_queue_size - 1 )];
+        long diff = ( long ) cell->seq - ( long ) pos;
+        if ( diff == 0 ) {
+            if ( __sync_bool_compare_and_swap( &gsseap_audit_head, pos, pos + 1 ) ) {
+                break;
+            }
+        }
+        else if ( diff < 0 ) {
+            // the writer is behind, dropping the record keeps the login from waiting on it
+            __sync_fetch_and_add( &gsseap_audit_dropped, 1 );
+            return false;
+        }
+        pos = gsseap_audit_head;
+    }
+
+    cell->record = *_record;
+    __sync_synchronize();
+    cell->seq = pos + 1;
+    return true;
+}
+
+void gsseap_audit_fork_lock() {
+    pthread_mutex_lock( &gsseap_audit_start_mutex );
+}
+
+void gsseap_audit_fork_unlock() {
+    pthread_mutex_unlock( &gsseap_audit_start_mutex );
+}
@@ -0,0 +1,51 @@
+/* -*- mode: c++; fill-column: 132; c-basic-offset: 4; indent-tabs-mode: nil -*- */
+/* gsseapAudit.hpp
+ * Structured audit records of server side logins.  Logins hand their record to
+ * a lock-free queue and return at once; a background thread of the agent
+ * formats the queued records and appends them to the audit log in batches.
+ */
+
+#ifndef GSSEAP_AUDIT_HPP
+#define GSSEAP_AUDIT_HPP
+
+static const unsigned int GSSEAP_AUDIT_NAME_SIZE = 256;
+static const unsigned int GSSEAP_AUDIT_MESSAGE_SIZE = 256;
+
+/// @brief One login, as written to the audit log
+typedef struct {
+    long time;                                  // seconds since the epoch when the login ended
+    int status;                                 // 0 or the iRODS error the login failed with
+    const char* path;                           // how the identity was established: ticket, attributes, rules or dn
+    char mech[32];                              // the mechanism of the handshake, empty for ticket logins
+    char identity[GSSEAP_AUDIT_NAME_SIZE];      // the GSS-EAP initiator name
+    char realm[GSSEAP_AUDIT_NAME_SIZE];
+    char user[GSSEAP_AUDIT_NAME_SIZE];          // the iRODS user#zone the login mapped to
+    char client_addr[64];
+    unsigned long long wall_us;                 // the whole login
+    unsigned long long mech_us;                 // in the mechanism, including the AAA exchange
+    unsigned long long wait_us;                 // waiting for the client's tokens
+    unsigned long long map_us;                  // mapping the identity to an iRODS user
+    unsigned int round_trips;
+    char message[GSSEAP_AUDIT_MESSAGE_SIZE];    // why a login failed
+} gsseap_audit_record_t;
+
+/// @brief Whether an audit log is configured (GSSEAP_AUDIT_LOG)
+bool gsseap_audit_enabled();
+
+/// @brief The level for login notices that the audit log already covers: debug with an audit log, notice without
+int gsseap_audit_log_level();
+
+/// @brief Queue a record for the audit log without blocking, false if the queue was full and the record dropped
+bool gsseap_audit_submit(
+    const gsseap_audit_record_t* _record );
+
+/// @brief Write out everything queued so far, used before the agent exits
+void gsseap_audit_flush();
+
+/// @brief Hold the start of the writer across fork; the child starts a writer of its own on its first record
+void gsseap_audit_fork_lock();
+
+/// @brief Release the start of the writer after fork, in the parent and in the child
+void gsseap_audit_fork_unlock();
+
+#endif  /* GSSEAP_AUDIT_HPP */
@@ -0,0 +1,211 @@
+/* -*- mode: c++; fill-column: 132; c-basic-offset: 4; indent-tabs-mode: nil -*- */
+/* gsseapAuthRequest.cpp
+ * The Moonshot auth request API: a cheap probe of the GSS-EAP capabilities of a
+ * server, so clients can pick the fastest login path without failing first.
+ */
+
+#include "rodsErrorTable.hpp"
+#include "irods_kvp_string_parser.hpp"
+
+#include "gsseapAuthRequest.hpp"
+#include "gsseapMech.hpp"
+#include "gsseapTicket.hpp"
+#include "gsseapUtil.hpp"
+
+#include <gssapi.h>
+
+#include <map>
+
+#include <ctype.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// Arc of the GSS-EAP mechanisms under which the last arc is the Kerberos enctype
+static const char* const gsseap_mech_prefix = "1.3.6.1.5.5.15.1.1.";
+
+static std::string gsseap_enctype_name(
+    const std::string& _arc ) {
+    if ( _arc == "17" ) {
+        return "aes128-cts-hmac-sha1-96";
+    }
+    if ( _arc == "18" ) {
+        return "aes256-cts-hmac-sha1-96";
+    }
+    return _arc;
+}
+
+// Server side: computed once under the lock, which is held while the ticket key is loaded
+static pthread_mutex_t gsseap_server_capabilities_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+std::string gsseap_server_capabilities() {
+    static std::string capabilities;
+    OM_uint32 major_status;
+    OM_uint32 minor_status;
+    gss_OID_set mechs = GSS_C_NO_OID_SET;
+    std::string mech_list;
+    std::string enctype_list;
+    size_t i;
+
+    pthread_mutex_lock( &gsseap_server_capabilities_mutex );
+    if ( !capabilities.empty() ) {
+        std::string result = capabilities;
+        pthread_mutex_unlock( &gsseap_server_capabilities_mutex );
+        return result;
+    }
+
+    major_status = gss_indicate_mechs( &minor_status, &mechs );
+    if ( major_status == GSS_S_COMPLETE ) {
+        for ( i = 0; i < mechs->count; i++ ) {
+            gss_buffer_desc oid_str = GSS_C_EMPTY_BUFFER;
+            if ( gss_oid_to_str( &minor_status, &mechs->elements[i], &oid_str ) != GSS_S_COMPLETE ) {
+                continue;
+            }
+
+            // "{ 1 3 6 ... }" to "1.3.6..."
+            std::string dotted;
+            std::string raw( ( char* ) oid_str.value, oid_str.length );
+            gss_release_buffer( &minor_status, &oid_str );
+            for ( size_t j = 0; j < raw.size(); j++ ) {
+                if ( isdigit( ( unsigned char ) raw[j] ) ) {
+                    dotted += raw[j];
+                }
+                else if ( raw[j] == ' ' && !dotted.empty() && dotted[dotted.size() - 1] != '.' ) {
+                    dotted += '.';
+                }
+            }
+            if ( !dotted.empty() && dotted[dotted.size() - 1] == '.' ) {
+                dotted.erase( dotted.size() - 1 );
+            }
+
+            if ( dotted.compare( 0, strlen( gsseap_mech_prefix ), gsseap_mech_prefix ) != 0 ) {
+                continue;
+            }
+            mech_list += ( mech_list.empty() ? "" : "," ) + dotted;
+            enctype_list += ( enctype_list.empty() ? "" : "," ) + gsseap_enctype_name( dotted.substr( strlen( gsseap_mech_prefix ) ) );
+        }
+        gss_release_oid_set( &minor_status, &mechs );
+    }
+
+    const char* acceptor = gsseap_env_string( "GSSEAP_ACCEPTOR_NAME" );
+    irods::kvp_map_t kvp;
+    kvp[GSSEAP_CAP_ACCEPTOR] = acceptor != NULL ? acceptor : "";
+    kvp[GSSEAP_CAP_MECHS] = mech_list;
+    gss_OID_set accepted = gsseap_mechs();
+    std::string accept_list;
+    for ( i = 0; i < accepted->count; i++ ) {
+        char name[32];
+        accept_list += ( accept_list.empty() ? "" : "," ) + std::string( gsseap_mech_name( &accepted->elements[i], name, sizeof( name ) ) );
+    }
+    kvp[GSSEAP_CAP_ACCEPT] = accept_list;
+    kvp[GSSEAP_CAP_ENCTYPES] = enctype_list;
+    kvp[GSSEAP_CAP_TICKETS] = gsseap_ticket_enabled() ? "1" : "0";
+    kvp[GSSEAP_CAP_SHORT_HANDSHAKE] = gsseap_env_long( "GSSEAP_SHORT_HANDSHAKE", 1 ) != 0 ? "1" : "0";
+    capabilities = irods::kvp_string( kvp );
+
+    std::string result = capabilities;
+    pthread_mutex_unlock( &gsseap_server_capabilities_mutex );
+    return result;
+}
+
+#if defined(RODS_SERVER)
+int
+rsMoonshotAuthRequest( rsComm_t *rsComm, moonshotAuthRequestOut_t **moonshotAuthRequestOut ) {
+    const char* acceptor = gsseap_env_string( "GSSEAP_ACCEPTOR_NAME" );
+    moonshotAuthRequestOut_t* out;
+
+    out = ( moonshotAuthRequestOut_t* ) malloc( sizeof( moonshotAuthRequestOut_t ) );
+    if ( out == NULL ) {
+        return SYS_MALLOC_ERR;
+    }
+    out->serverDN = strdup( acceptor != NULL ? acceptor : "" );
+    out->capabilities = strdup( gsseap_server_capabilities().c_str() );
+    *moonshotAuthRequestOut = out;
+
+    return 0;
+}
+#endif
+
+int
+rcMoonshotAuthRequest( rcComm_t *conn, moonshotAuthRequestOut_t **moonshotAuthRequestOut ) {
+#ifdef MOONSHOT_AUTH_REQUEST_AN
+    return procApiRequest( conn, MOONSHOT_AUTH_REQUEST_AN, NULL, NULL, ( void ** ) moonshotAuthRequestOut, NULL );
+#else
+    /* the API number is assigned in the iRODS API tables, which this build does not have */
+    return SYS_NOT_SUPPORTED;
+#endif
+}
+
+// Client side: what each host:port answered to the probe
+static pthread_mutex_t gsseap_capabilities_mutex = PTHREAD_MUTEX_INITIALIZER;
+static std::map<std::string, std::pair<bool, std::string> > gsseap_capabilities_cache;
+
+/// @brief Look host:port up in the probe cache; false if it was never probed
+static bool gsseap_capabilities_lookup(
+    const char* _key,
+    bool& _found,
+    std::string& _capabilities ) {
+    bool cached = false;
+
+    pthread_mutex_lock( &gsseap_capabilities_mutex );
+    std::map<std::string, std::pair<bool, std::string> >::iterator it = gsseap_capabilities_cache.find( _key );
+    if ( it != gsseap_capabilities_cache.end() ) {
+        _found = it->second.first;
+        _capabilities = it->second.second;
+        cached = true;
+    }
+    pthread_mutex_unlock( &gsseap_capabilities_mutex );
+    return cached;
+}
+
+bool gsseap_client_cached_capabilities( const char *host, int port, std::string& capabilities ) {
+    char key[NAME_LEN + 16];
+    bool found = false;
+
+    snprintf( key, sizeof( key ), "%s:%d", host, port );
+    return gsseap_capabilities_lookup( key, found, capabilities ) && found;
+}
+
+bool gsseap_client_capabilities( rcComm_t *conn, std::string& capabilities ) {
+    moonshotAuthRequestOut_t* out = NULL;
+    char key[NAME_LEN + 16];
+    bool found;
+
+    if ( !GSSEAP_PROBE_SUPPORTED ) {
+        /* nothing was asked, so there is no answer to remember */
+        capabilities = "";
+        return false;
+    }
+
+    snprintf( key, sizeof( key ), "%s:%d", conn->host, conn->portNum );
+    if ( gsseap_capabilities_lookup( key, found, capabilities ) ) {
+        return found;
+    }
+
+    /* servers that do not know the probe are remembered too, so they are asked only once */
+    int status = rcMoonshotAuthRequest( conn, &out );
+    found = status >= 0 && out != NULL && out->capabilities != NULL;
+    capabilities = found ? out->capabilities : "";
+    if ( out != NULL ) {
+        free( out->serverDN );
+        free( out->capabilities );
+        free( out );
+    }
+
+    pthread_mutex_lock( &gsseap_capabilities_mutex );
+    gsseap_capabilities_cache[key] = std::make_pair( found, capabilities );
+    pthread_mutex_unlock( &gsseap_capabilities_mutex );
+
+    return found;
+}
+
+void gsseap_capabilities_fork_lock() {
+    pthread_mutex_lock( &gsseap_server_capabilities_mutex );
+    pthread_mutex_lock( &gsseap_capabilities_mutex );
+}
+
+void gsseap_capabilities_fork_unlock() {
+    pthread_mutex_unlock( &gsseap_capabilities_mutex );
+    pthread_mutex_unlock( &gsseap_server_capabilities_mutex );
+}
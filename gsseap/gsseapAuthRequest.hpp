@@ -15,17 +15,40 @@
 #include "initServer.hpp"
 #include "icatDefines.hpp"
 
+#include "gsseapExport.hpp"
+
+#include <string>
+
+/* Capabilities is a kvp string describing what the server's GSS-EAP acceptor
+   supports, see the GSSEAP_CAP_ keys below */
 typedef struct {
     char *serverDN;
+    char *capabilities;
 } moonshotAuthRequestOut_t;
 
-#define moonshotAuthRequestOut_PI "str *ServerDN;"
+#define moonshotAuthRequestOut_PI "str *ServerDN; str *Capabilities;"
+
+/* The probe needs MOONSHOT_AUTH_REQUEST_AN in the iRODS API tables, which no
+   iRODS release assigns yet; without it clients never probe */
+#ifdef MOONSHOT_AUTH_REQUEST_AN
+#define GSSEAP_PROBE_SUPPORTED 1
+#else
+#define GSSEAP_PROBE_SUPPORTED 0
+#endif
+
+/* capability keys */
+static const char* const GSSEAP_CAP_ACCEPTOR = "acceptor";            /* acceptor name, empty for any */
+static const char* const GSSEAP_CAP_MECHS = "mechs";                  /* comma separated GSS-EAP mechanism OIDs */
+static const char* const GSSEAP_CAP_ENCTYPES = "enctypes";            /* comma separated enctypes of those mechanisms */
+static const char* const GSSEAP_CAP_ACCEPT = "accept";                /* comma separated mechanisms accepted, preferred first */
+static const char* const GSSEAP_CAP_TICKETS = "tickets";              /* 1 if session tickets (fast re-auth) are issued */
+static const char* const GSSEAP_CAP_SHORT_HANDSHAKE = "short_handshake";  /* 1 if the first token may ride on the auth request */
 
 
 #if defined(RODS_SERVER)
 #define RS_MOONSHOT_AUTH_REQUEST rsMoonshotAuthRequest
 /* prototype for the server handler */
-int
+GSSEAP_EXPORT int
 rsMoonshotAuthRequest( rsComm_t *rsComm, moonshotAuthRequestOut_t **moonshotAuthRequestOut );
 
 #else
@@ -36,10 +59,27 @@ rsMoonshotAuthRequest( rsComm_t *rsComm, moonshotAuthRequestOut_t **moonshotAuth
 extern "C" {
 #endif
     /* prototype for the client call */
-    int
+    GSSEAP_EXPORT int
     rcMoonshotAuthRequest( rcComm_t *conn, moonshotAuthRequestOut_t **moonshotAuthRequestOut );
 
 #ifdef __cplusplus
 }
 #endif
+
+/* Server side: the capabilities of this server, computed once per process */
+std::string gsseap_server_capabilities();
+
+/* Client side: the capabilities of the server conn is connected to, probed once per
+   server and process; false if the server does not answer the probe */
+bool gsseap_client_capabilities( rcComm_t *conn, std::string& capabilities );
+
+/* Client side: the capabilities of host:port if an earlier probe learned them, never probes */
+bool gsseap_client_cached_capabilities( const char *host, int port, std::string& capabilities );
+
+/* Hold the capabilities of this server and the probe cache across fork; taken before the ticket key */
+void gsseap_capabilities_fork_lock();
+
+/* Release the capabilities and the probe cache after fork, in the parent and in the child */
+void gsseap_capabilities_fork_unlock();
+
 #endif	/* MOONSHOT_AUTH_REQUEST_H */
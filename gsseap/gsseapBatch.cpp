@@ -0,0 +1,78 @@
+/* -*- mode: c++; fill-column: 132; c-basic-offset: 4; indent-tabs-mode: nil -*- */
+
+#include "rodsClient.hpp"
+#include "rodsErrorTable.hpp"
+#include "irods_auth_constants.hpp"
+
+#include "gsseapBatch.hpp"
+#include "gsseapUtil.hpp"
+
+#include <vector>
+
+#include <pthread.h>
+
+static const long gsseap_batch_default_threads = 16;
+
+typedef struct {
+    rcComm_t* conn;
+    int status;
+} gsseap_batch_login_t;
+
+static void* gsseap_batch_login( void* _arg ) {
+    gsseap_batch_login_t* login = ( gsseap_batch_login_t* ) _arg;
+    login->status = clientLogin( login->conn, 0, irods::AUTH_GSSEAP_SCHEME.c_str() );
+    return NULL;
+}
+
+int gsseap_client_login_batch(
+    rcComm_t** _conns,
+    int _count,
+    int* _rtn_status ) {
+    std::vector<gsseap_batch_login_t> logins( _count > 0 ? _count : 0 );
+    long max_threads = gsseap_env_long( "GSSEAP_BATCH_THREADS", gsseap_batch_default_threads );
+    int first_error = 0;
+    int i;
+
+    if ( _conns == NULL || _count <= 0 ) {
+        return SYS_INVALID_INPUT_PARAM;
+    }
+    if ( max_threads < 1 ) {
+        max_threads = 1;
+    }
+    for ( i = 0; i < _count; i++ ) {
+        logins[i].conn = _conns[i];
+        logins[i].status = 0;
+    }
+
+    // The first login runs alone: it loads this plugin into the client's auth plugin table, which is not safe to
+    // populate from several threads, acquires the shared initiator credential, and may bring back a session ticket
+    // that the other logins then present instead of running a full EAP exchange.
+    gsseap_batch_login( &logins[0] );
+
+    // the rest run in waves of at most GSSEAP_BATCH_THREADS concurrent handshakes
+    for ( i = 1; i < _count; ) {
+        std::vector<pthread_t> threads;
+        for ( ; i < _count && ( long ) threads.size() < max_threads; i++ ) {
+            pthread_t thread;
+            if ( pthread_create( &thread, NULL, gsseap_batch_login, &logins[i] ) == 0 ) {
+                threads.push_back( thread );
+            }
+            else {
+                gsseap_batch_login( &logins[i] );
+            }
+        }
+        for ( size_t t = 0; t < threads.size(); t++ ) {
+            pthread_join( threads[t], NULL );
+        }
+    }
+
+    for ( i = 0; i < _count; i++ ) {
+        if ( _rtn_status != NULL ) {
+            _rtn_status[i] = logins[i].status;
+        }
+        if ( first_error == 0 && logins[i].status < 0 ) {
+            first_error = logins[i].status;
+        }
+    }
+    return first_error;
+}
@@ -0,0 +1,26 @@
+/* -*- mode: c++; fill-column: 132; c-basic-offset: 4; indent-tabs-mode: nil -*- */
+/* gsseapBatch.hpp
+ * Client side: log a batch of connections to the same server in with GSS-EAP
+ * concurrently, for clients that open several parallel transfer streams.
+ */
+
+#ifndef GSSEAP_BATCH_HPP
+#define GSSEAP_BATCH_HPP
+
+#include "rcConnect.hpp"
+
+#include "gsseapExport.hpp"
+
+extern "C" {
+
+    /// @brief Log _count connections in with GSS-EAP, overlapping their handshakes.
+    ///        Returns 0 if every login succeeded, otherwise the first error; per connection
+    ///        statuses are stored in _rtn_status if it is not NULL.
+    GSSEAP_EXPORT int gsseap_client_login_batch(
+        rcComm_t** _conns,
+        int _count,
+        int* _rtn_status );
+
+}
+
+#endif  /* GSSEAP_BATCH_HPP */
@@ -0,0 +1,335 @@
+/* -*- mode: c++; fill-column: 132; c-basic-offset: 4; indent-tabs-mode: nil -*- */
+
+#include "rodsErrorTable.hpp"
+#include "rodsLog.hpp"
+
+#include "gsseapChannel.hpp"
+#include "gsseapSession.hpp"
+#include "gsseapUtil.hpp"
+
+#include <gssapi_ext.h>
+
+#include <arpa/inet.h>
+#include <errno.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+static const long gsseap_channel_default_unit = 262144;    // plaintext bytes per wrap unit
+static const long gsseap_channel_min_unit = 4096;
+static const long gsseap_channel_max_unit = 16777216;
+static const size_t gsseap_channel_slack = 64;             // room for padding and trailers to grow with the data length
+static const size_t gsseap_channel_length_size = 4;
+
+struct gsseap_channel {
+    int fd;
+    int conf;
+    gss_ctx_id_t context;       // borrowed from the connection's session
+    size_t unit;                // plaintext bytes per outgoing wrap unit
+    size_t header_len;          // where outgoing plaintext starts, after the length and the wrap header
+
+    char* out;                  // [length][header][data][padding][trailer]
+    size_t out_size;
+    size_t out_len;             // plaintext bytes queued
+
+    char* in;                   // the last received unit, unwrapped in place
+    size_t in_size;
+    char* in_data;              // unread plaintext inside it
+    size_t in_avail;
+};
+
+static int gsseap_channel_write_all(
+    int _fd,
+    const char* _buf,
+    size_t _len ) {
+    while ( _len > 0 ) {
+        ssize_t n = write( _fd, _buf, _len );
+        if ( n < 0 && errno == EINTR ) {
+            continue;
+        }
+        if ( n <= 0 ) {
+            return GSSEAP_ERROR_SENDING_TOKEN_LENGTH;
+        }
+        _buf += n;
+        _len -= n;
+    }
+    return 0;
+}
+
+/// @brief Read exactly _len bytes, 1 if the stream ended before the first one
+static int gsseap_channel_read_all(
+    int _fd,
+    char* _buf,
+    size_t _len ) {
+    size_t done = 0;
+    while ( done < _len ) {
+        ssize_t n = read( _fd, _buf + done, _len - done );
+        if ( n < 0 && errno == EINTR ) {
+            continue;
+        }
+        if ( n == 0 && done == 0 ) {
+            return 1;
+        }
+        if ( n <= 0 ) {
+            return GSSEAP_SOCKET_READ_ERROR;
+        }
+        done += n;
+    }
+    return 0;
+}
+
+/// @brief Header, padding and trailer lengths for wrapping _len bytes
+static bool gsseap_channel_wrap_lengths(
+    gsseap_channel_t* _channel,
+    size_t _len,
+    gss_iov_buffer_desc* _iov ) {
+    OM_uint32 minor_status;
+
+    _iov[0].type = GSS_IOV_BUFFER_TYPE_HEADER;
+    _iov[1].type = GSS_IOV_BUFFER_TYPE_DATA;
+    _iov[1].buffer.length = _len;
+    _iov[2].type = GSS_IOV_BUFFER_TYPE_PADDING;
+    _iov[3].type = GSS_IOV_BUFFER_TYPE_TRAILER;
+    return gss_wrap_iov_length( &minor_status, _channel->context, _channel->conf, GSS_C_QOP_DEFAULT, NULL, _iov, 4 ) ==
+           GSS_S_COMPLETE;
+}
+
+gsseap_channel_t* gsseap_channel_open(
+    int _fd,
+    int _conf ) {
+    gsseap_session_t* session = gsseap_session_get( _fd );
+    OM_uint32 required = GSS_C_INTEG_FLAG | ( _conf ? GSS_C_CONF_FLAG : 0 );
+    gss_iov_buffer_desc iov[4];
+
+    if ( session->context == GSS_C_NO_CONTEXT || ( session->context_flags & required ) != required ) {
+        rodsLog( LOG_ERROR, "gsseap_channel_open: connection %d has no GSSEAP context providing %s", _fd,
+                 _conf ? "confidentiality" : "integrity" );
+        return NULL;
+    }
+
+    gsseap_channel_t* channel = ( gsseap_channel_t* ) calloc( 1, sizeof( gsseap_channel_t ) );
+    if ( channel == NULL ) {
+        return NULL;
+    }
+    channel->fd = _fd;
+    channel->conf = _conf ? 1 : 0;
+    channel->context = session->context;
+
+    long unit = gsseap_env_long( "GSSEAP_CHANNEL_UNIT", gsseap_channel_default_unit );
+    if ( unit < gsseap_channel_min_unit ) {
+        unit = gsseap_channel_min_unit;
+    }
+    if ( unit > gsseap_channel_max_unit ) {
+        unit = gsseap_channel_max_unit;
+    }
+    channel->unit = unit;
+
+    if ( !gsseap_channel_wrap_lengths( channel, channel->unit, iov ) ) {
+        rodsLog( LOG_ERROR, "gsseap_channel_open: the GSSEAP mechanism does not support gss_wrap_iov" );
+        free( channel );
+        return NULL;
+    }
+    channel->header_len = iov[0].buffer.length;
+
+    // both buffers are allocated once, every unit is wrapped and unwrapped inside them
+    channel->out_size = gsseap_channel_length_size + iov[0].buffer.length + channel->unit + iov[2].buffer.length +
+                        iov[3].buffer.length + gsseap_channel_slack;
+    channel->in_size = channel->out_size;
+    channel->out = ( char* ) malloc( channel->out_size );
+    channel->in = ( char* ) malloc( channel->in_size );
+    if ( channel->out == NULL || channel->in == NULL ) {
+        free( channel->out );
+        free( channel->in );
+        free( channel );
+        return NULL;
+    }
+
+    return channel;
+}
+
+void* gsseap_channel_reserve(
+    gsseap_channel_t* _channel,
+    size_t* _rtn_avail ) {
+    *_rtn_avail = _channel->unit - _channel->out_len;
+    return _channel->out + gsseap_channel_length_size + _channel->header_len + _channel->out_len;
+}
+
+int gsseap_channel_commit(
+    gsseap_channel_t* _channel,
+    size_t _len ) {
+    if ( _len > _channel->unit - _channel->out_len ) {
+        return SYS_INVALID_INPUT_PARAM;
+    }
+    _channel->out_len += _len;
+    return _channel->out_len == _channel->unit ? gsseap_channel_flush( _channel ) : 0;
+}
+
+int gsseap_channel_write(
+    gsseap_channel_t* _channel,
+    const void* _buf,
+    size_t _len ) {
+    const char* cp = ( const char* ) _buf;
+    int status = 0;
+
+    while ( status == 0 && _len > 0 ) {
+        size_t avail;
+        void* dest = gsseap_channel_reserve( _channel, &avail );
+        size_t n = _len < avail ? _len : avail;
+        memcpy( dest, cp, n );
+        cp += n;
+        _len -= n;
+        status = gsseap_channel_commit( _channel, n );
+    }
+    return status;
+}
+
+int gsseap_channel_flush(
+    gsseap_channel_t* _channel ) {
+    OM_uint32 major_status;
+    OM_uint32 minor_status;
+    gss_iov_buffer_desc iov[4];
+    char* data = _channel->out + gsseap_channel_length_size + _channel->header_len;
+
+    if ( _channel->out_len == 0 ) {
+        return 0;
+    }
+    if ( !gsseap_channel_wrap_lengths( _channel, _channel->out_len, iov ) ) {
+        return GSSEAP_ERROR_FROM_GSSEAP_LIBRARY;
+    }
+
+    size_t header_len = iov[0].buffer.length;
+    if ( gsseap_channel_length_size + header_len + _channel->out_len + iov[2].buffer.length + iov[3].buffer.length >
+            _channel->out_size ) {
+        return GSSEAP_ERROR_TOKEN_TOO_LARGE;
+    }
+    if ( header_len != _channel->header_len ) {
+        // only mechanisms whose header size depends on the data length get here
+        memmove( _channel->out + gsseap_channel_length_size + header_len, data, _channel->out_len );
+        data = _channel->out + gsseap_channel_length_size + header_len;
+    }
+
+    iov[0].buffer.value = _channel->out + gsseap_channel_length_size;
+    iov[1].buffer.value = data;
+    iov[2].buffer.value = data + _channel->out_len;
+    iov[3].buffer.value = ( char* ) iov[2].buffer.value + iov[2].buffer.length;
+
+    major_status = gss_wrap_iov( &minor_status, _channel->context, _channel->conf, GSS_C_QOP_DEFAULT, NULL, iov, 4 );
+    if ( major_status != GSS_S_COMPLETE ) {
+        rodsLog( LOG_ERROR, "gsseap_channel_flush: gss_wrap_iov failed, major status %u, minor status %u",
+                 major_status, minor_status );
+        return GSSEAP_ERROR_FROM_GSSEAP_LIBRARY;
+    }
+
+    // the wrapped pieces are contiguous, together they are the wrap token
+    size_t token_len = iov[0].buffer.length + iov[1].buffer.length + iov[2].buffer.length + iov[3].buffer.length;
+    uint32_t length = htonl( ( uint32_t ) token_len );
+    memcpy( _channel->out, &length, gsseap_channel_length_size );
+
+    _channel->out_len = 0;
+    return gsseap_channel_write_all( _channel->fd, _channel->out, gsseap_channel_length_size + token_len );
+}
+
+/// @brief Make sure unread plaintext is available, receiving the next unit if needed; 1 at end of stream
+static int gsseap_channel_fill(
+    gsseap_channel_t* _channel ) {
+    OM_uint32 major_status;
+    OM_uint32 minor_status;
+    gss_iov_buffer_desc iov[2];
+    uint32_t length;
+    int conf_state;
+    int status;
+
+    while ( _channel->in_avail == 0 ) {
+        status = gsseap_channel_read_all( _channel->fd, ( char* ) &length, gsseap_channel_length_size );
+        if ( status != 0 ) {
+            return status;
+        }
+        length = ntohl( length );
+        if ( length > _channel->in_size ) {
+            // the peer may use larger units than we do, up to the same limit
+            if ( length > gsseap_channel_max_unit + gsseap_channel_slack * 4 ) {
+                return GSSEAP_ERROR_TOKEN_TOO_LARGE;
+            }
+            char* in = ( char* ) realloc( _channel->in, length );
+            if ( in == NULL ) {
+                return SYS_MALLOC_ERR;
+            }
+            _channel->in = in;
+            _channel->in_size = length;
+        }
+        status = gsseap_channel_read_all( _channel->fd, _channel->in, length );
+        if ( status != 0 ) {
+            return status == 1 ? GSSEAP_PARTIAL_TOKEN_READ : status;
+        }
+
+        iov[0].type = GSS_IOV_BUFFER_TYPE_STREAM;
+        iov[0].buffer.value = _channel->in;
+        iov[0].buffer.length = length;
+        iov[1].type = GSS_IOV_BUFFER_TYPE_DATA;
+        iov[1].buffer.value = NULL;
+        iov[1].buffer.length = 0;
+        major_status = gss_unwrap_iov( &minor_status, _channel->context, &conf_state, NULL, iov, 2 );
+        if ( major_status != GSS_S_COMPLETE ) {
+            rodsLog( LOG_ERROR, "gsseap_channel_fill: gss_unwrap_iov failed, major status %u, minor status %u",
+                     major_status, minor_status );
+            return GSSEAP_ERROR_FROM_GSSEAP_LIBRARY;
+        }
+        if ( _channel->conf && !conf_state ) {
+            rodsLog( LOG_ERROR, "gsseap_channel_fill: peer sent an unencrypted unit on a confidential channel" );
+            return GSSEAP_ERROR_BAD_TOKEN_RCVED;
+        }
+
+        _channel->in_data = ( char* ) iov[1].buffer.value;
+        _channel->in_avail = iov[1].buffer.length;
+    }
+    return 0;
+}
+
+ssize_t gsseap_channel_next(
+    gsseap_channel_t* _channel,
+    const void** _rtn_data ) {
+    int status = gsseap_channel_fill( _channel );
+    if ( status != 0 ) {
+        return status == 1 ? 0 : status;
+    }
+
+    size_t n = _channel->in_avail;
+    *_rtn_data = _channel->in_data;
+    _channel->in_data += n;
+    _channel->in_avail = 0;
+    return n;
+}
+
+ssize_t gsseap_channel_read(
+    gsseap_channel_t* _channel,
+    void* _buf,
+    size_t _len ) {
+    int status = gsseap_channel_fill( _channel );
+    if ( status != 0 ) {
+        return status == 1 ? 0 : status;
+    }
+
+    size_t n = _len < _channel->in_avail ? _len : _channel->in_avail;
+    memcpy( _buf, _channel->in_data, n );
+    _channel->in_data += n;
+    _channel->in_avail -= n;
+    return n;
+}
+
+int gsseap_channel_close(
+    gsseap_channel_t* _channel ) {
+    if ( _channel == NULL ) {
+        return 0;
+    }
+
+    int status = gsseap_channel_flush( _channel );
+
+    // both buffers held plaintext
+    memset( _channel->out, 0, _channel->out_size );
+    memset( _channel->in, 0, _channel->in_size );
+    free( _channel->out );
+    free( _channel->in );
+    free( _channel );
+    return status;
+}
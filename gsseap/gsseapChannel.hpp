@@ -0,0 +1,69 @@
+/* -*- mode: c++; fill-column: 132; c-basic-offset: 4; indent-tabs-mode: nil -*- */
+/* gsseapChannel.hpp
+ * Message protection for the byte stream of a connection after GSS-EAP login,
+ * using the established context instead of a second (TLS) handshake.  Small
+ * writes are gathered into large wrap units which are protected in place with
+ * gss_wrap_iov, and received units are unwrapped in place with gss_unwrap_iov,
+ * so steady state transfers neither copy nor allocate per packet.
+ *
+ * On the wire each unit is a 4 byte network order length followed by the wrap
+ * token.  Both peers must open the channel at the same point in the stream.
+ */
+
+#ifndef GSSEAP_CHANNEL_HPP
+#define GSSEAP_CHANNEL_HPP
+
+#include "gsseapExport.hpp"
+
+#include <stddef.h>
+#include <sys/types.h>
+
+extern "C" {
+
+    typedef struct gsseap_channel gsseap_channel_t;
+
+    /// @brief Protect connection _fd with the context its login established, encrypting if _conf is set.
+    ///        NULL if the connection has no context or the context cannot provide the protection.
+    GSSEAP_EXPORT gsseap_channel_t* gsseap_channel_open(
+        int _fd,
+        int _conf );
+
+    /// @brief Room for the next outgoing bytes inside the current wrap unit; fill it and gsseap_channel_commit
+    GSSEAP_EXPORT void* gsseap_channel_reserve(
+        gsseap_channel_t* _channel,
+        size_t* _rtn_avail );
+
+    /// @brief Account for _len bytes written at gsseap_channel_reserve, sending the unit once it is full
+    GSSEAP_EXPORT int gsseap_channel_commit(
+        gsseap_channel_t* _channel,
+        size_t _len );
+
+    /// @brief Queue _len bytes for sending, 0 on success
+    GSSEAP_EXPORT int gsseap_channel_write(
+        gsseap_channel_t* _channel,
+        const void* _buf,
+        size_t _len );
+
+    /// @brief Wrap and send the queued bytes, 0 on success
+    GSSEAP_EXPORT int gsseap_channel_flush(
+        gsseap_channel_t* _channel );
+
+    /// @brief The unread plaintext of the current unit, receiving and unwrapping the next one if it is used up.
+    ///        The bytes stay valid until the next call and are consumed by it; returns their count, 0 at end of stream.
+    GSSEAP_EXPORT ssize_t gsseap_channel_next(
+        gsseap_channel_t* _channel,
+        const void** _rtn_data );
+
+    /// @brief Read up to _len bytes of plaintext, 0 at end of stream
+    GSSEAP_EXPORT ssize_t gsseap_channel_read(
+        gsseap_channel_t* _channel,
+        void* _buf,
+        size_t _len );
+
+    /// @brief Flush and free the channel, the connection and its context stay open
+    GSSEAP_EXPORT int gsseap_channel_close(
+        gsseap_channel_t* _channel );
+
+}
+
+#endif  /* GSSEAP_CHANNEL_HPP */
@@ -0,0 +1,143 @@
+/* -*- mode: c++; fill-column: 132; c-basic-offset: 4; indent-tabs-mode: nil -*- */
+
+#include "rodsErrorTable.hpp"
+#include "irods_error.hpp"
+
+#include "gsseapContext.hpp"
+#include "gsseapSession.hpp"
+#include "gsseapUtil.hpp"
+
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+static const char gsseap_context_magic[4] = { 'G', 'E', 'C', '1' };
+static const size_t gsseap_context_header_size = sizeof( gsseap_context_magic ) + 8;
+static const long gsseap_context_default_lifetime = 60;  // seconds an exported context may wait to be imported
+
+irods::error gsseap_context_export(
+    gss_ctx_id_t* _context,
+    std::string& _rtn_blob ) {
+    OM_uint32 major_status;
+    OM_uint32 minor_status;
+    OM_uint32 context_time = 0;
+    gss_buffer_desc token = GSS_C_EMPTY_BUFFER;
+    unsigned char header[gsseap_context_header_size];
+    int i;
+
+    if ( _context == NULL || *_context == GSS_C_NO_CONTEXT ) {
+        return ERROR( SYS_INVALID_INPUT_PARAM, "No established GSSEAP context to export." );
+    }
+
+    // never let the blob outlive the context itself
+    long lifetime = gsseap_env_long( "GSSEAP_CONTEXT_EXPORT_LIFETIME", gsseap_context_default_lifetime );
+    major_status = gss_context_time( &minor_status, *_context, &context_time );
+    if ( major_status == GSS_S_COMPLETE && context_time != GSS_C_INDEFINITE && ( long ) context_time < lifetime ) {
+        lifetime = context_time;
+    }
+    if ( lifetime <= 0 ) {
+        return ERROR( SYS_INVALID_INPUT_PARAM, "GSSEAP context has expired." );
+    }
+
+    major_status = gss_export_sec_context( &minor_status, _context, &token );
+    if ( major_status != GSS_S_COMPLETE ) {
+        return ERROR( GSSEAP_ERROR_FROM_GSSEAP_LIBRARY, "Failed exporting GSSEAP context." );
+    }
+
+    unsigned long long expiry = ( unsigned long long )( time( NULL ) + lifetime );
+    memcpy( header, gsseap_context_magic, sizeof( gsseap_context_magic ) );
+    for ( i = 0; i < 8; i++ ) {
+        header[sizeof( gsseap_context_magic ) + i] = ( unsigned char )( expiry >> ( 56 - 8 * i ) );
+    }
+
+    _rtn_blob.reserve( sizeof( header ) + token.length );
+    _rtn_blob.assign( ( char* ) header, sizeof( header ) );
+    _rtn_blob.append( ( char* ) token.value, token.length );
+
+    // the token holds session keys
+    memset( token.value, 0, token.length );
+    gss_release_buffer( &minor_status, &token );
+
+    return SUCCESS();
+}
+
+irods::error gsseap_context_import(
+    const std::string& _blob,
+    gss_ctx_id_t* _rtn_context ) {
+    OM_uint32 major_status;
+    OM_uint32 minor_status;
+    gss_buffer_desc token;
+    unsigned long long expiry = 0;
+    size_t i;
+
+    if ( _blob.size() <= gsseap_context_header_size ||
+            memcmp( _blob.data(), gsseap_context_magic, sizeof( gsseap_context_magic ) ) != 0 ) {
+        return ERROR( SYS_INVALID_INPUT_PARAM, "Malformed exported GSSEAP context." );
+    }
+    for ( i = 0; i < 8; i++ ) {
+        expiry = ( expiry << 8 ) | ( unsigned char ) _blob[sizeof( gsseap_context_magic ) + i];
+    }
+    if ( ( unsigned long long ) time( NULL ) >= expiry ) {
+        return ERROR( SYS_INVALID_INPUT_PARAM, "Exported GSSEAP context has expired." );
+    }
+
+    token.value = ( void* )( _blob.data() + gsseap_context_header_size );
+    token.length = _blob.size() - gsseap_context_header_size;
+    *_rtn_context = GSS_C_NO_CONTEXT;
+    major_status = gss_import_sec_context( &minor_status, &token, _rtn_context );
+    if ( major_status != GSS_S_COMPLETE ) {
+        return ERROR( GSSEAP_ERROR_FROM_GSSEAP_LIBRARY, "Failed importing GSSEAP context." );
+    }
+
+    return SUCCESS();
+}
+
+int gsseap_export_connection_context(
+    int _fd,
+    char** _rtn_blob,
+    size_t* _rtn_len ) {
+    gsseap_session_t* session = gsseap_session_get( _fd );
+    std::string blob;
+
+    if ( _rtn_blob == NULL || _rtn_len == NULL ) {
+        return SYS_INVALID_INPUT_PARAM;
+    }
+    irods::error ret = gsseap_context_export( &session->context, blob );
+    if ( !ret.ok() ) {
+        return ret.code();
+    }
+
+    *_rtn_blob = ( char* ) malloc( blob.size() );
+    if ( *_rtn_blob == NULL ) {
+        return SYS_MALLOC_ERR;
+    }
+    memcpy( *_rtn_blob, blob.data(), blob.size() );
+    *_rtn_len = blob.size();
+    memset( &blob[0], 0, blob.size() );
+
+    return 0;
+}
+
+int gsseap_import_connection_context(
+    int _fd,
+    const char* _blob,
+    size_t _len ) {
+    gsseap_session_t* session = gsseap_session_begin( _fd, NULL );
+    gss_ctx_id_t context;
+    OM_uint32 minor_status;
+    OM_uint32 flags;
+
+    if ( _blob == NULL ) {
+        return SYS_INVALID_INPUT_PARAM;
+    }
+    irods::error ret = gsseap_context_import( std::string( _blob, _len ), &context );
+    if ( !ret.ok() ) {
+        return ret.code();
+    }
+    session->context = context;
+    if ( gss_inquire_context( &minor_status, context, NULL, NULL, NULL, NULL, &flags, NULL, NULL ) == GSS_S_COMPLETE ) {
+        session->context_flags = flags;
+    }
+
+    return 0;
+}
@@ -0,0 +1,47 @@
+/* -*- mode: c++; fill-column: 132; c-basic-offset: 4; indent-tabs-mode: nil -*- */
+/* gsseapContext.hpp
+ * Transfer of an established GSS-EAP security context between processes.  The
+ * exported blob is the mechanism's serialized context behind a small header
+ * that bounds how long it may be imported.  It carries the session keys, so it
+ * must only travel over a private channel such as a pipe to a child process.
+ */
+
+#ifndef GSSEAP_CONTEXT_HPP
+#define GSSEAP_CONTEXT_HPP
+
+#include "irods_error.hpp"
+
+#include "gsseapExport.hpp"
+
+#include <string>
+
+#include <gssapi.h>
+#include <stddef.h>
+
+/// @brief Serialize an established context; _context is consumed and reset to GSS_C_NO_CONTEXT
+irods::error gsseap_context_export(
+    gss_ctx_id_t* _context,
+    std::string& _rtn_blob );
+
+/// @brief Recreate a context from an unexpired blob
+irods::error gsseap_context_import(
+    const std::string& _blob,
+    gss_ctx_id_t* _rtn_context );
+
+extern "C" {
+
+    /// @brief Export the context established on connection _fd into a malloc'ed blob, 0 on success
+    GSSEAP_EXPORT int gsseap_export_connection_context(
+        int _fd,
+        char** _rtn_blob,
+        size_t* _rtn_len );
+
+    /// @brief Attach a context exported by another process to connection _fd, 0 on success
+    GSSEAP_EXPORT int gsseap_import_connection_context(
+        int _fd,
+        const char* _blob,
+        size_t _len );
+
+}
+
+#endif  /* GSSEAP_CONTEXT_HPP */
@@ -0,0 +1,15 @@
+/* -*- mode: c++; fill-column: 132; c-basic-offset: 4; indent-tabs-mode: nil -*- */
+/* gsseapExport.hpp
+ * The plugin is compiled with hidden symbol visibility, so only what iRODS
+ * looks up by name (the factory, the interface version and the operations it
+ * registers) and the public C entry points of the headers are exported.  The
+ * rest binds locally, which keeps the dynamic symbol table and the relocations
+ * resolved at load time small.
+ */
+
+#ifndef GSSEAP_EXPORT_HPP
+#define GSSEAP_EXPORT_HPP
+
+#define GSSEAP_EXPORT __attribute__ ( ( visibility ( "default" ) ) )
+
+#endif  /* GSSEAP_EXPORT_HPP */
@@ -0,0 +1,242 @@
+/* -*- mode: c++; fill-column: 132; c-basic-offset: 4; indent-tabs-mode: nil -*- */
+
+#include "rodsErrorTable.hpp"
+#include "rodsLog.hpp"
+#include "irods_error.hpp"
+
+#include "gsseapFailure.hpp"
+#include "gsseapShm.hpp"
+#include "gsseapUtil.hpp"
+
+#include <errno.h>
+#include <pthread.h>
+#include <signal.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/types.h>
+#include <time.h>
+#include <unistd.h>
+
+static const unsigned int gsseap_failure_entries = 4096;
+static const long gsseap_failure_default_backoff = 1;        // seconds after the first failure
+static const long gsseap_failure_default_max_backoff = 300;  // seconds, the backoff stops doubling here
+
+static const unsigned int gsseap_breaker_max_realms = 64;
+static const size_t gsseap_breaker_realm_size = 128;
+static const long gsseap_breaker_default_threshold = 10;     // consecutive AAA failures that open a breaker
+static const long gsseap_breaker_default_reset = 30;         // seconds an open breaker waits before letting a probe through
+
+// Opened once per process, by whichever thread of a multithreaded agent gets there first
+static pthread_once_t gsseap_failures_once = PTHREAD_ONCE_INIT;
+static gsseap_shm_table_t* gsseap_failures = NULL;
+
+static void gsseap_failures_open() {
+    gsseap_failures = gsseap_shm_table_open( "failures", gsseap_failure_entries );
+}
+
+static gsseap_shm_table_t* gsseap_failure_table() {
+    pthread_once( &gsseap_failures_once, gsseap_failures_open );
+    return gsseap_failures;
+}
+
+bool gsseap_failure_backoff(
+    const std::string& _key,
+    int& _rtn_error ) {
+    std::string value;
+    unsigned int count;
+    long until;
+
+    if ( gsseap_env_long( "GSSEAP_FAILURE_BACKOFF", gsseap_failure_default_backoff ) <= 0 || gsseap_failure_table() == NULL ) {
+        return false;
+    }
+    if ( !gsseap_shm_table_get( gsseap_failures, _key, value ) ||
+            sscanf( value.c_str(), "%u %d %ld", &count, &_rtn_error, &until ) != 3 ) {
+        return false;
+    }
+    return time( NULL ) < ( time_t ) until;
+}
+
+void gsseap_failure_record(
+    const std::string& _key,
+    int _error ) {
+    long backoff = gsseap_env_long( "GSSEAP_FAILURE_BACKOFF", gsseap_failure_default_backoff );
+    long max_backoff = gsseap_env_long( "GSSEAP_FAILURE_BACKOFF_MAX", gsseap_failure_default_max_backoff );
+    std::string value;
+    unsigned int count = 0;
+    int error;
+    long until;
+    char buf[64];
+
+    if ( backoff <= 0 || gsseap_failure_table() == NULL ) {
+        return;
+    }
+    if ( !gsseap_shm_table_get( gsseap_failures, _key, value ) ||
+            sscanf( value.c_str(), "%u %d %ld", &count, &error, &until ) != 3 ) {
+        count = 0;
+    }
+
+    // concurrent failures of one key may lose an increment, which only delays the backoff by a step
+    count++;
+    unsigned int i;
+    for ( i = 1; i < count && backoff < max_backoff; i++ ) {
+        backoff *= 2;
+    }
+    if ( backoff > max_backoff ) {
+        backoff = max_backoff;
+    }
+
+    snprintf( buf, sizeof( buf ), "%u %d %ld", count, _error, ( long ) time( NULL ) + backoff );
+    // keep the count around for a while after the backoff ends, so a key that keeps failing keeps doubling
+    gsseap_shm_table_put( gsseap_failures, _key, buf, backoff + max_backoff );
+}
+
+void gsseap_failure_clear(
+    const std::string& _key ) {
+    gsseap_shm_table_remove( gsseap_failure_table(), _key );
+}
+
+enum {
+    GSSEAP_BREAKER_CLOSED = 0,
+    GSSEAP_BREAKER_OPEN,
+    GSSEAP_BREAKER_HALF_OPEN
+};
+
+typedef struct {
+    char realm[gsseap_breaker_realm_size];  // empty marks a free slot
+    int state;
+    unsigned int failures;                  // consecutive AAA failures
+    time_t opened;
+    pid_t probe;                            // the agent whose login tests a half open breaker
+    time_t probe_since;
+} gsseap_breaker_t;
+
+typedef struct {
+    gsseap_shm_header_t header;
+    gsseap_breaker_t breakers[gsseap_breaker_max_realms];
+} gsseap_breakers_t;
+
+static pthread_once_t gsseap_breakers_once = PTHREAD_ONCE_INIT;
+static gsseap_breakers_t* gsseap_breakers = NULL;
+
+static void gsseap_breakers_init( void* _addr ) {
+    gsseap_breakers_t* breakers = ( gsseap_breakers_t* ) _addr;
+    memset( breakers->breakers, 0, sizeof( breakers->breakers ) );
+}
+
+static void gsseap_breakers_open() {
+    gsseap_breakers = ( gsseap_breakers_t* ) gsseap_shm_map( "breakers", sizeof( gsseap_breakers_t ), gsseap_breakers_init );
+}
+
+static long gsseap_breaker_threshold() {
+    return gsseap_env_long( "GSSEAP_BREAKER_THRESHOLD", gsseap_breaker_default_threshold );
+}
+
+/// @brief Lock the breakers, NULL if they are disabled or unavailable
+static gsseap_breakers_t* gsseap_breakers_lock() {
+    if ( gsseap_breaker_threshold() <= 0 ) {
+        return NULL;
+    }
+    pthread_once( &gsseap_breakers_once, gsseap_breakers_open );
+    if ( gsseap_breakers == NULL ) {
+        return NULL;
+    }
+    if ( gsseap_shm_lock( &gsseap_breakers->header ) != 0 ) {
+        return NULL;
+    }
+    return gsseap_breakers;
+}
+
+/// @brief The breaker of _realm, claiming a slot for it if _create is set, the caller holds the lock
+static gsseap_breaker_t* gsseap_breaker_find(
+    const std::string& _realm,
+    bool _create ) {
+    gsseap_breaker_t* unused = NULL;
+    unsigned int i;
+
+    for ( i = 0; i < gsseap_breaker_max_realms; i++ ) {
+        gsseap_breaker_t* breaker = &gsseap_breakers->breakers[i];
+        if ( breaker->realm[0] != '\0' && strncmp( breaker->realm, _realm.c_str(), gsseap_breaker_realm_size - 1 ) == 0 ) {
+            return breaker;
+        }
+        // healthy realms give their slot up to new ones
+        if ( unused == NULL && ( breaker->realm[0] == '\0' ||
+                                 ( breaker->state == GSSEAP_BREAKER_CLOSED && breaker->failures == 0 ) ) ) {
+            unused = breaker;
+        }
+    }
+    if ( !_create || unused == NULL ) {
+        return NULL;
+    }
+    memset( unused, 0, sizeof( *unused ) );
+    snprintf( unused->realm, sizeof( unused->realm ), "%s", _realm.c_str() );
+    return unused;
+}
+
+irods::error gsseap_breaker_admit(
+    const std::string& _realm ) {
+    irods::error result = SUCCESS();
+    long reset = gsseap_env_long( "GSSEAP_BREAKER_RESET", gsseap_breaker_default_reset );
+    time_t now = time( NULL );
+
+    // there is no shared breaker for logins whose realm is unknown
+    if ( _realm.empty() || gsseap_breakers_lock() == NULL ) {
+        return result;
+    }
+
+    gsseap_breaker_t* breaker = gsseap_breaker_find( _realm, false );
+    if ( breaker != NULL && breaker->state != GSSEAP_BREAKER_CLOSED ) {
+        bool probe_gone = breaker->state == GSSEAP_BREAKER_HALF_OPEN &&
+                          ( now - breaker->probe_since >= reset || ( kill( breaker->probe, 0 ) != 0 && errno == ESRCH ) );
+        if ( ( breaker->state == GSSEAP_BREAKER_OPEN && now - breaker->opened >= reset ) || probe_gone ) {
+            breaker->state = GSSEAP_BREAKER_HALF_OPEN;
+            breaker->probe = getpid();
+            breaker->probe_since = now;
+            rodsLog( LOG_NOTICE, "gsseap_breaker_admit: probing AAA for realm %s", breaker->realm );
+        }
+        else {
+            result = ERROR( GSSEAP_ACCEPT_SEC_CONTEXT_ERROR, "AAA for this realm is failing, retry later." );
+        }
+    }
+
+    gsseap_shm_unlock( &gsseap_breakers->header );
+    return result;
+}
+
+void gsseap_breaker_report(
+    const std::string& _realm,
+    gsseap_aaa_outcome_t _outcome ) {
+    long threshold = gsseap_breaker_threshold();
+
+    if ( _realm.empty() || gsseap_breakers_lock() == NULL ) {
+        return;
+    }
+
+    gsseap_breaker_t* breaker = gsseap_breaker_find( _realm, _outcome == GSSEAP_AAA_FAILED );
+    if ( breaker != NULL ) {
+        if ( _outcome == GSSEAP_AAA_OK ) {
+            if ( breaker->state != GSSEAP_BREAKER_CLOSED ) {
+                rodsLog( LOG_NOTICE, "gsseap_breaker_report: AAA for realm %s recovered", breaker->realm );
+            }
+            breaker->state = GSSEAP_BREAKER_CLOSED;
+            breaker->failures = 0;
+        }
+        else if ( _outcome == GSSEAP_AAA_FAILED ) {
+            breaker->failures++;
+            if ( breaker->state == GSSEAP_BREAKER_HALF_OPEN ||
+                    ( breaker->state == GSSEAP_BREAKER_CLOSED && breaker->failures >= ( unsigned int ) threshold ) ) {
+                if ( breaker->state == GSSEAP_BREAKER_CLOSED ) {
+                    rodsLog( LOG_ERROR, "gsseap_breaker_report: %u consecutive AAA failures for realm %s, "
+                             "refusing its logins until a probe succeeds", breaker->failures, breaker->realm );
+                }
+                breaker->state = GSSEAP_BREAKER_OPEN;
+                breaker->opened = time( NULL );
+            }
+        }
+        else if ( breaker->state == GSSEAP_BREAKER_HALF_OPEN && breaker->probe == getpid() ) {
+            // the probe told us nothing, let the next login probe instead
+            breaker->probe_since = 0;
+        }
+    }
+
+    gsseap_shm_unlock( &gsseap_breakers->header );
+}
@@ -0,0 +1,52 @@
+/* -*- mode: c++; fill-column: 132; c-basic-offset: 4; indent-tabs-mode: nil -*- */
+/* gsseapFailure.hpp
+ * Cheap rejection of logins that are known to fail.  A negative cache remembers
+ * authenticated names that recently failed to map to an iRODS user and backs
+ * them off exponentially, and a circuit breaker per realm stops sending logins
+ * to an AAA backend that keeps failing until a single probe login gets through
+ * again.  The backoff is keyed by the name the mechanism authenticated.  The
+ * breaker's realm is the one the initiator announced, as the mechanism names
+ * it before the exchange completes, so a client can claim any realm: a
+ * failure only counts against the realm once its AAA backend has answered in
+ * the same exchange, and a client whose messages the backend never answers
+ * trips no breaker.
+ */
+
+#ifndef GSSEAP_FAILURE_HPP
+#define GSSEAP_FAILURE_HPP
+
+#include "irods_error.hpp"
+
+#include <string>
+
+/// @brief Whether _key is backing off after recent failures; _rtn_error is the error that caused it
+bool gsseap_failure_backoff(
+    const std::string& _key,
+    int& _rtn_error );
+
+/// @brief Note a failure for _key, doubling its backoff
+void gsseap_failure_record(
+    const std::string& _key,
+    int _error );
+
+/// @brief Forget the failures for _key after a successful login
+void gsseap_failure_clear(
+    const std::string& _key );
+
+/// @brief How an AAA exchange ended, for the circuit breaker
+enum gsseap_aaa_outcome_t {
+    GSSEAP_AAA_OK,       // the backend answered
+    GSSEAP_AAA_FAILED,   // the backend failed or could not be reached
+    GSSEAP_AAA_UNKNOWN   // the login ended before the backend was involved
+};
+
+/// @brief Let the AAA exchange of a login in _realm go on, failing at once while the realm's breaker is open
+irods::error gsseap_breaker_admit(
+    const std::string& _realm );
+
+/// @brief Report how the AAA exchange of an admitted login ended
+void gsseap_breaker_report(
+    const std::string& _realm,
+    gsseap_aaa_outcome_t _outcome );
+
+#endif  /* GSSEAP_FAILURE_HPP */
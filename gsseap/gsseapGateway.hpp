@@ -0,0 +1,44 @@
+/* -*- mode: c++; fill-column: 132; c-basic-offset: 4; indent-tabs-mode: nil -*- */
+/* gsseapGateway.hpp
+ * Client side: log end users in over the connection of a trusted gateway.  A
+ * portal that authenticates its users with GSS-EAP relays their tokens over its
+ * own rodsadmin connection; the server accepts them, maps each end user to an
+ * iRODS user and makes that user the client of the connection, with the
+ * gateway as its proxy.  The server must list the gateway in GSSEAP_GATEWAY.
+ */
+
+#ifndef GSSEAP_GATEWAY_HPP
+#define GSSEAP_GATEWAY_HPP
+
+#include "rcConnect.hpp"
+
+#include "gsseapExport.hpp"
+
+#include <stddef.h>
+
+extern "C" {
+
+    /// @brief Carry one token between the gateway and the end user.  _token is the acceptor's latest token, NULL on the
+    ///        first call; the end user's answer goes in *_rtn_token, malloc'ed.  Returns 1 if the end user expects another
+    ///        token from the acceptor, 0 if its context is complete, or a negative error.
+    typedef int ( *gsseap_gateway_relay_t )(
+        void* _arg,
+        const void* _token,
+        size_t _len,
+        void** _rtn_token,
+        size_t* _rtn_len );
+
+    /// @brief Log the end user behind _relay in on the gateway's connection _conn, which must already be logged in as a
+    ///        rodsadmin.  _user_name and _zone_name name the iRODS user the end user asks for, NULL to take the user its
+    ///        GSS-EAP name maps to.  On success the end user is the client of _conn, as in _conn->clientUser; on failure
+    ///        the connection keeps its previous client.  Returns 0 or an error.
+    GSSEAP_EXPORT int gsseap_gateway_login(
+        rcComm_t* _conn,
+        const char* _user_name,
+        const char* _zone_name,
+        gsseap_gateway_relay_t _relay,
+        void* _arg );
+
+}
+
+#endif  /* GSSEAP_GATEWAY_HPP */
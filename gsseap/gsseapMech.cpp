@@ -0,0 +1,255 @@
+/* -*- mode: c++; fill-column: 132; c-basic-offset: 4; indent-tabs-mode: nil -*- */
+
+#include "rodsLog.hpp"
+
+#include "gsseapMech.hpp"
+#include "gsseapUtil.hpp"
+
+#include <string>
+
+#include <ctype.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+static const unsigned int gsseap_max_mechs = 8;
+static const unsigned int gsseap_max_oid_size = 32;    // DER bytes of one OID
+static const char* const gsseap_default_mechs = "eap-aes256";
+
+typedef struct {
+    const char* name;
+    const char* dotted;
+} gsseap_mech_alias_t;
+
+static const gsseap_mech_alias_t gsseap_mech_aliases[] = {
+    { "eap-aes256", "1.3.6.1.5.5.15.1.1.18" },
+    { "eap-aes128", "1.3.6.1.5.5.15.1.1.17" },
+    { "krb5", "1.2.840.113554.1.2.2" },
+    { "spnego", "1.3.6.1.5.5.2" },
+    { NULL, NULL }
+};
+
+static pthread_once_t gsseap_mechs_once = PTHREAD_ONCE_INIT;
+static unsigned char gsseap_mech_der[gsseap_max_mechs][gsseap_max_oid_size];
+static gss_OID_desc gsseap_mech_oids[gsseap_max_mechs];
+static gss_OID_set_desc gsseap_mech_set = { 0, gsseap_mech_oids };
+static gss_OID_desc gsseap_spnego_oid = { 0, NULL };
+static unsigned char gsseap_spnego_der[gsseap_max_oid_size];
+static gss_OID_desc gsseap_fragment_size_oid = { 0, NULL };    // cred option setting the EAP fragment size, if any
+static unsigned char gsseap_fragment_size_der[gsseap_max_oid_size];
+
+/// @brief DER encode the dotted OID _dotted into _der, returning its length or 0 if it is malformed
+static size_t gsseap_oid_encode(
+    const char* _dotted,
+    unsigned char* _der,
+    size_t _size ) {
+    unsigned long arcs[64];
+    size_t count = 0;
+    size_t len = 0;
+    const char* p = _dotted;
+
+    while ( *p != '\0' && count < 64 ) {
+        char* end;
+        if ( !isdigit( ( unsigned char ) *p ) ) {
+            return 0;
+        }
+        arcs[count++] = strtoul( p, &end, 10 );
+        p = end;
+        if ( *p == '.' ) {
+            p++;
+        }
+        else if ( *p != '\0' ) {
+            return 0;
+        }
+    }
+    if ( count < 2 || *p != '\0' || arcs[0] > 2 || ( arcs[0] < 2 && arcs[1] > 39 ) ) {
+        return 0;
+    }
+
+    arcs[1] += arcs[0] * 40;
+    for ( size_t i = 1; i < count; i++ ) {
+        unsigned char bytes[10];
+        size_t n = 0;
+        unsigned long arc = arcs[i];
+        do {
+            bytes[n++] = arc & 0x7f;
+            arc >>= 7;
+        }
+        while ( arc != 0 );
+        if ( len + n > _size ) {
+            return 0;
+        }
+        while ( n > 0 ) {
+            n--;
+            _der[len++] = bytes[n] | ( n > 0 ? 0x80 : 0 );
+        }
+    }
+    return len;
+}
+
+static const char* gsseap_mech_dotted(
+    const std::string& _name ) {
+    for ( const gsseap_mech_alias_t* alias = gsseap_mech_aliases; alias->name != NULL; alias++ ) {
+        if ( _name == alias->name ) {
+            return alias->dotted;
+        }
+    }
+    return _name.c_str();
+}
+
+static void gsseap_mech_add(
+    const std::string& _name ) {
+    unsigned int i = gsseap_mech_set.count;
+    size_t len = gsseap_oid_encode( gsseap_mech_dotted( _name ), gsseap_mech_der[i], gsseap_max_oid_size );
+
+    if ( len == 0 ) {
+        rodsLog( LOG_ERROR, "gsseap_mechs: ignoring unknown mechanism \"%s\" in GSSEAP_MECHS", _name.c_str() );
+        return;
+    }
+    gsseap_mech_oids[i].length = len;
+    gsseap_mech_oids[i].elements = gsseap_mech_der[i];
+    gsseap_mech_set.count++;
+}
+
+static void gsseap_mechs_parse() {
+    const char* list = gsseap_env_string( "GSSEAP_MECHS" );
+    std::string mechs = list != NULL ? list : gsseap_default_mechs;
+    size_t start = 0;
+
+    gsseap_spnego_oid.length = gsseap_oid_encode( "1.3.6.1.5.5.2", gsseap_spnego_der, gsseap_max_oid_size );
+    gsseap_spnego_oid.elements = gsseap_spnego_der;
+
+    const char* option = gsseap_env_string( "GSSEAP_FRAGMENT_SIZE_OID" );
+    if ( option != NULL ) {
+        gsseap_fragment_size_oid.length = gsseap_oid_encode( option, gsseap_fragment_size_der, gsseap_max_oid_size );
+        gsseap_fragment_size_oid.elements = gsseap_fragment_size_der;
+        if ( gsseap_fragment_size_oid.length == 0 ) {
+            rodsLog( LOG_ERROR, "gsseap_mechs: ignoring malformed GSSEAP_FRAGMENT_SIZE_OID \"%s\"", option );
+        }
+    }
+
+    while ( start <= mechs.size() && gsseap_mech_set.count < gsseap_max_mechs ) {
+        size_t end = mechs.find( ',', start );
+        if ( end == std::string::npos ) {
+            end = mechs.size();
+        }
+        std::string name = mechs.substr( start, end - start );
+        while ( !name.empty() && isspace( ( unsigned char ) name[0] ) ) {
+            name.erase( 0, 1 );
+        }
+        while ( !name.empty() && isspace( ( unsigned char ) name[name.size() - 1] ) ) {
+            name.erase( name.size() - 1 );
+        }
+        if ( !name.empty() ) {
+            gsseap_mech_add( name );
+        }
+        start = end + 1;
+    }
+    if ( gsseap_mech_set.count == 0 ) {
+        gsseap_mech_add( gsseap_default_mechs );
+    }
+}
+
+gss_OID_set gsseap_mechs() {
+    pthread_once( &gsseap_mechs_once, gsseap_mechs_parse );
+    return &gsseap_mech_set;
+}
+
+static bool gsseap_oid_equal(
+    gss_const_OID _a,
+    gss_const_OID _b ) {
+    return _a->length == _b->length && memcmp( _a->elements, _b->elements, _a->length ) == 0;
+}
+
+bool gsseap_mech_is_spnego(
+    gss_const_OID _mech ) {
+    gsseap_mechs();
+    return _mech != GSS_C_NO_OID && gsseap_oid_equal( _mech, &gsseap_spnego_oid );
+}
+
+OM_uint32 gsseap_mech_acquire_cred(
+    OM_uint32* _minor_status,
+    gss_OID_set _mechs,
+    gss_cred_usage_t _usage,
+    gss_cred_id_t* _rtn_cred ) {
+    gss_OID_desc negotiable[gsseap_max_mechs];
+    gss_OID_set_desc neg_mechs = { 0, negotiable };
+    bool spnego = false;
+    OM_uint32 major_status;
+    OM_uint32 minor_status;
+
+    *_rtn_cred = GSS_C_NO_CREDENTIAL;
+    major_status = gss_acquire_cred( _minor_status, GSS_C_NO_NAME, GSS_C_INDEFINITE, _mechs, _usage, _rtn_cred, NULL, NULL );
+    if ( major_status != GSS_S_COMPLETE ) {
+        *_rtn_cred = GSS_C_NO_CREDENTIAL;
+        return major_status;
+    }
+
+    for ( size_t i = 0; i < _mechs->count && neg_mechs.count < gsseap_max_mechs; i++ ) {
+        if ( gsseap_mech_is_spnego( &_mechs->elements[i] ) ) {
+            spnego = true;
+        }
+        else {
+            negotiable[neg_mechs.count++] = _mechs->elements[i];
+        }
+    }
+    // without this SPNEGO would also offer every other mechanism the library happens to have credentials for
+    if ( spnego && neg_mechs.count > 0 &&
+            gss_set_neg_mechs( &minor_status, *_rtn_cred, &neg_mechs ) != GSS_S_COMPLETE ) {
+        rodsLog( LOG_NOTICE, "gsseap_mech_acquire_cred: could not restrict the SPNEGO mechanisms, minor status %u", minor_status );
+    }
+
+    // larger EAP fragments carry a certificate chain in fewer round trips, if the mechanism lets us set them
+    long fragment_size = gsseap_env_long( "GSSEAP_FRAGMENT_SIZE", 0 );
+    if ( fragment_size > 0 && gsseap_fragment_size_oid.length > 0 ) {
+        char value[32];
+        gss_buffer_desc buffer;
+        buffer.length = snprintf( value, sizeof( value ), "%ld", fragment_size );
+        buffer.value = value;
+        if ( gss_set_cred_option( &minor_status, _rtn_cred, &gsseap_fragment_size_oid, &buffer ) != GSS_S_COMPLETE ) {
+            rodsLog( LOG_NOTICE, "gsseap_mech_acquire_cred: could not set the EAP fragment size, minor status %u", minor_status );
+        }
+    }
+    return major_status;
+}
+
+const char* gsseap_mech_name(
+    gss_const_OID _mech,
+    char* _buf,
+    size_t _size ) {
+    const unsigned char* der;
+    size_t len = 0;
+    unsigned long arc = 0;
+    bool first = true;
+
+    if ( _size == 0 ) {
+        return _buf;
+    }
+    _buf[0] = '\0';
+    if ( _mech == GSS_C_NO_OID ) {
+        snprintf( _buf, _size, "none" );
+        return _buf;
+    }
+
+    // decode to dotted form, then prefer the short name
+    der = ( const unsigned char* ) _mech->elements;
+    for ( size_t i = 0; i < _mech->length && len < _size; i++ ) {
+        arc = ( arc << 7 ) | ( der[i] & 0x7f );
+        if ( der[i] & 0x80 ) {
+            continue;
+        }
+        int n = first ? snprintf( _buf + len, _size - len, "%lu.%lu", arc < 80 ? arc / 40 : 2, arc < 80 ? arc % 40 : arc - 80 )
+                      : snprintf( _buf + len, _size - len, ".%lu", arc );
+        len += n > 0 ? n : 0;
+        first = false;
+        arc = 0;
+    }
+    for ( const gsseap_mech_alias_t* alias = gsseap_mech_aliases; alias->name != NULL; alias++ ) {
+        if ( strcmp( _buf, alias->dotted ) == 0 ) {
+            snprintf( _buf, _size, "%s", alias->name );
+            break;
+        }
+    }
+    return _buf;
+}
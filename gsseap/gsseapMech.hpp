@@ -0,0 +1,38 @@
+/* -*- mode: c++; fill-column: 132; c-basic-offset: 4; indent-tabs-mode: nil -*- */
+/* gsseapMech.hpp
+ * The GSS-API mechanisms the plugin offers, in order of preference.  Besides
+ * GSS-EAP this may list Kerberos, which authenticates users who already hold a
+ * ticket in a single round trip without involving the AAA backend, and SPNEGO,
+ * which lets the peers negotiate among the listed mechanisms.
+ */
+
+#ifndef GSSEAP_MECH_HPP
+#define GSSEAP_MECH_HPP
+
+#include <stddef.h>
+
+#include <gssapi.h>
+#include <gssapi_ext.h>
+
+/// @brief The configured mechanisms in order of preference (GSSEAP_MECHS), parsed once per process, never empty
+gss_OID_set gsseap_mechs();
+
+/// @brief Acquire a default credential for _usage over _mechs; if SPNEGO is among them it negotiates only the others.
+///        The EAP fragment size is set on it if GSSEAP_FRAGMENT_SIZE and the option's GSSEAP_FRAGMENT_SIZE_OID are.
+OM_uint32 gsseap_mech_acquire_cred(
+    OM_uint32* _minor_status,
+    gss_OID_set _mechs,
+    gss_cred_usage_t _usage,
+    gss_cred_id_t* _rtn_cred );
+
+/// @brief Whether _mech is SPNEGO
+bool gsseap_mech_is_spnego(
+    gss_const_OID _mech );
+
+/// @brief _mech as its short name (eap-aes256, krb5, ...) or in dotted form, written to _buf
+const char* gsseap_mech_name(
+    gss_const_OID _mech,
+    char* _buf,
+    size_t _size );
+
+#endif  /* GSSEAP_MECH_HPP */
@@ -0,0 +1,350 @@
+/* -*- mode: c++; fill-column: 132; c-basic-offset: 4; indent-tabs-mode: nil -*- */
+
+#include "rodsErrorTable.hpp"
+#include "rodsLog.hpp"
+#include "irods_error.hpp"
+
+#include "gsseapNameRules.hpp"
+
+#include <map>
+#include <string>
+#include <vector>
+
+#include <ctype.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+/*
+  Rules are compiled once at load:
+
+   - realms go into a trie keyed on their labels from right to left, so one pass over the realm of a name finds
+     the exact rules and every enclosing wildcard rule, most specific first;
+   - each user glob is compiled by subset construction into a DFA over bytes, so testing a local part is a single
+     table walk with no backtracking.
+*/
+
+static const size_t gsseap_glob_max_length = 63;      // glob positions must fit in a 64 bit state set
+static const size_t gsseap_glob_max_states = 512;
+
+typedef struct {
+    std::vector<unsigned short> next;  // next[state * 256 + byte]
+    std::vector<char> accept;
+} gsseap_glob_dfa_t;
+
+typedef struct {
+    bool match_all;          // no user glob, skip the DFA
+    gsseap_glob_dfa_t dfa;
+    bool keep_realm;
+    bool admin_allowed;
+    bool lookup;
+    std::string prefix;
+    std::string suffix;
+    std::string zone;
+} gsseap_name_rule_t;
+
+typedef struct {
+    std::map<std::string, int> children;
+    std::vector<int> exact_rules;     // rules for exactly this realm
+    std::vector<int> wildcard_rules;  // rules for every subrealm of this realm
+} gsseap_realm_node_t;
+
+typedef struct {
+    std::vector<gsseap_name_rule_t> rules;
+    std::vector<gsseap_realm_node_t> nodes;  // nodes[0] is the root, its wildcard rules match any realm
+} gsseap_name_rule_set_t;
+
+static gsseap_name_rule_set_t* gsseap_name_rules = NULL;
+
+/// @brief Positions reachable from _set without consuming input, i.e. skipping over '*'
+static uint64_t gsseap_glob_closure(
+    const std::string& _glob,
+    uint64_t _set ) {
+    size_t i;
+    for ( i = 0; i < _glob.size(); i++ ) {
+        if ( ( _set & ( ( uint64_t ) 1 << i ) ) && _glob[i] == '*' ) {
+            _set |= ( uint64_t ) 1 << ( i + 1 );
+        }
+    }
+    return _set;
+}
+
+static uint64_t gsseap_glob_step(
+    const std::string& _glob,
+    uint64_t _set,
+    unsigned char _c ) {
+    uint64_t next = 0;
+    size_t i;
+    for ( i = 0; i < _glob.size(); i++ ) {
+        if ( !( _set & ( ( uint64_t ) 1 << i ) ) ) {
+            continue;
+        }
+        if ( _glob[i] == '*' ) {
+            next |= ( uint64_t ) 1 << i;
+        }
+        else if ( _glob[i] == '?' || ( unsigned char ) _glob[i] == _c ) {
+            next |= ( uint64_t ) 1 << ( i + 1 );
+        }
+    }
+    return gsseap_glob_closure( _glob, next );
+}
+
+static irods::error gsseap_glob_compile(
+    const std::string& _glob,
+    gsseap_glob_dfa_t& _rtn_dfa ) {
+    irods::error result = SUCCESS();
+    std::map<uint64_t, unsigned short> state_ids;
+    std::vector<uint64_t> states;
+    size_t s;
+    int c;
+
+    if ( !( result = ASSERT_ERROR( _glob.size() <= gsseap_glob_max_length, SYS_INVALID_INPUT_PARAM,
+                                   "User glob \"%s\" is longer than %u characters.", _glob.c_str(),
+                                   ( unsigned int ) gsseap_glob_max_length ) ).ok() ) {
+        return result;
+    }
+
+    uint64_t start = gsseap_glob_closure( _glob, 1 );
+    state_ids[start] = 0;
+    states.push_back( start );
+
+    for ( s = 0; s < states.size() && result.ok(); s++ ) {
+        _rtn_dfa.accept.push_back( ( states[s] >> _glob.size() ) & 1 );
+        for ( c = 0; c < 256; c++ ) {
+            uint64_t next = gsseap_glob_step( _glob, states[s], ( unsigned char ) c );
+            std::map<uint64_t, unsigned short>::iterator itr = state_ids.find( next );
+            if ( itr == state_ids.end() ) {
+                if ( !( result = ASSERT_ERROR( states.size() < gsseap_glob_max_states, SYS_INVALID_INPUT_PARAM,
+                                               "User glob \"%s\" is too complex.", _glob.c_str() ) ).ok() ) {
+                    break;
+                }
+                itr = state_ids.insert( std::make_pair( next, ( unsigned short ) states.size() ) ).first;
+                states.push_back( next );
+            }
+            _rtn_dfa.next.push_back( itr->second );
+        }
+    }
+
+    return result;
+}
+
+static bool gsseap_glob_match(
+    const gsseap_glob_dfa_t& _dfa,
+    const char* _str,
+    size_t _len ) {
+    unsigned short state = 0;
+    size_t i;
+    for ( i = 0; i < _len; i++ ) {
+        state = _dfa.next[state * 256 + ( unsigned char ) _str[i]];
+    }
+    return _dfa.accept[state] != 0;
+}
+
+static std::string gsseap_lowercase( const std::string& _str ) {
+    std::string out( _str );
+    size_t i;
+    for ( i = 0; i < out.size(); i++ ) {
+        out[i] = tolower( ( unsigned char ) out[i] );
+    }
+    return out;
+}
+
+/// @brief Find or create the trie node for a realm, walking its labels right to left
+static int gsseap_realm_node(
+    gsseap_name_rule_set_t& _set,
+    const std::string& _realm ) {
+    int node = 0;
+    size_t end = _realm.size();
+
+    while ( end > 0 ) {
+        size_t dot = _realm.rfind( '.', end - 1 );
+        size_t start = ( dot == std::string::npos ) ? 0 : dot + 1;
+        std::string label = _realm.substr( start, end - start );
+
+        std::map<std::string, int>::iterator itr = _set.nodes[node].children.find( label );
+        if ( itr == _set.nodes[node].children.end() ) {
+            int child = _set.nodes.size();
+            _set.nodes[node].children[label] = child;
+            _set.nodes.push_back( gsseap_realm_node_t() );
+            node = child;
+        }
+        else {
+            node = itr->second;
+        }
+        end = ( dot == std::string::npos ) ? 0 : dot;
+    }
+    return node;
+}
+
+static irods::error gsseap_name_rule_parse(
+    gsseap_name_rule_set_t& _set,
+    char* _line,
+    int _line_number ) {
+    irods::error result = SUCCESS();
+    gsseap_name_rule_t rule;
+    char* save = NULL;
+    char* token;
+
+    token = strtok_r( _line, " \t\r\n", &save );
+    if ( token == NULL || *token == '#' ) {
+        return result;
+    }
+
+    std::string realm = gsseap_lowercase( token );
+    rule.match_all = true;
+    rule.keep_realm = false;
+    rule.admin_allowed = false;
+    rule.lookup = false;
+
+    while ( result.ok() && ( token = strtok_r( NULL, " \t\r\n", &save ) ) != NULL ) {
+        if ( *token == '#' ) {
+            break;
+        }
+        else if ( strncmp( token, "user=", 5 ) == 0 ) {
+            rule.match_all = false;
+            result = gsseap_glob_compile( token + 5, rule.dfa );
+        }
+        else if ( strcmp( token, "strip" ) == 0 ) {
+            rule.keep_realm = false;
+        }
+        else if ( strcmp( token, "keep" ) == 0 ) {
+            rule.keep_realm = true;
+        }
+        else if ( strncmp( token, "prefix=", 7 ) == 0 ) {
+            rule.prefix = token + 7;
+        }
+        else if ( strncmp( token, "suffix=", 7 ) == 0 ) {
+            rule.suffix = token + 7;
+        }
+        else if ( strncmp( token, "zone=", 5 ) == 0 ) {
+            rule.zone = token + 5;
+        }
+        else if ( strcmp( token, "admin" ) == 0 ) {
+            rule.admin_allowed = true;
+        }
+        else if ( strcmp( token, "lookup" ) == 0 ) {
+            rule.lookup = true;
+        }
+        else {
+            result = ERROR( SYS_INVALID_INPUT_PARAM, "Unknown option." );
+        }
+    }
+    if ( !result.ok() ) {
+        rodsLog( LOG_ERROR, "gsseap_name_rules_load: bad option \"%s\" on line %d", token ? token : "", _line_number );
+        return result;
+    }
+
+    int rule_index = _set.rules.size();
+    _set.rules.push_back( rule );
+
+    if ( realm == "*" ) {
+        _set.nodes[0].wildcard_rules.push_back( rule_index );
+    }
+    else if ( realm.compare( 0, 2, "*." ) == 0 ) {
+        _set.nodes[gsseap_realm_node( _set, realm.substr( 2 ) )].wildcard_rules.push_back( rule_index );
+    }
+    else {
+        _set.nodes[gsseap_realm_node( _set, realm )].exact_rules.push_back( rule_index );
+    }
+
+    return result;
+}
+
+irods::error gsseap_name_rules_load(
+    const char* _path ) {
+    irods::error result = SUCCESS();
+    char line[1024];
+    int line_number = 0;
+
+    FILE* fp = fopen( _path, "r" );
+    if ( !( result = ASSERT_ERROR( fp != NULL, SYS_CONFIG_FILE_ERR, "Failed opening GSSEAP name rules \"%s\", error = %s.",
+                                   _path, strerror( errno ) ) ).ok() ) {
+        return result;
+    }
+
+    gsseap_name_rule_set_t* set = new gsseap_name_rule_set_t;
+    set->nodes.push_back( gsseap_realm_node_t() );
+    while ( result.ok() && fgets( line, sizeof( line ), fp ) != NULL ) {
+        line_number++;
+        result = gsseap_name_rule_parse( *set, line, line_number );
+    }
+    fclose( fp );
+
+    if ( result.ok() ) {
+        delete gsseap_name_rules;
+        gsseap_name_rules = set;
+        rodsLog( LOG_DEBUG, "gsseap_name_rules_load: %u rules, %u realm nodes from %s",
+                 ( unsigned int ) set->rules.size(), ( unsigned int ) set->nodes.size(), _path );
+    }
+    else {
+        delete set;
+    }
+
+    return result;
+}
+
+bool gsseap_name_rules_loaded() {
+    return gsseap_name_rules != NULL;
+}
+
+bool gsseap_name_rules_apply(
+    const char* _client_name,
+    std::string& _rtn_user_name,
+    std::string& _rtn_zone_name,
+    bool& _rtn_admin_allowed ) {
+    if ( gsseap_name_rules == NULL ) {
+        return false;
+    }
+
+    const char* at = strrchr( _client_name, '@' );
+    if ( at == NULL || at == _client_name || at[1] == '\0' ) {
+        return false;
+    }
+
+    const gsseap_name_rule_set_t& set = *gsseap_name_rules;
+    std::string realm = gsseap_lowercase( at + 1 );
+    size_t local_len = at - _client_name;
+
+    // walk the trie once, collecting candidate rule lists from the least to the most specific
+    std::vector<const std::vector<int>*> candidates;
+    candidates.push_back( &set.nodes[0].wildcard_rules );
+    int node = 0;
+    size_t end = realm.size();
+    while ( end > 0 ) {
+        size_t dot = realm.rfind( '.', end - 1 );
+        size_t start = ( dot == std::string::npos ) ? 0 : dot + 1;
+        std::map<std::string, int>::const_iterator itr = set.nodes[node].children.find( realm.substr( start, end - start ) );
+        if ( itr == set.nodes[node].children.end() ) {
+            break;
+        }
+        node = itr->second;
+        end = ( dot == std::string::npos ) ? 0 : dot;
+        if ( end > 0 ) {
+            candidates.push_back( &set.nodes[node].wildcard_rules );
+        }
+        else {
+            candidates.push_back( &set.nodes[node].exact_rules );
+        }
+    }
+
+    size_t i, j;
+    for ( i = candidates.size(); i-- > 0; ) {
+        for ( j = 0; j < candidates[i]->size(); j++ ) {
+            const gsseap_name_rule_t& rule = set.rules[( *candidates[i] )[j]];
+            if ( !rule.match_all && !gsseap_glob_match( rule.dfa, _client_name, local_len ) ) {
+                continue;
+            }
+            if ( rule.lookup ) {
+                return false;
+            }
+            _rtn_user_name = rule.prefix +
+                             ( rule.keep_realm ? std::string( _client_name ) : std::string( _client_name, local_len ) ) +
+                             rule.suffix;
+            _rtn_zone_name = rule.zone;
+            _rtn_admin_allowed = rule.admin_allowed;
+            return true;
+        }
+    }
+
+    return false;
+}
@@ -0,0 +1,42 @@
+/* -*- mode: c++; fill-column: 132; c-basic-offset: 4; indent-tabs-mode: nil -*- */
+/* gsseapNameRules.hpp
+ * Realm level rules which map a GSS-EAP name "user@realm" to an iRODS identity
+ * without a COL_USER_DN entry per person.
+ *
+ * Rules file format, one rule per line, '#' starts a comment:
+ *
+ *     <realm> [user=<glob>] [keep] [prefix=<text>] [suffix=<text>] [zone=<zone>] [admin] [lookup]
+ *
+ * <realm> is a realm ("example.org"), every subrealm of a realm ("*.example.org") or any realm ("*").
+ * user=<glob> limits the rule to local parts matching a glob of literals, '?' and '*'.  By default the
+ * realm is stripped and the local part becomes the user name; "keep" keeps the whole name instead.
+ * "prefix" and "suffix" add a tag, "zone" sets the zone, "admin" allows rodsadmin privileges if the
+ * catalog grants them, and "lookup" sends matching names to the DN lookup instead.  The most specific
+ * realm wins, and among the rules of one realm the first in file order.
+ *
+ * A mapped user must exist in the catalog.  Its type is kept in the binding cache, so a name mapped
+ * again within GSSEAP_BINDING_CACHE_TTL costs no catalog query.
+ */
+
+#ifndef GSSEAP_NAME_RULES_HPP
+#define GSSEAP_NAME_RULES_HPP
+
+#include "irods_error.hpp"
+
+#include <string>
+
+/// @brief Parse and compile a rules file, replacing the current rules
+irods::error gsseap_name_rules_load(
+    const char* _path );
+
+/// @brief Whether any rules are loaded
+bool gsseap_name_rules_loaded();
+
+/// @brief Map a GSS-EAP name, returns false if no rule applies
+bool gsseap_name_rules_apply(
+    const char* _client_name,
+    std::string& _rtn_user_name,
+    std::string& _rtn_zone_name,
+    bool& _rtn_admin_allowed );
+
+#endif  /* GSSEAP_NAME_RULES_HPP */
@@ -0,0 +1,363 @@
+/* -*- mode: c++; fill-column: 132; c-basic-offset: 4; indent-tabs-mode: nil -*- */
+
+#include "rodsClient.hpp"
+#include "rodsErrorTable.hpp"
+#include "rodsLog.hpp"
+
+#include "gsseapBatch.hpp"
+#include "gsseapPool.hpp"
+#include "gsseapSession.hpp"
+#include "gsseapUtil.hpp"
+
+#include <map>
+#include <string>
+#include <vector>
+
+#include <gssapi.h>
+#include <poll.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <sys/time.h>
+#include <time.h>
+
+static const long gsseap_pool_default_size = 4;         // warm connections per server and identity
+static const long gsseap_pool_default_refresh = 300;    // seconds before its context expires that a connection is replaced
+static const long gsseap_pool_default_max_age = 3600;   // seconds a connection without a context (ticket login) is kept
+static const long gsseap_pool_default_retry = 30;       // seconds the refresh thread leaves a server alone after failed logins
+static const long gsseap_pool_check_interval = 1;       // seconds between passes of the refresh thread
+
+enum {
+    GSSEAP_POOL_STOPPED = 0,
+    GSSEAP_POOL_RUNNING,
+    GSSEAP_POOL_SHUTDOWN
+};
+
+typedef struct {
+    std::string host;
+    int port;
+    std::string user;
+    std::string zone;
+    std::vector<rcComm_t*> idle;    // most recently returned last
+    time_t retry_after;
+} gsseap_pool_entry_t;
+
+// The pool, and the key and login time of every connection it handed out, checked out or idle
+static pthread_mutex_t gsseap_pool_mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t gsseap_pool_cond = PTHREAD_COND_INITIALIZER;
+static std::map<std::string, gsseap_pool_entry_t> gsseap_pool;
+static std::map<rcComm_t*, std::pair<std::string, time_t> > gsseap_pool_conns;
+static int gsseap_pool_state = GSSEAP_POOL_STOPPED;
+static pthread_t gsseap_pool_thread;
+
+static long gsseap_pool_size() {
+    return gsseap_env_long( "GSSEAP_POOL_SIZE", gsseap_pool_default_size );
+}
+
+static void gsseap_pool_disconnect(
+    rcComm_t* _conn ) {
+    gsseap_session_end( _conn->sock );
+    rcDisconnect( _conn );
+}
+
+/// @brief Whether an idle connection is still open: the server sends nothing unasked, so anything readable is its close
+static bool gsseap_pool_alive(
+    rcComm_t* _conn ) {
+    struct pollfd pfd;
+    pfd.fd = _conn->sock;
+    pfd.events = POLLIN;
+    pfd.revents = 0;
+    return poll( &pfd, 1, 0 ) == 0;
+}
+
+/// @brief Seconds until an idle connection must be replaced, the caller holds the lock
+static long gsseap_pool_lifetime(
+    rcComm_t* _conn,
+    time_t _now ) {
+    gsseap_session_t* session = gsseap_session_get( _conn->sock );
+    long lifetime = gsseap_pool_conns[_conn].second + gsseap_env_long( "GSSEAP_POOL_MAX_AGE", gsseap_pool_default_max_age ) - _now;
+    OM_uint32 minor_status;
+    OM_uint32 time_rec;
+
+    if ( session->context != GSS_C_NO_CONTEXT &&
+            gss_context_time( &minor_status, session->context, &time_rec ) == GSS_S_COMPLETE && ( long ) time_rec < lifetime ) {
+        lifetime = time_rec;
+    }
+    return lifetime;
+}
+
+/// @brief Connect and log in _count connections for the pool entry _key, overlapping the handshakes; returns the first error
+static int gsseap_pool_login(
+    const std::string& _key,
+    const gsseap_pool_entry_t& _entry,
+    int _count,
+    std::vector<rcComm_t*>& _rtn_conns ) {
+    std::vector<rcComm_t*> conns;
+    int first_error = 0;
+    int i;
+
+    for ( i = 0; i < _count; i++ ) {
+        rErrMsg_t err_msg;
+        rcComm_t* conn = rcConnect( _entry.host.c_str(), _entry.port, _entry.user.c_str(), _entry.zone.c_str(), 0, &err_msg );
+        if ( conn == NULL ) {
+            first_error = err_msg.status < 0 ? err_msg.status : SYS_INTERNAL_ERR;
+            break;
+        }
+        conns.push_back( conn );
+    }
+    if ( conns.empty() ) {
+        return first_error;
+    }
+
+    std::vector<int> status( conns.size() );
+    int error = gsseap_client_login_batch( &conns[0], conns.size(), &status[0] );
+    if ( first_error == 0 ) {
+        first_error = error;
+    }
+
+    time_t now = time( NULL );
+    for ( size_t c = 0; c < conns.size(); c++ ) {
+        if ( status[c] < 0 ) {
+            gsseap_pool_disconnect( conns[c] );
+            continue;
+        }
+        pthread_mutex_lock( &gsseap_pool_mutex );
+        gsseap_pool_conns[conns[c]] = std::make_pair( _key, now );
+        pthread_mutex_unlock( &gsseap_pool_mutex );
+        _rtn_conns.push_back( conns[c] );
+    }
+    return first_error;
+}
+
+static std::string gsseap_pool_key(
+    const char* _host,
+    int _port,
+    const char* _user,
+    const char* _zone ) {
+    char port[16];
+    snprintf( port, sizeof( port ), "%d", _port );
+    return std::string( _host ) + ":" + port + "/" + _user + "#" + _zone;
+}
+
+static void* gsseap_pool_main( void* ) {
+    long check_us = gsseap_pool_check_interval * 1000000;
+
+    pthread_mutex_lock( &gsseap_pool_mutex );
+    while ( gsseap_pool_state == GSSEAP_POOL_RUNNING ) {
+        long size = gsseap_pool_size();
+        long refresh = gsseap_env_long( "GSSEAP_POOL_REFRESH", gsseap_pool_default_refresh );
+        time_t now = time( NULL );
+        std::vector<rcComm_t*> retired;
+        std::vector<std::pair<std::string, int> > wanted;
+
+        // retire idle connections that were closed or are about to expire, and work out what is missing
+        for ( std::map<std::string, gsseap_pool_entry_t>::iterator it = gsseap_pool.begin(); it != gsseap_pool.end(); ++it ) {
+            gsseap_pool_entry_t& entry = it->second;
+            size_t kept = 0;
+            for ( size_t i = 0; i < entry.idle.size(); i++ ) {
+                rcComm_t* conn = entry.idle[i];
+                if ( gsseap_pool_alive( conn ) && gsseap_pool_lifetime( conn, now ) > refresh ) {
+                    entry.idle[kept++] = conn;
+                }
+                else {
+                    gsseap_pool_conns.erase( conn );
+                    retired.push_back( conn );
+                }
+            }
+            entry.idle.resize( kept );
+            if ( ( long ) kept < size && now >= entry.retry_after ) {
+                wanted.push_back( std::make_pair( it->first, ( int )( size - kept ) ) );
+            }
+        }
+        pthread_mutex_unlock( &gsseap_pool_mutex );
+
+        for ( size_t i = 0; i < retired.size(); i++ ) {
+            gsseap_pool_disconnect( retired[i] );
+        }
+
+        // log the replacements in without holding the lock, checkouts go on meanwhile
+        for ( size_t i = 0; i < wanted.size(); i++ ) {
+            pthread_mutex_lock( &gsseap_pool_mutex );
+            gsseap_pool_entry_t entry = gsseap_pool[wanted[i].first];
+            entry.idle.clear();
+            pthread_mutex_unlock( &gsseap_pool_mutex );
+
+            std::vector<rcComm_t*> conns;
+            int status = gsseap_pool_login( wanted[i].first, entry, wanted[i].second, conns );
+
+            pthread_mutex_lock( &gsseap_pool_mutex );
+            gsseap_pool_entry_t& pooled = gsseap_pool[wanted[i].first];
+            if ( status < 0 ) {
+                rodsLog( LOG_NOTICE, "gsseap_pool: warming connections to %s failed, status %d", wanted[i].first.c_str(), status );
+                pooled.retry_after = time( NULL ) + gsseap_env_long( "GSSEAP_POOL_RETRY", gsseap_pool_default_retry );
+            }
+            for ( size_t c = 0; c < conns.size(); c++ ) {
+                if ( gsseap_pool_state == GSSEAP_POOL_RUNNING && ( long ) pooled.idle.size() < size ) {
+                    pooled.idle.push_back( conns[c] );
+                    conns[c] = NULL;
+                }
+                else {
+                    gsseap_pool_conns.erase( conns[c] );
+                }
+            }
+            pthread_mutex_unlock( &gsseap_pool_mutex );
+
+            for ( size_t c = 0; c < conns.size(); c++ ) {
+                if ( conns[c] != NULL ) {
+                    gsseap_pool_disconnect( conns[c] );
+                }
+            }
+        }
+
+        pthread_mutex_lock( &gsseap_pool_mutex );
+        if ( gsseap_pool_state == GSSEAP_POOL_RUNNING ) {
+            struct timeval tv;
+            struct timespec until;
+            gettimeofday( &tv, NULL );
+            until.tv_sec = tv.tv_sec + ( tv.tv_usec + check_us ) / 1000000;
+            until.tv_nsec = ( ( tv.tv_usec + check_us ) % 1000000 ) * 1000;
+            pthread_cond_timedwait( &gsseap_pool_cond, &gsseap_pool_mutex, &until );
+        }
+    }
+    pthread_mutex_unlock( &gsseap_pool_mutex );
+
+    return NULL;
+}
+
+rcComm_t* gsseap_pool_get(
+    const char* _host,
+    int _port,
+    const char* _user,
+    const char* _zone,
+    int* _rtn_status ) {
+    rcComm_t* conn = NULL;
+    std::vector<rcComm_t*> closed;
+    int status = 0;
+
+    if ( _host == NULL || _user == NULL || _zone == NULL ) {
+        if ( _rtn_status != NULL ) {
+            *_rtn_status = SYS_INVALID_INPUT_PARAM;
+        }
+        return NULL;
+    }
+    std::string key = gsseap_pool_key( _host, _port, _user, _zone );
+
+    pthread_mutex_lock( &gsseap_pool_mutex );
+    if ( gsseap_pool_state == GSSEAP_POOL_STOPPED && gsseap_pool_size() > 0 ) {
+        gsseap_pool_state = GSSEAP_POOL_RUNNING;
+        if ( pthread_create( &gsseap_pool_thread, NULL, gsseap_pool_main, NULL ) != 0 ) {
+            rodsLog( LOG_ERROR, "gsseap_pool_get: cannot start the refresh thread, connections are not kept warm" );
+            gsseap_pool_state = GSSEAP_POOL_STOPPED;
+        }
+    }
+
+    std::map<std::string, gsseap_pool_entry_t>::iterator it = gsseap_pool.find( key );
+    if ( it == gsseap_pool.end() ) {
+        gsseap_pool_entry_t entry;
+        entry.host = _host;
+        entry.port = _port;
+        entry.user = _user;
+        entry.zone = _zone;
+        entry.retry_after = 0;
+        it = gsseap_pool.insert( std::make_pair( key, entry ) ).first;
+    }
+    gsseap_pool_entry_t& entry = it->second;
+    while ( conn == NULL && !entry.idle.empty() ) {
+        conn = entry.idle.back();
+        entry.idle.pop_back();
+        if ( !gsseap_pool_alive( conn ) ) {
+            gsseap_pool_conns.erase( conn );
+            closed.push_back( conn );
+            conn = NULL;
+        }
+    }
+    gsseap_pool_entry_t target = entry;
+    target.idle.clear();
+    // let the refresh thread top the pool up again
+    pthread_cond_signal( &gsseap_pool_cond );
+    pthread_mutex_unlock( &gsseap_pool_mutex );
+
+    for ( size_t i = 0; i < closed.size(); i++ ) {
+        gsseap_pool_disconnect( closed[i] );
+    }
+
+    if ( conn == NULL ) {
+        std::vector<rcComm_t*> conns;
+        status = gsseap_pool_login( key, target, 1, conns );
+        if ( !conns.empty() ) {
+            conn = conns[0];
+        }
+    }
+    if ( _rtn_status != NULL ) {
+        *_rtn_status = conn != NULL ? 0 : ( status < 0 ? status : SYS_INTERNAL_ERR );
+    }
+    return conn;
+}
+
+int gsseap_pool_put(
+    rcComm_t* _conn,
+    int _healthy ) {
+    bool keep = false;
+
+    if ( _conn == NULL ) {
+        return SYS_INVALID_INPUT_PARAM;
+    }
+
+    pthread_mutex_lock( &gsseap_pool_mutex );
+    std::map<rcComm_t*, std::pair<std::string, time_t> >::iterator conn = gsseap_pool_conns.find( _conn );
+    if ( conn == gsseap_pool_conns.end() ) {
+        pthread_mutex_unlock( &gsseap_pool_mutex );
+        return SYS_INVALID_INPUT_PARAM;
+    }
+    std::map<std::string, gsseap_pool_entry_t>::iterator it = gsseap_pool.find( conn->second.first );
+    if ( _healthy && gsseap_pool_state == GSSEAP_POOL_RUNNING && it != gsseap_pool.end() &&
+            ( long ) it->second.idle.size() < gsseap_pool_size() ) {
+        it->second.idle.push_back( _conn );
+        keep = true;
+    }
+    else {
+        gsseap_pool_conns.erase( conn );
+    }
+    pthread_mutex_unlock( &gsseap_pool_mutex );
+
+    if ( !keep ) {
+        gsseap_pool_disconnect( _conn );
+    }
+    return 0;
+}
+
+void gsseap_pool_shutdown() {
+    std::vector<rcComm_t*> idle;
+
+    pthread_mutex_lock( &gsseap_pool_mutex );
+    bool running = gsseap_pool_state == GSSEAP_POOL_RUNNING;
+    gsseap_pool_state = GSSEAP_POOL_SHUTDOWN;
+    pthread_cond_broadcast( &gsseap_pool_cond );
+    pthread_mutex_unlock( &gsseap_pool_mutex );
+
+    if ( running ) {
+        pthread_join( gsseap_pool_thread, NULL );
+    }
+
+    pthread_mutex_lock( &gsseap_pool_mutex );
+    for ( std::map<std::string, gsseap_pool_entry_t>::iterator it = gsseap_pool.begin(); it != gsseap_pool.end(); ++it ) {
+        for ( size_t i = 0; i < it->second.idle.size(); i++ ) {
+            gsseap_pool_conns.erase( it->second.idle[i] );
+            idle.push_back( it->second.idle[i] );
+        }
+    }
+    gsseap_pool.clear();
+    gsseap_pool_state = GSSEAP_POOL_STOPPED;
+    pthread_mutex_unlock( &gsseap_pool_mutex );
+
+    for ( size_t i = 0; i < idle.size(); i++ ) {
+        gsseap_pool_disconnect( idle[i] );
+    }
+}
+
+void gsseap_pool_fork_lock() {
+    pthread_mutex_lock( &gsseap_pool_mutex );
+}
+
+void gsseap_pool_fork_unlock() {
+    pthread_mutex_unlock( &gsseap_pool_mutex );
+}
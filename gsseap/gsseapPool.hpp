@@ -0,0 +1,43 @@
+/* -*- mode: c++; fill-column: 132; c-basic-offset: 4; indent-tabs-mode: nil -*- */
+/* gsseapPool.hpp
+ * Client side: a pool of connections already logged in with GSS-EAP, for
+ * services that open a connection per request.  A background thread keeps a
+ * number of connections warm per server and identity and replaces them before
+ * their security context expires, so checking one out costs no handshake.
+ */
+
+#ifndef GSSEAP_POOL_HPP
+#define GSSEAP_POOL_HPP
+
+#include "rcConnect.hpp"
+
+#include "gsseapExport.hpp"
+
+extern "C" {
+
+    /// @brief Check out a connection to _host:_port logged in as _user#_zone, logging a new one in if none is warm.
+    ///        Returns NULL on failure, with the error in *_rtn_status if it is not NULL.
+    GSSEAP_EXPORT rcComm_t* gsseap_pool_get(
+        const char* _host,
+        int _port,
+        const char* _user,
+        const char* _zone,
+        int* _rtn_status );
+
+    /// @brief Return a connection checked out of the pool; it is disconnected instead if _healthy is 0 or the pool is full
+    GSSEAP_EXPORT int gsseap_pool_put(
+        rcComm_t* _conn,
+        int _healthy );
+
+    /// @brief Stop the refresh thread and disconnect every idle connection, checked out ones are disconnected when returned
+    GSSEAP_EXPORT void gsseap_pool_shutdown();
+
+}
+
+/// @brief Hold the pool across fork
+void gsseap_pool_fork_lock();
+
+/// @brief Release the pool after fork, in the parent and in the child
+void gsseap_pool_fork_unlock();
+
+#endif  /* GSSEAP_POOL_HPP */
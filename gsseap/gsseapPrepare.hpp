@@ -0,0 +1,23 @@
+/* -*- mode: c++; fill-column: 132; c-basic-offset: 4; indent-tabs-mode: nil -*- */
+/* gsseapPrepare.hpp
+ * Client side: prepare the first GSS-EAP token of a login in the background,
+ * so identity selection, credential acquisition and the first
+ * gss_init_sec_context step overlap with connecting to the server.
+ */
+
+#ifndef GSSEAP_PREPARE_HPP
+#define GSSEAP_PREPARE_HPP
+
+#include "gsseapExport.hpp"
+
+extern "C" {
+
+    /// @brief Start preparing the first token of a login to the acceptor _server_dn (NULL for the default)
+    ///        on a background thread.  The next login to that acceptor picks it up, waiting for it if it is
+    ///        not ready yet.  Returns 0, or an error if no preparation could be started.
+    GSSEAP_EXPORT int gsseap_client_prepare(
+        const char* _server_dn );
+
+}
+
+#endif  /* GSSEAP_PREPARE_HPP */
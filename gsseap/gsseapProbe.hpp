@@ -0,0 +1,28 @@
+/* -*- mode: c++; fill-column: 132; c-basic-offset: 4; indent-tabs-mode: nil -*- */
+/* gsseapProbe.hpp
+ * USDT probes (provider "gsseap") at the entry and return of each handshake and
+ * authorization phase, for bpftrace and perf on a running server.  Every probe
+ * carries the session id (the socket of the connection, -1 for work not bound
+ * to one yet), a length (token bytes or rows) and a status.  They compile to a
+ * nop and a note section with USDT=1 (needs sys/sdt.h), and to nothing without.
+ *
+ *     bpftrace -e 'usdt:/path/libgsseap.so:gsseap:accept_step_return { @[arg2] = count(); }'
+ */
+
+#ifndef GSSEAP_PROBE_HPP
+#define GSSEAP_PROBE_HPP
+
+#if defined(GSSEAP_USDT)
+
+#include <sys/sdt.h>
+
+#define GSSEAP_PROBE( _name, _session_id, _length, _status ) \
+    DTRACE_PROBE3( gsseap, _name, ( int ) ( _session_id ), ( unsigned long ) ( _length ), ( int ) ( _status ) )
+
+#else
+
+#define GSSEAP_PROBE( _name, _session_id, _length, _status ) do { } while ( 0 )
+
+#endif
+
+#endif  /* GSSEAP_PROBE_HPP */
@@ -0,0 +1,177 @@
+/* -*- mode: c++; fill-column: 132; c-basic-offset: 4; indent-tabs-mode: nil -*- */
+
+#include "gsseapSession.hpp"
+#include "gsseapUtil.hpp"
+
+#include <map>
+
+#include <pthread.h>
+#include <string.h>
+#include <sys/stat.h>
+
+static const long gsseap_min_token_size = 4096;
+static const long gsseap_max_max_token_size = 16 * 1024 * 1024;
+
+// Sessions are only looked up under the lock, each one is then used by the single thread logging its connection in
+static pthread_mutex_t gsseap_session_mutex = PTHREAD_MUTEX_INITIALIZER;
+static std::map<int, gsseap_session_t*> gsseap_sessions;
+
+static pthread_once_t gsseap_max_token_size_once = PTHREAD_ONCE_INIT;
+static unsigned int gsseap_max_token_size_value;
+
+static void gsseap_max_token_size_read() {
+    long configured = gsseap_env_long( "GSSEAP_MAX_TOKEN_SIZE", GSSEAP_DEFAULT_MAX_TOKEN_SIZE );
+    if ( configured < gsseap_min_token_size ) {
+        configured = gsseap_min_token_size;
+    }
+    else if ( configured > gsseap_max_max_token_size ) {
+        configured = gsseap_max_max_token_size;
+    }
+    gsseap_max_token_size_value = ( unsigned int ) configured;
+}
+
+unsigned int gsseap_max_token_size() {
+    pthread_once( &gsseap_max_token_size_once, gsseap_max_token_size_read );
+    return gsseap_max_token_size_value;
+}
+
+static void gsseap_session_clear(
+    gsseap_session_t* _session ) {
+    OM_uint32 minor_status;
+
+    if ( _session->context != GSS_C_NO_CONTEXT ) {
+        gss_delete_sec_context( &minor_status, &_session->context, GSS_C_NO_BUFFER );
+    }
+    if ( _session->peer != GSS_C_NO_NAME ) {
+        gss_release_name( &minor_status, &_session->peer );
+    }
+    gss_release_buffer( &minor_status, &_session->pending_token );
+    _session->token_header_mode = 1;
+    _session->r_error = NULL;
+    _session->context = GSS_C_NO_CONTEXT;
+    _session->context_flags = 0;
+    _session->handshake.active = 0;
+    _session->handshake.steps = 0;
+    _session->auth_req_status = 0;
+    _session->auth_req_error = 0;
+    _session->login_start.active = 0;
+    _session->login_path = NULL;
+    _session->map_us = 0;
+    _session->ticket_presented = 0;
+    _session->ticket_requested = 0;
+    _session->ticket = gsseap_ticket_t();
+    _session->ticket_challenge.clear();
+    _session->ticket_key.clear();
+    _session->ticket_cache_key.clear();
+    _session->server_dn.clear();
+    _session->server_mechs.clear();
+    _session->short_handshake = 0;
+    _session->mech = GSS_C_NO_OID;
+    _session->peer = GSS_C_NO_NAME;
+    _session->pending_token.length = 0;
+    _session->pending_token.value = NULL;
+    _session->gateway = 0;
+    _session->catalog_preconnect = 0;
+    _session->auth_req_error_msg[0] = '\0';
+    _session->client_name[0] = '\0';
+    _session->aaa_realm.clear();
+    _session->aaa_answered = 0;
+}
+
+/// @brief Identity of the socket open on _fd, sockets get a fresh inode each
+static ino_t gsseap_session_sock_id(
+    int _fd ) {
+    struct stat st;
+    return fstat( _fd, &st ) == 0 ? st.st_ino : 0;
+}
+
+gsseap_session_t* gsseap_session_get(
+    int _fd ) {
+    gsseap_session_t* session;
+    ino_t sock_id = gsseap_session_sock_id( _fd );
+    bool stale = false;
+
+    pthread_mutex_lock( &gsseap_session_mutex );
+    std::map<int, gsseap_session_t*>::iterator it = gsseap_sessions.find( _fd );
+    if ( it != gsseap_sessions.end() ) {
+        session = it->second;
+        // the connection the session was made for is gone and the descriptor was reused
+        if ( session->sock_id != sock_id ) {
+            session->sock_id = sock_id;
+            stale = true;
+        }
+    }
+    else {
+        session = new gsseap_session_t();
+        session->fd = _fd;
+        session->sock_id = sock_id;
+        session->scratch = NULL;
+        session->scratch_size = 0;
+        session->context = GSS_C_NO_CONTEXT;
+        session->peer = GSS_C_NO_NAME;
+        session->pending_token.length = 0;
+        session->pending_token.value = NULL;
+        gsseap_session_clear( session );
+        gsseap_sessions[_fd] = session;
+    }
+    pthread_mutex_unlock( &gsseap_session_mutex );
+
+    // only the thread owning the new connection uses its descriptor, so the old state can go outside the lock
+    if ( stale ) {
+        gsseap_session_clear( session );
+    }
+
+    return session;
+}
+
+gsseap_session_t* gsseap_session_begin(
+    int _fd,
+    rError_t* _r_error ) {
+    gsseap_session_t* session = gsseap_session_get( _fd );
+
+    gsseap_session_clear( session );
+    session->r_error = _r_error;
+    return session;
+}
+
+void gsseap_session_end(
+    int _fd ) {
+    gsseap_session_t* session = NULL;
+
+    pthread_mutex_lock( &gsseap_session_mutex );
+    std::map<int, gsseap_session_t*>::iterator it = gsseap_sessions.find( _fd );
+    if ( it != gsseap_sessions.end() ) {
+        session = it->second;
+        gsseap_sessions.erase( it );
+    }
+    pthread_mutex_unlock( &gsseap_session_mutex );
+
+    if ( session != NULL ) {
+        gsseap_session_clear( session );
+        delete[] session->scratch;
+        delete session;
+    }
+}
+
+void gsseap_session_reserve_scratch(
+    gsseap_session_t* _session ) {
+    if ( _session->scratch == NULL ) {
+        _session->scratch_size = gsseap_max_token_size();
+        _session->scratch = new char[_session->scratch_size]();
+    }
+}
+
+void gsseap_session_release_scratch(
+    gsseap_session_t* _session ) {
+    delete[] _session->scratch;
+    _session->scratch = NULL;
+    _session->scratch_size = 0;
+}
+
+void gsseap_session_fork_lock() {
+    pthread_mutex_lock( &gsseap_session_mutex );
+}
+
+void gsseap_session_fork_unlock() {
+    pthread_mutex_unlock( &gsseap_session_mutex );
+}
@@ -0,0 +1,107 @@
+/* -*- mode: c++; fill-column: 132; c-basic-offset: 4; indent-tabs-mode: nil -*- */
+/* gsseapSession.hpp
+ * The state of a GSS-EAP login, kept per connection socket rather than in
+ * process globals so that a multithreaded client can authenticate several
+ * connections at once.
+ */
+
+#ifndef GSSEAP_SESSION_HPP
+#define GSSEAP_SESSION_HPP
+
+#include "rodsError.hpp"
+#include "rodsUser.hpp"
+
+#include "gsseapStats.hpp"
+#include "gsseapTicket.hpp"
+
+#include <string>
+
+#include <sys/types.h>
+
+#include <gssapi.h>
+
+static const unsigned int GSSEAP_DEFAULT_MAX_TOKEN_SIZE = 20000;  // GSSEAP_MAX_TOKEN_SIZE overrides it
+static const unsigned int GSSEAP_AUTH_ERROR_SIZE = 1000;
+static const unsigned int GSSEAP_CLIENT_NAME_SIZE = 500;
+
+/// @brief Login state of one connection, owned by the thread authenticating it
+typedef struct {
+    // touched on every token
+    int fd;
+    ino_t sock_id;                    // inode of the socket on fd, a new connection reusing the descriptor has another
+    int token_header_mode;            // 1 is the normal mode, 0 means running in a non-token-header mode, ie Java; dynamically cleared
+    rError_t* r_error;
+    gss_ctx_id_t context;
+    OM_uint32 context_flags;
+    gsseap_handshake_stats_t handshake;
+    char* scratch;                    // token receive buffer, only while a login is in progress
+    unsigned int scratch_size;        // the largest token accepted, see gsseap_max_token_size; 0 without a buffer
+
+    // agent: outcome of agent_start, reported by the next auth request on the connection
+    int auth_req_status;
+    int auth_req_error;
+    gsseap_stats_mark_t login_start;  // agent: for login cost accounting and the audit log
+    const char* login_path;           // agent: how the identity was established, for the audit log
+    unsigned long long map_us;        // agent: time spent mapping the identity to an iRODS user
+
+    // session tickets
+    int ticket_presented;             // agent: the client presented a valid ticket
+    int ticket_requested;             // agent: send a ticket after a successful handshake
+    gsseap_ticket_t ticket;           // agent: the identity from the presented ticket
+    std::string ticket_challenge;     // agent: the client proves it holds the key of the presented ticket over this
+    std::string ticket_key;           // client: key of the presented ticket
+    std::string ticket_cache_key;     // client: server and user the current ticket belongs to
+    std::string server_dn;            // client: acceptor name announced by the server's capability probe
+    std::string server_mechs;         // client: mechanisms the server accepts, empty if unknown
+
+    // short handshake: the first token rides on the auth request and the reply to it on the request result
+    int short_handshake;              // client: the first token went with the auth request; agent: its accept step ran there
+    gss_OID mech;                     // client: mechanism of the context being established
+    gss_name_t peer;                  // agent: the initiator, if the first accept step already completed the context
+    gss_buffer_desc pending_token;    // agent: the reply to the first token, if it did not fit the request result
+
+    // gateway: an end user logging in over the connection of a trusted gateway, see gsseapGateway.hpp
+    int gateway;                      // agent: the login in progress is a gateway's
+    userInfo_t gateway_proxy;         // agent: the users of the connection before it, the gateway keeps being the proxy
+    userInfo_t gateway_client;        // agent: restored if the end user's login fails
+
+    int catalog_preconnect;           // agent: connect to the catalog the next time the handshake waits on the client
+
+    char auth_req_error_msg[GSSEAP_AUTH_ERROR_SIZE];
+    char client_name[GSSEAP_CLIENT_NAME_SIZE];  // agent: the authenticated GSS-EAP name
+    std::string aaa_realm;            // agent: realm the initiator announced, once the mechanism names it
+    int aaa_answered;                 // agent: the AAA backend answered for that realm, so a failure now counts against it
+} gsseap_session_t;
+
+/// @brief The largest token a session receives (GSSEAP_MAX_TOKEN_SIZE), read once per process
+unsigned int gsseap_max_token_size();
+
+/// @brief The session of the connection on _fd, created on first use; a session left behind by an earlier connection on
+/// the same descriptor is cleared first
+gsseap_session_t* gsseap_session_get(
+    int _fd );
+
+/// @brief Start a new login on _fd, dropping the security context of any previous login on the same socket
+gsseap_session_t* gsseap_session_begin(
+    int _fd,
+    rError_t* _r_error );
+
+/// @brief Forget the session of _fd
+void gsseap_session_end(
+    int _fd );
+
+/// @brief Give a login starting on _session the buffer it receives tokens in, if it does not have one yet
+void gsseap_session_reserve_scratch(
+    gsseap_session_t* _session );
+
+/// @brief Free the token buffer of a login that is over; the security context stays with the connection
+void gsseap_session_release_scratch(
+    gsseap_session_t* _session );
+
+/// @brief Hold the session map across fork, so neither process is left with it locked
+void gsseap_session_fork_lock();
+
+/// @brief Release the session map after fork, in the parent and in the child
+void gsseap_session_fork_unlock();
+
+#endif  /* GSSEAP_SESSION_HPP */
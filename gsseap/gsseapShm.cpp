@@ -0,0 +1,290 @@
+/* -*- mode: c++; fill-column: 132; c-basic-offset: 4; indent-tabs-mode: nil -*- */
+
+#include "rodsLog.hpp"
+
+#include "gsseapShm.hpp"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+static const unsigned int gsseap_shm_magic = 0x67656170;  // "geap"
+static const int gsseap_shm_wait_tries = 100;
+static const useconds_t gsseap_shm_wait_interval = 10000;
+
+// Entries are looked up in a short window of slots after their hash position
+static const unsigned int gsseap_shm_probe_window = 8;
+
+typedef struct {
+    unsigned int hash;
+    time_t expiry;                      // 0 marks a free slot
+    unsigned short key_len;
+    unsigned short value_len;
+    char key[GSSEAP_SHM_KEY_SIZE];
+    char value[GSSEAP_SHM_VALUE_SIZE];
+} gsseap_shm_entry_t;
+
+struct gsseap_shm_table {
+    gsseap_shm_header_t header;
+    unsigned int entries;
+    gsseap_shm_entry_t slots[1];
+};
+
+/// @brief Map the segment at _path, replacing it once if it was laid out for another size when _reinit is set
+static void* gsseap_shm_map_path(
+    const char* _path,
+    size_t _size,
+    void ( *_init )( void* ),
+    bool _reinit ) {
+    const char* path = _path;
+    size_t map_size = _size;
+    bool created = false;
+    int i;
+
+    int fd = shm_open( path, O_RDWR | O_CREAT | O_EXCL, 0600 );
+    if ( fd >= 0 ) {
+        created = true;
+        if ( ftruncate( fd, _size ) != 0 ) {
+            rodsLog( LOG_ERROR, "gsseap_shm_map: ftruncate of %s failed, error = %s", path, strerror( errno ) );
+            close( fd );
+            shm_unlink( path );
+            return NULL;
+        }
+    }
+    else if ( errno == EEXIST ) {
+        fd = shm_open( path, O_RDWR, 0600 );
+    }
+    if ( fd < 0 ) {
+        rodsLog( LOG_ERROR, "gsseap_shm_map: shm_open of %s failed, error = %s", path, strerror( errno ) );
+        return NULL;
+    }
+
+    if ( !created ) {
+        // the creator may not have sized the segment yet, it does so in one step before initializing it
+        struct stat st;
+        for ( i = 0; i < gsseap_shm_wait_tries; i++ ) {
+            if ( fstat( fd, &st ) == 0 && ( size_t ) st.st_size >= sizeof( gsseap_shm_header_t ) ) {
+                break;
+            }
+            usleep( gsseap_shm_wait_interval );
+        }
+        if ( i == gsseap_shm_wait_tries ) {
+            rodsLog( LOG_ERROR, "gsseap_shm_map: %s was never sized, remove it and restart the server", path );
+            close( fd );
+            return NULL;
+        }
+        map_size = st.st_size;
+    }
+
+    void* addr = mmap( NULL, map_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0 );
+    close( fd );
+    if ( addr == MAP_FAILED ) {
+        rodsLog( LOG_ERROR, "gsseap_shm_map: mmap of %s failed, error = %s", path, strerror( errno ) );
+        return NULL;
+    }
+
+    gsseap_shm_header_t* header = ( gsseap_shm_header_t* ) addr;
+    if ( created ) {
+        pthread_mutexattr_t attr;
+        pthread_mutexattr_init( &attr );
+        pthread_mutexattr_setpshared( &attr, PTHREAD_PROCESS_SHARED );
+        pthread_mutexattr_setrobust( &attr, PTHREAD_MUTEX_ROBUST );
+        pthread_mutex_init( &header->lock, &attr );
+        pthread_mutexattr_destroy( &attr );
+        header->size = _size;
+        if ( _init != NULL ) {
+            _init( addr );
+        }
+        __sync_synchronize();
+        header->magic = gsseap_shm_magic;
+    }
+    else {
+        for ( i = 0; i < gsseap_shm_wait_tries && header->magic != gsseap_shm_magic; i++ ) {
+            usleep( gsseap_shm_wait_interval );
+        }
+        if ( header->magic != gsseap_shm_magic ) {
+            rodsLog( LOG_ERROR, "gsseap_shm_map: %s was never initialized, remove it and restart the server", path );
+            munmap( addr, map_size );
+            return NULL;
+        }
+        if ( header->size != _size || map_size != _size ) {
+            // laid out for another configuration, e.g. a different number of entries; agents that still map the
+            // old segment keep using it until they exit, new ones share the replacement
+            munmap( addr, map_size );
+            if ( !_reinit ) {
+                rodsLog( LOG_ERROR, "gsseap_shm_map: %s has %u bytes instead of %u", path, header->size, ( unsigned int ) _size );
+                return NULL;
+            }
+            rodsLog( LOG_NOTICE, "gsseap_shm_map: %s has %u bytes instead of %u, replacing it", path,
+                     ( unsigned int ) map_size, ( unsigned int ) _size );
+            shm_unlink( path );
+            return gsseap_shm_map_path( path, _size, _init, false );
+        }
+    }
+
+    return addr;
+}
+
+void* gsseap_shm_map(
+    const char* _name,
+    size_t _size,
+    void ( *_init )( void* ) ) {
+    char path[256];
+
+    // one namespace per service account, so test servers do not collide with production
+    snprintf( path, sizeof( path ), "/irods_gsseap_%s.%u", _name, ( unsigned int ) geteuid() );
+    return gsseap_shm_map_path( path, _size, _init, true );
+}
+
+int gsseap_shm_lock(
+    gsseap_shm_header_t* _header ) {
+    int status = pthread_mutex_lock( &_header->lock );
+    if ( status == EOWNERDEAD ) {
+        // an agent died inside the critical section; the tables below only publish an entry
+        // by setting its expiry last, so a half written entry is simply a free slot
+        pthread_mutex_consistent( &_header->lock );
+        status = 0;
+    }
+    return status;
+}
+
+void gsseap_shm_unlock(
+    gsseap_shm_header_t* _header ) {
+    pthread_mutex_unlock( &_header->lock );
+}
+
+static unsigned int gsseap_shm_hash( const std::string& _key ) {
+    unsigned int hash = 2166136261u;
+    size_t i;
+    for ( i = 0; i < _key.size(); i++ ) {
+        hash ^= ( unsigned char ) _key[i];
+        hash *= 16777619u;
+    }
+    return hash;
+}
+
+static unsigned int gsseap_shm_table_entries;
+
+static void gsseap_shm_table_init( void* _addr ) {
+    gsseap_shm_table_t* table = ( gsseap_shm_table_t* ) _addr;
+    table->entries = gsseap_shm_table_entries;
+    memset( table->slots, 0, sizeof( gsseap_shm_entry_t ) * table->entries );
+}
+
+gsseap_shm_table_t* gsseap_shm_table_open(
+    const char* _name,
+    unsigned int _entries ) {
+    if ( _entries < gsseap_shm_probe_window ) {
+        _entries = gsseap_shm_probe_window;
+    }
+    gsseap_shm_table_entries = _entries;
+    return ( gsseap_shm_table_t* ) gsseap_shm_map( _name,
+            sizeof( gsseap_shm_table_t ) + sizeof( gsseap_shm_entry_t ) * ( _entries - 1 ),
+            gsseap_shm_table_init );
+}
+
+/// @brief Find the slot holding _key, the caller holds the lock
+static gsseap_shm_entry_t* gsseap_shm_table_find(
+    gsseap_shm_table_t* _table,
+    const std::string& _key,
+    unsigned int _hash ) {
+    unsigned int i;
+    for ( i = 0; i < gsseap_shm_probe_window; i++ ) {
+        gsseap_shm_entry_t* entry = &_table->slots[( _hash + i ) % _table->entries];
+        if ( entry->expiry != 0 && entry->hash == _hash && entry->key_len == _key.size() &&
+                memcmp( entry->key, _key.data(), _key.size() ) == 0 ) {
+            return entry;
+        }
+    }
+    return NULL;
+}
+
+bool gsseap_shm_table_get(
+    gsseap_shm_table_t* _table,
+    const std::string& _key,
+    std::string& _rtn_value ) {
+    bool found = false;
+    unsigned int hash = gsseap_shm_hash( _key );
+
+    if ( _table == NULL || gsseap_shm_lock( &_table->header ) != 0 ) {
+        return false;
+    }
+
+    gsseap_shm_entry_t* entry = gsseap_shm_table_find( _table, _key, hash );
+    if ( entry != NULL ) {
+        if ( entry->expiry > time( NULL ) ) {
+            _rtn_value.assign( entry->value, entry->value_len );
+            found = true;
+        }
+        else {
+            entry->expiry = 0;
+        }
+    }
+
+    gsseap_shm_unlock( &_table->header );
+    return found;
+}
+
+void gsseap_shm_table_put(
+    gsseap_shm_table_t* _table,
+    const std::string& _key,
+    const std::string& _value,
+    time_t _ttl ) {
+    unsigned int hash = gsseap_shm_hash( _key );
+    unsigned int i;
+
+    if ( _table == NULL ) {
+        return;
+    }
+    if ( _key.size() > GSSEAP_SHM_KEY_SIZE || _value.size() > GSSEAP_SHM_VALUE_SIZE ) {
+        rodsLog( LOG_NOTICE, "gsseap_shm_table_put: not storing an entry with a %u byte key and a %u byte value, the limits are %u and %u",
+                 ( unsigned int ) _key.size(), ( unsigned int ) _value.size(),
+                 ( unsigned int ) GSSEAP_SHM_KEY_SIZE, ( unsigned int ) GSSEAP_SHM_VALUE_SIZE );
+        return;
+    }
+    if ( gsseap_shm_lock( &_table->header ) != 0 ) {
+        return;
+    }
+
+    gsseap_shm_entry_t* entry = gsseap_shm_table_find( _table, _key, hash );
+    if ( entry == NULL ) {
+        // take a free slot, else the one that expires first
+        for ( i = 0; i < gsseap_shm_probe_window; i++ ) {
+            gsseap_shm_entry_t* candidate = &_table->slots[( hash + i ) % _table->entries];
+            if ( entry == NULL || candidate->expiry < entry->expiry ) {
+                entry = candidate;
+            }
+        }
+    }
+
+    entry->expiry = 0;
+    entry->hash = hash;
+    entry->key_len = _key.size();
+    entry->value_len = _value.size();
+    memcpy( entry->key, _key.data(), _key.size() );
+    memcpy( entry->value, _value.data(), _value.size() );
+    entry->expiry = time( NULL ) + _ttl;
+
+    gsseap_shm_unlock( &_table->header );
+}
+
+void gsseap_shm_table_remove(
+    gsseap_shm_table_t* _table,
+    const std::string& _key ) {
+    unsigned int hash = gsseap_shm_hash( _key );
+
+    if ( _table == NULL || gsseap_shm_lock( &_table->header ) != 0 ) {
+        return;
+    }
+
+    gsseap_shm_entry_t* entry = gsseap_shm_table_find( _table, _key, hash );
+    if ( entry != NULL ) {
+        entry->expiry = 0;
+    }
+
+    gsseap_shm_unlock( &_table->header );
+}
@@ -0,0 +1,67 @@
+/* -*- mode: c++; fill-column: 132; c-basic-offset: 4; indent-tabs-mode: nil -*- */
+/* gsseapShm.hpp
+ * State shared by all agents of one server, kept in POSIX shared memory so it
+ * survives the fork-per-connection agent model.
+ */
+
+#ifndef GSSEAP_SHM_HPP
+#define GSSEAP_SHM_HPP
+
+#include <string>
+
+#include <pthread.h>
+#include <time.h>
+
+/// @brief Every shared segment starts with this header
+typedef struct {
+    volatile unsigned int magic;  // set once the creator finished initializing
+    unsigned int size;            // total size of the segment
+    pthread_mutex_t lock;         // robust, process shared
+} gsseap_shm_header_t;
+
+/// @brief Map the named segment of _size bytes, creating and initializing it with _init if it does not exist yet, or
+/// replacing it if it was created with another size
+void* gsseap_shm_map(
+    const char* _name,
+    size_t _size,
+    void ( *_init )( void* ) );
+
+/// @brief Lock a segment, recovering the lock if its previous owner died while holding it
+int gsseap_shm_lock(
+    gsseap_shm_header_t* _header );
+
+/// @brief Unlock a segment
+void gsseap_shm_unlock(
+    gsseap_shm_header_t* _header );
+
+/// @brief A bounded key/value table with per-entry expiry in shared memory
+typedef struct gsseap_shm_table gsseap_shm_table_t;
+
+static const size_t GSSEAP_SHM_KEY_SIZE = 256;
+static const size_t GSSEAP_SHM_VALUE_SIZE = 256;
+
+/// @brief Open the named table, NULL if shared memory is unavailable
+gsseap_shm_table_t* gsseap_shm_table_open(
+    const char* _name,
+    unsigned int _entries );
+
+/// @brief Fetch an unexpired value
+bool gsseap_shm_table_get(
+    gsseap_shm_table_t* _table,
+    const std::string& _key,
+    std::string& _rtn_value );
+
+/// @brief Store a value for _ttl seconds, evicting the entry closest to expiry when the table is full; keys and values over
+/// the size limits are logged and not stored
+void gsseap_shm_table_put(
+    gsseap_shm_table_t* _table,
+    const std::string& _key,
+    const std::string& _value,
+    time_t _ttl );
+
+/// @brief Drop a value
+void gsseap_shm_table_remove(
+    gsseap_shm_table_t* _table,
+    const std::string& _key );
+
+#endif  /* GSSEAP_SHM_HPP */
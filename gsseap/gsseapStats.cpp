@@ -0,0 +1,215 @@
+/* -*- mode: c++; fill-column: 132; c-basic-offset: 4; indent-tabs-mode: nil -*- */
+
+#include "rodsLog.hpp"
+
+#include "gsseapShm.hpp"
+#include "gsseapStats.hpp"
+#include "gsseapUtil.hpp"
+
+#include <string.h>
+
+static const long gsseap_stats_default_interval = 1000;  // logins between reports
+static const int gsseap_stats_buckets = 24;              // bucket i counts logins of [2^i, 2^(i+1)) ms, bucket 0 those under 2 ms
+
+typedef struct {
+    gsseap_shm_header_t header;
+    unsigned long long logins;          // since the segment was created
+    unsigned long long failures;
+    struct timeval since;               // start of the current report interval
+    unsigned long long interval_logins;
+    unsigned long long interval_failures;
+    unsigned long long interval_wall_us;
+    unsigned long long interval_cpu_us;
+    unsigned long long interval_handshakes;
+    unsigned long long interval_round_trips;
+    unsigned long long interval_bytes;
+    unsigned long long interval_step_us;
+    long interval_max_rss_kb;
+    unsigned long long interval_buckets[gsseap_stats_buckets];
+} gsseap_stats_t;
+
+static gsseap_stats_t* gsseap_stats = NULL;
+
+static void gsseap_stats_init( void* _addr ) {
+    gsseap_stats_t* stats = ( gsseap_stats_t* ) _addr;
+    memset( ( char* ) stats + sizeof( stats->header ), 0, sizeof( *stats ) - sizeof( stats->header ) );
+    gettimeofday( &stats->since, NULL );
+}
+
+bool gsseap_stats_enabled() {
+    return gsseap_env_long( "GSSEAP_LOGIN_STATS", 0 ) > 0;
+}
+
+static unsigned long long gsseap_stats_us(
+    const struct timeval* _tv ) {
+    return ( unsigned long long ) _tv->tv_sec * 1000000 + _tv->tv_usec;
+}
+
+unsigned long long gsseap_stats_elapsed_us(
+    const struct timeval* _since ) {
+    struct timeval now;
+    gettimeofday( &now, NULL );
+    return gsseap_stats_us( &now ) - gsseap_stats_us( _since );
+}
+
+void gsseap_stats_begin(
+    gsseap_stats_mark_t* _mark ) {
+    gettimeofday( &_mark->wall, NULL );
+    getrusage( RUSAGE_SELF, &_mark->usage );
+    _mark->active = 1;
+}
+
+/// @brief The upper bound in ms of the bucket holding the _percent'th percentile, the caller holds the lock
+static unsigned long long gsseap_stats_percentile(
+    int _percent ) {
+    unsigned long long want = ( gsseap_stats->interval_logins * _percent + 99 ) / 100;
+    unsigned long long seen = 0;
+    int i;
+
+    for ( i = 0; i < gsseap_stats_buckets; i++ ) {
+        seen += gsseap_stats->interval_buckets[i];
+        if ( seen >= want ) {
+            break;
+        }
+    }
+    return 2ULL << ( i < gsseap_stats_buckets ? i : gsseap_stats_buckets - 1 );
+}
+
+unsigned long long gsseap_stats_end(
+    gsseap_stats_mark_t* _mark,
+    const gsseap_handshake_stats_t* _handshake,
+    int _status ) {
+    struct timeval now;
+    struct rusage usage;
+    struct timeval cpu;
+    struct timeval cpu_start;
+
+    if ( !_mark->active ) {
+        return 0;
+    }
+    _mark->active = 0;
+
+    gettimeofday( &now, NULL );
+    getrusage( RUSAGE_SELF, &usage );
+    timeradd( &usage.ru_utime, &usage.ru_stime, &cpu );
+    timeradd( &_mark->usage.ru_utime, &_mark->usage.ru_stime, &cpu_start );
+    unsigned long long wall_us = gsseap_stats_us( &now ) - gsseap_stats_us( &_mark->wall );
+    unsigned long long cpu_us = gsseap_stats_us( &cpu ) - gsseap_stats_us( &cpu_start );
+
+    if ( !gsseap_stats_enabled() ) {
+        return wall_us;
+    }
+
+    rodsLog( LOG_DEBUG, "gsseap_stats_end: login status %d, %llu us wall, %llu us cpu, %ld kB max rss",
+             _status, wall_us, cpu_us, usage.ru_maxrss );
+
+    if ( gsseap_stats == NULL ) {
+        gsseap_stats = ( gsseap_stats_t* ) gsseap_shm_map( "stats", sizeof( gsseap_stats_t ), gsseap_stats_init );
+        if ( gsseap_stats == NULL ) {
+            return wall_us;
+        }
+    }
+    if ( gsseap_shm_lock( &gsseap_stats->header ) != 0 ) {
+        return wall_us;
+    }
+
+    int bucket = 0;
+    unsigned long long ms = wall_us / 1000;
+    while ( ms > 1 && bucket < gsseap_stats_buckets - 1 ) {
+        ms >>= 1;
+        bucket++;
+    }
+
+    gsseap_stats->logins++;
+    gsseap_stats->interval_logins++;
+    if ( _status < 0 ) {
+        gsseap_stats->failures++;
+        gsseap_stats->interval_failures++;
+    }
+    gsseap_stats->interval_wall_us += wall_us;
+    gsseap_stats->interval_cpu_us += cpu_us;
+    if ( usage.ru_maxrss > gsseap_stats->interval_max_rss_kb ) {
+        gsseap_stats->interval_max_rss_kb = usage.ru_maxrss;
+    }
+    gsseap_stats->interval_buckets[bucket]++;
+    if ( _handshake != NULL && _handshake->steps > 0 ) {
+        gsseap_stats->interval_handshakes++;
+        gsseap_stats->interval_round_trips += _handshake->round_trips;
+        gsseap_stats->interval_bytes += _handshake->bytes_sent + _handshake->bytes_received;
+        gsseap_stats->interval_step_us += _handshake->step_us;
+    }
+
+    long interval = gsseap_env_long( "GSSEAP_LOGIN_STATS_INTERVAL", gsseap_stats_default_interval );
+    if ( interval > 0 && gsseap_stats->interval_logins >= ( unsigned long long ) interval ) {
+        unsigned long long elapsed_us = gsseap_stats_us( &now ) - gsseap_stats_us( &gsseap_stats->since );
+        unsigned long long n = gsseap_stats->interval_logins;
+        unsigned long long handshakes = gsseap_stats->interval_handshakes;
+        rodsLog( LOG_NOTICE,
+                 "gsseap_stats: %llu logins (%llu failed) at %.1f/s, latency p50 < %llu ms p95 < %llu ms p99 < %llu ms, "
+                 "mean %llu us wall %llu us cpu per login, agent max rss %ld kB, "
+                 "%llu handshakes of mean %.1f round trips %llu bytes %llu us in the mechanism",
+                 n, gsseap_stats->interval_failures, elapsed_us > 0 ? n * 1000000.0 / elapsed_us : 0.0,
+                 gsseap_stats_percentile( 50 ), gsseap_stats_percentile( 95 ), gsseap_stats_percentile( 99 ),
+                 gsseap_stats->interval_wall_us / n, gsseap_stats->interval_cpu_us / n, gsseap_stats->interval_max_rss_kb,
+                 handshakes, handshakes > 0 ? ( double ) gsseap_stats->interval_round_trips / handshakes : 0.0,
+                 handshakes > 0 ? gsseap_stats->interval_bytes / handshakes : 0,
+                 handshakes > 0 ? gsseap_stats->interval_step_us / handshakes : 0 );
+
+        gsseap_stats->since = now;
+        gsseap_stats->interval_logins = 0;
+        gsseap_stats->interval_failures = 0;
+        gsseap_stats->interval_wall_us = 0;
+        gsseap_stats->interval_cpu_us = 0;
+        gsseap_stats->interval_handshakes = 0;
+        gsseap_stats->interval_round_trips = 0;
+        gsseap_stats->interval_bytes = 0;
+        gsseap_stats->interval_step_us = 0;
+        gsseap_stats->interval_max_rss_kb = 0;
+        memset( gsseap_stats->interval_buckets, 0, sizeof( gsseap_stats->interval_buckets ) );
+    }
+
+    gsseap_shm_unlock( &gsseap_stats->header );
+    return wall_us;
+}
+
+void gsseap_handshake_begin(
+    gsseap_handshake_stats_t* _handshake ) {
+    memset( _handshake, 0, sizeof( *_handshake ) );
+    gettimeofday( &_handshake->start, NULL );
+    _handshake->active = 1;
+}
+
+void gsseap_handshake_step(
+    gsseap_handshake_stats_t* _handshake,
+    const struct timeval* _since ) {
+    unsigned long long us = gsseap_stats_elapsed_us( _since );
+
+    _handshake->steps++;
+    _handshake->step_us += us;
+    if ( us > _handshake->max_step_us ) {
+        _handshake->max_step_us = us;
+    }
+}
+
+void gsseap_handshake_end(
+    gsseap_handshake_stats_t* _handshake,
+    const char* _side,
+    int _status ) {
+    if ( !_handshake->active ) {
+        return;
+    }
+    _handshake->active = 0;
+    _handshake->total_us = gsseap_stats_elapsed_us( &_handshake->start );
+
+    if ( gsseap_env_long( "GSSEAP_HANDSHAKE_STATS", 0 ) <= 0 ) {
+        return;
+    }
+    unsigned long long accounted = _handshake->step_us + _handshake->wait_us;
+    rodsLog( LOG_NOTICE,
+             "gsseap_handshake: %s status %d, mechanism %s, %u round trips, %u tokens %llu bytes sent, %llu bytes received, "
+             "%llu us: %llu us in %u mechanism steps (slowest %llu us), %llu us waiting for the peer, %llu us in the plugin",
+             _side, _status, _handshake->mech[0] != '\0' ? _handshake->mech : "unknown",
+             _handshake->round_trips, _handshake->tokens_sent, _handshake->bytes_sent, _handshake->bytes_received,
+             _handshake->total_us, _handshake->step_us, _handshake->steps, _handshake->max_step_us, _handshake->wait_us,
+             _handshake->total_us > accounted ? _handshake->total_us - accounted : 0 );
+}
@@ -0,0 +1,72 @@
+/* -*- mode: c++; fill-column: 132; c-basic-offset: 4; indent-tabs-mode: nil -*- */
+/* gsseapStats.hpp
+ * Cost accounting for server side logins.  Each agent measures the wall time,
+ * CPU time and peak RSS of its logins, and all agents of a server add them to
+ * totals in shared memory which are periodically logged as logins per second,
+ * latency percentiles and CPU per login.  Both sides can also break a single
+ * handshake down into round trips, bytes on the wire, time in the mechanism
+ * (which on the acceptor includes the AAA exchange) and time waiting for the peer.
+ */
+
+#ifndef GSSEAP_STATS_HPP
+#define GSSEAP_STATS_HPP
+
+#include <sys/resource.h>
+#include <sys/time.h>
+
+/// @brief Where a login started
+typedef struct {
+    int active;
+    struct timeval wall;
+    struct rusage usage;
+} gsseap_stats_mark_t;
+
+/// @brief Where the time of one GSS-EAP handshake went
+typedef struct {
+    int active;
+    struct timeval start;
+    unsigned int round_trips;           // tokens received from the peer
+    unsigned int tokens_sent;
+    unsigned long long bytes_sent;      // on the wire, length headers included
+    unsigned long long bytes_received;
+    unsigned int steps;                 // gss_init_sec_context or gss_accept_sec_context calls
+    unsigned long long step_us;
+    unsigned long long max_step_us;
+    unsigned long long wait_us;         // blocked reading the peer's tokens
+    unsigned long long total_us;        // set by gsseap_handshake_end
+    char mech[32];                      // the mechanism the peers settled on
+} gsseap_handshake_stats_t;
+
+/// @brief Whether login accounting is configured (GSSEAP_LOGIN_STATS)
+bool gsseap_stats_enabled();
+
+/// @brief Start measuring a login
+void gsseap_stats_begin(
+    gsseap_stats_mark_t* _mark );
+
+/// @brief Finish measuring a login started with gsseap_stats_begin, once; returns its wall time in microseconds
+unsigned long long gsseap_stats_end(
+    gsseap_stats_mark_t* _mark,
+    const gsseap_handshake_stats_t* _handshake,
+    int _status );
+
+/// @brief Microseconds since _since
+unsigned long long gsseap_stats_elapsed_us(
+    const struct timeval* _since );
+
+/// @brief Start accounting a handshake
+void gsseap_handshake_begin(
+    gsseap_handshake_stats_t* _handshake );
+
+/// @brief Account for a mechanism step that started at _since
+void gsseap_handshake_step(
+    gsseap_handshake_stats_t* _handshake,
+    const struct timeval* _since );
+
+/// @brief Finish a handshake, logging its breakdown if GSSEAP_HANDSHAKE_STATS is set
+void gsseap_handshake_end(
+    gsseap_handshake_stats_t* _handshake,
+    const char* _side,
+    int _status );
+
+#endif  /* GSSEAP_STATS_HPP */
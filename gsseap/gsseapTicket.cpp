@@ -0,0 +1,445 @@
+/* -*- mode: c++; fill-column: 132; c-basic-offset: 4; indent-tabs-mode: nil -*- */
+
+#include "rodsErrorTable.hpp"
+#include "rodsLog.hpp"
+#include "irods_error.hpp"
+
+#include "gsseapTicket.hpp"
+#include "gsseapUtil.hpp"
+
+#include <openssl/crypto.h>
+#include <openssl/evp.h>
+#include <openssl/hmac.h>
+#include <openssl/rand.h>
+
+#include <map>
+#include <string>
+
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+/*
+  Ticket format:
+
+      base64url( "1|<key epoch>|<expiry>|<user>|<zone>|<user type>|<client name>" ) "." base64url( mac )
+
+  The mac is an HMAC-SHA256 under a key derived from the master secret in GSSEAP_TICKET_KEY_FILE and the key
+  epoch (time / GSSEAP_TICKET_KEY_ROTATION), so keys rotate without any shared state between agents.  Tickets
+  signed under the current or the previous epoch key are accepted, and the lifetime is capped at the rotation
+  period so no valid ticket outlives its key.
+
+  The key of a ticket is an HMAC of its mac under the epoch key, so any agent can derive it from the ticket
+  while only the client learns it, wrapped under the GSS-EAP context of the login that issued the ticket.
+  Presenting a ticket gets the client a random challenge, and it logs in by answering with an HMAC of the
+  challenge under the ticket key; a ticket seen on the wire is of no use without that key.
+*/
+
+static const char* const gsseap_ticket_version = "1";
+static const long gsseap_ticket_default_lifetime = 600;
+static const long gsseap_ticket_default_rotation = 3600;
+static const long gsseap_ticket_min_rotation = 60;
+static const size_t gsseap_ticket_min_key_size = 32;
+static const size_t gsseap_ticket_max_key_size = 4096;
+static const size_t gsseap_ticket_challenge_size = 32;
+
+// Refuse to present a ticket that would expire while the request is in flight
+static const time_t gsseap_ticket_expiry_margin = 5;
+
+// Loaded once under the lock, the key never changes afterwards
+static pthread_mutex_t gsseap_ticket_key_mutex = PTHREAD_MUTEX_INITIALIZER;
+static int gsseap_ticket_key_state = 0;  // 0 not yet loaded, 1 loaded, -1 unavailable
+static std::string gsseap_ticket_master_key;
+
+static pthread_mutex_t gsseap_ticket_cache_mutex = PTHREAD_MUTEX_INITIALIZER;
+static std::map<std::string, std::string> gsseap_ticket_cache;
+
+static long gsseap_ticket_rotation() {
+    long rotation = gsseap_env_long( "GSSEAP_TICKET_KEY_ROTATION", gsseap_ticket_default_rotation );
+    if ( rotation < gsseap_ticket_min_rotation ) {
+        rotation = gsseap_ticket_min_rotation;
+    }
+    return rotation;
+}
+
+static long gsseap_ticket_lifetime() {
+    long lifetime = gsseap_env_long( "GSSEAP_TICKET_LIFETIME", gsseap_ticket_default_lifetime );
+    long rotation = gsseap_ticket_rotation();
+    if ( lifetime <= 0 ) {
+        lifetime = gsseap_ticket_default_lifetime;
+    }
+    if ( lifetime > rotation ) {
+        lifetime = rotation;
+    }
+    return lifetime;
+}
+
+/// @brief Read the master ticket secret, called with gsseap_ticket_key_mutex held
+static irods::error gsseap_ticket_read_key() {
+    irods::error result = SUCCESS();
+
+    gsseap_ticket_key_state = -1;
+    const char* path = gsseap_env_string( "GSSEAP_TICKET_KEY_FILE" );
+    if ( path == NULL ) {
+        return ERROR( SYS_CONFIG_FILE_ERR, "GSSEAP_TICKET_KEY_FILE is not set." );
+    }
+
+    int fd = open( path, O_RDONLY );
+    if ( !( result = ASSERT_ERROR( fd >= 0, SYS_CONFIG_FILE_ERR, "Failed opening ticket key file \"%s\", error = %s.",
+                                   path, strerror( errno ) ) ).ok() ) {
+        return result;
+    }
+
+    struct stat st;
+    char buf[gsseap_ticket_max_key_size];
+    ssize_t len = -1;
+    if ( ( result = ASSERT_ERROR( fstat( fd, &st ) == 0 && ( st.st_mode & ( S_IRWXG | S_IRWXO ) ) == 0, SYS_CONFIG_FILE_ERR,
+                                  "Ticket key file \"%s\" must not be accessible by group or other.", path ) ).ok() ) {
+        len = read( fd, buf, sizeof( buf ) );
+        result = ASSERT_ERROR( len >= ( ssize_t ) gsseap_ticket_min_key_size, SYS_CONFIG_FILE_ERR,
+                               "Ticket key file \"%s\" must hold at least %u bytes.", path, ( unsigned int ) gsseap_ticket_min_key_size );
+    }
+    close( fd );
+
+    if ( result.ok() ) {
+        gsseap_ticket_master_key.assign( buf, len );
+        gsseap_ticket_key_state = 1;
+    }
+    memset( buf, 0, sizeof( buf ) );
+
+    return result;
+}
+
+/// @brief Load the master ticket secret once per process
+static irods::error gsseap_ticket_load_key() {
+    irods::error result = SUCCESS();
+
+    pthread_mutex_lock( &gsseap_ticket_key_mutex );
+    if ( gsseap_ticket_key_state == 0 ) {
+        result = gsseap_ticket_read_key();
+    }
+    else if ( gsseap_ticket_key_state == -1 ) {
+        result = ERROR( SYS_CONFIG_FILE_ERR, "GSS-EAP session ticket key unavailable." );
+    }
+    pthread_mutex_unlock( &gsseap_ticket_key_mutex );
+
+    return result;
+}
+
+/// @brief Sign a payload under the key of the given epoch
+static std::string gsseap_ticket_mac(
+    long _epoch,
+    const std::string& _payload ) {
+    unsigned char epoch_key[EVP_MAX_MD_SIZE];
+    unsigned int epoch_key_len = 0;
+    unsigned char mac[EVP_MAX_MD_SIZE];
+    unsigned int mac_len = 0;
+    char label[64];
+
+    snprintf( label, sizeof( label ), "irods-gsseap-ticket-key:%ld", _epoch );
+    HMAC( EVP_sha256(), gsseap_ticket_master_key.data(), gsseap_ticket_master_key.size(),
+          ( const unsigned char* ) label, strlen( label ), epoch_key, &epoch_key_len );
+    HMAC( EVP_sha256(), epoch_key, epoch_key_len,
+          ( const unsigned char* ) _payload.data(), _payload.size(), mac, &mac_len );
+    OPENSSL_cleanse( epoch_key, sizeof( epoch_key ) );
+
+    return std::string( ( const char* ) mac, mac_len );
+}
+
+/// @brief The proof of possession key of the ticket with the given mac
+static std::string gsseap_ticket_key(
+    long _epoch,
+    const std::string& _mac ) {
+    // ticket payloads start with the version, so this never signs a payload
+    return gsseap_ticket_mac( _epoch, "key|" + _mac );
+}
+
+/// @brief Split a decoded payload into its fields, the client name is last and may contain the separator
+static bool gsseap_ticket_parse_payload(
+    const std::string& _payload,
+    long* _epoch,
+    gsseap_ticket_t& _rtn_ticket ) {
+    std::string fields[7];
+    size_t start = 0;
+    int i;
+
+    for ( i = 0; i < 6; i++ ) {
+        size_t end = _payload.find( '|', start );
+        if ( end == std::string::npos ) {
+            return false;
+        }
+        fields[i] = _payload.substr( start, end - start );
+        start = end + 1;
+    }
+    fields[6] = _payload.substr( start );
+
+    if ( fields[0] != gsseap_ticket_version ) {
+        return false;
+    }
+    *_epoch = strtol( fields[1].c_str(), NULL, 10 );
+    _rtn_ticket.expiry = ( time_t ) strtol( fields[2].c_str(), NULL, 10 );
+    _rtn_ticket.user_name = fields[3];
+    _rtn_ticket.zone_name = fields[4];
+    _rtn_ticket.user_type = fields[5];
+    _rtn_ticket.client_name = fields[6];
+
+    return true;
+}
+
+bool gsseap_ticket_enabled() {
+    return gsseap_ticket_load_key().ok();
+}
+
+irods::error gsseap_ticket_issue(
+    gsseap_ticket_t& _ticket,
+    std::string& _rtn_encoded ) {
+    irods::error result = SUCCESS();
+    irods::error ret;
+
+    ret = gsseap_ticket_load_key();
+    if ( ( result = ASSERT_PASS( ret, "Session tickets are not configured." ) ).ok() ) {
+        if ( ( result = ASSERT_ERROR( _ticket.user_name.find( '|' ) == std::string::npos &&
+                                      _ticket.zone_name.find( '|' ) == std::string::npos &&
+                                      _ticket.user_type.find( '|' ) == std::string::npos,
+                                      SYS_INVALID_INPUT_PARAM, "Invalid character in ticket identity." ) ).ok() ) {
+
+            time_t now = time( NULL );
+            long epoch = now / gsseap_ticket_rotation();
+            char header[64];
+
+            _ticket.expiry = now + gsseap_ticket_lifetime();
+            snprintf( header, sizeof( header ), "%s|%ld|%ld|", gsseap_ticket_version, epoch, ( long ) _ticket.expiry );
+
+            std::string payload = header;
+            payload += _ticket.user_name + "|" + _ticket.zone_name + "|" + _ticket.user_type + "|" + _ticket.client_name;
+
+            std::string mac = gsseap_ticket_mac( epoch, payload );
+            _ticket.key = gsseap_ticket_key( epoch, mac );
+            _rtn_encoded = gsseap_base64url_encode( ( const unsigned char* ) payload.data(), payload.size() ) + "." +
+                           gsseap_base64url_encode( ( const unsigned char* ) mac.data(), mac.size() );
+        }
+    }
+
+    return result;
+}
+
+irods::error gsseap_ticket_verify(
+    const std::string& _encoded,
+    gsseap_ticket_t& _rtn_ticket ) {
+    irods::error result = SUCCESS();
+    irods::error ret;
+
+    ret = gsseap_ticket_load_key();
+    if ( ( result = ASSERT_PASS( ret, "Session tickets are not configured." ) ).ok() ) {
+
+        size_t dot = _encoded.find( '.' );
+        std::string payload;
+        std::string mac;
+        long epoch = 0;
+
+        if ( ( result = ASSERT_ERROR( dot != std::string::npos &&
+                                      gsseap_base64url_decode( _encoded.substr( 0, dot ), payload ) &&
+                                      gsseap_base64url_decode( _encoded.substr( dot + 1 ), mac ) &&
+                                      gsseap_ticket_parse_payload( payload, &epoch, _rtn_ticket ),
+                                      SYS_INVALID_INPUT_PARAM, "Malformed session ticket." ) ).ok() ) {
+
+            time_t now = time( NULL );
+            long current_epoch = now / gsseap_ticket_rotation();
+            if ( ( result = ASSERT_ERROR( epoch == current_epoch || epoch == current_epoch - 1, SYS_INVALID_INPUT_PARAM,
+                                          "Session ticket key epoch %ld has been rotated out.", epoch ) ).ok() ) {
+
+                std::string expected = gsseap_ticket_mac( epoch, payload );
+                if ( ( result = ASSERT_ERROR( expected.size() == mac.size() &&
+                                              CRYPTO_memcmp( expected.data(), mac.data(), mac.size() ) == 0,
+                                              SYS_INVALID_INPUT_PARAM, "Session ticket signature mismatch." ) ).ok() ) {
+                    result = ASSERT_ERROR( _rtn_ticket.expiry > now, SYS_INVALID_INPUT_PARAM, "Session ticket has expired." );
+                    _rtn_ticket.key = gsseap_ticket_key( epoch, mac );
+                }
+            }
+        }
+    }
+
+    return result;
+}
+
+std::string gsseap_ticket_challenge() {
+    unsigned char challenge[gsseap_ticket_challenge_size];
+
+    if ( RAND_bytes( challenge, sizeof( challenge ) ) != 1 ) {
+        return "";
+    }
+    return gsseap_base64url_encode( challenge, sizeof( challenge ) );
+}
+
+std::string gsseap_ticket_proof(
+    const std::string& _key,
+    const std::string& _challenge ) {
+    unsigned char mac[EVP_MAX_MD_SIZE];
+    unsigned int mac_len = 0;
+    std::string message = "irods-gsseap-ticket-proof:" + _challenge;
+
+    HMAC( EVP_sha256(), _key.data(), _key.size(),
+          ( const unsigned char* ) message.data(), message.size(), mac, &mac_len );
+    return std::string( ( const char* ) mac, mac_len );
+}
+
+irods::error gsseap_ticket_check_proof(
+    const gsseap_ticket_t& _ticket,
+    const std::string& _challenge,
+    const std::string& _proof ) {
+    if ( _ticket.key.empty() || _challenge.empty() ) {
+        return ERROR( SYS_INVALID_INPUT_PARAM, "No session ticket challenge outstanding." );
+    }
+
+    std::string expected = gsseap_ticket_proof( _ticket.key, _challenge );
+    return ASSERT_ERROR( expected.size() == _proof.size() &&
+                         CRYPTO_memcmp( expected.data(), _proof.data(), _proof.size() ) == 0,
+                         SYS_INVALID_INPUT_PARAM, "Session ticket proof of possession mismatch." );
+}
+
+/// @brief Client side view of the expiry of a cache entry, "<ticket> <key>", the client cannot check the signature
+static time_t gsseap_ticket_peek_expiry(
+    const std::string& _entry ) {
+    gsseap_ticket_t ticket;
+    std::string payload;
+    long epoch;
+    std::string encoded = _entry.substr( 0, _entry.find( ' ' ) );
+    size_t dot = encoded.find( '.' );
+
+    if ( dot == std::string::npos ||
+            !gsseap_base64url_decode( encoded.substr( 0, dot ), payload ) ||
+            !gsseap_ticket_parse_payload( payload, &epoch, ticket ) ) {
+        return 0;
+    }
+    return ticket.expiry;
+}
+
+/// @brief Load the optional on-disk ticket cache so short-lived client processes can share tickets
+static void gsseap_ticket_cache_load( std::map<std::string, std::string>& _cache ) {
+    const char* path = gsseap_env_string( "GSSEAP_TICKET_CACHE" );
+    if ( path == NULL ) {
+        return;
+    }
+
+    FILE* fp = fopen( path, "r" );
+    if ( fp == NULL ) {
+        return;
+    }
+
+    char line[4096];
+    while ( fgets( line, sizeof( line ), fp ) != NULL ) {
+        char* sep = strchr( line, ' ' );
+        char* nl = strchr( line, '\n' );
+        if ( sep == NULL || nl == NULL ) {
+            continue;
+        }
+        *sep = '\0';
+        *nl = '\0';
+        _cache[line] = sep + 1;
+    }
+    fclose( fp );
+}
+
+static void gsseap_ticket_cache_save( const std::map<std::string, std::string>& _cache ) {
+    const char* path = gsseap_env_string( "GSSEAP_TICKET_CACHE" );
+    if ( path == NULL ) {
+        return;
+    }
+
+    std::string tmp_path = std::string( path ) + ".tmp";
+    int fd = open( tmp_path.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0600 );
+    if ( fd < 0 ) {
+        rodsLog( LOG_DEBUG, "gsseap_ticket_cache_save: cannot write %s, error = %s", tmp_path.c_str(), strerror( errno ) );
+        return;
+    }
+
+    FILE* fp = fdopen( fd, "w" );
+    if ( fp == NULL ) {
+        close( fd );
+        return;
+    }
+
+    time_t now = time( NULL );
+    std::map<std::string, std::string>::const_iterator itr;
+    for ( itr = _cache.begin(); itr != _cache.end(); ++itr ) {
+        if ( gsseap_ticket_peek_expiry( itr->second ) > now ) {
+            fprintf( fp, "%s %s\n", itr->first.c_str(), itr->second.c_str() );
+        }
+    }
+    if ( fclose( fp ) == 0 ) {
+        rename( tmp_path.c_str(), path );
+    }
+    else {
+        unlink( tmp_path.c_str() );
+    }
+}
+
+bool gsseap_ticket_cache_get(
+    const std::string& _key,
+    std::string& _rtn_encoded,
+    std::string& _rtn_ticket_key ) {
+    bool found = false;
+
+    pthread_mutex_lock( &gsseap_ticket_cache_mutex );
+
+    std::map<std::string, std::string>::iterator itr = gsseap_ticket_cache.find( _key );
+    if ( itr == gsseap_ticket_cache.end() ) {
+        gsseap_ticket_cache_load( gsseap_ticket_cache );
+        itr = gsseap_ticket_cache.find( _key );
+    }
+    if ( itr != gsseap_ticket_cache.end() ) {
+        size_t sep = itr->second.find( ' ' );
+        if ( sep != std::string::npos &&
+                gsseap_ticket_peek_expiry( itr->second ) > time( NULL ) + gsseap_ticket_expiry_margin &&
+                gsseap_base64url_decode( itr->second.substr( sep + 1 ), _rtn_ticket_key ) ) {
+            _rtn_encoded = itr->second.substr( 0, sep );
+            found = true;
+        }
+        else {
+            gsseap_ticket_cache.erase( itr );
+        }
+    }
+
+    pthread_mutex_unlock( &gsseap_ticket_cache_mutex );
+
+    return found;
+}
+
+void gsseap_ticket_cache_put(
+    const std::string& _key,
+    const std::string& _encoded,
+    const std::string& _ticket_key ) {
+    pthread_mutex_lock( &gsseap_ticket_cache_mutex );
+
+    gsseap_ticket_cache_load( gsseap_ticket_cache );
+    gsseap_ticket_cache[_key] = _encoded + " " +
+                                gsseap_base64url_encode( ( const unsigned char* ) _ticket_key.data(), _ticket_key.size() );
+    gsseap_ticket_cache_save( gsseap_ticket_cache );
+
+    pthread_mutex_unlock( &gsseap_ticket_cache_mutex );
+}
+
+void gsseap_ticket_cache_remove(
+    const std::string& _key ) {
+    pthread_mutex_lock( &gsseap_ticket_cache_mutex );
+
+    gsseap_ticket_cache_load( gsseap_ticket_cache );
+    gsseap_ticket_cache.erase( _key );
+    gsseap_ticket_cache_save( gsseap_ticket_cache );
+
+    pthread_mutex_unlock( &gsseap_ticket_cache_mutex );
+}
+
+void gsseap_ticket_fork_lock() {
+    pthread_mutex_lock( &gsseap_ticket_key_mutex );
+    pthread_mutex_lock( &gsseap_ticket_cache_mutex );
+}
+
+void gsseap_ticket_fork_unlock() {
+    pthread_mutex_unlock( &gsseap_ticket_cache_mutex );
+    pthread_mutex_unlock( &gsseap_ticket_key_mutex );
+}
@@ -0,0 +1,78 @@
+/* -*- mode: c++; fill-column: 132; c-basic-offset: 4; indent-tabs-mode: nil -*- */
+/* gsseapTicket.hpp
+ * Short-lived session tickets which let a client that recently completed a full
+ * GSS-EAP login skip the EAP exchange on its next connection.  A ticket is not a
+ * bearer token: it comes with a key, sent wrapped under the GSS-EAP context that
+ * issued it, and the client proves it holds that key over a fresh challenge each
+ * time it presents the ticket.
+ */
+
+#ifndef GSSEAP_TICKET_HPP
+#define GSSEAP_TICKET_HPP
+
+#include "irods_error.hpp"
+
+#include <string>
+
+#include <time.h>
+
+/// @brief The identity a ticket vouches for
+typedef struct {
+    std::string user_name;    // iRODS user the ticket was issued to
+    std::string zone_name;    // zone of that user
+    std::string user_type;    // user type at issue time, determines the privilege level
+    std::string client_name;  // authenticated GSS-EAP name of the client
+    time_t expiry;            // absolute expiry time
+    std::string key;          // proof of possession key, only the server and the holder of the ticket know it
+} gsseap_ticket_t;
+
+/// @brief Whether this server has a ticket key configured (GSSEAP_TICKET_KEY_FILE)
+bool gsseap_ticket_enabled();
+
+/// @brief Issue a signed ticket for an identity, the expiry and the key are filled in, the lifetime is GSSEAP_TICKET_LIFETIME
+irods::error gsseap_ticket_issue(
+    gsseap_ticket_t& _ticket,
+    std::string& _rtn_encoded );
+
+/// @brief Check the signature and lifetime of a presented ticket and unpack it, including its key
+irods::error gsseap_ticket_verify(
+    const std::string& _encoded,
+    gsseap_ticket_t& _rtn_ticket );
+
+/// @brief Server side: a fresh random challenge for the holder of a presented ticket
+std::string gsseap_ticket_challenge();
+
+/// @brief Client side: prove possession of a ticket key over the server's challenge
+std::string gsseap_ticket_proof(
+    const std::string& _key,
+    const std::string& _challenge );
+
+/// @brief Server side: check the proof of possession of a verified ticket
+irods::error gsseap_ticket_check_proof(
+    const gsseap_ticket_t& _ticket,
+    const std::string& _challenge,
+    const std::string& _proof );
+
+/// @brief Client side: look up a cached, unexpired ticket and its key for a server and user
+bool gsseap_ticket_cache_get(
+    const std::string& _key,
+    std::string& _rtn_encoded,
+    std::string& _rtn_ticket_key );
+
+/// @brief Client side: remember a ticket and its key for a server and user
+void gsseap_ticket_cache_put(
+    const std::string& _key,
+    const std::string& _encoded,
+    const std::string& _ticket_key );
+
+/// @brief Client side: forget a ticket, e.g. after the server refused it
+void gsseap_ticket_cache_remove(
+    const std::string& _key );
+
+/// @brief Hold the ticket key and the ticket cache across fork
+void gsseap_ticket_fork_lock();
+
+/// @brief Release the ticket key and the ticket cache after fork, in the parent and in the child
+void gsseap_ticket_fork_unlock();
+
+#endif  /* GSSEAP_TICKET_HPP */
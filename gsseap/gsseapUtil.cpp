@@ -0,0 +1,111 @@
+/* -*- mode: c++; fill-column: 132; c-basic-offset: 4; indent-tabs-mode: nil -*- */
+
+#include "gsseapUtil.hpp"
+
+#include <stdlib.h>
+
+static const char gsseap_b64url_alphabet[] =
+    "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789-_";
+
+std::string gsseap_base64url_encode(
+    const unsigned char* _buf,
+    size_t _len ) {
+    std::string out;
+    size_t i;
+
+    out.reserve( ( _len * 4 + 2 ) / 3 );
+    for ( i = 0; i + 2 < _len; i += 3 ) {
+        unsigned long v = ( _buf[i] << 16 ) | ( _buf[i + 1] << 8 ) | _buf[i + 2];
+        out += gsseap_b64url_alphabet[( v >> 18 ) & 0x3f];
+        out += gsseap_b64url_alphabet[( v >> 12 ) & 0x3f];
+        out += gsseap_b64url_alphabet[( v >> 6 ) & 0x3f];
+        out += gsseap_b64url_alphabet[v & 0x3f];
+    }
+    if ( _len - i == 1 ) {
+        unsigned long v = _buf[i] << 16;
+        out += gsseap_b64url_alphabet[( v >> 18 ) & 0x3f];
+        out += gsseap_b64url_alphabet[( v >> 12 ) & 0x3f];
+    }
+    else if ( _len - i == 2 ) {
+        unsigned long v = ( _buf[i] << 16 ) | ( _buf[i + 1] << 8 );
+        out += gsseap_b64url_alphabet[( v >> 18 ) & 0x3f];
+        out += gsseap_b64url_alphabet[( v >> 12 ) & 0x3f];
+        out += gsseap_b64url_alphabet[( v >> 6 ) & 0x3f];
+    }
+    return out;
+}
+
+static int gsseap_b64url_value( char c ) {
+    if ( c >= 'A' && c <= 'Z' ) {
+        return c - 'A';
+    }
+    if ( c >= 'a' && c <= 'z' ) {
+        return c - 'a' + 26;
+    }
+    if ( c >= '0' && c <= '9' ) {
+        return c - '0' + 52;
+    }
+    if ( c == '-' ) {
+        return 62;
+    }
+    if ( c == '_' ) {
+        return 63;
+    }
+    return -1;
+}
+
+bool gsseap_base64url_decode(
+    const std::string& _in,
+    std::string& _out ) {
+    unsigned long v = 0;
+    int bits = 0;
+    size_t i;
+
+    // a single trailing character can never encode a whole byte
+    if ( _in.size() % 4 == 1 ) {
+        return false;
+    }
+
+    _out.clear();
+    _out.reserve( _in.size() * 3 / 4 );
+    for ( i = 0; i < _in.size(); i++ ) {
+        int c = gsseap_b64url_value( _in[i] );
+        if ( c < 0 ) {
+            return false;
+        }
+        v = ( v << 6 ) | c;
+        bits += 6;
+        if ( bits >= 8 ) {
+            bits -= 8;
+            _out += ( char )( ( v >> bits ) & 0xff );
+        }
+    }
+    return true;
+}
+
+long gsseap_env_long(
+    const char* _name,
+    long _default ) {
+    const char* value = getenv( _name );
+    char* end = NULL;
+    long result;
+
+    if ( value == NULL || *value == '\0' ) {
+        return _default;
+    }
+    result = strtol( value, &end, 10 );
+    if ( end == NULL || *end != '\0' ) {
+        return _default;
+    }
+    return result;
+}
+
+const char* gsseap_env_string(
+    const char* _name ) {
+    const char* value = getenv( _name );
+
+    if ( value == NULL || *value == '\0' ) {
+        return NULL;
+    }
+    return value;
+}
@@ -0,0 +1,32 @@
+/* -*- mode: c++; fill-column: 132; c-basic-offset: 4; indent-tabs-mode: nil -*- */
+/* gsseapUtil.hpp
+ * Small helpers shared by the GSS-EAP auth plugin sources.
+ */
+
+#ifndef GSSEAP_UTIL_HPP
+#define GSSEAP_UTIL_HPP
+
+#include <string>
+
+#include <stddef.h>
+
+/// @brief Encode a buffer as unpadded base64url, which is safe to embed in a kvp string
+std::string gsseap_base64url_encode(
+    const unsigned char* _buf,
+    size_t _len );
+
+/// @brief Decode an unpadded base64url string, returns false on malformed input
+bool gsseap_base64url_decode(
+    const std::string& _in,
+    std::string& _out );
+
+/// @brief Read an integer setting from the environment, _default if unset or malformed
+long gsseap_env_long(
+    const char* _name,
+    long _default );
+
+/// @brief Read a string setting from the environment, NULL if unset or empty
+const char* gsseap_env_string(
+    const char* _name );
+
+#endif  /* GSSEAP_UTIL_HPP */
@@ -0,0 +1,78 @@
+/* -*- mode: c++; fill-column: 132; c-basic-offset: 4; indent-tabs-mode: nil -*- */
+
+#include "rodsErrorTable.hpp"
+#include "rodsLog.hpp"
+#include "miscServerFunct.hpp"
+
+#include "gsseapZone.hpp"
+
+#include <map>
+#include <string>
+
+#include <stdio.h>
+#include <string.h>
+
+static gsseap_zone_t gsseap_zone;
+static bool gsseap_zone_loaded = false;
+
+// remote zone SIDs, padded for the hash input; an empty string records a zone without one
+static std::map<std::string, std::string> gsseap_zone_sids;
+
+static const int gsseap_zone_priv_levels = LOCAL_PRIV_USER_AUTH + 1;
+
+// indexed by gsseap_zone_view_t, then by level (NO_USER_AUTH, REMOTE_USER_AUTH, LOCAL_USER_AUTH, REMOTE_PRIV_USER_AUTH, 4,
+// LOCAL_PRIV_USER_AUTH); 4 is not a level and stays as it is
+static const int gsseap_zone_priv_table[][gsseap_zone_priv_levels] = {
+    // GSSEAP_ZONE_REMOTE_ICAT: a local user of the other zone is a remote user here
+    { NO_USER_AUTH, REMOTE_USER_AUTH, REMOTE_USER_AUTH, REMOTE_PRIV_USER_AUTH, 4, REMOTE_PRIV_USER_AUTH },
+    // GSSEAP_ZONE_LOCAL_CLIENT: a remote user of the other zone is one of ours
+    { NO_USER_AUTH, LOCAL_USER_AUTH, LOCAL_USER_AUTH, LOCAL_PRIV_USER_AUTH, 4, LOCAL_PRIV_USER_AUTH },
+    // GSSEAP_ZONE_REMOTE_CLIENT: never privileged here
+    { NO_USER_AUTH, REMOTE_USER_AUTH, REMOTE_USER_AUTH, REMOTE_PRIV_USER_AUTH, 4, REMOTE_USER_AUTH }
+};
+
+const gsseap_zone_t* gsseap_zone_snapshot(
+    int* _rtn_status ) {
+    if ( !gsseap_zone_loaded ) {
+        zoneInfo_t* zone_info;
+        int status = getLocalZoneInfo( &zone_info );
+        if ( status < 0 ) {
+            if ( _rtn_status != NULL ) {
+                *_rtn_status = status;
+            }
+            return NULL;
+        }
+        memset( &gsseap_zone, 0, sizeof( gsseap_zone ) );
+        strncpy( gsseap_zone.zone_name, zone_info->zoneName, NAME_LEN - 1 );
+        gsseap_zone_loaded = true;
+    }
+    return &gsseap_zone;
+}
+
+const char* gsseap_zone_sid(
+    const char* _zone_name ) {
+    std::map<std::string, std::string>::iterator it = gsseap_zone_sids.find( _zone_name );
+
+    if ( it == gsseap_zone_sids.end() ) {
+        char zone_name[NAME_LEN];
+        char sid[MAX_PASSWORD_LEN + 2];
+        snprintf( zone_name, sizeof( zone_name ), "%s", _zone_name );
+        memset( sid, 0, sizeof( sid ) );
+        getZoneServerId( zone_name, sid );
+        std::string padded;
+        if ( sid[0] != '\0' ) {
+            padded.assign( sid, MAX_PASSWORD_LEN );
+        }
+        it = gsseap_zone_sids.insert( std::make_pair( std::string( _zone_name ), padded ) ).first;
+    }
+    return it->second.empty() ? NULL : it->second.data();
+}
+
+int gsseap_zone_priv(
+    gsseap_zone_view_t _view,
+    int _priv_level ) {
+    if ( _priv_level < 0 || _priv_level >= gsseap_zone_priv_levels ) {
+        return _priv_level;
+    }
+    return gsseap_zone_priv_table[_view][_priv_level];
+}
@@ -0,0 +1,39 @@
+/* -*- mode: c++; fill-column: 132; c-basic-offset: 4; indent-tabs-mode: nil -*- */
+/* gsseapZone.hpp
+ * Server side: the zone configuration the auth response needs, read once per
+ * agent.  The snapshot holds the local zone name and the SID of every remote
+ * zone asked about, already laid out as the tail of the server response hash
+ * input, and the privilege level rewriting for federated logins is a table.
+ */
+
+#ifndef GSSEAP_ZONE_HPP
+#define GSSEAP_ZONE_HPP
+
+#include "rodsUser.hpp"
+
+/// @brief How a privilege level is seen across zones, indexes the translation table
+enum gsseap_zone_view_t {
+    GSSEAP_ZONE_REMOTE_ICAT,     // the proxy of a login checked by the catalog of another zone
+    GSSEAP_ZONE_LOCAL_CLIENT,    // a client of the local zone, as the other zone's catalog rated it
+    GSSEAP_ZONE_REMOTE_CLIENT    // a client of a remote zone, likewise
+};
+
+/// @brief The zone configuration of this agent, immutable once loaded
+typedef struct {
+    char zone_name[NAME_LEN];    // the local zone
+} gsseap_zone_t;
+
+/// @brief The zone snapshot, loaded on first use; NULL if the local zone is unknown, with the error in *_rtn_status
+const gsseap_zone_t* gsseap_zone_snapshot(
+    int* _rtn_status );
+
+/// @brief The SID of _zone_name padded with zeros to MAX_PASSWORD_LEN bytes, NULL if server.config defines none
+const char* gsseap_zone_sid(
+    const char* _zone_name );
+
+/// @brief _priv_level as seen from _view, levels the table does not know are returned as they are
+int gsseap_zone_priv(
+    gsseap_zone_view_t _view,
+    int _priv_level );
+
+#endif  /* GSSEAP_ZONE_HPP */
@@ -13,6 +13,22 @@
 #include "authResponse.hpp"
 #include "authCheck.hpp"
 #include "gsseapAuthRequest.hpp"
+#include "gsseapAdmission.hpp"
+#include "gsseapAudit.hpp"
+#include "gsseapExport.hpp"
+#include "gsseapFailure.hpp"
+#include "gsseapGateway.hpp"
+#include "gsseapMech.hpp"
+#include "gsseapPrepare.hpp"
+#include "gsseapProbe.hpp"
+#include "gsseapNameRules.hpp"
+#include "gsseapPool.hpp"
+#include "gsseapSession.hpp"
+#include "gsseapShm.hpp"
+#include "gsseapStats.hpp"
+#include "gsseapTicket.hpp"
+#include "gsseapUtil.hpp"
+#include "gsseapZone.hpp"
 #include "irods_kvp_string_parser.hpp"
 #include "authPluginRequest.hpp"
 #include "irods_client_server_negotiation.hpp"
@@ -24,9 +40,18 @@
 #include <gssapi_eap.h>
 #include <gssapi_ext.h>
 
+#include <list>
+#include <map>
 #include <string>
+#include <vector>
 
+#include <ctype.h>
+#include <errno.h>
+#include <poll.h>
+#include <pthread.h>
 #include <string.h>
+#include <sys/time.h>
+#include <time.h>
 
 
 extern "C" {
@@ -35,15 +60,11 @@ extern "C" {
     // 1. Define plugin Version Variable, used in plugin
     //    creation when the factory function is called.
     //    -- currently only 1.0 is supported.
-    double IRODS_PLUGIN_INTERFACE_VERSION = 1.0;
+    GSSEAP_EXPORT double IRODS_PLUGIN_INTERFACE_VERSION = 1.0;
 
     // Define some useful globals
     static const int igsseapDebugFlag = 0;
     static const int gss_nt_service_name_gsseap = 0;
-    static const unsigned int SCRATCH_BUFFER_SIZE = 20000;
-    static char igsseapScratchBuffer[SCRATCH_BUFFER_SIZE];
-    static int igsseapTokenHeaderMode = 1;  /* 1 is the normal mode,
-                                               0 means running in a non-token-header mode, ie Java; dynamically cleared. */
 
     // =-=-=-=-=-=-=-
     // NOTE:: this needs to become a property
@@ -52,25 +73,42 @@ extern "C" {
     // is not set)
     static const int requireServerAuth = 0;
 
-    static int gsseapAuthReqStatus = 0;
-    static int gsseapAuthReqError = 0;
-    static const int gsseapAuthErrorSize = 1000;
-    static char gsseapAuthReqErrorMsg[gsseapAuthErrorSize];
-    static rError_t *igsseap_rErrorPtr;
-
-    static const int MAX_FDS = 32;
-    static gss_ctx_id_t context[MAX_FDS] = {
-        GSS_C_NO_CONTEXT, GSS_C_NO_CONTEXT, GSS_C_NO_CONTEXT, GSS_C_NO_CONTEXT,
-        GSS_C_NO_CONTEXT, GSS_C_NO_CONTEXT, GSS_C_NO_CONTEXT, GSS_C_NO_CONTEXT,
-        GSS_C_NO_CONTEXT, GSS_C_NO_CONTEXT, GSS_C_NO_CONTEXT, GSS_C_NO_CONTEXT,
-        GSS_C_NO_CONTEXT, GSS_C_NO_CONTEXT, GSS_C_NO_CONTEXT, GSS_C_NO_CONTEXT,
-        GSS_C_NO_CONTEXT, GSS_C_NO_CONTEXT, GSS_C_NO_CONTEXT, GSS_C_NO_CONTEXT,
-        GSS_C_NO_CONTEXT, GSS_C_NO_CONTEXT, GSS_C_NO_CONTEXT, GSS_C_NO_CONTEXT,
-        GSS_C_NO_CONTEXT, GSS_C_NO_CONTEXT, GSS_C_NO_CONTEXT, GSS_C_NO_CONTEXT,
-        GSS_C_NO_CONTEXT, GSS_C_NO_CONTEXT, GSS_C_NO_CONTEXT, GSS_C_NO_CONTEXT
-    };
+    // =-=-=-=-=-=-=-
+    // Session ticket negotiation keys, carried in the auth plugin request context and result
+    static const char* const GSSEAP_TICKET_KEY = "gsseap_ticket";                  // client: a cached ticket
+    static const char* const GSSEAP_TICKET_REQUEST_KEY = "gsseap_ticket_request";  // client: issue me a ticket
+    static const char* const GSSEAP_TICKET_CHALLENGE_KEY = "gsseap_ticket_challenge";  // server: prove the ticket key, no handshake
+    static const char* const GSSEAP_TICKET_ISSUE_KEY = "gsseap_ticket_issue";      // server: a ticket follows the handshake
+
+    // Short handshake keys: the first context token rides on the auth plugin request, the reply to it on the result
+    static const char* const GSSEAP_TOKEN_KEY = "gsseap_token";                    // client: the first token, base64url
+    static const char* const GSSEAP_REPLY_KEY = "gsseap_reply";                    // server: the reply to it, base64url
+    static const char* const GSSEAP_REPLY_FOLLOWS_KEY = "gsseap_reply_follows";    // server: the reply was too long, it follows on the socket
+
+    // Gateway keys: a trusted gateway logging an end user in over its own connection
+    static const char* const GSSEAP_GATEWAY_KEY = "gsseap_gateway";                // client: the tokens that follow are an end user's
+    static const char* const GSSEAP_GATEWAY_USER_KEY = "gsseap_gateway_user";      // client: the iRODS user the end user asks for
+    static const char* const GSSEAP_GATEWAY_ZONE_KEY = "gsseap_gateway_zone";      // client: and its zone
+    static const char* const GSSEAP_GATEWAY_STATUS_KEY = "gsseap_gateway_status";  // client: how did it end; server: user#zone
+
+#if defined(RODS_SERVER)
+    /// @brief An iRODS identity asserted for the client by its GSS-EAP name, used instead of a DN lookup
+    typedef struct {
+        char user_name[NAME_LEN];
+        char zone_name[NAME_LEN];   // empty for the zone the client asked for, or the local zone
+        int admin_allowed;          // 0 if the client may not use rodsadmin privileges even if the catalog grants them
+        const char* source;         // what produced the mapping, for logging
+    } gsseap_mapped_identity_t;
+
+    // Cache of mapped users already found in the catalog, shared by all agents.  The catalog check of every auth response
+    // drops an entry it disagrees with, so a demoted or removed user is looked up again on the next login.
+    static gsseap_shm_table_t* gsseapBindingCache = NULL;
+    static pthread_once_t gsseapBindingCacheOnce = PTHREAD_ONCE_INIT;
+    static const unsigned int gsseapBindingCacheEntries = 1024;
+    static const long gsseapBindingCacheDefaultTTL = 60;
+    static const long gsseapBindingCacheMaxTTL = 600;
+#endif
 
-    static unsigned int context_flags;
 
     void parse_oid(const char *mechanism, gss_OID * oid) {
     	char   *mechstr = 0;
@@ -90,6 +128,16 @@ extern "C" {
     	if(mechstr);
     }
 
+#if defined(IGSSEAP_TIMING)
+    static int _igsseapTime(
+        struct timeval* _diff,
+        struct timeval* _end,
+        struct timeval* _start ) {
+        timersub( _end, _start, _diff );
+        return 0;
+    }
+#endif
+
     void gsseap_print_token(gss_buffer_t tok ) {
         unsigned int i, j;
         unsigned char *p = ( unsigned char * )tok->value;
@@ -116,6 +164,7 @@ extern "C" {
         fflush( stderr );
     }
 
+#if defined(RODS_SERVER)
     static irods::error check_proxy_user_privileges(
         rsComm_t *rsComm,
         int proxyUserPriv ) {
@@ -135,6 +184,7 @@ extern "C" {
 
         return result;
     }
+#endif
 
 
     void gsseap_log_error_1(
@@ -187,38 +237,35 @@ extern "C" {
         return result;
     }
 
+    // agent: the acceptor credential, acquired by the first login and shared by the rest, see gsseap_setup_creds
+    static pthread_mutex_t gsseapAcceptorMutex = PTHREAD_MUTEX_INITIALIZER;
+    static gss_cred_id_t gsseapAcceptorCred = GSS_C_NO_CREDENTIAL;
+
+    /// @brief Server side: give _go the acceptor credential of this agent; every auth object iRODS creates would
+    /// otherwise acquire one of its own and never release it
     irods::error gsseap_setup_creds( irods::gsseap_auth_object_ptr _go  ) {
         irods::error result = SUCCESS();
-        OM_uint32 major_status;
+        OM_uint32 major_status = GSS_S_COMPLETE;
         OM_uint32 minor_status;
-        gss_name_t my_name = GSS_C_NO_NAME;
         gss_cred_id_t tmp_creds = GSS_C_NO_CREDENTIAL;
-        gss_OID moid;
-	gss_OID_set_desc mechlist;
-        gss_OID_set mechs = GSS_C_NO_OID_SET;
-        std::string mech = "{ 1 3 6 1 5 5 15 1 1 18 }";
-
-	parse_oid(mech.c_str(), &moid);
-	if (moid != GSS_C_NO_OID) {
-       	    mechlist.count = 1;
-            mechlist.elements = moid;
-            mechs = &mechlist;
-	}
 
-        if ( _go->creds() == GSS_C_NO_CREDENTIAL ) {
-            major_status = gss_acquire_cred( &minor_status, my_name, 0, mechs, GSS_C_ACCEPT, &tmp_creds, NULL, NULL );
-        }
-        else {
-            major_status = GSS_S_COMPLETE;
+        pthread_mutex_lock( &gsseapAcceptorMutex );
+        /* accept every configured mechanism, the client picks the one it can complete fastest */
+        if ( gsseapAcceptorCred == GSS_C_NO_CREDENTIAL ) {
+            major_status = gsseap_mech_acquire_cred( &minor_status, gsseap_mechs(), GSS_C_ACCEPT, &tmp_creds );
+            if ( major_status == GSS_S_COMPLETE ) {
+                gsseapAcceptorCred = tmp_creds;
+            }
         }
+        tmp_creds = gsseapAcceptorCred;
+        pthread_mutex_unlock( &gsseapAcceptorMutex );
 
         if ( major_status != GSS_S_COMPLETE ) {
             gsseap_log_error( _go->r_error(), "acquiring credentials", major_status, minor_status, false );
             return ERROR( GSSEAP_ERROR_ACQUIRING_CREDS, "Failed acquiring credentials." );
         }
 
-	_go->creds( tmp_creds );
-        gss_release_name( &minor_status, &my_name );
+        _go->creds( tmp_creds );
       
         return result;
     }
@@ -240,10 +287,9 @@ extern "C" {
 
         *_target_name = GSS_C_NO_NAME;
         if ( _service_name != NULL && strlen( _service_name ) > 0 ) {
-            size_t size = strlen( _service_name ) + 1;
-            name_buffer.value = malloc( size );
-            memcpy( name_buffer.value, _service_name, size );
-            name_buffer.length = size;
+            /* gss_import_name copies the name, so the caller's string can be passed as is */
+            name_buffer.value = ( void* ) _service_name;
+            name_buffer.length = strlen( _service_name ) + 1;
 
             OM_uint32 minor_status;
             OM_uint32 major_status = gss_import_name( &minor_status, &name_buffer, ( gss_OID ) gss_nt_service_name_gsseap, _target_name );
@@ -298,15 +344,16 @@ extern "C" {
        descriptor.  It returns 0 on success, and -1 if an error occurs or if it could not write all the data.
     */
     irods::error gsseap_send_token(
-        gss_buffer_desc* _send_tok,
-        int _fd ) {
+        gsseap_session_t* _session,
+        gss_buffer_desc* _send_tok ) {
         irods::error result = SUCCESS();
         irods::error ret;
         int len;
         char *cp;
         unsigned int bytes_written;
 
-        if ( igsseapTokenHeaderMode ) {
+        GSSEAP_PROBE( send_token_entry, _session->fd, _send_tok->length, 0 );
+        if ( _session->token_header_mode ) {
             len = htonl( _send_tok->length );
 
             cp = ( char * ) &len;
@@ -319,11 +366,11 @@ extern "C" {
                 }
             }
             if ( result.ok() ) {
-                ret = gsseap_write_all( _fd, cp, 4, &bytes_written );
+                ret = gsseap_write_all( _session->fd, cp, 4, &bytes_written );
                 if ( ( result = ASSERT_PASS( ret, "Error sending GSSEAP token length." ) ).ok() ) {
                     if ( !( result = ASSERT_ERROR( bytes_written == 4, GSSEAP_ERROR_SENDING_TOKEN_LENGTH, "Error sending token data: %u of %u bytes written.",
                                                    bytes_written, _send_tok->length ) ).ok() ) {
-                       rodsLogAndErrorMsg( LOG_ERROR, igsseap_rErrorPtr, result.code(), "sending token data: %d of %d bytes written",
+                       rodsLogAndErrorMsg( LOG_ERROR, _session->r_error, result.code(), "sending token data: %d of %d bytes written",
                           bytes_written, _send_tok->length );
                     }
                 }
@@ -331,17 +378,23 @@ extern "C" {
         }
 
         if ( result.ok() ) {
-            ret = gsseap_write_all( _fd, ( char * )_send_tok->value, _send_tok->length, &bytes_written );
+            ret = gsseap_write_all( _session->fd, ( char * )_send_tok->value, _send_tok->length, &bytes_written );
             if ( ( result = ASSERT_PASS( ret, "Error sending token data2." ) ).ok() ) {
 
                 if ( !( result = ASSERT_ERROR( bytes_written == _send_tok->length, GSSEAP_ERROR_SENDING_TOKEN_LENGTH,
                                                "Sending token data2: %u of %u bytes written.", bytes_written, _send_tok->length ) ).ok() ) {
-                    rodsLogAndErrorMsg( LOG_ERROR, igsseap_rErrorPtr, result.code(), "sending token data2: %u of %u bytes written",
+                    rodsLogAndErrorMsg( LOG_ERROR, _session->r_error, result.code(), "sending token data2: %u of %u bytes written",
                                         bytes_written, _send_tok->length );
                 }
             }
         }
 
+        if ( result.ok() && _session->handshake.active ) {
+            _session->handshake.tokens_sent++;
+            _session->handshake.bytes_sent += _send_tok->length + ( _session->token_header_mode ? 4 : 0 );
+        }
+        GSSEAP_PROBE( send_token_return, _session->fd, _send_tok->length, result.code() );
+
         return result;
     }
 
@@ -370,7 +423,7 @@ extern "C" {
 
     /// @brief Read the GSSEAP token header
     irods::error gsseap_rcv_token_header(
-        int _fd,
+        gsseap_session_t* _session,
         unsigned int* _rtn_length ) {
         irods::error result = SUCCESS();
         irods::error ret;
@@ -384,12 +437,12 @@ extern "C" {
         if ( sizeof( length ) > 4 ) {
             cp += sizeof( length ) - 4;
         }
-        ret = gsseap_read_all( _fd, cp, 4, &bytes_read );
+        ret = gsseap_read_all( _session->fd, cp, 4, &bytes_read );
         if ( ( result = ASSERT_PASS( ret, "Failed reading GSSEAP token header." ) ).ok() ) {
             if ( !( result = ASSERT_ERROR( bytes_read == 4 || bytes_read == 0, GSSEAP_ERROR_READING_TOKEN_LENGTH,
                                            "Error reading GSSEAP token, length %u of %u bytes read.", bytes_read, 4 ) ).ok() ) {
                 status = GSSEAP_ERROR_READING_TOKEN_LENGTH;
-                rodsLogAndErrorMsg( LOG_ERROR, igsseap_rErrorPtr, status, "reading token length: %d of %d bytes read", bytes_read, 4 );
+                rodsLogAndErrorMsg( LOG_ERROR, _session->r_error, status, "reading token length: %d of %d bytes read", bytes_read, 4 );
             }
             else {
                 length = ntohl( length );
@@ -407,7 +460,7 @@ extern "C" {
 
     /// @brief Read a GSSEAP token body
     irods::error gsseap_rcv_token_body(
-        int _fd,
+        gsseap_session_t* _session,
         gss_buffer_t _token,
         unsigned int _length,
         unsigned int* _rtn_bytes_read ) {
@@ -420,7 +473,7 @@ extern "C" {
                                        "Error GSSEAP token is too large for buffer, %u bytes in token, buffer is %d bytes.",
                                        _length, _token->length ) ).ok() ) {
             status = GSSEAP_ERROR_TOKEN_TOO_LARGE;
-            rodsLogAndErrorMsg( LOG_ERROR, igsseap_rErrorPtr, status,
+            rodsLogAndErrorMsg( LOG_ERROR, _session->r_error, status,
                                 "_igsseapRcvTokenBody error, token is too large for buffer, %d bytes in token, buffer is %d bytes",
                                 _length, _token->length );
         }
@@ -429,12 +482,12 @@ extern "C" {
 
                 _token->length = _length;
 
-                ret = gsseap_read_all( _fd, ( char * ) _token->value, _token->length, &bytes_read );
+                ret = gsseap_read_all( _session->fd, ( char * ) _token->value, _token->length, &bytes_read );
                 if ( ( result = ASSERT_PASS( ret, "Error reading GSSEAP token body." ) ).ok() ) {
                     if ( !( result = ASSERT_ERROR( bytes_read == _token->length, GSSEAP_PARTIAL_TOKEN_READ, "Error reading token data, %u of %d bytes read.",
                                                    bytes_read, _token->length ) ).ok() ) {
                         status = GSSEAP_PARTIAL_TOKEN_READ;
-                        rodsLogAndErrorMsg( LOG_ERROR, igsseap_rErrorPtr, status,
+                        rodsLogAndErrorMsg( LOG_ERROR, _session->r_error, status,
                                             "reading token data: %d of %d bytes read\n",
                                             bytes_read, _token->length );
                     }
@@ -450,7 +503,7 @@ extern "C" {
 
     ///@brief Receive a GSSEAP token
     irods::error gsseap_receive_token(
-        int _fd,
+        gsseap_session_t* _session,
         gss_buffer_t _token,
         unsigned int* _rtn_bytes_read ) {
         irods::error result = SUCCESS();
@@ -459,8 +512,14 @@ extern "C" {
         int tmpLength;
         char* cp;
         int i;
+        struct timeval waitStart;
+
+        if ( _session->handshake.active ) {
+            gettimeofday( &waitStart, NULL );
+        }
+        GSSEAP_PROBE( receive_token_entry, _session->fd, _token->length, 0 );
 
-        if ( igsseapTokenHeaderMode ) {
+        if ( _session->token_header_mode ) {
 
             /*
               First, if in normal mode, peek to see if the other side is sending
@@ -471,30 +530,30 @@ extern "C" {
             if ( sizeof( tmpLength ) > 4 ) {
                 cp += sizeof( tmpLength ) - 4;
             }
-            i = recv( _fd, cp, 4, MSG_PEEK );
+            i = recv( _session->fd, cp, 4, MSG_PEEK );
             tmpLength = ntohl( tmpLength );
             if ( igsseapDebugFlag > 0 ) {
                 fprintf( stderr, "peek length = %d\n", tmpLength );
             }
-            if ( tmpLength > 100000 ) {
-                igsseapTokenHeaderMode = 0;
+            if ( tmpLength > 100000 && ( unsigned int ) tmpLength > _session->scratch_size ) {
+                _session->token_header_mode = 0;
                 if ( igsseapDebugFlag > 0 ) {
                     fprintf( stderr, "switching to non-hdr mode\n" );
                 }
             }
         }
 
-        if ( igsseapTokenHeaderMode ) {
+        if ( _session->token_header_mode ) {
             unsigned int length;
-            ret = gsseap_rcv_token_header( _fd, &length );
+            ret = gsseap_rcv_token_header( _session, &length );
             if ( ( result = ASSERT_PASS( ret, "Failed reading GSSEAP header." ) ).ok() ) {
-                ret = gsseap_rcv_token_body( _fd, _token, length, _rtn_bytes_read );
+                ret = gsseap_rcv_token_body( _session, _token, length, _rtn_bytes_read );
                 result = ASSERT_PASS( ret, "Failed reading GSSEAP body." );
             }
         }
         else {
 
-            i = read( _fd, ( char * ) _token->value, _token->length );
+            i = read( _session->fd, ( char * ) _token->value, _token->length );
             if ( igsseapDebugFlag > 0 ) {
                 fprintf( stderr, "rcved token, length = %d\n", i );
             }
@@ -502,33 +561,517 @@ extern "C" {
                 _token->length = i;        /* Assume all of token is rcv'ed */
             }
         }
+
+        if ( result.ok() && _session->handshake.active ) {
+            _session->handshake.round_trips++;
+            _session->handshake.bytes_received += _token->length + ( _session->token_header_mode ? 4 : 0 );
+            _session->handshake.wait_us += gsseap_stats_elapsed_us( &waitStart );
+        }
+        GSSEAP_PROBE( receive_token_return, _session->fd, result.ok() ? _token->length : 0, result.code() );
         return result;
     }
 
     /// @brief Print the current context flags
-    void gsseap_display_ctx_flags() {
-        if ( context_flags & GSS_C_DELEG_FLAG ) {
+    void gsseap_display_ctx_flags(
+        gsseap_session_t* _session ) {
+        if ( _session->context_flags & GSS_C_DELEG_FLAG ) {
             fprintf( stdout, "context flag: GSS_C_DELEG_FLAG\n" );
         }
-        if ( context_flags & GSS_C_MUTUAL_FLAG ) {
+        if ( _session->context_flags & GSS_C_MUTUAL_FLAG ) {
             fprintf( stdout, "context flag: GSS_C_MUTUAL_FLAG\n" );
         }
-        if ( context_flags & GSS_C_REPLAY_FLAG ) {
+        if ( _session->context_flags & GSS_C_REPLAY_FLAG ) {
             fprintf( stdout, "context flag: GSS_C_REPLAY_FLAG\n" );
         }
-        if ( context_flags & GSS_C_SEQUENCE_FLAG ) {
+        if ( _session->context_flags & GSS_C_SEQUENCE_FLAG ) {
             fprintf( stdout, "context flag: GSS_C_SEQUENCE_FLAG\n" );
         }
-        if ( context_flags & GSS_C_CONF_FLAG ) {
+        if ( _session->context_flags & GSS_C_CONF_FLAG ) {
             fprintf( stdout, "context flag: GSS_C_CONF_FLAG \n" );
         }
-        if ( context_flags & GSS_C_INTEG_FLAG ) {
+        if ( _session->context_flags & GSS_C_INTEG_FLAG ) {
             fprintf( stdout, "context flag: GSS_C_INTEG_FLAG \n" );
         }
     }
 
+    /// @brief Client side: read the session ticket the server sends after a full handshake and cache it
+    irods::error gsseap_client_receive_ticket(
+        gsseap_session_t* _session ) {
+        irods::error result = SUCCESS();
+        irods::error ret;
+        gss_buffer_desc ticket_tok;
+        unsigned int bytes_read;
+
+        ticket_tok.value = _session->scratch;
+        ticket_tok.length = _session->scratch_size;
+        ret = gsseap_receive_token( _session, &ticket_tok, &bytes_read );
+        if ( ( result = ASSERT_PASS( ret, "Error reading GSSEAP session ticket." ) ).ok() ) {
+            /* an empty token means the server did not issue a ticket */
+            if ( ticket_tok.length > 0 ) {
+                OM_uint32 minor_status;
+                gss_buffer_desc message_tok;
+                int conf_state = 0;
+
+                /* the ticket and its key, "<ticket> <key>", come wrapped under the context just established */
+                message_tok.value = NULL;
+                message_tok.length = 0;
+                OM_uint32 major_status = gss_unwrap( &minor_status, _session->context, &ticket_tok, &message_tok, &conf_state, NULL );
+                std::string message( ( char* ) message_tok.value, message_tok.length );
+                size_t sep = message.find( ' ' );
+                std::string ticket_key;
+                if ( major_status == GSS_S_COMPLETE && conf_state && sep != std::string::npos &&
+                        gsseap_base64url_decode( message.substr( sep + 1 ), ticket_key ) ) {
+                    gsseap_ticket_cache_put( _session->ticket_cache_key, message.substr( 0, sep ), ticket_key );
+                }
+                else {
+                    rodsLog( LOG_DEBUG, "gsseap_client_receive_ticket: unusable ticket, major status %u", major_status );
+                }
+                gss_release_buffer( &minor_status, &message_tok );
+            }
+        }
+        memset( _session->scratch, 0, _session->scratch_size );
+
+        return result;
+    }
+
+    // =-=-=-=-=-=-=-
+    // Client side: the initiator credentials, target names and mechanism OIDs are the same for every
+    // connection of a process, so they are set up once and shared by concurrent logins
+    static pthread_mutex_t gsseapClientSharedMutex = PTHREAD_MUTEX_INITIALIZER;
+    static std::map<std::string, gss_cred_id_t> gsseapClientCreds;
+    static std::map<std::string, gss_name_t> gsseapClientTargets;
+
+    /// @brief Client side: whether the comma separated mechanism list _list names _mech, an empty list allows everything
+    static bool gsseap_mech_listed(
+        const std::string& _list,
+        const char* _mech ) {
+        if ( _list.empty() ) {
+            return true;
+        }
+        std::string padded = "," + _list + ",";
+        return padded.find( std::string( "," ) + _mech + "," ) != std::string::npos;
+    }
+
+    /// @brief Client side: the first mechanism in order of preference that the server accepts and we hold a credential for,
+    /// the caller holds gsseapClientSharedMutex
+    static void gsseap_client_choose_mech(
+        const std::string& _server_mechs,
+        gss_cred_id_t* _rtn_cred,
+        gss_OID* _rtn_mech ) {
+        gss_OID_set mechs = gsseap_mechs();
+        gss_OID fallback = GSS_C_NO_OID;
+        OM_uint32 major_status;
+        OM_uint32 minor_status;
+        size_t i;
+
+        for ( i = 0; i < mechs->count; i++ ) {
+            gss_OID mech = &mechs->elements[i];
+            char name[32];
+            gsseap_mech_name( mech, name, sizeof( name ) );
+            if ( !gsseap_mech_listed( _server_mechs, name ) ) {
+                continue;
+            }
+            if ( fallback == GSS_C_NO_OID ) {
+                fallback = mech;
+            }
+
+            /* a failed acquisition is retried by the next login, e.g. Kerberos once the user has a ticket */
+            std::map<std::string, gss_cred_id_t>::iterator it = gsseapClientCreds.find( name );
+            if ( it == gsseapClientCreds.end() ) {
+                gss_cred_id_t cred;
+                gss_OID_set_desc single = { 1, mech };
+                major_status = gsseap_mech_acquire_cred( &minor_status, gsseap_mech_is_spnego( mech ) ? mechs : &single,
+                                                         GSS_C_INITIATE, &cred );
+                if ( major_status != GSS_S_COMPLETE ) {
+                    continue;
+                }
+                it = gsseapClientCreds.insert( std::make_pair( std::string( name ), cred ) ).first;
+            }
+            *_rtn_cred = it->second;
+            *_rtn_mech = mech;
+            return;
+        }
+
+        /* no credential for anything, let the most preferred mechanism try its default credential */
+        *_rtn_cred = GSS_C_NO_CREDENTIAL;
+        *_rtn_mech = fallback != GSS_C_NO_OID ? fallback : &mechs->elements[0];
+    }
+
+    /// @brief Client side: the shared initiator credential, target name for _server_dn and mechanism to use with a server
+    /// accepting _server_mechs
+    static irods::error gsseap_client_shared_handles(
+        rError_t* _r_error,
+        const char* _server_dn,
+        const std::string& _server_mechs,
+        gss_cred_id_t* _rtn_cred,
+        gss_name_t* _rtn_target_name,
+        gss_OID* _rtn_mech ) {
+        irods::error result = SUCCESS();
+        irods::error ret;
+        std::string dn = _server_dn != NULL ? _server_dn : "";
+        gss_cred_id_t cred = GSS_C_NO_CREDENTIAL;
+        gss_OID mech = GSS_C_NO_OID;
+
+        pthread_mutex_lock( &gsseapClientSharedMutex );
+
+        gsseap_client_choose_mech( _server_mechs, &cred, &mech );
+
+        std::map<std::string, gss_name_t>::iterator it = gsseapClientTargets.find( dn );
+        if ( it != gsseapClientTargets.end() ) {
+            *_rtn_target_name = it->second;
+        }
+        else {
+            ret = gsseap_import_name( _r_error, _server_dn, _rtn_target_name, true );
+            if ( ( result = ASSERT_PASS( ret, "Failed to import username into GSSEAP." ) ).ok() ) {
+                gsseapClientTargets[dn] = *_rtn_target_name;
+            }
+        }
+
+        if ( *_rtn_cred == GSS_C_NO_CREDENTIAL ) {
+            *_rtn_cred = cred;
+        }
+        *_rtn_mech = mech;
+
+        pthread_mutex_unlock( &gsseapClientSharedMutex );
+        return result;
+    }
+
+    // =-=-=-=-=-=-=-
+    // Client side: first tokens prepared in the background by gsseap_client_prepare, waiting for a login to the same acceptor
+    static const unsigned int gsseapMaxPrepared = 16;
+    static const time_t gsseapPreparedMaxAge = 60;        // seconds a finished preparation waits for a login
+    static const long gsseapPreparedDefaultWait = 5000;   // milliseconds a login waits for a running one
+    /* ask for message protection too, so the context can back a gsseapChannel after login */
+    static const OM_uint32 gsseapInitFlags = GSS_C_MUTUAL_FLAG | GSS_C_REPLAY_FLAG | GSS_C_CONF_FLAG | GSS_C_INTEG_FLAG;
+
+    enum {
+        GSSEAP_PREPARE_RUNNING,
+        GSSEAP_PREPARE_READY,
+        GSSEAP_PREPARE_FAILED
+    };
+
+    typedef struct {
+        std::string server_dn;
+        int owner;                      // socket of the login that asked for it, -1 if the application did
+        int state;
+        bool abandoned;                 // nobody will take it, the preparing thread releases it when done
+        time_t started;
+        gss_OID mech;
+        gss_ctx_id_t context;
+        OM_uint32 major_status;
+        OM_uint32 context_flags;
+        gss_buffer_desc token;          // the first token, owned by the context until it is sent
+    } gsseap_prepared_t;
+
+    static pthread_mutex_t gsseapPreparedMutex = PTHREAD_MUTEX_INITIALIZER;
+    static pthread_cond_t gsseapPreparedCond = PTHREAD_COND_INITIALIZER;
+    static std::list<gsseap_prepared_t*> gsseapPrepared;
+
+    static void gsseap_prepared_release(
+        gsseap_prepared_t* _prepared ) {
+        OM_uint32 minor_status;
+        if ( _prepared->context != GSS_C_NO_CONTEXT ) {
+            ( void ) gss_delete_sec_context( &minor_status, &_prepared->context, GSS_C_NO_BUFFER );
+        }
+        ( void ) gss_release_buffer( &minor_status, &_prepared->token );
+        delete _prepared;
+    }
+
+    /// @brief Take the preparations of _owner (all owners if -1) that no login will use out of the list, called with
+    /// gsseapPreparedMutex held.  Finished ones go to _rtn_stale for release outside the lock, running ones are
+    /// abandoned to their thread.  With _expired_only, only those that finished gsseapPreparedMaxAge ago or failed go.
+    static void gsseap_prepared_collect(
+        int _owner,
+        bool _expired_only,
+        std::list<gsseap_prepared_t*>& _rtn_stale ) {
+        time_t now = time( NULL );
+        std::list<gsseap_prepared_t*>::iterator it = gsseapPrepared.begin();
+        while ( it != gsseapPrepared.end() ) {
+            gsseap_prepared_t* prepared = *it;
+            bool expired = prepared->state == GSSEAP_PREPARE_FAILED ||
+                           ( prepared->state == GSSEAP_PREPARE_READY && now - prepared->started >= gsseapPreparedMaxAge );
+            if ( ( _owner != -1 && prepared->owner != _owner ) || ( _expired_only && !expired ) ) {
+                ++it;
+            }
+            else if ( prepared->state == GSSEAP_PREPARE_RUNNING ) {
+                prepared->abandoned = true;
+                it = gsseapPrepared.erase( it );
+            }
+            else {
+                _rtn_stale.push_back( prepared );
+                it = gsseapPrepared.erase( it );
+            }
+        }
+    }
+
+    static void gsseap_prepared_release_all(
+        std::list<gsseap_prepared_t*>& _stale ) {
+        for ( std::list<gsseap_prepared_t*>::iterator it = _stale.begin(); it != _stale.end(); ++it ) {
+            gsseap_prepared_release( *it );
+        }
+        _stale.clear();
+    }
+
+    /// @brief Client side: drop what was prepared for the login on _owner and not taken, however that login ended
+    static void gsseap_client_drop_prepared(
+        int _owner ) {
+        std::list<gsseap_prepared_t*> stale;
+
+        pthread_mutex_lock( &gsseapPreparedMutex );
+        gsseap_prepared_collect( _owner, false, stale );
+        pthread_mutex_unlock( &gsseapPreparedMutex );
+
+        gsseap_prepared_release_all( stale );
+    }
+
+    static void* gsseap_prepare_main(
+        void* _arg ) {
+        gsseap_prepared_t* prepared = ( gsseap_prepared_t* ) _arg;
+        gss_cred_id_t cred = GSS_C_NO_CREDENTIAL;
+        gss_name_t target_name = GSS_C_NO_NAME;
+        gss_OID mech = GSS_C_NO_OID;
+        OM_uint32 major_status = GSS_S_FAILURE;
+        OM_uint32 minor_status;
+        gss_ctx_id_t context = GSS_C_NO_CONTEXT;
+        gss_buffer_desc token = GSS_C_EMPTY_BUFFER;
+        OM_uint32 context_flags = 0;
+
+        irods::error ret = gsseap_client_shared_handles( NULL, prepared->server_dn.empty() ? NULL : prepared->server_dn.c_str(), "",
+                                                         &cred, &target_name, &mech );
+        if ( ret.ok() ) {
+            GSSEAP_PROBE( init_step_entry, -1, 0, 0 );
+            major_status = gss_init_sec_context( &minor_status, cred, &context, target_name, mech, gsseapInitFlags, 0,
+                                                 GSS_C_NO_CHANNEL_BINDINGS, GSS_C_NO_BUFFER, NULL, &token, &context_flags, NULL );
+            GSSEAP_PROBE( init_step_return, -1, token.length, major_status );
+        }
+
+        pthread_mutex_lock( &gsseapPreparedMutex );
+        prepared->mech = mech;
+        prepared->context = context;
+        prepared->token = token;
+        prepared->context_flags = context_flags;
+        prepared->major_status = major_status;
+        prepared->state = major_status == GSS_S_COMPLETE || major_status == GSS_S_CONTINUE_NEEDED ?
+                          GSSEAP_PREPARE_READY : GSSEAP_PREPARE_FAILED;
+        prepared->started = time( NULL );
+        bool abandoned = prepared->abandoned;
+        pthread_cond_broadcast( &gsseapPreparedCond );
+        pthread_mutex_unlock( &gsseapPreparedMutex );
+
+        if ( abandoned ) {
+            gsseap_prepared_release( prepared );
+        }
+        return NULL;
+    }
+
+    /// @brief Start preparing a first token for _server_dn on behalf of the login on _owner, -1 for the application
+    static int gsseap_client_prepare_for(
+        const char* _server_dn,
+        int _owner ) {
+        gsseap_prepared_t* prepared;
+        pthread_attr_t attr;
+        pthread_t thread;
+        std::list<gsseap_prepared_t*> stale;
+
+        pthread_mutex_lock( &gsseapPreparedMutex );
+        /* what nobody took in time, and what an earlier login on the same socket left behind, makes room */
+        gsseap_prepared_collect( -1, true, stale );
+        if ( _owner != -1 ) {
+            gsseap_prepared_collect( _owner, false, stale );
+        }
+        if ( gsseapPrepared.size() >= gsseapMaxPrepared ) {
+            pthread_mutex_unlock( &gsseapPreparedMutex );
+            gsseap_prepared_release_all( stale );
+            return SYS_MAX_CONNECT_COUNT_EXCEEDED;
+        }
+        prepared = new gsseap_prepared_t();
+        prepared->server_dn = _server_dn != NULL ? _server_dn : "";
+        prepared->owner = _owner;
+        prepared->state = GSSEAP_PREPARE_RUNNING;
+        prepared->abandoned = false;
+        prepared->started = time( NULL );
+        prepared->mech = GSS_C_NO_OID;
+        prepared->context = GSS_C_NO_CONTEXT;
+        prepared->token.length = 0;
+        prepared->token.value = NULL;
+        gsseapPrepared.push_back( prepared );
+        pthread_mutex_unlock( &gsseapPreparedMutex );
+        gsseap_prepared_release_all( stale );
+
+        pthread_attr_init( &attr );
+        pthread_attr_setdetachstate( &attr, PTHREAD_CREATE_DETACHED );
+        int status = pthread_create( &thread, &attr, gsseap_prepare_main, prepared );
+        pthread_attr_destroy( &attr );
+        if ( status != 0 ) {
+            pthread_mutex_lock( &gsseapPreparedMutex );
+            gsseapPrepared.remove( prepared );
+            pthread_mutex_unlock( &gsseapPreparedMutex );
+            delete prepared;
+            return SYS_THREAD_RESOURCE_ERR;
+        }
+        return 0;
+    }
+
+    int gsseap_client_prepare(
+        const char* _server_dn ) {
+        return gsseap_client_prepare_for( _server_dn, -1 );
+    }
+
+    /// @brief Client side: claim a first token prepared for _server_dn, by the login on _owner or by the application,
+    /// with a mechanism the server accepts.  A preparation still running is waited for up to GSSEAP_PREPARE_WAIT
+    /// milliseconds; NULL if there is none, and the login then runs the first step itself.
+    static gsseap_prepared_t* gsseap_client_take_prepared(
+        const char* _server_dn,
+        const std::string& _server_mechs,
+        int _owner ) {
+        std::string dn = _server_dn != NULL ? _server_dn : "";
+        gsseap_prepared_t* match = NULL;
+        std::list<gsseap_prepared_t*> unusable;
+        long wait_ms = gsseap_env_long( "GSSEAP_PREPARE_WAIT", gsseapPreparedDefaultWait );
+        struct timeval tv;
+        struct timespec until;
+
+        gettimeofday( &tv, NULL );
+        until.tv_sec = tv.tv_sec + wait_ms / 1000 + ( tv.tv_usec + ( wait_ms % 1000 ) * 1000 ) / 1000000;
+        until.tv_nsec = ( ( tv.tv_usec + ( wait_ms % 1000 ) * 1000 ) % 1000000 ) * 1000;
+
+        pthread_mutex_lock( &gsseapPreparedMutex );
+        gsseap_prepared_collect( -1, true, unusable );
+        for ( ;; ) {
+            bool running = false;
+            std::list<gsseap_prepared_t*>::iterator it = gsseapPrepared.begin();
+            while ( match == NULL && it != gsseapPrepared.end() ) {
+                gsseap_prepared_t* prepared = *it;
+                char name[32];
+                if ( prepared->server_dn != dn || ( prepared->owner != _owner && prepared->owner != -1 ) ) {
+                    ++it;
+                }
+                else if ( prepared->state == GSSEAP_PREPARE_RUNNING ) {
+                    running = true;
+                    ++it;
+                }
+                else if ( prepared->state == GSSEAP_PREPARE_READY &&
+                          gsseap_mech_listed( _server_mechs, gsseap_mech_name( prepared->mech, name, sizeof( name ) ) ) ) {
+                    match = prepared;
+                    it = gsseapPrepared.erase( it );
+                }
+                else {
+                    unusable.push_back( prepared );
+                    it = gsseapPrepared.erase( it );
+                }
+            }
+            if ( match != NULL || !running ||
+                    pthread_cond_timedwait( &gsseapPreparedCond, &gsseapPreparedMutex, &until ) == ETIMEDOUT ) {
+                break;
+            }
+        }
+        pthread_mutex_unlock( &gsseapPreparedMutex );
+
+        gsseap_prepared_release_all( unusable );
+        return match;
+    }
+
+    /// @brief Client side: the acceptor name to authenticate to, NULL for the default
+    static const char* gsseap_client_server_dn(
+        gsseap_session_t* _session ) {
+        const char* server_dn = getenv( "irodsServerDn" ); /* Use irodsServerDn if defined */
+        if ( server_dn == NULL ) {
+            server_dn = getenv( "SERVER_DN" ); /* NULL or the SERVER_DN string */
+        }
+        if ( server_dn == NULL && !_session->server_dn.empty() ) {
+            server_dn = _session->server_dn.c_str(); /* as announced by the server */
+        }
+        return server_dn;
+    }
+
+    /// @brief Client side: run the first step of the handshake and add its token to the auth request _context;
+    /// the handshake stays on the socket if the step fails or its token does not fit
+    static void gsseap_client_short_handshake(
+        irods::gsseap_auth_object_ptr _ptr,
+        gsseap_session_t* _session,
+        std::string& _context ) {
+        gss_cred_id_t cred = _ptr->creds();
+        gss_name_t target_name = GSS_C_NO_NAME;
+        gss_OID mech = GSS_C_NO_OID;
+        gss_buffer_desc token = GSS_C_EMPTY_BUFFER;
+        OM_uint32 major_status;
+        OM_uint32 minor_status;
+        const char* server_dn = gsseap_client_server_dn( _session );
+
+        irods::error ret = gsseap_client_shared_handles( _session->r_error, server_dn, _session->server_mechs, &cred, &target_name, &mech );
+        if ( !ret.ok() ) {
+            return;
+        }
+
+        gsseap_handshake_begin( &_session->handshake );
+        gsseap_prepared_t* prepared = gsseap_client_take_prepared( server_dn, _session->server_mechs, _session->fd );
+        if ( prepared != NULL ) {
+            _session->context = prepared->context;
+            _session->context_flags = prepared->context_flags;
+            token = prepared->token;
+            major_status = prepared->major_status;
+            mech = prepared->mech;
+            delete prepared;
+        }
+        else {
+            struct timeval stepStart;
+            gettimeofday( &stepStart, NULL );
+            GSSEAP_PROBE( init_step_entry, _session->fd, 0, 0 );
+            major_status = gss_init_sec_context( &minor_status, cred, &_session->context, target_name, mech, gsseapInitFlags, 0,
+                                                 GSS_C_NO_CHANNEL_BINDINGS, GSS_C_NO_BUFFER, NULL, &token, &_session->context_flags, NULL );
+            GSSEAP_PROBE( init_step_return, _session->fd, token.length, major_status );
+            gsseap_handshake_step( &_session->handshake, &stepStart );
+        }
+
+        std::string token_kvp = irods::kvp_delimiter() + GSSEAP_TOKEN_KEY + irods::kvp_association() +
+                                gsseap_base64url_encode( ( const unsigned char* ) token.value, token.length );
+        if ( major_status == GSS_S_CONTINUE_NEEDED && _context.size() + token_kvp.size() < MAX_NAME_LEN ) {
+            _context += token_kvp;
+            _session->short_handshake = 1;
+            _session->mech = mech;
+            _session->handshake.tokens_sent++;
+            _session->handshake.bytes_sent += token.length;
+        }
+        else {
+            rodsLog( LOG_DEBUG, "gsseap_client_short_handshake: first token not sent with the auth request, status %u, %lu bytes",
+                     major_status, ( unsigned long ) token.length );
+            if ( _session->context != GSS_C_NO_CONTEXT ) {
+                ( void ) gss_delete_sec_context( &minor_status, &_session->context, GSS_C_NO_BUFFER );
+            }
+            _session->handshake.active = 0;
+        }
+        ( void ) gss_release_buffer( &minor_status, &token );
+    }
+
+    /// @brief Client side: the server's reply to the first token, from the auth request result or from the socket
+    static irods::error gsseap_client_short_reply(
+        gsseap_session_t* _session,
+        irods::kvp_map_t& _req_kvp,
+        gss_buffer_t _rtn_token ) {
+        irods::error result = SUCCESS();
+        std::string reply;
+
+        _rtn_token->value = _session->scratch;
+        _rtn_token->length = _session->scratch_size;
+        if ( _req_kvp.count( GSSEAP_REPLY_FOLLOWS_KEY ) ) {
+            unsigned int bytes_read;
+            irods::error ret = gsseap_receive_token( _session, _rtn_token, &bytes_read );
+            return ASSERT_PASS( ret, "Error reading GSSEAP token." );
+        }
+
+        if ( ( result = ASSERT_ERROR( gsseap_base64url_decode( _req_kvp[GSSEAP_REPLY_KEY], reply ) &&
+                                      reply.size() <= _session->scratch_size, GSSEAP_ERROR_INIT_SECURITY_CONTEXT,
+                                      "Malformed GSSEAP token in the auth request result." ) ).ok() ) {
+            memcpy( _session->scratch, reply.data(), reply.size() );
+            _rtn_token->length = reply.size();
+            _session->handshake.round_trips++;
+            _session->handshake.bytes_received += reply.size();
+        }
+        return result;
+    }
+
     /// @brief Establish context - take the auth request results and massage them for the auth response call
-    irods::error gsseap_auth_establish_context(
+    GSSEAP_EXPORT irods::error gsseap_auth_establish_context(
         irods::auth_plugin_context& _ctx)
     {
         irods::error result = SUCCESS();
@@ -539,28 +1082,55 @@ extern "C" {
 
             irods::gsseap_auth_object_ptr ptr = boost::dynamic_pointer_cast<irods::gsseap_auth_object>( _ctx.fco() );
         
-	    int fd;
-            
-            fd = ptr->sock();
-    
-            igsseap_rErrorPtr = ptr->r_error();
+            gsseap_session_t* session = gsseap_session_get( ptr->sock() );
+            session->r_error = ptr->r_error();
+
+            irods::kvp_map_t req_kvp;
+            irods::parse_kvp_string( ptr->request_result(), req_kvp );
+            if ( req_kvp.count( GSSEAP_TICKET_CHALLENGE_KEY ) ) {
+                /* the server accepted our session ticket, proving we hold its key replaces the GSS-EAP exchange */
+                std::string proof = gsseap_ticket_proof( session->ticket_key, req_kvp[GSSEAP_TICKET_CHALLENGE_KEY] );
+                gss_buffer_desc proof_tok;
+                proof_tok.value = ( void* ) proof.data();
+                proof_tok.length = proof.size();
+                ret = gsseap_send_token( session, &proof_tok );
+                gsseap_client_drop_prepared( session->fd );
+                if ( !( result = ASSERT_PASS( ret, "Failed sending GSSEAP session ticket proof." ) ).ok() ) {
+                    gsseap_session_end( ptr->sock() );
+                }
+                return result;
+            }
             
-            std::string mech = "{ 1 3 6 1 5 5 15 1 1 18 }";
             gss_OID oid = GSS_C_NULL_OID;
             gss_buffer_desc send_tok, recv_tok, *tokenPtr;
-            gss_name_t target_name;
+            gss_name_t target_name = GSS_C_NO_NAME;
+            gss_cred_id_t cred = ptr->creds();
             OM_uint32 majorStatus, minorStatus;
             OM_uint32 flags = 0;
             
             // overload the use of the username in the response structure
-            char* serverDN = NULL;
-            serverDN = getenv( "irodsServerDn" ); /* Use irodsServerDn if defined */
-            if ( serverDN == NULL ) {
-                serverDN = getenv( "SERVER_DN" ); /* NULL or the SERVER_DN string */
+            const char* serverDN = gsseap_client_server_dn( session );
+            gsseap_session_reserve_scratch( session );
+
+            /* a server that did not take up the first token sent with the auth request gets it again on the socket */
+            if ( session->short_handshake && !req_kvp.count( GSSEAP_REPLY_KEY ) && !req_kvp.count( GSSEAP_REPLY_FOLLOWS_KEY ) ) {
+                ( void ) gss_delete_sec_context( &minorStatus, &session->context, GSS_C_NO_BUFFER );
+                session->short_handshake = 0;
             }
             
-            ret = gsseap_import_name( igsseap_rErrorPtr, serverDN, &target_name, true );
-            if ( ( result = ASSERT_PASS( ret, "Failed to import username into GSSEAP." ) ).ok() ) {
+            ret = gsseap_client_shared_handles( session->r_error, serverDN, session->server_mechs, &cred, &target_name, &oid );
+            if ( ret.ok() && session->short_handshake ) {
+                /* the first round trip already happened with the auth request */
+                oid = session->mech;
+                ret = gsseap_client_short_reply( session, req_kvp, &recv_tok );
+            }
+            if ( ( result = ASSERT_PASS( ret, "Failed to set up GSSEAP initiator." ) ).ok() ) {
+
+                /* the first step may already have run in the background, see gsseap_client_prepare */
+                gsseap_prepared_t* prepared = NULL;
+                if ( !session->short_handshake ) {
+                    prepared = gsseap_client_take_prepared( serverDN, session->server_mechs, session->fd );
+                }
                 
                 /*
                  * Perform the context-establishment loop.
@@ -578,47 +1148,73 @@ extern "C" {
                  * and only if the server has another token to send us.
                  */
 
-        	parse_oid(mech.c_str(), &oid);
+#if defined(IGSSEAP_TIMING)
+                struct timeval startTimeFunc, endTimeFunc, sTimeDiff;
+                float fSec;
+                /* Starting timer for function */
+                ( void ) gettimeofday( &startTimeFunc, ( struct timezone * ) 0 );
+#endif
+
                 tokenPtr = GSS_C_NO_BUFFER;
-                context[fd] = GSS_C_NO_CONTEXT;
-                flags = GSS_C_MUTUAL_FLAG | GSS_C_REPLAY_FLAG;
+                if ( session->short_handshake ) {
+                    tokenPtr = &recv_tok;
+                }
+                else {
+                    session->context = GSS_C_NO_CONTEXT;
+                    gsseap_handshake_begin( &session->handshake );
+                }
+                flags = gsseapInitFlags;
+                gss_OID actualMech = GSS_C_NO_OID;
                 do {
-                    majorStatus = gss_init_sec_context( &minorStatus,
-                                                        ptr->creds(), &context[fd], target_name, oid,
-                                                        flags, 0,
-                                                        NULL,           /* no channel bindings */
-                                                        tokenPtr, NULL, /* ignore mech type */
-                                                        &send_tok, &context_flags,
-                                                        NULL ); /* ignore time_rec */
+                    if ( prepared != NULL ) {
+                        /* the context, its first token and the mechanism's outcome are taken over as they are */
+                        session->context = prepared->context;
+                        session->context_flags = prepared->context_flags;
+                        send_tok = prepared->token;
+                        majorStatus = prepared->major_status;
+                        actualMech = prepared->mech;
+                        oid = prepared->mech;
+                        delete prepared;
+                        prepared = NULL;
+                    }
+                    else {
+                        struct timeval stepStart;
+                        gettimeofday( &stepStart, NULL );
+                        GSSEAP_PROBE( init_step_entry, session->fd, tokenPtr != GSS_C_NO_BUFFER ? tokenPtr->length : 0, 0 );
+                        majorStatus = gss_init_sec_context( &minorStatus,
+                                                            cred, &session->context, target_name, oid,
+                                                            flags, 0,
+                                                            NULL,           /* no channel bindings */
+                                                            tokenPtr, &actualMech,
+                                                            &send_tok, &session->context_flags,
+                                                            NULL ); /* ignore time_rec */
+                        GSSEAP_PROBE( init_step_return, session->fd, send_tok.length, majorStatus );
+                        gsseap_handshake_step( &session->handshake, &stepStart );
+                    }
+                    if ( majorStatus == GSS_S_COMPLETE ) {
+                        gsseap_mech_name( actualMech, session->handshake.mech, sizeof( session->handshake.mech ) );
+                    }
                     
                     /* since recv_tok is not malloc'ed, don't need to call
                        gss_release_buffer, instead clear it. */
-                    memset( igsseapScratchBuffer, 0, SCRATCH_BUFFER_SIZE );
+                    memset( session->scratch, 0, session->scratch_size );
                     
                     if ( !( result = ASSERT_ERROR( majorStatus == GSS_S_COMPLETE || majorStatus == GSS_S_CONTINUE_NEEDED,
                                                    GSSEAP_ERROR_INIT_SECURITY_CONTEXT, "Failed initializing GSSEAP context. Major status: %d\tMinor status: %d" ) ).ok() ) {
                         gsseap_log_error( ptr->r_error(), "initializing context", majorStatus, minorStatus, true );
-                        ( void ) gss_release_name( &minorStatus, &target_name );
                     }
                     else {
                         
-                        ret = gsseap_send_token( &send_tok, fd );
-                        if ( !( result = ASSERT_PASS( ret, "Failed sending GSSEAP token." ) ).ok() ) {
-                            ( void ) gss_release_buffer( &minorStatus, &send_tok );
-                            ( void ) gss_release_name( &minorStatus, &target_name );
-                        }
-                        else {
-                            ( void ) gss_release_buffer( &minorStatus, &send_tok );
+                        ret = gsseap_send_token( session, &send_tok );
+                        ( void ) gss_release_buffer( &minorStatus, &send_tok );
+                        if ( ( result = ASSERT_PASS( ret, "Failed sending GSSEAP token." ) ).ok() ) {
                             
                             if ( majorStatus == GSS_S_CONTINUE_NEEDED ) {
-                                recv_tok.value = &igsseapScratchBuffer;
-                                recv_tok.length = SCRATCH_BUFFER_SIZE;
+                                recv_tok.value = session->scratch;
+                                recv_tok.length = session->scratch_size;
                                 unsigned int bytes_read;
-                                ret = gsseap_receive_token( fd, &recv_tok, &bytes_read );
-                                if ( !( result = ASSERT_PASS( ret, "Error reading GSSEAP token." ) ).ok() ) {
-                                    ( void ) gss_release_name( &minorStatus, &target_name );
-                                }
-                                else {
+                                ret = gsseap_receive_token( session, &recv_tok, &bytes_read );
+                                if ( ( result = ASSERT_PASS( ret, "Error reading GSSEAP token." ) ).ok() ) {
                                     tokenPtr = &recv_tok;
                                 }
                             }
@@ -626,13 +1222,15 @@ extern "C" {
                     }
                 }
                 while ( result.ok() && majorStatus == GSS_S_CONTINUE_NEEDED );
-                
-                if ( serverDN != 0 && strlen( serverDN ) > 0 ) {
-                    ( void ) gss_release_name( &minorStatus, &target_name );
+
+                if ( result.ok() && req_kvp.count( GSSEAP_TICKET_ISSUE_KEY ) ) {
+                    ret = gsseap_client_receive_ticket( session );
+                    result = ASSERT_PASS( ret, "Failed receiving GSSEAP session ticket." );
                 }
+                gsseap_handshake_end( &session->handshake, "client", result.code() );
                 
                 if ( igsseapDebugFlag > 0 ) {
-                    gsseap_display_ctx_flags();
+                    gsseap_display_ctx_flags( session );
                 }
                 
 #if defined(IGSSEAP_TIMING)
@@ -645,12 +1243,23 @@ extern "C" {
                          "igsseapEstablishContextClientside() ---  \n", fSec );
 #endif
             }
+
+            /* a preparation of this login that was not taken up, e.g. after a failure, is of no use to later ones */
+            gsseap_client_drop_prepared( session->fd );
+
+            /* the connection keeps the context of a login that succeeded, a failed one leaves nothing worth keeping */
+            if ( result.ok() ) {
+                gsseap_session_release_scratch( session );
+            }
+            else {
+                gsseap_session_end( ptr->sock() );
+            }
         }
         return result;
     }
 
     /// @brief Setup auth object with relevant information
-    irods::error gsseap_auth_client_start(
+    GSSEAP_EXPORT irods::error gsseap_auth_client_start(
         irods::auth_plugin_context& _ctx,
         rcComm_t* _comm,
         const char* _context ) {
@@ -671,74 +1280,433 @@ extern "C" {
 
                 // set the socket from the conn
                 ptr->sock( _comm->sock );
+
+                // start with clean login state for this connection
+                gsseap_session_begin( _comm->sock, _comm->rError );
+
+                // prepare the first token while the auth request and capability probe are on the wire
+                if ( gsseap_env_long( "GSSEAP_PREPARE", 0 ) > 0 ) {
+                    const char* serverDN = getenv( "irodsServerDn" );
+                    if ( serverDN == NULL ) {
+                        serverDN = getenv( "SERVER_DN" );
+                    }
+                    std::string capabilities;
+                    irods::kvp_map_t cap_kvp;
+                    if ( serverDN == NULL && gsseap_client_cached_capabilities( _comm->host, _comm->portNum, capabilities ) ) {
+                        irods::parse_kvp_string( capabilities, cap_kvp );
+                        if ( !cap_kvp[GSSEAP_CAP_ACCEPTOR].empty() ) {
+                            serverDN = cap_kvp[GSSEAP_CAP_ACCEPTOR].c_str();
+                        }
+                    }
+                    int status = gsseap_client_prepare_for( serverDN, _comm->sock );
+                    if ( status < 0 ) {
+                        rodsLog( LOG_DEBUG, "gsseap_auth_client_start: not preparing the first token, status %d", status );
+                    }
+                }
             }
         }
 
         return result;
     }
 
-    /**
-       Set up an session between this server and a connected new client.
+#if defined(RODS_SERVER)
+    /// @brief Whether a mapped name is safe to use as an iRODS user or zone name in a catalog query
+    static bool gsseap_valid_irods_name(
+        const char* _name ) {
+        const char* cp;
+        if ( _name == NULL || *_name == '\0' || strlen( _name ) >= NAME_LEN ) {
+            return false;
+        }
+        for ( cp = _name; *cp != '\0'; cp++ ) {
+            if ( !isalnum( ( unsigned char ) *cp ) && strchr( "._-@", *cp ) == NULL ) {
+                return false;
+            }
+        }
+        return true;
+    }
 
-       Establishses a GSS-API context (as the service specified in
-       igsseapSetupCreds) with an incoming client, and returns the
-       authenticated client name (the id on the other side of the socket).
-       The other side (the client) must call igsseapEstablishContextClientside at
-       about the same time for the exchanges across the network to work
-       (each side will block waiting for the other).
+    /// @brief Fetch the authenticated values of a GSS name attribute (RFC 6680 naming extensions)
+    static void gsseap_get_name_attribute(
+        gss_name_t _name,
+        const char* _attribute,
+        std::vector<std::string>& _rtn_values ) {
+        OM_uint32 majorStatus, minorStatus;
+        gss_buffer_desc attribute;
+        int more = -1;
+
+        attribute.value = ( void* ) _attribute;
+        attribute.length = strlen( _attribute );
+        while ( more != 0 ) {
+            gss_buffer_desc value = GSS_C_EMPTY_BUFFER;
+            gss_buffer_desc display_value = GSS_C_EMPTY_BUFFER;
+            int authenticated = 0;
+            int complete = 0;
+
+            majorStatus = gss_get_name_attribute( &minorStatus, _name, &attribute, &authenticated, &complete,
+                                                  &value, &display_value, &more );
+            if ( majorStatus != GSS_S_COMPLETE ) {
+                break;
+            }
+            /* only trust what the mechanism verified, e.g. attributes in the RADIUS Access-Accept */
+            if ( authenticated ) {
+                _rtn_values.push_back( std::string( ( char* ) value.value, value.length ) );
+            }
+            ( void ) gss_release_buffer( &minorStatus, &value );
+            ( void ) gss_release_buffer( &minorStatus, &display_value );
+        }
+    }
 
-       If successful, the context handle is set in the global context array.
-       If unsuccessful, an error message is displayed and -1 is returned.
+    /// @brief Derive the iRODS identity from the configured GSS name attributes, if any
+    /**
+       GSSEAP_USER_ATTRIBUTE names the attribute holding the iRODS user, either "user" or "user#zone".
+       GSSEAP_ZONE_ATTRIBUTE optionally names an attribute holding the zone.  When GSSEAP_ADMIN_ATTRIBUTE is set,
+       rodsadmin privileges additionally require one of its values to equal GSSEAP_ADMIN_ATTRIBUTE_VALUE.
+    */
+    static void gsseap_map_name_attributes(
+        gss_name_t _name,
+        gsseap_mapped_identity_t* _rtn_identity ) {
+        std::vector<std::string> users;
+        std::vector<std::string> zones;
+        std::string user;
+        std::string zone;
+        size_t sep;
+
+        const char* user_attribute = gsseap_env_string( "GSSEAP_USER_ATTRIBUTE" );
+        if ( user_attribute == NULL ) {
+            return;
+        }
 
-    **/
-    irods::error gsseap_establish_context_serverside(
-        irods::auth_plugin_context& _ctx,
-        char* _clientName,
-        int _maxLen_clientName ) {
-        irods::error result = SUCCESS();
-        irods::error result2 = SUCCESS();
-        irods::error ret;
+        gsseap_get_name_attribute( _name, user_attribute, users );
+        if ( users.size() != 1 ) {
+            rodsLog( LOG_DEBUG, "gsseap_map_name_attributes: %u authenticated values for %s, falling back to DN lookup",
+                     ( unsigned int ) users.size(), user_attribute );
+            return;
+        }
 
-        ret = _ctx.valid<irods::gsseap_auth_object>();
-        if ( ( result = ASSERT_PASS( ret, "Invalid plugin context." ) ).ok() ) {
+        user = users[0];
+        if ( ( sep = user.find( '#' ) ) != std::string::npos ) {
+            zone = user.substr( sep + 1 );
+            user = user.substr( 0, sep );
+        }
 
-            irods::gsseap_auth_object_ptr ptr = boost::dynamic_pointer_cast<irods::gsseap_auth_object>( _ctx.fco() );
+        const char* zone_attribute = gsseap_env_string( "GSSEAP_ZONE_ATTRIBUTE" );
+        if ( zone_attribute != NULL ) {
+            gsseap_get_name_attribute( _name, zone_attribute, zones );
+            if ( zones.size() == 1 ) {
+                zone = zones[0];
+            }
+        }
 
-            int fd=0;
+        if ( !gsseap_valid_irods_name( user.c_str() ) || ( !zone.empty() && !gsseap_valid_irods_name( zone.c_str() ) ) ) {
+            rodsLog( LOG_NOTICE, "gsseap_map_name_attributes: ignoring invalid user name \"%s\" in %s", users[0].c_str(), user_attribute );
+            return;
+        }
 
-            fd = _ctx.comm()->sock;
-            igsseap_rErrorPtr = &_ctx.comm()->rError;
+        _rtn_identity->admin_allowed = 1;
+        const char* admin_attribute = gsseap_env_string( "GSSEAP_ADMIN_ATTRIBUTE" );
+        if ( admin_attribute != NULL ) {
+            std::vector<std::string> entitlements;
+            const char* admin_value = gsseap_env_string( "GSSEAP_ADMIN_ATTRIBUTE_VALUE" );
+            gsseap_get_name_attribute( _name, admin_attribute, entitlements );
+            _rtn_identity->admin_allowed = 0;
+            for ( size_t i = 0; admin_value != NULL && i < entitlements.size(); i++ ) {
+                if ( entitlements[i] == admin_value ) {
+                    _rtn_identity->admin_allowed = 1;
+                }
+            }
+        }
 
-            gss_buffer_desc send_buffer, recv_buffer;
-            gss_buffer_desc client_name;
-            gss_name_t client;
-            gss_OID doid;
-            OM_uint32 majorStatus, minorStatus;
+        strncpy( _rtn_identity->user_name, user.c_str(), NAME_LEN );
+        strncpy( _rtn_identity->zone_name, zone.c_str(), NAME_LEN );
+        _rtn_identity->source = "name attribute";
+    }
 
-            int i, j;
-        
-            OM_uint32 major_status;
-            OM_uint32 minor_status;
+    /// @brief Derive the iRODS identity from the realm rules in GSSEAP_NAME_RULES_FILE, if any
+    static void gsseap_map_name_rules(
+        const char* _client_name,
+        gsseap_mapped_identity_t* _rtn_identity ) {
+        static int rules_state = 0;  // 0 not yet loaded, 1 loaded, -1 none or broken
+        std::string user;
+        std::string zone;
+        bool admin_allowed = false;
+
+        if ( rules_state == 0 ) {
+            const char* path = gsseap_env_string( "GSSEAP_NAME_RULES_FILE" );
+            rules_state = -1;
+            if ( path != NULL ) {
+                irods::error ret = gsseap_name_rules_load( path );
+                if ( ret.ok() ) {
+                    rules_state = 1;
+                }
+                else {
+                    irods::log( PASS( ret ) );
+                }
+            }
+        }
+        if ( rules_state != 1 || !gsseap_name_rules_apply( _client_name, user, zone, admin_allowed ) ) {
+            return;
+        }
 
-#if defined(IGSSEAP_TIMING)
-            struct timeval startTimeFunc, endTimeFunc, sTimeDiff;
-            float fSec;
-            /* Starting timer for function */
-            ( void ) gettimeofday( &startTimeFunc, ( struct timezone * ) 0 );
+        if ( !gsseap_valid_irods_name( user.c_str() ) || ( !zone.empty() && !gsseap_valid_irods_name( zone.c_str() ) ) ) {
+            rodsLog( LOG_NOTICE, "gsseap_map_name_rules: rule maps %s to invalid user name \"%s\"", _client_name, user.c_str() );
+            return;
+        }
 
-#endif
+        strncpy( _rtn_identity->user_name, user.c_str(), NAME_LEN );
+        strncpy( _rtn_identity->zone_name, zone.c_str(), NAME_LEN );
+        _rtn_identity->admin_allowed = admin_allowed;
+        _rtn_identity->source = "name rule";
+    }
 
-            context[fd] = GSS_C_NO_CONTEXT;
+    /// @brief Server side: the realm of a GSS-EAP name, empty for a name without one
+    static std::string gsseap_name_realm(
+        const char* _name ) {
+        const char* at = strrchr( _name, '@' );
+        return at != NULL ? at + 1 : "";
+    }
 
-            recv_buffer.value = &igsseapScratchBuffer;
+    /// @brief Server side: note the realm of the initiator once the mechanism has named it, which it does when the
+    /// exchange reaches the AAA backend; true the first time the realm is known
+    static bool gsseap_agent_aaa_realm(
+        gsseap_session_t* _session ) {
+        OM_uint32 minor_status;
+        gss_name_t initiator = GSS_C_NO_NAME;
+        gss_buffer_desc name_buf = GSS_C_EMPTY_BUFFER;
 
-            do {
-                recv_buffer.length = SCRATCH_BUFFER_SIZE;
-                unsigned int bytes_read;
-                ret = gsseap_receive_token( fd, &recv_buffer, &bytes_read );
-                if ( !( result = ASSERT_PASS( ret, "Failed reading GSSEAP token." ) ).ok() ) {
-                    rodsLogAndErrorMsg( LOG_ERROR, igsseap_rErrorPtr, result.code(),
-                                        "igsseapEstablishContextServerside" );
+        if ( !_session->aaa_realm.empty() || _session->context == GSS_C_NO_CONTEXT ) {
+            return false;
+        }
+        if ( gss_inquire_context( &minor_status, _session->context, &initiator, NULL, NULL, NULL, NULL, NULL, NULL ) == GSS_S_COMPLETE &&
+                initiator != GSS_C_NO_NAME &&
+                gss_display_name( &minor_status, initiator, &name_buf, NULL ) == GSS_S_COMPLETE ) {
+            _session->aaa_realm = gsseap_name_realm( std::string( ( char* ) name_buf.value, name_buf.length ).c_str() );
+        }
+        ( void ) gss_release_buffer( &minor_status, &name_buf );
+        if ( initiator != GSS_C_NO_NAME ) {
+            ( void ) gss_release_name( &minor_status, &initiator );
+        }
+        return !_session->aaa_realm.empty();
+    }
+
+    /// @brief Server side: negative cache key for an authenticated GSS-EAP name asking for the requested user
+    static std::string gsseap_agent_name_key(
+        irods::auth_plugin_context& _ctx,
+        const char* _client_name ) {
+        rsComm_t* comm = _ctx.comm();
+        return std::string( "name:" ) + _client_name + "|" + comm->clientUser.userName + "#" + comm->clientUser.rodsZone;
+    }
+
+    /// @brief Server side: whether the proxy user of the connection may act as a gateway, GSSEAP_GATEWAY lists those allowed
+    static irods::error gsseap_agent_gateway_allowed(
+        rsComm_t* _comm ) {
+        const char* gateways = gsseap_env_string( "GSSEAP_GATEWAY" );
+        int authFlag = _comm->proxyUser.authInfo.authFlag;
+        bool listed = gateways != NULL &&
+                      ( std::string( "," ) + gateways + "," ).find( std::string( "," ) + _comm->proxyUser.userName + "," ) != std::string::npos;
+
+        return ASSERT_ERROR( listed && ( authFlag == LOCAL_PRIV_USER_AUTH || authFlag == REMOTE_PRIV_USER_AUTH ), SYS_PROXYUSER_NO_PRIV,
+                             "%s may not act as a GSSEAP gateway.", _comm->proxyUser.userName );
+    }
+
+    /// @brief Server side: take the gateway's identity off its connection while an end user logs in over it, so the login
+    /// runs as it would on a connection of the end user's own
+    static void gsseap_agent_gateway_begin(
+        rsComm_t* _comm,
+        gsseap_session_t* _session,
+        irods::kvp_map_t& _kvp ) {
+        _session->gateway = 1;
+        _session->gateway_proxy = _comm->proxyUser;
+        _session->gateway_client = _comm->clientUser;
+
+        memset( &_comm->clientUser, 0, sizeof( _comm->clientUser ) );
+        snprintf( _comm->clientUser.userName, NAME_LEN, "%s", _kvp[GSSEAP_GATEWAY_USER_KEY].c_str() );
+        snprintf( _comm->clientUser.rodsZone, NAME_LEN, "%s", _kvp[GSSEAP_GATEWAY_ZONE_KEY].c_str() );
+        _comm->clientUser.authInfo.authFlag = NO_USER_AUTH;
+        _comm->proxyUser = _comm->clientUser;
+    }
+
+    /// @brief Server side: give the gateway its connection back as it was, after a failed end user login
+    static void gsseap_agent_gateway_restore(
+        rsComm_t* _comm,
+        gsseap_session_t* _session ) {
+        _comm->proxyUser = _session->gateway_proxy;
+        _comm->clientUser = _session->gateway_client;
+        setenv( SP_CLIENT_USER, _comm->clientUser.userName, 1 );
+        _session->gateway = 0;
+    }
+
+    /// @brief Server side: run one gss_accept_sec_context step on _token, telling the circuit breaker's outcome in _rtn_aaa.
+    /// The breaker of the realm the initiator announced is consulted as soon as the mechanism names it, but a failure only
+    /// counts against the realm once its AAA backend has answered a step of the exchange
+    static irods::error gsseap_agent_accept_step(
+        irods::auth_plugin_context& _ctx,
+        irods::gsseap_auth_object_ptr _ptr,
+        gsseap_session_t* _session,
+        gss_buffer_t _token,
+        gss_buffer_t _rtn_reply,
+        gss_name_t* _rtn_client,
+        OM_uint32* _rtn_major,
+        gsseap_aaa_outcome_t* _rtn_aaa ) {
+        irods::error result = SUCCESS();
+        gss_OID doid;
+        OM_uint32 majorStatus, minorStatus;
+
+        struct timeval stepStart;
+        gettimeofday( &stepStart, NULL );
+        GSSEAP_PROBE( accept_step_entry, _session->fd, _token->length, 0 );
+        majorStatus = gss_accept_sec_context( &minorStatus,
+                                              &_session->context, _ptr->creds(), _token,
+                                              GSS_C_NO_CHANNEL_BINDINGS, _rtn_client, &doid,
+                                              _rtn_reply, &_session->context_flags,
+                                              NULL,     /* ignore time_rec */
+                                              NULL );   /* ignore del_cred_handle */
+        GSSEAP_PROBE( accept_step_return, _session->fd, _rtn_reply->length, majorStatus );
+        gsseap_handshake_step( &_session->handshake, &stepStart );
+        *_rtn_major = majorStatus;
+        bool known = !_session->aaa_realm.empty();
+        bool named = gsseap_agent_aaa_realm( _session );
+
+        if ( !( result = ASSERT_ERROR( majorStatus == GSS_S_COMPLETE || majorStatus == GSS_S_CONTINUE_NEEDED,
+                                       GSSEAP_ACCEPT_SEC_CONTEXT_ERROR, "Error accepting GSSEAP security context." ) ).ok() ) {
+            gsseap_log_error( &_ctx.comm()->rError, "accepting context", majorStatus, minorStatus, false );
+
+            /* a rejected credential is an answer from the AAA backend.  The realm is only what the client announced, and
+               a backend silently drops EAP messages it cannot use, so a client can make any exchange time out; a failure
+               is the backend's only once it has answered for the realm in this exchange */
+            if ( GSS_ROUTINE_ERROR( majorStatus ) == GSS_S_UNAVAILABLE || GSS_ROUTINE_ERROR( majorStatus ) == GSS_S_FAILURE ) {
+                *_rtn_aaa = _session->aaa_answered ? GSSEAP_AAA_FAILED : GSSEAP_AAA_UNKNOWN;
+            }
+            else {
+                *_rtn_aaa = GSSEAP_AAA_OK;
+            }
+        }
+        else if ( majorStatus == GSS_S_COMPLETE ) {
+            *_rtn_aaa = GSSEAP_AAA_OK;
+            gsseap_mech_name( doid, _session->handshake.mech, sizeof( _session->handshake.mech ) );
+        }
+        else if ( named ) {
+            /* the rest of the exchange only goes to the realm's AAA backend while its breaker lets it */
+            irods::error ret = gsseap_breaker_admit( _session->aaa_realm );
+            result = ASSERT_PASS( ret, "GSSEAP login refused, the AAA backend of its realm is failing." );
+        }
+        else if ( known ) {
+            /* a step past the one that named the realm went on, so the realm's backend answered it */
+            _session->aaa_answered = 1;
+        }
+        return result;
+    }
+
+    /// @brief Server side: connect to the catalog of the local zone if the client has not sent its next token yet,
+    /// so the connection is made on the handshake thread while the client and the network take their time
+    static void gsseap_agent_preconnect(
+        rsComm_t* _comm,
+        gsseap_session_t* _session ) {
+        struct pollfd pfd;
+        rodsServerHost_t* rodsServerHost = NULL;
+
+        pfd.fd = _session->fd;
+        pfd.events = POLLIN;
+        pfd.revents = 0;
+        if ( poll( &pfd, 1, 0 ) != 0 ) {
+            /* the token is there already, or the socket failed; the first catalog query connects */
+            return;
+        }
+        _session->catalog_preconnect = 0;
+
+        int status = getAndConnRcatHost( _comm, MASTER_RCAT, _comm->myEnv.rodsZone, &rodsServerHost );
+        if ( status < 0 ) {
+            /* the first catalog query connects again */
+            rodsLog( LOG_NOTICE, "gsseap_agent_preconnect: connecting to the catalog during the handshake failed, status = %d",
+                     status );
+        }
+    }
+
+    /**
+       Set up an session between this server and a connected new client.
+
+       Establishses a GSS-API context (as the service specified in
+       igsseapSetupCreds) with an incoming client, and returns the
+       authenticated client name (the id on the other side of the socket).
+       The other side (the client) must call igsseapEstablishContextClientside at
+       about the same time for the exchanges across the network to work
+       (each side will block waiting for the other).
+
+       If successful, the context handle is set in the global context array,
+       and _rtn_identity holds the identity asserted by name attributes, if any.
+       If unsuccessful, an error message is displayed and -1 is returned.
+
+    **/
+    irods::error gsseap_establish_context_serverside(
+        irods::auth_plugin_context& _ctx,
+        char* _clientName,
+        int _maxLen_clientName,
+        gsseap_mapped_identity_t* _rtn_identity ) {
+        irods::error result = SUCCESS();
+        irods::error result2 = SUCCESS();
+        irods::error ret;
+
+        ret = _ctx.valid<irods::gsseap_auth_object>();
+        if ( ( result = ASSERT_PASS( ret, "Invalid plugin context." ) ).ok() ) {
+
+            irods::gsseap_auth_object_ptr ptr = boost::dynamic_pointer_cast<irods::gsseap_auth_object>( _ctx.fco() );
+
+            gsseap_session_t* session = gsseap_session_get( _ctx.comm()->sock );
+            session->r_error = &_ctx.comm()->rError;
+
+            gss_buffer_desc send_buffer, recv_buffer;
+            gss_buffer_desc client_name;
+            gss_name_t client;
+            gss_OID doid;
+            OM_uint32 majorStatus, minorStatus;
+
+            int i, j;
+            gsseap_aaa_outcome_t aaa = GSSEAP_AAA_UNKNOWN;
+            bool refused = false;
+        
+            OM_uint32 major_status;
+            OM_uint32 minor_status;
+
+#if defined(IGSSEAP_TIMING)
+            struct timeval startTimeFunc, endTimeFunc, sTimeDiff;
+            float fSec;
+            /* Starting timer for function */
+            ( void ) gettimeofday( &startTimeFunc, ( struct timezone * ) 0 );
+
+#endif
+
+            majorStatus = GSS_S_CONTINUE_NEEDED;
+            if ( session->short_handshake ) {
+                /* the first accept step ran in the auth request, see gsseap_agent_short_handshake */
+                client = session->peer;
+                session->peer = GSS_C_NO_NAME;
+                if ( client != GSS_C_NO_NAME ) {
+                    majorStatus = GSS_S_COMPLETE;
+                    aaa = GSSEAP_AAA_OK;
+                }
+                if ( session->pending_token.length != 0 ) {
+                    ret = gsseap_send_token( session, &session->pending_token );
+                    result = ASSERT_PASS( ret, "Failed sending GSSEAP token." );
+                }
+                ( void ) gss_release_buffer( &minorStatus, &session->pending_token );
+                session->short_handshake = 0;
+            }
+            else {
+                session->context = GSS_C_NO_CONTEXT;
+                gsseap_handshake_begin( &session->handshake );
+            }
+
+            recv_buffer.value = session->scratch;
+
+            while ( result.ok() && majorStatus == GSS_S_CONTINUE_NEEDED ) {
+                if ( session->catalog_preconnect ) {
+                    gsseap_agent_preconnect( _ctx.comm(), session );
+                }
+                recv_buffer.length = session->scratch_size;
+                unsigned int bytes_read;
+                ret = gsseap_receive_token( session, &recv_buffer, &bytes_read );
+                if ( !( result = ASSERT_PASS( ret, "Failed reading GSSEAP token." ) ).ok() ) {
+                    rodsLogAndErrorMsg( LOG_ERROR, session->r_error, result.code(),
+                                        "igsseapEstablishContextServerside" );
                 }
                 else {
                     if ( igsseapDebugFlag > 0 ) {
@@ -747,31 +1715,23 @@ extern "C" {
                         gsseap_print_token( &recv_buffer );
                     }
 
-                    majorStatus = gss_accept_sec_context( &minorStatus,
-                                                          &context[fd], ptr->creds(), &recv_buffer,
-                                                          GSS_C_NO_CHANNEL_BINDINGS, &client, &doid,
-                                                          &send_buffer, &context_flags,
-                                                          NULL,     /* ignore time_rec */
-                                                          NULL );   /* ignore del_cred_handle */
-
-                    if ( !( result = ASSERT_ERROR( majorStatus == GSS_S_COMPLETE || majorStatus == GSS_S_CONTINUE_NEEDED,
-                                                   GSSEAP_ACCEPT_SEC_CONTEXT_ERROR, "Error accepting GSSEAP security context." ) ).ok() ) {
-                        fprintf( stderr, " gss_accept_sec_context error\n");
-                        gsseap_log_error( &_ctx.comm()->rError, "accepting context", majorStatus, minorStatus, false );
-                        memset( igsseapScratchBuffer, 0, SCRATCH_BUFFER_SIZE );
+                    ret = gsseap_agent_accept_step( _ctx, ptr, session, &recv_buffer, &send_buffer, &client, &majorStatus, &aaa );
+                    if ( !( result = ASSERT_PASS( ret, "Error accepting GSSEAP security context." ) ).ok() ) {
+                        refused = true;
+                        memset( session->scratch, 0, session->scratch_size );
                     }
                     else {
 
                         /* since buffer is not malloc'ed, don't need to call
                            gss_release_buffer, instead clear it. */
-                        memset( igsseapScratchBuffer, 0, SCRATCH_BUFFER_SIZE );
+                        memset( session->scratch, 0, session->scratch_size );
 
                         if ( send_buffer.length != 0 ) {
                             if ( igsseapDebugFlag > 0 ) {
                                 fprintf( stderr, "Sending accept_sec_context token (size=%lu):\n", send_buffer.length );
                                 gsseap_print_token( &send_buffer );
                             }
-                            ret = gsseap_send_token( &send_buffer, fd );
+                            ret = gsseap_send_token( session, &send_buffer );
                             result = ASSERT_PASS( ret, "Failed sending GSSEAP token." );
                         }
                         if ( igsseapDebugFlag > 0 ) {
@@ -780,17 +1740,27 @@ extern "C" {
                             }
                         }
                     }
+                    /* the reply is the mechanism's, sent or not */
+                    ( void ) gss_release_buffer( &minorStatus, &send_buffer );
                 }
             }
-            while ( result.ok() && majorStatus == GSS_S_CONTINUE_NEEDED );
             
-            /* client sends an extraneous token? */
-            unsigned int bytes_read;
-            ret = gsseap_receive_token( fd, &recv_buffer, &bytes_read );
-            if ( !( result2 = ASSERT_PASS( ret, "Failed reading GSSEAP token." ) ).ok() ) {
-                rodsLogAndErrorMsg( LOG_ERROR, igsseap_rErrorPtr, result.code(),
-                                    "igsseapEstablishContextServerside" );
+            if ( !result.ok() && ( refused || session->gateway ) ) {
+                /* the client waits for a reply to its last token, tell it with an empty token that it was refused; a
+                   gateway also keeps its connection */
+                gss_buffer_desc refusal = GSS_C_EMPTY_BUFFER;
+                ( void ) gsseap_send_token( session, &refusal );
             }
+            else {
+                /* client sends an extraneous token? */
+                unsigned int bytes_read;
+                ret = gsseap_receive_token( session, &recv_buffer, &bytes_read );
+                if ( !( result2 = ASSERT_PASS( ret, "Failed reading GSSEAP token." ) ).ok() ) {
+                    rodsLogAndErrorMsg( LOG_ERROR, session->r_error, result.code(),
+                                        "igsseapEstablishContextServerside" );
+                }
+            }
+            gsseap_handshake_end( &session->handshake, "server", result.code() );
 
             if ( result.ok() ) {
 
@@ -799,6 +1769,7 @@ extern "C" {
                 if ( !( result = ASSERT_ERROR( majorStatus == GSS_S_COMPLETE, GSSEAP_ERROR_DISPLAYING_NAME, "Failed displaying name: \"%s\"",
                                                client_name ) ).ok() ) {
                     gsseap_log_error( &_ctx.comm()->rError, "displaying name", majorStatus, minorStatus, false );
+                    ( void ) gss_release_name( &minorStatus, &client );
                 }
                 else {
 
@@ -818,14 +1789,19 @@ extern "C" {
 			_clientName[i] = '\0';	
 		    }
 
+                    /* the mechanism may already assert the iRODS account */
+                    if ( _rtn_identity != NULL ) {
+                        gsseap_map_name_attributes( client, _rtn_identity );
+                    }
+
                     /* release the name structure */
 		   majorStatus = gss_release_name( &minorStatus, &client );
 
+                    ( void ) gss_release_buffer( &minorStatus, &client_name );
                     if ( !( result = ASSERT_ERROR( majorStatus == GSS_S_COMPLETE, GSSEAP_ERROR_RELEASING_NAME, "Error releasing name." ) ).ok() ) {
                         gsseap_log_error( &_ctx.comm()->rError, "releasing name", majorStatus, minorStatus, false );
                     }
                     else {
-                        ( void ) gss_release_buffer( &minorStatus, &client_name );
 
 #if defined(IGSSEAP_TIMING)
                         ( void ) gettimeofday( &endTimeFunc, ( struct timezone * ) 0 );
@@ -840,293 +1816,838 @@ extern "C" {
                     }
                 }
             }
+
+            /* the AAA backend is no longer involved, let the next queued login run */
+            gsseap_breaker_report( session->aaa_realm, aaa );
+            gsseap_admission_release();
         }
 
         return result;
     }
 
-    /// @brief Setup auth object with relevant information
-    irods::error gsseap_auth_agent_start(
+    /// @brief Server side: run the first accept step on the token the client sent with its auth request and add the reply
+    /// to _rtn_result, or keep it for the socket if it does not fit
+    static irods::error gsseap_agent_short_handshake(
         irods::auth_plugin_context& _ctx,
-        const char* _context ) {
+        irods::gsseap_auth_object_ptr _ptr,
+        gsseap_session_t* _session,
+        const std::string& _token,
+        std::string& _rtn_result ) {
         irods::error result = SUCCESS();
         irods::error ret;
-        
-        ret = _ctx.valid<irods::gsseap_auth_object>();
-        if ( ( result = ASSERT_PASS( ret, "Invalid plugin context" ) ).ok() ) {
+        gss_buffer_desc recv_buffer;
+        gss_buffer_desc send_buffer = GSS_C_EMPTY_BUFFER;
+        gss_name_t client = GSS_C_NO_NAME;
+        OM_uint32 majorStatus, minorStatus;
+        gsseap_aaa_outcome_t aaa = GSSEAP_AAA_UNKNOWN;
+        std::string token;
+
+        _session->r_error = &_ctx.comm()->rError;
+        _session->context = GSS_C_NO_CONTEXT;
+        gsseap_handshake_begin( &_session->handshake );
+
+        if ( ( result = ASSERT_ERROR( gsseap_base64url_decode( _token, token ), GSSEAP_ACCEPT_SEC_CONTEXT_ERROR,
+                                      "Malformed GSSEAP token in the auth request." ) ).ok() ) {
+            _session->handshake.round_trips++;
+            _session->handshake.bytes_received += token.size();
+
+            recv_buffer.value = ( void* ) token.data();
+            recv_buffer.length = token.size();
+            ret = gsseap_agent_accept_step( _ctx, _ptr, _session, &recv_buffer, &send_buffer, &client, &majorStatus, &aaa );
+            result = ASSERT_PASS( ret, "Error accepting the GSSEAP token sent with the auth request." );
+        }
 
-                irods::gsseap_auth_object_ptr ptr = boost::dynamic_pointer_cast<irods::gsseap_auth_object>( _ctx.fco() );
-                int status;
-                char clientName[500];
-                genQueryInp_t genQueryInp;
-                genQueryOut_t *genQueryOut;
-                char condition1[MAX_NAME_LEN];
-                char condition2[MAX_NAME_LEN];
-                char *tResult;
-                int privLevel;
-                int clientPrivLevel;
-                int noNameMode;
-
-                gsseapAuthReqStatus = 1;
-
-                ret = gsseap_establish_context_serverside( _ctx, clientName, 500 );
-                if ( ( result = ASSERT_PASS( ret, "Failed to establish server side context." ) ).ok() ) {
+        if ( result.ok() ) {
+            std::string reply_kvp = ( _rtn_result.empty() ? "" : irods::kvp_delimiter() ) + GSSEAP_REPLY_KEY + irods::kvp_association() +
+                                    gsseap_base64url_encode( ( const unsigned char* ) send_buffer.value, send_buffer.length );
+            if ( _rtn_result.size() + reply_kvp.size() < MAX_NAME_LEN ) {
+                _rtn_result += reply_kvp;
+                _session->handshake.tokens_sent++;
+                _session->handshake.bytes_sent += send_buffer.length;
+                ( void ) gss_release_buffer( &minorStatus, &send_buffer );
+            }
+            else {
+                /* sent by gsseap_establish_context_serverside before it reads the next token */
+                _rtn_result += ( _rtn_result.empty() ? "" : irods::kvp_delimiter() ) + GSSEAP_REPLY_FOLLOWS_KEY + irods::kvp_association() + "1";
+                _session->pending_token = send_buffer;
+            }
+            if ( majorStatus == GSS_S_COMPLETE ) {
+                _session->peer = client;
+            }
+            else if ( client != GSS_C_NO_NAME ) {
+                ( void ) gss_release_name( &minorStatus, &client );
+            }
+            _session->short_handshake = 1;
+        }
+        else {
+            gsseap_handshake_end( &_session->handshake, "server", result.code() );
+            /* the AAA backend is no longer involved, let the next queued login run */
+            gsseap_breaker_report( _session->aaa_realm, aaa );
+            gsseap_admission_release();
+        }
+        return result;
+    }
 
-                    //#ifdef GSSEAP_DEBUG
-                    if ( result.ok() ) {
-                        printf( "clientName:%s\n", clientName );
+    /// @brief Server side: account for a login that ended, successfully or not, and queue its audit record
+    static void gsseap_agent_login_done(
+        irods::auth_plugin_context& _ctx,
+        gsseap_session_t* _session,
+        const gsseap_handshake_stats_t* _handshake,
+        int _status ) {
+        // the connection stays with the agent, its token buffer is only needed for another login on it
+        gsseap_session_release_scratch( _session );
+        if ( !_session->login_start.active ) {
+            return;
+        }
+        unsigned long long wall_us = gsseap_stats_end( &_session->login_start, _handshake, _status );
+        if ( !gsseap_audit_enabled() ) {
+            return;
+        }
+
+        gsseap_audit_record_t record;
+        record.time = time( NULL );
+        record.status = _status;
+        record.path = _session->login_path;
+        snprintf( record.mech, sizeof( record.mech ), "%s", _handshake != NULL ? _handshake->mech : "" );
+        snprintf( record.identity, sizeof( record.identity ), "%s", _session->client_name );
+        snprintf( record.realm, sizeof( record.realm ), "%s",
+                  _session->client_name[0] != '\0' ? gsseap_name_realm( _session->client_name ).c_str() : _session->aaa_realm.c_str() );
+        snprintf( record.user, sizeof( record.user ), "%s#%s", _ctx.comm()->clientUser.userName, _ctx.comm()->clientUser.rodsZone );
+        snprintf( record.client_addr, sizeof( record.client_addr ), "%s", _ctx.comm()->clientAddr );
+        record.wall_us = wall_us;
+        record.mech_us = _handshake != NULL ? _handshake->step_us : 0;
+        record.wait_us = _handshake != NULL ? _handshake->wait_us : 0;
+        record.round_trips = _handshake != NULL ? _handshake->round_trips : 0;
+        record.map_us = _session->map_us;
+        snprintf( record.message, sizeof( record.message ), "%s", _status < 0 ? _session->auth_req_error_msg : "" );
+        gsseap_audit_submit( &record );
+    }
+
+    /// @brief Set the auth flags for a client whose iRODS identity has been established
+    static irods::error gsseap_agent_authorize(
+        irods::auth_plugin_context& _ctx,
+        const char* _user_type,
+        int _no_name_mode ) {
+        irods::error result = SUCCESS();
+        int status;
+        int privLevel = LOCAL_USER_AUTH;
+        int clientPrivLevel = LOCAL_USER_AUTH;
+
+        if ( strcmp( _user_type, "rodsadmin" ) == 0 ) {
+            privLevel = LOCAL_PRIV_USER_AUTH;
+            clientPrivLevel = LOCAL_PRIV_USER_AUTH;
+        }
+
+        status = chkProxyUserPriv( _ctx.comm(), privLevel );
+        if ( ( result = ASSERT_ERROR( status >= 0, status, "Failed checking proxy user priviledges." ) ).ok() ) {
+
+            _ctx.comm()->proxyUser.authInfo.authFlag = privLevel;
+            _ctx.comm()->clientUser.authInfo.authFlag = clientPrivLevel;
+
+            // Reset the auth scheme here so we do not try to authenticate again unless the client requests it.
+            if ( _ctx.comm()->auth_scheme != NULL ) {
+                free( _ctx.comm()->auth_scheme );
+            }
+            _ctx.comm()->auth_scheme = NULL;
+
+            if ( _no_name_mode ) { /* We didn't before, but now have an irodsUserName */
+                int status2, status3;
+                rodsServerHost_t *rodsServerHost = NULL;
+                status2 = getAndConnRcatHost( _ctx.comm(), MASTER_RCAT,
+                                              _ctx.comm()->myEnv.rodsZone, &rodsServerHost );
+                if ( status2 >= 0 &&
+                        rodsServerHost->localFlag == REMOTE_HOST &&
+                        rodsServerHost->conn != NULL ) {  /* If the IES is remote */
+
+                    status3 = rcDisconnect( rodsServerHost->conn ); /* disconnect*/
+
+                    /* And clear out the connection information so
+                       getAndConnRcatHost will reconnect.  This may leak some
+                       memory but only happens at most once in an agent:  */
+                    rodsServerHost->conn = NULL;
+
+                    /* And reconnect (with irodsUserName here and in the IES): */
+                    status3 = getAndConnRcatHost( _ctx.comm(), MASTER_RCAT,
+                                                  _ctx.comm()->myEnv.rodsZone,
+                                                  &rodsServerHost );
+                    if ( !( result = ASSERT_ERROR( status3 == 0, status3,
+                                                   " GSSEAP server side auth failed in connecting to Rcat host, status = %d.",
+                                                   status3 ) ).ok() ) {
+                        rodsLog( LOG_ERROR,
+                                 "igsseapServersideAuth failed in getAndConnRcatHost, status = %d",
+                                 status3 );
                     }
-                    //#endif
+                }
+            }
+        }
 
-                    memset( &genQueryInp, 0, sizeof( genQueryInp_t ) );
+        return result;
+    }
 
-                    noNameMode = 0;
-                    if ( strlen( _ctx.comm()->clientUser.userName ) > 0 ) {
-                        /* regular mode */
+    /// @brief Server side: validate a presented session ticket, or note that the client wants one
+    static void gsseap_agent_check_ticket(
+        irods::auth_plugin_context& _ctx,
+        const std::string& _context,
+        std::string& _rtn_result ) {
+        gsseap_session_t* session = gsseap_session_get( _ctx.comm()->sock );
+        irods::kvp_map_t kvp;
+        irods::kvp_map_t out;
+        irods::error ret;
 
-                        snprintf( condition1, MAX_NAME_LEN, "='%s'", clientName );
-                        addInxVal( &genQueryInp.sqlCondInp, COL_USER_DN, condition1 );
+        session->ticket_presented = 0;
+        session->ticket_requested = 0;
 
-                        snprintf( condition2, MAX_NAME_LEN, "='%s'",
-                                  _ctx.comm()->clientUser.userName );
-                        addInxVal( &genQueryInp.sqlCondInp, COL_USER_NAME, condition2 );
+        if ( !gsseap_ticket_enabled() ) {
+            return;
+        }
 
-                        addInxIval( &genQueryInp.selectInp, COL_USER_ID, 1 );
-                        addInxIval( &genQueryInp.selectInp, COL_USER_TYPE, 1 );
-                        addInxIval( &genQueryInp.selectInp, COL_USER_ZONE, 1 );
+        irods::parse_kvp_string( _context, kvp );
+        if ( kvp.count( GSSEAP_TICKET_KEY ) ) {
+            userInfo_t* client = &_ctx.comm()->clientUser;
+            ret = gsseap_ticket_verify( kvp[GSSEAP_TICKET_KEY], session->ticket );
+            if ( !ret.ok() ) {
+                rodsLog( LOG_DEBUG, "gsseap_agent_check_ticket: ticket refused, %s", ret.result().c_str() );
+            }
+            else if ( ( strlen( client->userName ) > 0 && session->ticket.user_name != client->userName ) ||
+                      ( strlen( client->rodsZone ) > 0 && session->ticket.zone_name != client->rodsZone ) ) {
+                rodsLog( LOG_DEBUG, "gsseap_agent_check_ticket: ticket for %s#%s presented by %s#%s",
+                         session->ticket.user_name.c_str(), session->ticket.zone_name.c_str(), client->userName, client->rodsZone );
+            }
+            else {
+                session->ticket_challenge = gsseap_ticket_challenge();
+                if ( !session->ticket_challenge.empty() ) {
+                    session->ticket_presented = 1;
+                    out[GSSEAP_TICKET_CHALLENGE_KEY] = session->ticket_challenge;
+                }
+            }
+        }
+        if ( !session->ticket_presented && kvp.count( GSSEAP_TICKET_REQUEST_KEY ) ) {
+            session->ticket_requested = 1;
+            out[GSSEAP_TICKET_ISSUE_KEY] = "1";
+        }
 
-                        genQueryInp.maxRows = 2;
+        if ( !out.empty() ) {
+            _rtn_result = irods::kvp_string( out );
+        }
+    }
 
-                        status = rsGenQuery( _ctx.comm(), &genQueryInp, &genQueryOut );
-                    }
-                    else {
-                        /*
-                          The client isn't providing the rodsUserName so query on just
-                          the DN.  If it returns just one row, set the clientUser to
-                          the returned irods user name.
-                        */
-                        noNameMode = 1;
-                        memset( &genQueryInp, 0, sizeof( genQueryInp_t ) );
-
-                        snprintf( condition1, MAX_NAME_LEN, "='%s'", clientName );
-                        addInxVal( &genQueryInp.sqlCondInp, COL_USER_DN, condition1 );
-
-                        addInxIval( &genQueryInp.selectInp, COL_USER_ID, 1 );
-                        addInxIval( &genQueryInp.selectInp, COL_USER_TYPE, 1 );
-                        addInxIval( &genQueryInp.selectInp, COL_USER_NAME, 1 );
-                        addInxIval( &genQueryInp.selectInp, COL_USER_ZONE, 1 );
-
-                        genQueryInp.maxRows = 2;
-
-                        status = rsGenQuery( _ctx.comm(), &genQueryInp, &genQueryOut );
-
-                        if ( status == CAT_NO_ROWS_FOUND ) { /* not found */
-                            /* execute the rule acGetUserByDN.  By default this
-                               is a no-op but at some sites can be configured to
-                               run a process to determine a user by DN (for VO support)
-                               or possibly create the user.
-                               The stdout of the process is the irodsUserName to use.
-
-                               The corresponding rule would be something like this:
-                               acGetUserByDN(*arg,*OUT)||msiExecCmd(t,"*arg",null,null,null,*OUT)|nop
-                            */
-                            ruleExecInfo_t rei;
-                            const char *args[2];
-                            msParamArray_t *myMsParamArray;
-                            msParamArray_t myInOutParamArray;
-
-                            memset( ( char* )&rei, 0, sizeof( rei ) );
-                            rei.rsComm = _ctx.comm();
-                            rei.uoic = &_ctx.comm()->clientUser;
-                            rei.uoip = &_ctx.comm()->proxyUser;
-                            args[0] = clientName;
-                            char out[200] = "*cmdOutput";
-                            args[1] = out;
-
-                            rei.inOutMsParamArray = myInOutParamArray;
-
-                            myMsParamArray = ( msParamArray_t * ) malloc( sizeof( msParamArray_t ) );
-                            memset( myMsParamArray, 0, sizeof( msParamArray_t ) );
-
-                            applyRuleArgPA( "acGetUserByDN", args, 2, myMsParamArray, &rei, NO_SAVE_REI );
+    /// @brief Server side: log the client in from the identity in its session ticket
+    static irods::error gsseap_agent_ticket_login(
+        irods::auth_plugin_context& _ctx ) {
+        rsComm_t* comm = _ctx.comm();
+        gsseap_session_t* session = gsseap_session_get( comm->sock );
+        int noNameMode = 0;
+
+        if ( strlen( comm->clientUser.userName ) == 0 ) {
+            noNameMode = 1;
+            strncpy( comm->clientUser.userName, session->ticket.user_name.c_str(), NAME_LEN );
+            strncpy( comm->proxyUser.userName, session->ticket.user_name.c_str(), NAME_LEN );
+            strncpy( comm->clientUser.rodsZone, session->ticket.zone_name.c_str(), NAME_LEN );
+            strncpy( comm->proxyUser.rodsZone, session->ticket.zone_name.c_str(), NAME_LEN );
+            setenv( SP_CLIENT_USER, comm->clientUser.userName, 1 );
+        }
+
+        rodsLog( LOG_DEBUG, "gsseap_agent_ticket_login: user=%s#%s, EAP name=%s",
+                 session->ticket.user_name.c_str(), session->ticket.zone_name.c_str(), session->ticket.client_name.c_str() );
+
+        return gsseap_agent_authorize( _ctx, session->ticket.user_type.c_str(), noNameMode );
+    }
+
+    /// @brief Server side: check the proof of possession of the presented ticket, read from the client
+    static irods::error gsseap_agent_ticket_proof(
+        gsseap_session_t* _session ) {
+        irods::error ret;
+        gss_buffer_desc proof_tok;
+        unsigned int bytes_read;
+
+        proof_tok.value = _session->scratch;
+        proof_tok.length = _session->scratch_size;
+        ret = gsseap_receive_token( _session, &proof_tok, &bytes_read );
+        if ( ret.ok() ) {
+            ret = gsseap_ticket_check_proof( _session->ticket, _session->ticket_challenge,
+                                             std::string( ( char* ) proof_tok.value, proof_tok.length ) );
+        }
+        /* a challenge is answered once */
+        _session->ticket_challenge.clear();
+
+        return ret;
+    }
+
+    /// @brief Server side: send the requested session ticket and its key wrapped under the context, or an empty token
+    static irods::error gsseap_agent_send_ticket(
+        irods::auth_plugin_context& _ctx,
+        const char* _client_name,
+        const char* _user_type,
+        const char* _user_zone,
+        bool _issue ) {
+        gsseap_session_t* session = gsseap_session_get( _ctx.comm()->sock );
+        irods::error ret;
+        OM_uint32 minor_status;
+        gss_buffer_desc ticket_tok;
+        std::string encoded;
+
+        ticket_tok.value = NULL;
+        ticket_tok.length = 0;
+
+        /* the ticket key must only reach the client, so no ticket goes out without confidentiality */
+        if ( _issue && ( session->context_flags & GSS_C_CONF_FLAG ) ) {
+            gsseap_ticket_t ticket;
+            ticket.user_name = _ctx.comm()->clientUser.userName;
+            ticket.zone_name = _user_zone;
+            ticket.user_type = _user_type;
+            ticket.client_name = _client_name;
+            ret = gsseap_ticket_issue( ticket, encoded );
+            if ( !ret.ok() ) {
+                irods::log( PASS( ret ) );
+            }
+            else {
+                std::string message = encoded + " " +
+                                      gsseap_base64url_encode( ( const unsigned char* ) ticket.key.data(), ticket.key.size() );
+                gss_buffer_desc message_tok;
+                int conf_state = 0;
+
+                message_tok.value = ( void* ) message.data();
+                message_tok.length = message.size();
+                OM_uint32 major_status = gss_wrap( &minor_status, session->context, 1, GSS_C_QOP_DEFAULT,
+                                                   &message_tok, &conf_state, &ticket_tok );
+                if ( major_status != GSS_S_COMPLETE || !conf_state ) {
+                    rodsLog( LOG_ERROR, "gsseap_agent_send_ticket: gss_wrap failed, major status %u", major_status );
+                    gss_release_buffer( &minor_status, &ticket_tok );
+                    ticket_tok.length = 0;
+                }
+            }
+        }
+
+        /* always answer once negotiated, the client is waiting for this token */
+        ret = gsseap_send_token( session, &ticket_tok );
+        gss_release_buffer( &minor_status, &ticket_tok );
+        return ret;
+    }
+
+    /// @brief Server side: rsGenQuery between the gen_query probes, the length is the number of rows returned
+    static int gsseap_agent_gen_query(
+        rsComm_t* _comm,
+        genQueryInp_t* _inp,
+        genQueryOut_t** _out ) {
+        GSSEAP_PROBE( gen_query_entry, _comm->sock, 0, 0 );
+        int status = rsGenQuery( _comm, _inp, _out );
+        GSSEAP_PROBE( gen_query_return, _comm->sock, status >= 0 && *_out != NULL ? ( *_out )->rowCnt : 0, status );
+        return status;
+    }
+
+    /// @brief Server side: map the authenticated GSS-EAP name to an iRODS user through the COL_USER_DN catalog entries
+    static irods::error gsseap_agent_dn_login(
+        irods::auth_plugin_context& _ctx,
+        const char* _client_name,
+        char* _rtn_user_type,
+        char* _rtn_user_zone ) {
+        irods::error result = SUCCESS();
+        irods::error ret;
+        int status;
+        genQueryInp_t genQueryInp;
+        genQueryOut_t *genQueryOut = NULL;
+        char condition1[MAX_NAME_LEN];
+        char condition2[MAX_NAME_LEN];
+        char *tResult;
+        int noNameMode;
+        gsseap_session_t* session = gsseap_session_get( _ctx.comm()->sock );
+
+        memset( &genQueryInp, 0, sizeof( genQueryInp_t ) );
+
+        noNameMode = 0;
+        if ( strlen( _ctx.comm()->clientUser.userName ) > 0 ) {
+            /* regular mode */
+
+            snprintf( condition1, MAX_NAME_LEN, "='%s'", _client_name );
+            addInxVal( &genQueryInp.sqlCondInp, COL_USER_DN, condition1 );
+
+            snprintf( condition2, MAX_NAME_LEN, "='%s'",
+                      _ctx.comm()->clientUser.userName );
+            addInxVal( &genQueryInp.sqlCondInp, COL_USER_NAME, condition2 );
+
+            addInxIval( &genQueryInp.selectInp, COL_USER_ID, 1 );
+            addInxIval( &genQueryInp.selectInp, COL_USER_TYPE, 1 );
+            addInxIval( &genQueryInp.selectInp, COL_USER_ZONE, 1 );
+
+            genQueryInp.maxRows = 2;
+
+            status = gsseap_agent_gen_query( _ctx.comm(), &genQueryInp, &genQueryOut );
+            clearGenQueryInp( &genQueryInp );
+        }
+        else {
+            /*
+              The client isn't providing the rodsUserName so query on just
+              the DN.  If it returns just one row, set the clientUser to
+              the returned irods user name.
+            */
+            noNameMode = 1;
+            memset( &genQueryInp, 0, sizeof( genQueryInp_t ) );
+
+            snprintf( condition1, MAX_NAME_LEN, "='%s'", _client_name );
+            addInxVal( &genQueryInp.sqlCondInp, COL_USER_DN, condition1 );
+
+            addInxIval( &genQueryInp.selectInp, COL_USER_ID, 1 );
+            addInxIval( &genQueryInp.selectInp, COL_USER_TYPE, 1 );
+            addInxIval( &genQueryInp.selectInp, COL_USER_NAME, 1 );
+            addInxIval( &genQueryInp.selectInp, COL_USER_ZONE, 1 );
+
+            genQueryInp.maxRows = 2;
+
+            status = gsseap_agent_gen_query( _ctx.comm(), &genQueryInp, &genQueryOut );
+            clearGenQueryInp( &genQueryInp );
+
+            if ( status == CAT_NO_ROWS_FOUND ) { /* not found */
+                /* execute the rule acGetUserByDN.  By default this
+                   is a no-op but at some sites can be configured to
+                   run a process to determine a user by DN (for VO support)
+                   or possibly create the user.
+                   The stdout of the process is the irodsUserName to use.
+
+                   The corresponding rule would be something like this:
+                   acGetUserByDN(*arg,*OUT)||msiExecCmd(t,"*arg",null,null,null,*OUT)|nop
+                */
+                ruleExecInfo_t rei;
+                const char *args[2];
+                msParamArray_t myMsParamArray;
+                msParamArray_t myInOutParamArray;
+
+                memset( ( char* )&rei, 0, sizeof( rei ) );
+                rei.rsComm = _ctx.comm();
+                rei.uoic = &_ctx.comm()->clientUser;
+                rei.uoip = &_ctx.comm()->proxyUser;
+                args[0] = _client_name;
+                char out[200] = "*cmdOutput";
+                args[1] = out;
+
+                memset( &myInOutParamArray, 0, sizeof( myInOutParamArray ) );
+                rei.inOutMsParamArray = myInOutParamArray;
+
+                memset( &myMsParamArray, 0, sizeof( myMsParamArray ) );
+
+                GSSEAP_PROBE( get_user_by_dn_entry, _ctx.comm()->sock, 0, 0 );
+                int statusRule = applyRuleArgPA( "acGetUserByDN", args, 2, &myMsParamArray, &rei, NO_SAVE_REI );
+                GSSEAP_PROBE( get_user_by_dn_return, _ctx.comm()->sock, 0, statusRule );
 
 #ifdef GSSEAP_DEBUG
-                            // printf( "acGetUserByDN status=%d\n", statusRule );
-
-                            int i;
-                            for ( i = 0; i < myMsParamArray->len; i++ ) {
-                                char *r;
-                                msParam_t *myP;
-                                myP = myMsParamArray->msParam[i];
-                                r = myP->label;
-                                printf( "l1=%s\n", r );
-                            }
+                // printf( "acGetUserByDN status=%d\n", statusRule );
+
+                int i;
+                for ( i = 0; i < myMsParamArray.len; i++ ) {
+                    char *r;
+                    msParam_t *myP;
+                    myP = myMsParamArray.msParam[i];
+                    r = myP->label;
+                    printf( "l1=%s\n", r );
+                }
 #endif
-                            /* Try the query again, whether or not the rule succeeded, to see
-                               if the user has been added. */
-                            memset( &genQueryInp, 0, sizeof( genQueryInp_t ) );
+                clearMsParamArray( &myMsParamArray, 1 );
 
-                            snprintf( condition1, MAX_NAME_LEN, "='%s'", clientName );
-                            addInxVal( &genQueryInp.sqlCondInp, COL_USER_DN, condition1 );
+                /* Try the query again, whether or not the rule succeeded, to see
+                   if the user has been added. */
+                freeGenQueryOut( &genQueryOut );
+                memset( &genQueryInp, 0, sizeof( genQueryInp_t ) );
 
-                            addInxIval( &genQueryInp.selectInp, COL_USER_ID, 1 );
-                            addInxIval( &genQueryInp.selectInp, COL_USER_TYPE, 1 );
-                            addInxIval( &genQueryInp.selectInp, COL_USER_NAME, 1 );
-                            addInxIval( &genQueryInp.selectInp, COL_USER_ZONE, 1 );
+                snprintf( condition1, MAX_NAME_LEN, "='%s'", _client_name );
+                addInxVal( &genQueryInp.sqlCondInp, COL_USER_DN, condition1 );
 
-                            genQueryInp.maxRows = 2;
+                addInxIval( &genQueryInp.selectInp, COL_USER_ID, 1 );
+                addInxIval( &genQueryInp.selectInp, COL_USER_TYPE, 1 );
+                addInxIval( &genQueryInp.selectInp, COL_USER_NAME, 1 );
+                addInxIval( &genQueryInp.selectInp, COL_USER_ZONE, 1 );
 
-                            status = rsGenQuery( _ctx.comm(), &genQueryInp, &genQueryOut );
-                        }
-                        if ( status == 0 ) {
-                            char *myBuf;
-                            strncpy( _ctx.comm()->clientUser.userName, genQueryOut->sqlResult[2].value,
-                                     NAME_LEN );
-                            strncpy( _ctx.comm()->proxyUser.userName, genQueryOut->sqlResult[2].value,
-                                     NAME_LEN );
-                            strncpy( _ctx.comm()->clientUser.rodsZone, genQueryOut->sqlResult[3].value,
-                                     NAME_LEN );
-                            strncpy( _ctx.comm()->proxyUser.rodsZone, genQueryOut->sqlResult[3].value,
-                                     NAME_LEN );
-                            myBuf = ( char * )malloc( NAME_LEN * 2 );
-                            snprintf( myBuf, NAME_LEN * 2, "%s=%s", SP_CLIENT_USER,
-                                      _ctx.comm()->clientUser.userName );
-                            putenv( myBuf );
-                            free( myBuf ); // JMC cppcheck - leak
-                        }
-                    }
-                    if ( !( result = ASSERT_ERROR( status != CAT_NO_ROWS_FOUND && genQueryOut != NULL, GSSEAP_DN_DOES_NOT_MATCH_USER,
-                                                   "DN mismatch, user=%s, Certificate DN: %s, status = %d.", _ctx.comm()->clientUser.userName,
-                                                   clientName, status ) ).ok() ) {
-                        rodsLog( LOG_NOTICE,
-                                 "igsseapServersideAuth: DN mismatch, user=%s, Certificate DN=%s, status=%d",
-                                 _ctx.comm()->clientUser.userName,
-                                 clientName,
-                                 status );
-                        snprintf( gsseapAuthReqErrorMsg, sizeof gsseapAuthReqErrorMsg,
-                                  "igsseapServersideAuth: DN mismatch, user=%s, Certificate DN=%s, status=%d",
-                                  _ctx.comm()->clientUser.userName,
-                                  clientName,
-                                  status );
-                        gsseapAuthReqError = status;
-                    }
+                genQueryInp.maxRows = 2;
 
-                    else if ( !( result = ASSERT_ERROR( status >= 0, status, "rsGenQuery failed, status = %d.", status ) ).ok() ) {
-                        rodsLog( LOG_NOTICE,
-                                 "igsseapServersideAuth: rsGenQuery failed, status = %d", status );
-                        snprintf( gsseapAuthReqErrorMsg, sizeof gsseapAuthReqErrorMsg,
-                                  "igsseapServersideAuth: rsGenQuery failed, status = %d", status );
-                        gsseapAuthReqError = status;
-                    }
+                status = gsseap_agent_gen_query( _ctx.comm(), &genQueryInp, &genQueryOut );
+                clearGenQueryInp( &genQueryInp );
+            }
+            if ( status == 0 ) {
+                strncpy( _ctx.comm()->clientUser.userName, genQueryOut->sqlResult[2].value,
+                         NAME_LEN );
+                strncpy( _ctx.comm()->proxyUser.userName, genQueryOut->sqlResult[2].value,
+                         NAME_LEN );
+                strncpy( _ctx.comm()->clientUser.rodsZone, genQueryOut->sqlResult[3].value,
+                         NAME_LEN );
+                strncpy( _ctx.comm()->proxyUser.rodsZone, genQueryOut->sqlResult[3].value,
+                         NAME_LEN );
+                /* putenv would keep a pointer to our buffer, setenv copies the value */
+                setenv( SP_CLIENT_USER, _ctx.comm()->clientUser.userName, 1 );
+            }
+        }
+        if ( !( result = ASSERT_ERROR( status != CAT_NO_ROWS_FOUND && genQueryOut != NULL, GSSEAP_DN_DOES_NOT_MATCH_USER,
+                                       "DN mismatch, user=%s, Certificate DN: %s, status = %d.", _ctx.comm()->clientUser.userName,
+                                       _client_name, status ) ).ok() ) {
+            rodsLog( gsseap_audit_log_level(),
+                     "igsseapServersideAuth: DN mismatch, user=%s, Certificate DN=%s, status=%d",
+                     _ctx.comm()->clientUser.userName,
+                     _client_name,
+                     status );
+            snprintf( session->auth_req_error_msg, sizeof session->auth_req_error_msg,
+                      "igsseapServersideAuth: DN mismatch, user=%s, Certificate DN=%s, status=%d",
+                      _ctx.comm()->clientUser.userName,
+                      _client_name,
+                      status );
+            session->auth_req_error = status;
+        }
 
-                    else {
+        else if ( !( result = ASSERT_ERROR( status >= 0, status, "rsGenQuery failed, status = %d.", status ) ).ok() ) {
+            rodsLog( gsseap_audit_log_level(),
+                     "igsseapServersideAuth: rsGenQuery failed, status = %d", status );
+            snprintf( session->auth_req_error_msg, sizeof session->auth_req_error_msg,
+                      "igsseapServersideAuth: rsGenQuery failed, status = %d", status );
+            session->auth_req_error = status;
+        }
 
-                        if ( noNameMode == 0 ) {
-                            if ( !( result = ASSERT_ERROR( genQueryOut != NULL && genQueryOut->rowCnt >= 1, GSSEAP_NO_MATCHING_DN_FOUND,
-                                                           "No matching user DN found." ) ).ok() ) {
-                                gsseapAuthReqError = GSSEAP_NO_MATCHING_DN_FOUND;
-                            }
-                            else if ( !( result = ASSERT_ERROR( genQueryOut->rowCnt == 1, GSSEAP_MULTIPLE_MATCHING_DN_FOUND,
-                                                                "Multiple matching user DN's found." ) ).ok() ) {
-                                gsseapAuthReqError = GSSEAP_MULTIPLE_MATCHING_DN_FOUND;
-                            }
-                            else if ( !( result = ASSERT_ERROR( genQueryOut->attriCnt == 3, GSSEAP_QUERY_INTERNAL_ERROR,
-                                                                "Wrong number of values returned from query: %u, expected 3.",
-                                                                genQueryOut->attriCnt ) ).ok() ) {
-                                gsseapAuthReqError = GSSEAP_QUERY_INTERNAL_ERROR;
-                            }
-                        }
-                        else {
-                            if ( !( result = ASSERT_ERROR( genQueryOut != NULL && genQueryOut->rowCnt >= 1, GSSEAP_NO_MATCHING_DN_FOUND,
-                                                           "No matching user DN found." ) ).ok() ) {
-                                gsseapAuthReqError = GSSEAP_NO_MATCHING_DN_FOUND;
-                            }
-                            else if ( !( result = ASSERT_ERROR( genQueryOut->rowCnt == 1, GSSEAP_MULTIPLE_MATCHING_DN_FOUND,
-                                                                "Multiple matching user DN's found." ) ).ok() ) {
-                                gsseapAuthReqError = GSSEAP_MULTIPLE_MATCHING_DN_FOUND;
-                            }
-                            else if ( !( result = ASSERT_ERROR( genQueryOut->attriCnt == 4, GSSEAP_QUERY_INTERNAL_ERROR,
-                                                                "Wrong number of values returned from query: %u, expected 4.",
-                                                                genQueryOut->attriCnt ) ).ok() ) {
-                                gsseapAuthReqError = GSSEAP_QUERY_INTERNAL_ERROR;
-                            }
-                        }
+        else {
 
-                        // trap errors that have occurred
-                        if ( result.ok() ) {
+            if ( noNameMode == 0 ) {
+                if ( !( result = ASSERT_ERROR( genQueryOut != NULL && genQueryOut->rowCnt >= 1, GSSEAP_NO_MATCHING_DN_FOUND,
+                                               "No matching user DN found." ) ).ok() ) {
+                    session->auth_req_error = GSSEAP_NO_MATCHING_DN_FOUND;
+                }
+                else if ( !( result = ASSERT_ERROR( genQueryOut->rowCnt == 1, GSSEAP_MULTIPLE_MATCHING_DN_FOUND,
+                                                    "Multiple matching user DN's found." ) ).ok() ) {
+                    session->auth_req_error = GSSEAP_MULTIPLE_MATCHING_DN_FOUND;
+                }
+                else if ( !( result = ASSERT_ERROR( genQueryOut->attriCnt == 3, GSSEAP_QUERY_INTERNAL_ERROR,
+                                                    "Wrong number of values returned from query: %u, expected 3.",
+                                                    genQueryOut->attriCnt ) ).ok() ) {
+                    session->auth_req_error = GSSEAP_QUERY_INTERNAL_ERROR;
+                }
+            }
+            else {
+                if ( !( result = ASSERT_ERROR( genQueryOut != NULL && genQueryOut->rowCnt >= 1, GSSEAP_NO_MATCHING_DN_FOUND,
+                                               "No matching user DN found." ) ).ok() ) {
+                    session->auth_req_error = GSSEAP_NO_MATCHING_DN_FOUND;
+                }
+                else if ( !( result = ASSERT_ERROR( genQueryOut->rowCnt == 1, GSSEAP_MULTIPLE_MATCHING_DN_FOUND,
+                                                    "Multiple matching user DN's found." ) ).ok() ) {
+                    session->auth_req_error = GSSEAP_MULTIPLE_MATCHING_DN_FOUND;
+                }
+                else if ( !( result = ASSERT_ERROR( genQueryOut->attriCnt == 4, GSSEAP_QUERY_INTERNAL_ERROR,
+                                                    "Wrong number of values returned from query: %u, expected 4.",
+                                                    genQueryOut->attriCnt ) ).ok() ) {
+                    session->auth_req_error = GSSEAP_QUERY_INTERNAL_ERROR;
+                }
+            }
+
+            // trap errors that have occurred
+            if ( result.ok() ) {
 #ifdef GSSEAP_DEBUG
-                            printf( "Results=%d\n", genQueryOut->rowCnt );
+                printf( "Results=%d\n", genQueryOut->rowCnt );
 #endif
 
-                            tResult = genQueryOut->sqlResult[0].value;
+                tResult = genQueryOut->sqlResult[0].value;
 #ifdef GSSEAP_DEBUG
-                            printf( "0:%s\n", tResult );
+                printf( "0:%s\n", tResult );
 #endif
-                            tResult = genQueryOut->sqlResult[1].value;
+                tResult = genQueryOut->sqlResult[1].value;
 #ifdef GSSEAP_DEBUG
-                            printf( "1:%s\n", tResult );
+                printf( "1:%s\n", tResult );
 #endif
-                            privLevel = LOCAL_USER_AUTH;
-                            clientPrivLevel = LOCAL_USER_AUTH;
+                strncpy( _rtn_user_type, tResult, NAME_LEN );
+                strncpy( _rtn_user_zone, genQueryOut->sqlResult[noNameMode ? 3 : 2].value, NAME_LEN );
 
-                            if ( strcmp( tResult, "rodsadmin" ) == 0 ) {
-                                privLevel = LOCAL_PRIV_USER_AUTH;
-                                clientPrivLevel = LOCAL_PRIV_USER_AUTH;
-                            }
+                ret = gsseap_agent_authorize( _ctx, tResult, noNameMode );
+                result = ASSERT_PASS( ret, "Failed authorizing GSSEAP client." );
+            } // (result.ok()) {
+        } // if ((result = ASSERT_ERROR(status >= 0, status, "rsGenQuery failed, status = %d.", status )).ok()) {
 
-                            status = chkProxyUserPriv( _ctx.comm(), privLevel );
-                            if ( ( result = ASSERT_ERROR( status >= 0, status, "Failed checking proxy user priviledges." ) ).ok() ) {
+        freeGenQueryOut( &genQueryOut );
+        return result;
+    }
 
-                                _ctx.comm()->proxyUser.authInfo.authFlag = privLevel;
-                                _ctx.comm()->clientUser.authInfo.authFlag = clientPrivLevel;
-                                
-                                // Reset the auth scheme here so we do not try to authenticate again unless the client requests it.
-                                if ( _ctx.comm()->auth_scheme != NULL ) {
-                                    free( _ctx.comm()->auth_scheme );
-                                }
-                                _ctx.comm()->auth_scheme = NULL;
-
-                                if ( noNameMode ) { /* We didn't before, but now have an irodsUserName */
-                                    int status2, status3;
-                                    rodsServerHost_t *rodsServerHost = NULL;
-                                    status2 = getAndConnRcatHost( _ctx.comm(), MASTER_RCAT,
-                                                                  _ctx.comm()->myEnv.rodsZone, &rodsServerHost );
-                                    if ( status2 >= 0 &&
-                                            rodsServerHost->localFlag == REMOTE_HOST &&
-                                            rodsServerHost->conn != NULL ) {  /* If the IES is remote */
-
-                                        status3 = rcDisconnect( rodsServerHost->conn ); /* disconnect*/
-
-                                        /* And clear out the connection information so
-                                           getAndConnRcatHost will reconnect.  This may leak some
-                                           memory but only happens at most once in an agent:  */
-                                        rodsServerHost->conn = NULL;
-                                        
-					/* And reconnect (with irodsUserName here and in the IES): */
-                                        status3 = getAndConnRcatHost( _ctx.comm(), MASTER_RCAT,
-                                                                      _ctx.comm()->myEnv.rodsZone,
-                                                                      &rodsServerHost );
-                                        if ( !( result = ASSERT_ERROR( status3 == 0, status3,
-                                                                       " GSSEAP server side auth failed in connecting to Rcat host, status = %d.",
-                                                                       status3 ) ).ok() ) {
-                                            rodsLog( LOG_ERROR,
-                                                     "igsseapServersideAuth failed in getAndConnRcatHost, status = %d",
-                                                     status3 );
-                                        }
-                                    }
-                                }
+    static void gsseap_binding_cache_open() {
+        gsseapBindingCache = gsseap_shm_table_open( "bindings", gsseapBindingCacheEntries );
+    }
+
+    /// @brief Server side: seconds the binding cache keeps a mapped user, at most gsseapBindingCacheMaxTTL; 0 if it is off
+    static long gsseap_binding_cache_ttl() {
+        long ttl = gsseap_env_long( "GSSEAP_BINDING_CACHE_TTL", gsseapBindingCacheDefaultTTL );
+        if ( ttl <= 0 ) {
+            return 0;
+        }
+        pthread_once( &gsseapBindingCacheOnce, gsseap_binding_cache_open );
+        return ttl < gsseapBindingCacheMaxTTL ? ttl : gsseapBindingCacheMaxTTL;
+    }
+
+    /// @brief Server side: fetch the type of a mapped user, from the shared binding cache or the catalog
+    static irods::error gsseap_agent_lookup_user_type(
+        irods::auth_plugin_context& _ctx,
+        const char* _user_name,
+        const char* _user_zone,
+        char* _rtn_user_type ) {
+        irods::error result = SUCCESS();
+        int status;
+        genQueryInp_t genQueryInp;
+        genQueryOut_t *genQueryOut = NULL;
+        char condition1[MAX_NAME_LEN];
+        char condition2[MAX_NAME_LEN];
+        std::string key = std::string( _user_name ) + "#" + _user_zone;
+        std::string value;
+
+        long ttl = gsseap_binding_cache_ttl();
+        if ( ttl > 0 && gsseap_shm_table_get( gsseapBindingCache, key, value ) ) {
+            strncpy( _rtn_user_type, value.c_str(), NAME_LEN );
+            return result;
+        }
+
+        memset( &genQueryInp, 0, sizeof( genQueryInp_t ) );
+        snprintf( condition1, MAX_NAME_LEN, "='%s'", _user_name );
+        addInxVal( &genQueryInp.sqlCondInp, COL_USER_NAME, condition1 );
+        snprintf( condition2, MAX_NAME_LEN, "='%s'", _user_zone );
+        addInxVal( &genQueryInp.sqlCondInp, COL_USER_ZONE, condition2 );
+        addInxIval( &genQueryInp.selectInp, COL_USER_TYPE, 1 );
+        genQueryInp.maxRows = 2;
+
+        status = gsseap_agent_gen_query( _ctx.comm(), &genQueryInp, &genQueryOut );
+        if ( ( result = ASSERT_ERROR( status >= 0 && genQueryOut != NULL && genQueryOut->rowCnt == 1,
+                                      status < 0 ? status : GSSEAP_NO_MATCHING_DN_FOUND,
+                                      "No unique iRODS user %s#%s, status = %d.", _user_name, _user_zone, status ) ).ok() ) {
+            strncpy( _rtn_user_type, genQueryOut->sqlResult[0].value, NAME_LEN );
+            if ( ttl > 0 ) {
+                gsseap_shm_table_put( gsseapBindingCache, key, _rtn_user_type, ttl );
+            }
+        }
+
+        clearGenQueryInp( &genQueryInp );
+        freeGenQueryOut( &genQueryOut );
+
+        return result;
+    }
+
+    /// @brief Server side: drop the binding cache entry of the proxy user when the catalog check of the auth response failed
+    /// or disagrees with it about rodsadmin privileges; only mapped logins look their user up in the cache
+    static void gsseap_agent_check_binding(
+        rsComm_t* _comm,
+        const gsseap_session_t* _session,
+        int _status,
+        int _priv_level ) {
+        std::string key = std::string( _comm->proxyUser.userName ) + "#" + _comm->proxyUser.rodsZone;
+        std::string value;
+
+        bool mapped = _session->login_path != NULL &&
+                      ( strcmp( _session->login_path, "attributes" ) == 0 || strcmp( _session->login_path, "rules" ) == 0 );
+        if ( !mapped || gsseap_binding_cache_ttl() == 0 || !gsseap_shm_table_get( gsseapBindingCache, key, value ) ) {
+            return;
+        }
+        bool admin = _priv_level == LOCAL_PRIV_USER_AUTH || _priv_level == REMOTE_PRIV_USER_AUTH;
+        if ( _status < 0 || admin != ( value == "rodsadmin" ) ) {
+            rodsLog( LOG_NOTICE, "gsseap_agent_check_binding: %s is no longer a %s, dropping it from the binding cache",
+                     key.c_str(), value.c_str() );
+            gsseap_shm_table_remove( gsseapBindingCache, key );
+        }
+    }
+
+    /// @brief Server side: log the client in as the identity asserted by its GSS-EAP name
+    static irods::error gsseap_agent_mapped_login(
+        irods::auth_plugin_context& _ctx,
+        const char* _client_name,
+        const gsseap_mapped_identity_t* _identity,
+        char* _rtn_user_type,
+        char* _rtn_user_zone ) {
+        irods::error result = SUCCESS();
+        irods::error ret;
+        rsComm_t* comm = _ctx.comm();
+        gsseap_session_t* session = gsseap_session_get( comm->sock );
+        int noNameMode = strlen( comm->clientUser.userName ) == 0;
+
+        if ( _identity->zone_name[0] != '\0' ) {
+            strncpy( _rtn_user_zone, _identity->zone_name, NAME_LEN );
+        }
+        else if ( strlen( comm->clientUser.rodsZone ) > 0 ) {
+            strncpy( _rtn_user_zone, comm->clientUser.rodsZone, NAME_LEN );
+        }
+        else {
+            strncpy( _rtn_user_zone, comm->myEnv.rodsZone, NAME_LEN );
+        }
+
+        if ( !( result = ASSERT_ERROR( noNameMode || strcmp( comm->clientUser.userName, _identity->user_name ) == 0,
+                                       GSSEAP_DN_DOES_NOT_MATCH_USER, "Name mismatch, user=%s, %s maps %s to %s.",
+                                       comm->clientUser.userName, _identity->source, _client_name, _identity->user_name ) ).ok() ) {
+            rodsLog( gsseap_audit_log_level(),
+                     "igsseapServersideAuth: name mismatch, user=%s, %s maps %s to %s",
+                     comm->clientUser.userName, _identity->source, _client_name, _identity->user_name );
+            snprintf( session->auth_req_error_msg, sizeof session->auth_req_error_msg,
+                      "igsseapServersideAuth: name mismatch, user=%s, %s maps %s to %s",
+                      comm->clientUser.userName, _identity->source, _client_name, _identity->user_name );
+            session->auth_req_error = GSSEAP_DN_DOES_NOT_MATCH_USER;
+            return result;
+        }
+
+        ret = gsseap_agent_lookup_user_type( _ctx, _identity->user_name, _rtn_user_zone, _rtn_user_type );
+        if ( !( result = ASSERT_PASS( ret, "Mapped GSSEAP identity is not an iRODS user." ) ).ok() ) {
+            snprintf( session->auth_req_error_msg, sizeof session->auth_req_error_msg,
+                      "igsseapServersideAuth: %s maps %s to unknown user %s#%s",
+                      _identity->source, _client_name, _identity->user_name, _rtn_user_zone );
+            session->auth_req_error = ret.code();
+            return result;
+        }
+
+        if ( strcmp( _rtn_user_type, "rodsadmin" ) == 0 && !_identity->admin_allowed ) {
+            rodsLog( LOG_NOTICE, "igsseapServersideAuth: %s is not entitled to rodsadmin privileges, logging in as rodsuser",
+                     _client_name );
+            strncpy( _rtn_user_type, "rodsuser", NAME_LEN );
+        }
+
+        if ( noNameMode ) {
+            strncpy( comm->clientUser.userName, _identity->user_name, NAME_LEN );
+            strncpy( comm->proxyUser.userName, _identity->user_name, NAME_LEN );
+            strncpy( comm->clientUser.rodsZone, _rtn_user_zone, NAME_LEN );
+            strncpy( comm->proxyUser.rodsZone, _rtn_user_zone, NAME_LEN );
+            setenv( SP_CLIENT_USER, comm->clientUser.userName, 1 );
+        }
+
+        ret = gsseap_agent_authorize( _ctx, _rtn_user_type, noNameMode );
+        return ASSERT_PASS( ret, "Failed authorizing GSSEAP client." );
+    }
+
+    /// @brief Setup auth object with relevant information
+    GSSEAP_EXPORT irods::error gsseap_auth_agent_start(
+        irods::auth_plugin_context& _ctx,
+        const char* _context ) {
+        irods::error result = SUCCESS();
+        irods::error ret;
+
+        // whatever happens, the handshake slot taken by the auth request is given back
+        gsseap_admission_guard admission;
+        
+        ret = _ctx.valid<irods::gsseap_auth_object>();
+        if ( ( result = ASSERT_PASS( ret, "Invalid plugin context" ) ).ok() ) {
+
+                irods::gsseap_auth_object_ptr ptr = boost::dynamic_pointer_cast<irods::gsseap_auth_object>( _ctx.fco() );
+                gsseap_session_t* session = gsseap_session_get( _ctx.comm()->sock );
+                char* clientName = session->client_name;
+                gsseap_mapped_identity_t mappedIdentity;
+                char userType[NAME_LEN];
+                char userZone[NAME_LEN];
+
+                session->auth_req_status = 1;
+                session->auth_req_error = 0;
+                session->auth_req_error_msg[0] = '\0';
+
+                if ( session->ticket_presented ) {
+                    /* a valid session ticket and proof of its key stand in for the GSS-EAP exchange and the DN lookup */
+                    session->login_path = "ticket";
+                    snprintf( clientName, GSSEAP_CLIENT_NAME_SIZE, "%s", session->ticket.client_name.c_str() );
+                    ret = gsseap_agent_ticket_proof( session );
+                    if ( ret.ok() ) {
+                        ret = gsseap_agent_ticket_login( _ctx );
+                    }
+                    if ( !( result = ASSERT_PASS( ret, "Session ticket login failed." ) ).ok() ) {
+                        snprintf( session->auth_req_error_msg, sizeof session->auth_req_error_msg,
+                                  "igsseapServersideAuth: session ticket login failed for user=%s, status=%d",
+                                  session->ticket.user_name.c_str(), ret.code() );
+                        session->auth_req_error = ret.code();
+                        gsseap_agent_login_done( _ctx, session, NULL, result.code() );
+                    }
+                    return result;
+                }
+
+                userType[0] = '\0';
+                userZone[0] = '\0';
+                memset( &mappedIdentity, 0, sizeof( mappedIdentity ) );
 
-                            } // if ((result = ASSERT_ERROR(status >= 0, status, "Failed checking proxy user priviledges." )).ok()) {
-                        } // (result.ok()) {
-                    } // if ((result = ASSERT_ERROR(status >= 0, status, "rsGenQuery failed, status = %d.", status )).ok()) {
+                /*
+                  On a consumer the first catalog query logs in to the provider, so the handshake logs in while
+                  it waits for the client's next token, see gsseap_agent_preconnect.  Without a user name the
+                  connection would be for the wrong client, and a gateway's connection changes users once the
+                  end user is known; both connect afterwards.
+                */
+                session->catalog_preconnect = gsseap_env_long( "GSSEAP_CATALOG_PRECONNECT", 0 ) != 0 &&
+                                              _ctx.comm()->clientUser.userName[0] != '\0' && !session->gateway;
+
+                // iRODS hands agent_start an auth object of its own, without the credential of the auth request
+                ret = gsseap_setup_creds( ptr );
+                if ( ret.ok() ) {
+                    ret = gsseap_establish_context_serverside( _ctx, clientName, GSSEAP_CLIENT_NAME_SIZE, &mappedIdentity );
+                }
+                session->catalog_preconnect = 0;
+                if ( ( result = ASSERT_PASS( ret, "Failed to establish server side context." ) ).ok() ) {
+                    struct timeval mapStart;
+                    gettimeofday( &mapStart, NULL );
+
+                    if ( igsseapDebugFlag > 0 ) {
+                        fprintf( stderr, "clientName:%s\n", clientName );
+                    }
+
+                    /* a name that recently failed to map is refused without touching the catalog */
+                    std::string nameKey = gsseap_agent_name_key( _ctx, clientName );
+                    int cachedError;
+                    if ( gsseap_failure_backoff( nameKey, cachedError ) ) {
+                        snprintf( session->auth_req_error_msg, sizeof session->auth_req_error_msg,
+                                  "igsseapServersideAuth: %s recently failed to map to user=%s, backing off",
+                                  clientName, _ctx.comm()->clientUser.userName );
+                        session->auth_req_error = cachedError;
+                        ret = ERROR( cachedError, session->auth_req_error_msg );
+                    }
+                    else {
+                        session->login_path = "attributes";
+                        if ( mappedIdentity.user_name[0] == '\0' ) {
+                            session->login_path = "rules";
+                            gsseap_map_name_rules( clientName, &mappedIdentity );
+                        }
+
+                        if ( mappedIdentity.user_name[0] != '\0' ) {
+                            ret = gsseap_agent_mapped_login( _ctx, clientName, &mappedIdentity, userType, userZone );
+                        }
+                        else {
+                            session->login_path = "dn";
+                            ret = gsseap_agent_dn_login( _ctx, clientName, userType, userZone );
+                        }
+
+                        if ( ret.ok() ) {
+                            gsseap_failure_clear( nameKey );
+                        }
+                        else if ( ret.code() == GSSEAP_DN_DOES_NOT_MATCH_USER || ret.code() == GSSEAP_NO_MATCHING_DN_FOUND ) {
+                            gsseap_failure_record( nameKey, ret.code() );
+                        }
+                    }
+                    result = ASSERT_PASS( ret, "Failed mapping GSSEAP client to an iRODS user." );
+                    session->map_us = gsseap_stats_elapsed_us( &mapStart );
+
+                    if ( session->ticket_requested ) {
+                        ret = gsseap_agent_send_ticket( _ctx, clientName, userType, userZone, result.ok() );
+                        if ( !ret.ok() ) {
+                            irods::log( PASS( ret ) );
+                        }
+                    }
                 } // if((result = ASSERT_PASS(ret, "Failed to establish server side context.")).ok()) {
 
+                // the gateway goes back to being the proxy of its connection, and must be allowed to act for the end user
+                if ( session->gateway && result.ok() ) {
+                    _ctx.comm()->proxyUser = session->gateway_proxy;
+                    ret = check_proxy_user_privileges( _ctx.comm(), _ctx.comm()->proxyUser.authInfo.authFlag );
+                    result = ASSERT_PASS( ret, "GSSEAP gateway may not act for this user." );
+                }
+
+                // a failed login ends here, the client does not go on to the auth response
+                if ( !result.ok() ) {
+                    gsseap_agent_login_done( _ctx, session, &session->handshake, result.code() );
+                }
+
+                // neither does a gateway, which asks for the outcome with its next auth request
+                if ( session->gateway ) {
+                    if ( result.ok() ) {
+                        session->gateway = 0;
+                        gsseap_agent_login_done( _ctx, session, &session->handshake, result.code() );
+                    }
+                    else {
+                        if ( session->auth_req_error == 0 ) {
+                            snprintf( session->auth_req_error_msg, sizeof session->auth_req_error_msg,
+                                      "igsseapServersideAuth: gateway login failed, status=%d", result.code() );
+                            session->auth_req_error = result.code();
+                        }
+                        gsseap_agent_gateway_restore( _ctx.comm(), session );
+                    }
+                }
+
         } // if ( ( result = ASSERT_PASS( ret, "Invalid plugin context" ) ).ok() ) {
 
         return result;
     }
+#endif
 
-    irods::error gsseap_auth_client_request(
+    GSSEAP_EXPORT irods::error gsseap_auth_client_request(
         irods::auth_plugin_context& _ctx,
         rcComm_t* _comm ) {
         irods::error result = SUCCESS();
@@ -1139,18 +2660,64 @@ extern "C" {
             // =-=-=-=-=-=-=-
             // get the auth object
             irods::gsseap_auth_object_ptr ptr = boost::dynamic_pointer_cast <irods::gsseap_auth_object > ( _ctx.fco() );
+            gsseap_session_t* session = gsseap_session_get( _comm->sock );
 
             // =-=-=-=-=-=-=-
-            // get the context string
-            std::string context = ptr->context( );
+            // get the context string, sized once for everything appended below
+            std::string context;
+            context.reserve( MAX_NAME_LEN + 1 );
+            context = ptr->context( );
 	    
             // =-=-=-=-=-=-=-
             // append the auth scheme and user name
             context += irods::kvp_delimiter() + irods::AUTH_USER_KEY + irods::kvp_association() + ptr->user_name();
 
             // =-=-=-=-=-=-=-
-            // error check string size against MAX_NAME_LEN
-            if ( ( result = ASSERT_ERROR( context.size() <= MAX_NAME_LEN, SYS_INVALID_INPUT_PARAM, "context string > max name len" ) ).ok() ) {
+            // learn what the server supports, once per server
+            bool use_tickets = gsseap_env_long( "GSSEAP_USE_TICKETS", 0 ) != 0;
+            bool short_handshake = false;
+            std::string capabilities;
+            if ( GSSEAP_PROBE_SUPPORTED && gsseap_env_long( "GSSEAP_PROBE", 1 ) != 0 && gsseap_client_capabilities( _comm, capabilities ) ) {
+                irods::kvp_map_t cap_kvp;
+                irods::parse_kvp_string( capabilities, cap_kvp );
+                session->server_dn = cap_kvp[GSSEAP_CAP_ACCEPTOR];
+                session->server_mechs = cap_kvp[GSSEAP_CAP_ACCEPT];
+                if ( cap_kvp[GSSEAP_CAP_TICKETS] != "1" ) {
+                    use_tickets = false;
+                }
+                short_handshake = cap_kvp[GSSEAP_CAP_SHORT_HANDSHAKE] == "1" && gsseap_env_long( "GSSEAP_SHORT_HANDSHAKE", 1 ) != 0;
+            }
+
+            // =-=-=-=-=-=-=-
+            // present a cached session ticket for this server and user,
+            // or ask the server to issue one after the handshake
+            std::string ticket;
+            if ( use_tickets ) {
+                char port[16];
+                snprintf( port, sizeof( port ), "%d", _comm->portNum );
+                session->ticket_cache_key = std::string( _comm->host ) + ":" + port + "/" + ptr->user_name() + "#" + ptr->zone_name();
+
+                std::string ticket_kvp = irods::kvp_delimiter() + GSSEAP_TICKET_KEY + irods::kvp_association();
+                if ( gsseap_ticket_cache_get( session->ticket_cache_key, ticket, session->ticket_key ) &&
+                        context.size() + ticket_kvp.size() + ticket.size() < MAX_NAME_LEN ) {
+                    context += ticket_kvp + ticket;
+                }
+                else {
+                    ticket.clear();
+                    context += irods::kvp_delimiter() + GSSEAP_TICKET_REQUEST_KEY + irods::kvp_association() + "1";
+                }
+            }
+
+            // =-=-=-=-=-=-=-
+            // start the handshake right away and send its first token along, unless a ticket should make it unnecessary
+            session->short_handshake = 0;
+            if ( short_handshake && ticket.empty() ) {
+                gsseap_client_short_handshake( ptr, session, context );
+            }
+
+            // =-=-=-=-=-=-=-
+            // error check string size against MAX_NAME_LEN, which includes the terminating nul
+            if ( ( result = ASSERT_ERROR( context.size() < MAX_NAME_LEN, SYS_INVALID_INPUT_PARAM, "context string >= max name len" ) ).ok() ) {
 
                 // =-=-=-=-=-=-=-
                 // copy the context to the req in struct
@@ -1175,51 +2742,263 @@ extern "C" {
                     // and cache the result in our auth object
                     ptr->request_result( req_out->result_ );
                     free( req_out );
+
+                    // =-=-=-=-=-=-=-
+                    // drop a ticket the server would not honour
+                    if ( !ticket.empty() && ptr->request_result().find( GSSEAP_TICKET_CHALLENGE_KEY ) == std::string::npos ) {
+                        gsseap_ticket_cache_remove( session->ticket_cache_key );
+                    }
                 }
             }
+
+            // =-=-=-=-=-=-=-
+            // the login ends here, along with the context of a short handshake
+            if ( !result.ok() ) {
+                gsseap_session_end( _comm->sock );
+            }
         }
         return result;
     }
 
-    irods::error gsseap_auth_agent_request(
+#if !defined(RODS_SERVER)
+    /// @brief Gateway side: send the auth plugin request of a gateway login, _context is the kvp string to send
+    static int gsseap_gateway_request(
+        rcComm_t* _conn,
+        const std::string& _context,
+        irods::kvp_map_t& _rtn_kvp ) {
+        authPluginReqInp_t req_in;
+        authPluginReqOut_t* req_out = 0;
+
+        if ( _context.size() >= sizeof( req_in.context_ ) ) {
+            return SYS_INVALID_INPUT_PARAM;
+        }
+        strncpy( req_in.context_, _context.c_str(), _context.size() + 1 );
+        strncpy( req_in.auth_scheme_, irods::AUTH_GSSEAP_SCHEME.c_str(), irods::AUTH_GSSEAP_SCHEME.size() + 1 );
+        int status = rcAuthPluginRequest( _conn, &req_in, &req_out );
+        if ( status >= 0 ) {
+            irods::parse_kvp_string( req_out->result_, _rtn_kvp );
+            free( req_out );
+        }
+        return status;
+    }
+
+    int gsseap_gateway_login(
+        rcComm_t* _conn,
+        const char* _user_name,
+        const char* _zone_name,
+        gsseap_gateway_relay_t _relay,
+        void* _arg ) {
+        irods::error result = SUCCESS();
+        irods::error ret;
+        irods::kvp_map_t req_kvp;
+        void* token = NULL;
+        size_t length = 0;
+        bool requested = false;
+
+        if ( _conn == NULL || _relay == NULL ) {
+            return SYS_INVALID_INPUT_PARAM;
+        }
+        gsseap_session_t* session = gsseap_session_begin( _conn->sock, _conn->rError );
+        gsseap_session_reserve_scratch( session );
+        gsseap_handshake_begin( &session->handshake );
+
+        std::string context = GSSEAP_GATEWAY_KEY + irods::kvp_association() + "1" +
+                              irods::kvp_delimiter() + GSSEAP_GATEWAY_USER_KEY + irods::kvp_association() + ( _user_name != NULL ? _user_name : "" ) +
+                              irods::kvp_delimiter() + GSSEAP_GATEWAY_ZONE_KEY + irods::kvp_association() + ( _zone_name != NULL ? _zone_name : "" );
+
+        // the end user's first token goes along with the auth request if it fits, as in a short handshake
+        int more = _relay( _arg, NULL, 0, &token, &length );
+        result = ASSERT_ERROR( more >= 0, more < 0 ? more : 0, "GSSEAP gateway relay failed." );
+        bool sent = false;
+        if ( result.ok() && gsseap_env_long( "GSSEAP_SHORT_HANDSHAKE", 1 ) != 0 ) {
+            std::string token_kvp = irods::kvp_delimiter() + GSSEAP_TOKEN_KEY + irods::kvp_association() +
+                                    gsseap_base64url_encode( ( const unsigned char* ) token, length );
+            if ( context.size() + token_kvp.size() < MAX_NAME_LEN ) {
+                context += token_kvp;
+                sent = true;
+            }
+        }
+        if ( result.ok() ) {
+            int status = gsseap_gateway_request( _conn, context, req_kvp );
+            result = ASSERT_ERROR( status >= 0, status, "GSSEAP gateway auth request failed." );
+            requested = result.ok();
+        }
+        if ( result.ok() && !req_kvp.count( GSSEAP_REPLY_KEY ) && !req_kvp.count( GSSEAP_REPLY_FOLLOWS_KEY ) ) {
+            sent = false;
+        }
+
+        // relay tokens until the end user's context is complete, the server answers a refusal with an empty token
+        bool first = sent;
+        while ( result.ok() ) {
+            if ( !sent ) {
+                gss_buffer_desc send_tok;
+                send_tok.value = token;
+                send_tok.length = length;
+                ret = gsseap_send_token( session, &send_tok );
+                result = ASSERT_PASS( ret, "Failed sending GSSEAP token." );
+            }
+            free( token );
+            token = NULL;
+            sent = false;
+            if ( !result.ok() || more == 0 ) {
+                break;
+            }
+
+            gss_buffer_desc recv_tok;
+            if ( first ) {
+                ret = gsseap_client_short_reply( session, req_kvp, &recv_tok );
+                first = false;
+            }
+            else {
+                unsigned int bytes_read;
+                recv_tok.value = session->scratch;
+                recv_tok.length = session->scratch_size;
+                ret = gsseap_receive_token( session, &recv_tok, &bytes_read );
+            }
+            if ( ( result = ASSERT_PASS( ret, "Error reading GSSEAP token." ) ).ok() ) {
+                result = ASSERT_ERROR( recv_tok.length != 0, GSSEAP_ACCEPT_SEC_CONTEXT_ERROR, "GSSEAP gateway login refused." );
+            }
+            if ( result.ok() ) {
+                more = _relay( _arg, recv_tok.value, recv_tok.length, &token, &length );
+                if ( !( result = ASSERT_ERROR( more >= 0, more < 0 ? more : 0, "GSSEAP gateway relay failed." ) ).ok() ) {
+                    // give the server an empty token to refuse, and read its refusal, so the connection stays in step
+                    gss_buffer_desc empty = GSS_C_EMPTY_BUFFER;
+                    unsigned int bytes_read;
+                    if ( gsseap_send_token( session, &empty ).ok() ) {
+                        recv_tok.value = session->scratch;
+                        recv_tok.length = session->scratch_size;
+                        ( void ) gsseap_receive_token( session, &recv_tok, &bytes_read );
+                    }
+                }
+            }
+        }
+        free( token );
+        gsseap_handshake_end( &session->handshake, "gateway", result.code() );
+        gsseap_session_release_scratch( session );
+
+        // the outcome, mapping included, comes with the next auth request; a failed request made no login to ask about
+        if ( requested ) {
+            irods::kvp_map_t status_kvp;
+            int status = gsseap_gateway_request( _conn, GSSEAP_GATEWAY_STATUS_KEY + irods::kvp_association() + "1", status_kvp );
+            if ( result.ok() ) {
+                result = ASSERT_ERROR( status >= 0, status, "GSSEAP gateway login failed." );
+            }
+            if ( result.ok() ) {
+                std::string user = status_kvp[GSSEAP_GATEWAY_STATUS_KEY];
+                size_t hash = user.find( '#' );
+                snprintf( _conn->clientUser.userName, NAME_LEN, "%s", user.substr( 0, hash ).c_str() );
+                snprintf( _conn->clientUser.rodsZone, NAME_LEN, "%s",
+                          hash == std::string::npos ? "" : user.substr( hash + 1 ).c_str() );
+            }
+        }
+        return result.code();
+    }
+#else
+    GSSEAP_EXPORT irods::error gsseap_auth_agent_request(
         irods::auth_plugin_context& _ctx ) {
         irods::error result = SUCCESS();
         irods::error ret;
+
+        // a handshake slot taken below is only kept if agent_start is going to run the handshake
+        gsseap_admission_guard admission;
         
         // validate incoming parameters
         ret = _ctx.valid<irods::gsseap_auth_object>();
         if ( ( result = ASSERT_PASS( ret, "Invalid plugin context." ) ).ok() ) {
             if ( ( result = ASSERT_ERROR( _ctx.comm(), SYS_INVALID_INPUT_PARAM, "Null comm pointer." ) ).ok() ) {
+                gsseap_session_t* session = gsseap_session_get( _ctx.comm()->sock );
 
-                if ( gsseapAuthReqStatus == 1 ) {
-                    gsseapAuthReqStatus = 0;
-                    if ( !( result = ASSERT_ERROR( gsseapAuthReqError == 0, gsseapAuthReqError,
+                if ( session->auth_req_status == 1 ) {
+                    session->auth_req_status = 0;
+                    if ( !( result = ASSERT_ERROR( session->auth_req_error == 0, session->auth_req_error,
                                                    "A GSSEAP auth request error has occurred." ) ).ok() ) {
-                        rodsLogAndErrorMsg( LOG_NOTICE, &_ctx.comm()->rError, gsseapAuthReqError,
-                                            gsseapAuthReqErrorMsg );
+                        rodsLogAndErrorMsg( LOG_NOTICE, &_ctx.comm()->rError, session->auth_req_error,
+                                            session->auth_req_error_msg );
                     }
                 }
 
+                irods::gsseap_auth_object_ptr ptr = boost::dynamic_pointer_cast<irods::gsseap_auth_object>( _ctx.fco() );
+                irods::kvp_map_t req_kvp;
+                irods::parse_kvp_string( ptr->context(), req_kvp );
+
+                // a gateway asking how the login of its end user ended, a failure was reported just above
+                if ( result.ok() && req_kvp.count( GSSEAP_GATEWAY_STATUS_KEY ) ) {
+                    irods::kvp_map_t out;
+                    out[GSSEAP_GATEWAY_STATUS_KEY] = std::string( _ctx.comm()->clientUser.userName ) + "#" + _ctx.comm()->clientUser.rodsZone;
+                    ptr->request_result( irods::kvp_string( out ) );
+                    return result;
+                }
+
                 if ( result.ok() ) {
-                    irods::gsseap_auth_object_ptr ptr = boost::dynamic_pointer_cast<irods::gsseap_auth_object>( _ctx.fco() );
+                    gsseap_session_reserve_scratch( session );
+                    gsseap_stats_begin( &session->login_start );
+                    session->login_path = NULL;
+                    session->map_us = 0;
+                    session->client_name[0] = '\0';
+                    session->aaa_realm.clear();
+                    session->aaa_answered = 0;
+
 		    if ( ( result = ASSERT_PASS( ret, "Failed to fetch Moonshot name from server config." ) ).ok() ) {
-                    
-                        ret = gsseap_setup_creds( ptr );
-                        if ( ( result = ASSERT_PASS( ret, "Setting up GSSEAP credentials failed." ) ).ok() ) {
+
+                        // an end user logging in over a gateway's connection
+                        session->gateway = 0;
+                        if ( req_kvp.count( GSSEAP_GATEWAY_KEY ) ) {
+                            ret = gsseap_agent_gateway_allowed( _ctx.comm() );
+                            if ( ( result = ASSERT_PASS( ret, "GSSEAP gateway login refused." ) ).ok() ) {
+                                gsseap_agent_gateway_begin( _ctx.comm(), session, req_kvp );
+                            }
+                        }
+
+                        std::string req_result;
+                        gsseap_agent_check_ticket( _ctx, ptr->context(), req_result );
+
+                        // a session ticket replaces the handshake, so the acceptor credentials are not needed
+                        if ( result.ok() && !session->ticket_presented ) {
+                            GSSEAP_PROBE( setup_creds_entry, _ctx.comm()->sock, 0, 0 );
+                            ret = gsseap_setup_creds( ptr );
+                            GSSEAP_PROBE( setup_creds_return, _ctx.comm()->sock, 0, ret.code() );
+                            result = ASSERT_PASS( ret, "Setting up GSSEAP credentials failed." );
+                        }
+
+                        // wait for a handshake slot now, while the client is still waiting for our reply
+                        // rather than blocked mid-handshake on the socket
+                        if ( result.ok() && !session->ticket_presented && gsseap_admission_enabled() ) {
+                            ret = gsseap_admission_acquire( _ctx.comm()->clientAddr );
+                            result = ASSERT_PASS( ret, "GSSEAP login refused by admission control." );
+                        }
+
+                        // answer the first token if the client sent it along, saving it a round trip
+                        session->short_handshake = 0;
+                        bool shortHandshake = result.ok() && !session->ticket_presented && req_kvp.count( GSSEAP_TOKEN_KEY ) &&
+                                              gsseap_env_long( "GSSEAP_SHORT_HANDSHAKE", 1 ) != 0;
+                        if ( shortHandshake ) {
+                            ret = gsseap_agent_short_handshake( _ctx, ptr, session, req_kvp[GSSEAP_TOKEN_KEY], req_result );
+                            result = ASSERT_PASS( ret, "GSSEAP short handshake failed." );
+                        }
+                        if ( result.ok() ) {
     	                   _ctx.comm()->gsiRequest = 1;
                            if ( _ctx.comm()->auth_scheme != NULL ) {
            	                 free( _ctx.comm()->auth_scheme );
                            }
                            _ctx.comm()->auth_scheme = strdup( irods::AUTH_GSSEAP_SCHEME.c_str() );
+                           ptr->request_result( req_result );
+                           admission.keep();
 			}
+                        else {
+                            gsseap_agent_login_done( _ctx, session, shortHandshake ? &session->handshake : NULL, result.code() );
+                            if ( session->gateway ) {
+                                gsseap_agent_gateway_restore( _ctx.comm(), session );
+                            }
+                        }
                     }
                 }
             }
         }
         return result;
     }
+#endif
 
-    irods::error gsseap_auth_client_response(
+    GSSEAP_EXPORT irods::error gsseap_auth_client_response(
         irods::auth_plugin_context& _ctx,
         rcComm_t* _comm ) {
         irods::error result = SUCCESS();
@@ -1234,31 +3013,33 @@ extern "C" {
                 // get the auth object
                 irods::gsseap_auth_object_ptr ptr = boost::dynamic_pointer_cast<irods::gsseap_auth_object >( _ctx.fco() );
 
-		irods::kvp_map_t kvp;
-                kvp[irods::AUTH_SCHEME_KEY] = irods::AUTH_GSSEAP_SCHEME;
-                std::string resp_str = irods::kvp_string( kvp );
-                
+                // =-=-=-=-=-=-=-
+                // the response is the single pair auth_scheme=gsseap, formatted in place
                 char response[ RESPONSE_LEN + 2 ];
-                strncpy( response, resp_str.c_str(), RESPONSE_LEN + 2 );
+                snprintf( response, sizeof( response ), "%s%s%s", irods::AUTH_SCHEME_KEY.c_str(),
+                          irods::kvp_association().c_str(), irods::AUTH_GSSEAP_SCHEME.c_str() );
 
                 // =-=-=-=-=-=-=-
                 // build the username#zonename string
-                std::string user_name = ptr->user_name() + "#" + ptr->zone_name();
                 char username[ MAX_NAME_LEN ];
-                strncpy( username, user_name.c_str(), MAX_NAME_LEN );
+                snprintf( username, sizeof( username ), "%s#%s", ptr->user_name().c_str(), ptr->zone_name().c_str() );
 
                 authResponseInp_t auth_response;
                 auth_response.response = response;
                 auth_response.username = username;           
                 int status = rcAuthResponse( _comm, &auth_response );
-                result = ASSERT_ERROR( status >= 0, status, "Call to rcAuthResponseFailed." );
+                if ( !( result = ASSERT_ERROR( status >= 0, status, "Call to rcAuthResponseFailed." ) ).ok() ) {
+                    // the server refused the user, the context of the handshake is of no further use
+                    gsseap_session_end( _comm->sock );
+                }
             }
         }
 
         return result;
     }
 
-    irods::error gsseap_auth_agent_response(
+#if defined(RODS_SERVER)
+    GSSEAP_EXPORT irods::error gsseap_auth_agent_response(
         irods::auth_plugin_context& _ctx,
         authResponseInp_t* _resp ) {
         irods::error result = SUCCESS();
@@ -1277,7 +3058,6 @@ extern "C" {
 
                 char digest[RESPONSE_LEN + 2];
                 char md5Buf[CHALLENGE_LEN + MAX_PASSWORD_LEN + 2];
-                char serverId[MAX_PASSWORD_LEN + 2];
                 MD5_CTX context;
 
                 bufp = _rsAuthRequestGetChallenge();
@@ -1294,6 +3074,7 @@ extern "C" {
                     authCheckInp.response = _resp->response;
                     authCheckInp.username = _resp->username;
 
+                    GSSEAP_PROBE( auth_check_entry, _ctx.comm()->sock, 0, rodsServerHost->localFlag == LOCAL_HOST );
                     if ( rodsServerHost->localFlag == LOCAL_HOST ) {
                         status = rsAuthCheck( _ctx.comm(), &authCheckInp, &authCheckOut );
                     }
@@ -1303,6 +3084,9 @@ extern "C" {
                         rcDisconnect( rodsServerHost->conn );
                         rodsServerHost->conn = NULL;
                     }
+                    GSSEAP_PROBE( auth_check_return, _ctx.comm()->sock, 0, status );
+                    gsseap_agent_check_binding( _ctx.comm(), gsseap_session_get( _ctx.comm()->sock ), status,
+                                                status >= 0 && authCheckOut != NULL ? authCheckOut->privLevel : NO_USER_AUTH );
                     if ( ( result = ASSERT_ERROR( status >= 0 && authCheckOut != NULL, status, "rcAuthCheck failed, status = %d.",
                                                   status ) ).ok() ) { // JMC cppcheck
 
@@ -1314,7 +3098,7 @@ extern "C" {
 
                             else {
                                 char *cp;
-                                int OK, len, i;
+                                int OK, i;
                                 if ( *authCheckOut->serverResponse == '\0' ) {
                                     rodsLog( LOG_NOTICE, "Warning, cannot authenticate remote server, serverResponse field is empty" );
                                     result = ASSERT_ERROR( !requireServerAuth, REMOTE_SERVER_AUTH_EMPTY, "Authentication disallowed, empty serverResponse." );
@@ -1322,18 +3106,17 @@ extern "C" {
                                 else {
                                     char username2[NAME_LEN + 2];
                                     char userZone[NAME_LEN + 2];
-                                    memset( md5Buf, 0, sizeof( md5Buf ) );
-                                    strncpy( md5Buf, authCheckInp.challenge, CHALLENGE_LEN );
                                     parseUserName( _resp->username, username2, userZone );
                                     //splitUserName( _resp->username, username2, userZone );
-                                    getZoneServerId( userZone, serverId );
-                                    len = strlen( serverId );
-                                    if ( len <= 0 ) {
+                                    const char* serverId = gsseap_zone_sid( userZone );
+                                    if ( serverId == NULL ) {
                                         rodsLog( LOG_NOTICE, "rsAuthResponse: Warning, cannot authenticate the remote server, no RemoteZoneSID defined in server.config", status );
                                         result = ASSERT_ERROR( !requireServerAuth, REMOTE_SERVER_SID_NOT_DEFINED, "Authentication disallowed, no RemoteZoneSID defined." );
                                     }
                                     else {
-                                        strncpy( md5Buf + CHALLENGE_LEN, serverId, len );
+                                        /* the SID comes padded, so the hash input is the challenge followed by it */
+                                        memcpy( md5Buf, authCheckInp.challenge, CHALLENGE_LEN );
+                                        memcpy( md5Buf + CHALLENGE_LEN, serverId, MAX_PASSWORD_LEN );
                                         /*MD5Init( &context );
                                         MD5Update( &context, ( unsigned char* )md5Buf, CHALLENGE_LEN + MAX_PASSWORD_LEN );
                                         MD5Final( ( unsigned char* )digest, &context );*/
@@ -1377,10 +3160,9 @@ extern "C" {
 
                         /* Set the clientUser zone if it is null. */
                         if ( result.ok() && strlen( _ctx.comm()->clientUser.rodsZone ) == 0 ) {
-                            zoneInfo_t *tmpZoneInfo;
-                            status = getLocalZoneInfo( &tmpZoneInfo );
-                            if ( ( result = ASSERT_ERROR( status >= 0, status, "getLocalZoneInfo failed." ) ).ok() ) {
-                                strncpy( _ctx.comm()->clientUser.rodsZone, tmpZoneInfo->zoneName, NAME_LEN );
+                            const gsseap_zone_t* zone = gsseap_zone_snapshot( &status );
+                            if ( ( result = ASSERT_ERROR( zone != NULL, status, "getLocalZoneInfo failed." ) ).ok() ) {
+                                strncpy( _ctx.comm()->clientUser.rodsZone, zone->zone_name, NAME_LEN );
                             }
                         }
 
@@ -1392,39 +3174,18 @@ extern "C" {
                         if ( result.ok() && rodsServerHost->rcatEnabled == REMOTE_ICAT ) {
 
                             /* proxy is easy because rodsServerHost is based on proxy user */
-                            if ( authCheckOut->privLevel == LOCAL_PRIV_USER_AUTH ) {
-                                authCheckOut->privLevel = REMOTE_PRIV_USER_AUTH;
-                            }
-                            else if ( authCheckOut->privLevel == LOCAL_USER_AUTH ) {
-                                authCheckOut->privLevel = REMOTE_USER_AUTH;
-                            }
+                            authCheckOut->privLevel = gsseap_zone_priv( GSSEAP_ZONE_REMOTE_ICAT, authCheckOut->privLevel );
 
                             /* adjust client user */
                             if ( strcmp( _ctx.comm()->proxyUser.userName,  _ctx.comm()->clientUser.userName ) == 0 ) {
                                 authCheckOut->clientPrivLevel = authCheckOut->privLevel;
                             }
                             else {
-                                zoneInfo_t *tmpZoneInfo;
-                                status = getLocalZoneInfo( &tmpZoneInfo );
-                                if ( ( result = ASSERT_ERROR( status >= 0, status, "getLocalZoneInfo failed." ) ).ok() ) {
-                                    if ( strcmp( tmpZoneInfo->zoneName,  _ctx.comm()->clientUser.rodsZone ) == 0 ) {
-                                        /* client is from local zone */
-                                        if ( authCheckOut->clientPrivLevel == REMOTE_PRIV_USER_AUTH ) {
-                                            authCheckOut->clientPrivLevel = LOCAL_PRIV_USER_AUTH;
-                                        }
-                                        else if ( authCheckOut->clientPrivLevel == REMOTE_USER_AUTH ) {
-                                            authCheckOut->clientPrivLevel = LOCAL_USER_AUTH;
-                                        }
-                                    }
-                                    else {
-                                        /* client is from remote zone */
-                                        if ( authCheckOut->clientPrivLevel == LOCAL_PRIV_USER_AUTH ) {
-                                            authCheckOut->clientPrivLevel = REMOTE_USER_AUTH;
-                                        }
-                                        else if ( authCheckOut->clientPrivLevel == LOCAL_USER_AUTH ) {
-                                            authCheckOut->clientPrivLevel = REMOTE_USER_AUTH;
-                                        }
-                                    }
+                                const gsseap_zone_t* zone = gsseap_zone_snapshot( &status );
+                                if ( ( result = ASSERT_ERROR( zone != NULL, status, "getLocalZoneInfo failed." ) ).ok() ) {
+                                    bool localClient = strcmp( zone->zone_name, _ctx.comm()->clientUser.rodsZone ) == 0;
+                                    authCheckOut->clientPrivLevel = gsseap_zone_priv( localClient ? GSSEAP_ZONE_LOCAL_CLIENT : GSSEAP_ZONE_REMOTE_CLIENT,
+                                                                                      authCheckOut->clientPrivLevel );
                                 }
                             }
                         }
@@ -1436,7 +3197,7 @@ extern "C" {
                             ret = check_proxy_user_privileges( _ctx.comm(), authCheckOut->privLevel );
 
                             if ( ( result = ASSERT_PASS( ret, "Check proxy user priviledges failed." ) ).ok() ) {
-                                rodsLog( LOG_NOTICE,
+                                rodsLog( gsseap_audit_log_level(),
                                          "rsAuthResponse set proxy authFlag to %d, client authFlag to %d, user:%s proxy:%s client:%s",
                                          authCheckOut->privLevel,
                                          authCheckOut->clientPrivLevel,
@@ -1464,6 +3225,9 @@ extern "C" {
 
                     free( authCheckOut );
                 }
+
+                gsseap_session_t* session = gsseap_session_get( _ctx.comm()->sock );
+                gsseap_agent_login_done( _ctx, session, session->ticket_presented ? NULL : &session->handshake, result.code() );
             }
         }
         return result;
@@ -1472,7 +3236,7 @@ extern "C" {
     // =-=-=-=-=-=-=-
     // stub for ops that the native plug does
     // not need to support
-    irods::error gsseap_auth_agent_verify(
+    GSSEAP_EXPORT irods::error gsseap_auth_agent_verify(
         irods::auth_plugin_context& _ctx,
         const char* _a,
         const char* _b,
@@ -1480,6 +3244,7 @@ extern "C" {
         return SUCCESS();
 
     } // native_auth_agent_verify
+#endif
 
     /// @brief The gsseap auth plugin
     class gsseap_auth_plugin : public irods::auth {
@@ -1496,12 +3261,71 @@ extern "C" {
 
     }; // class gsseap_auth_plugin
 
+    // =-=-=-=-=-=-=-
+    // fork handling: a fork must not happen while another thread holds any lock of the plugin, or the child would
+    // find it locked forever, and a child must not use the parent's initiator credential, whose AAA connections
+    // belong to the parent.  The locks are taken in the order the code nests them: the capabilities of the server
+    // are computed with the ticket key loaded under its lock.
+    static void gsseap_atfork_prepare() {
+        gsseap_capabilities_fork_lock();
+        gsseap_ticket_fork_lock();
+        gsseap_session_fork_lock();
+#if defined(RODS_SERVER)
+        gsseap_audit_fork_lock();
+#else
+        gsseap_pool_fork_lock();
+#endif
+        pthread_mutex_lock( &gsseapAcceptorMutex );
+        pthread_mutex_lock( &gsseapClientSharedMutex );
+        pthread_mutex_lock( &gsseapPreparedMutex );
+    }
+
+    static void gsseap_atfork_unlock() {
+        pthread_mutex_unlock( &gsseapPreparedMutex );
+        pthread_mutex_unlock( &gsseapClientSharedMutex );
+        pthread_mutex_unlock( &gsseapAcceptorMutex );
+#if defined(RODS_SERVER)
+        gsseap_audit_fork_unlock();
+#else
+        gsseap_pool_fork_unlock();
+#endif
+        gsseap_session_fork_unlock();
+        gsseap_ticket_fork_unlock();
+        gsseap_capabilities_fork_unlock();
+    }
+
+    static void gsseap_atfork_parent() {
+        gsseap_atfork_unlock();
+    }
+
+    static void gsseap_atfork_child() {
+        /* The credentials are dropped, not released: releasing one would close AAA connections the parent still uses.
+         * The child leaks what they hold, once per fork. */
+        gsseapClientCreds.clear();
+        gsseapAcceptorCred = GSS_C_NO_CREDENTIAL;
+        /* the threads preparing tokens did not survive the fork, and the finished ones belong to the parent */
+        gsseapPrepared.clear();
+        gsseap_atfork_unlock();
+    }
+
+    static pthread_once_t gsseapInitOnce = PTHREAD_ONCE_INIT;
+
+    /// @brief Process wide setup, done once when the plugin is first loaded; iRODS loads it in each agent after the fork.
+    /// The fork handlers stay registered for the life of the process, so the plugin is linked -z nodelete and is never
+    /// unmapped under them.
+    static void gsseap_init() {
+        pthread_atfork( gsseap_atfork_prepare, gsseap_atfork_parent, gsseap_atfork_child );
+    }
+
     /// @brief factory function to provide an instance of the plugin
-    irods::auth* plugin_factory(
+    GSSEAP_EXPORT irods::auth* plugin_factory(
         const std::string& _inst_name, // The name of the plugin
         const std::string& _context ) { // The context
         irods::auth* result = NULL;
         irods::error ret;
+
+        pthread_once( &gsseapInitOnce, gsseap_init );
+
         // create a gsseap auth object
         gsseap_auth_plugin* gsseap = new gsseap_auth_plugin( _inst_name, _context );
 
@@ -1511,13 +3335,15 @@ extern "C" {
             // fill in the operation table mapping call names to function names
             // gsseap->add_operation( irods::AUTH_SETUP_CREDS,          "gsseap_setup_creds" );
             gsseap->add_operation( irods::AUTH_CLIENT_START,         "gsseap_auth_client_start" );
-            gsseap->add_operation( irods::AUTH_AGENT_START,          "gsseap_auth_agent_start" );
             gsseap->add_operation( irods::AUTH_ESTABLISH_CONTEXT,    "gsseap_auth_establish_context" );
             gsseap->add_operation( irods::AUTH_CLIENT_AUTH_REQUEST,  "gsseap_auth_client_request" );
-            gsseap->add_operation( irods::AUTH_AGENT_AUTH_REQUEST,   "gsseap_auth_agent_request" );
             gsseap->add_operation( irods::AUTH_CLIENT_AUTH_RESPONSE, "gsseap_auth_client_response" );
+#if defined(RODS_SERVER)
+            gsseap->add_operation( irods::AUTH_AGENT_START,          "gsseap_auth_agent_start" );
+            gsseap->add_operation( irods::AUTH_AGENT_AUTH_REQUEST,   "gsseap_auth_agent_request" );
             gsseap->add_operation( irods::AUTH_AGENT_AUTH_RESPONSE,  "gsseap_auth_agent_response" );
             gsseap->add_operation( irods::AUTH_AGENT_AUTH_VERIFY,    "gsseap_auth_agent_verify" );
+#endif
 
             result = dynamic_cast<irods::auth*>( gsseap );
             if ( !( ret = ASSERT_ERROR( result != NULL, SYS_INVALID_INPUT_PARAM, "Failed to dynamic cast to irods::auth*" ) ).ok() ) {
@@ -0,0 +1,55 @@
+#!/bin/bash -e
+
+# Report the load cost of a built plugin: its size, exported symbols and load
+# time relocations, the time and memory dlopen takes in a fresh process, and,
+# given the pid of a running agent, the memory its mapping of the plugin uses.
+# Run it on the plugin before and after a build change to compare them.
+
+SCRIPTNAME=`basename $0`
+
+USAGE="
+Usage:
+  $SCRIPTNAME <plugin.so> [agent pid]
+"
+
+if [ $# -lt 1 -o $# -gt 2 -o ! -f "$1" ] ; then
+    echo "$USAGE" 1>&2
+    exit 1
+fi
+PLUGIN=`readlink -f $1`
+
+echo "Plugin                              [$PLUGIN]"
+echo "File size                           [`stat -L -c %s $PLUGIN`]"
+size $PLUGIN | tail -1 | awk '{ printf "Text, data, bss                     [%s, %s, %s]\n", $1, $2, $3 }'
+echo "Exported symbols                    [`nm -D --defined-only $PLUGIN | wc -l | tr -d ' '`]"
+echo "Dynamic relocations                 [`readelf -rW $PLUGIN | grep -c '^[0-9a-f]\{8,\}' || true`]"
+
+# =-=-=-=-=-=-=-
+# dlopen in a fresh process; only a client plugin loads on its own, a server
+# plugin needs the symbols of the agent and is measured through its pid
+python - $PLUGIN <<'EOF' || echo "dlopen                              [failed, see above]"
+import ctypes, sys, time
+
+def rss_kb():
+    for line in open( "/proc/self/status" ):
+        if line.startswith( "VmRSS:" ):
+            return int( line.split()[1] )
+
+before = rss_kb()
+start = time.time()
+ctypes.CDLL( sys.argv[1], mode=ctypes.RTLD_GLOBAL )
+elapsed = time.time() - start
+print( "dlopen time (ms)                    [%.2f]" % ( elapsed * 1000 ) )
+print( "RSS growth (kB)                     [%d]" % ( rss_kb() - before ) )
+EOF
+
+# =-=-=-=-=-=-=-
+# memory the plugin's mappings use in a running agent
+if [ -n "$2" ] ; then
+    awk -v plugin=$PLUGIN '
+        /^[0-9a-f]+-[0-9a-f]+ / { mapped = ( $6 == plugin ) }
+        mapped && /^Rss:/ { rss += $2 }
+        mapped && /^Pss:/ { pss += $2 }
+        END { printf "Agent Rss, Pss (kB)                 [%d, %d]\n", rss, pss }
+    ' /proc/$2/smaps
+fi
@@ -0,0 +1,117 @@
+#!/bin/bash -e
+
+# Run gsseapHandshakeBench against a local FreeRADIUS server, with
+# gsseapImpairProxy adding delay, jitter and loss between the Moonshot acceptor
+# and the server.  FreeRADIUS runs from a copy of the system configuration with
+# clients.conf and users of this directory laid over it, and the initiator's
+# identity comes from a ~/.gss_eap_id under a temporary HOME.  radsec.conf of
+# this directory must be installed as /etc/radsec.conf.  Build the programs
+# with "make -C test bench" first.
+
+SCRIPTNAME=`basename $0`
+AAADIR=`dirname \`readlink -f $0\``
+TESTDIR=`dirname $AAADIR`
+
+USAGE="
+Usage:
+  $SCRIPTNAME [-d delay ms] [-j jitter ms] [-p loss %] [-s seed] [-n logins]
+
+Environment:
+  RADDB     FreeRADIUS configuration to copy, default /etc/freeradius/3.0 or /etc/raddb
+  RADIUSD   FreeRADIUS server binary, default freeradius or radiusd
+"
+
+DELAY=0
+JITTER=0
+LOSS=0
+SEED=1
+LOGINS=20
+while getopts "d:j:p:s:n:" OPT ; do
+    case $OPT in
+        d) DELAY=$OPTARG ;;
+        j) JITTER=$OPTARG ;;
+        p) LOSS=$OPTARG ;;
+        s) SEED=$OPTARG ;;
+        n) LOGINS=$OPTARG ;;
+        *) echo "$USAGE" 1>&2 ; exit 1 ;;
+    esac
+done
+
+# the ports radsec.conf and the proxy agree on
+PROXY_PORT=11812
+RADIUS_PORT=18120
+IDENTITY="alice@example.org"
+PASSWORD="gsseap-bench-password"
+
+if [ -z "$RADDB" ] ; then
+    for DIR in /etc/freeradius/3.0 /etc/raddb ; do
+        if [ -d $DIR ] ; then
+            RADDB=$DIR
+            break
+        fi
+    done
+fi
+if [ -z "$RADIUSD" ] ; then
+    RADIUSD=`which freeradius radiusd 2> /dev/null | head -1`
+fi
+if [ ! -d "$RADDB" -o -z "$RADIUSD" ] ; then
+    echo "$SCRIPTNAME: FreeRADIUS not found, set RADDB and RADIUSD" 1>&2
+    exit 1
+fi
+if ! cmp -s $AAADIR/radsec.conf /etc/radsec.conf ; then
+    echo "$SCRIPTNAME: the Moonshot acceptor reads /etc/radsec.conf, install $AAADIR/radsec.conf there first" 1>&2
+    exit 1
+fi
+for PROGRAM in gsseapHandshakeBench gsseapImpairProxy ; do
+    if [ ! -x $TESTDIR/$PROGRAM ] ; then
+        echo "$SCRIPTNAME: $TESTDIR/$PROGRAM not built, run make -C $TESTDIR bench" 1>&2
+        exit 1
+    fi
+done
+
+WORKDIR=`mktemp -d`
+PIDS=""
+cleanup() {
+    if [ -n "$PIDS" ] ; then
+        kill $PIDS 2> /dev/null || true
+        wait $PIDS 2> /dev/null || true
+    fi
+    rm -rf $WORKDIR
+}
+trap cleanup EXIT
+
+# =-=-=-=-=-=-=-
+# the AAA server: the system configuration, the benchmark's client and user
+cp -a $RADDB $WORKDIR/raddb
+cp $AAADIR/clients.conf $WORKDIR/raddb/clients.conf
+if [ -d $WORKDIR/raddb/mods-config/files ] ; then
+    cp $AAADIR/users $WORKDIR/raddb/mods-config/files/authorize
+else
+    cp $AAADIR/users $WORKDIR/raddb/users
+fi
+# a server started as root drops to its own user, which must still read the copy
+chmod 755 $WORKDIR
+chmod -R go+rX $WORKDIR/raddb
+
+$RADIUSD -f -d $WORKDIR/raddb -i 127.0.0.1 -p $RADIUS_PORT -l $WORKDIR/radius.log &
+PIDS="$PIDS $!"
+$TESTDIR/gsseapImpairProxy -l $PROXY_PORT -u 127.0.0.1:$RADIUS_PORT -d $DELAY -j $JITTER -p $LOSS -s $SEED &
+PIDS="$PIDS $!"
+sleep 1
+for PID in $PIDS ; do
+    if ! kill -0 $PID 2> /dev/null ; then
+        echo "$SCRIPTNAME: the AAA server or the proxy did not start, see $WORKDIR/radius.log" 1>&2
+        cat $WORKDIR/radius.log 1>&2 || true
+        exit 1
+    fi
+done
+
+# =-=-=-=-=-=-=-
+# the initiator: Moonshot without an identity selector reads the default
+# identity and its password from ~/.gss_eap_id
+mkdir -m 700 $WORKDIR/home
+printf "%s\n%s\n" "$IDENTITY" "$PASSWORD" > $WORKDIR/home/.gss_eap_id
+chmod 600 $WORKDIR/home/.gss_eap_id
+
+echo "AAA path: delay $DELAY ms, jitter $JITTER ms, loss $LOSS % each way"
+( cd $TESTDIR && HOME=$WORKDIR/home ./gsseapHandshakeBench -n $LOGINS -u ${IDENTITY%%@*} )
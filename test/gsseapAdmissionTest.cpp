@@ -0,0 +1,322 @@
+/* -*- mode: c++; fill-column: 132; c-basic-offset: 4; indent-tabs-mode: nil -*- */
+/* gsseapAdmissionTest.cpp
+ * Tests admission control of handshakes (GSSEAP_MAX_HANDSHAKES) against a slow
+ * AAA backend.  Each scenario starts a server that forks an agent per
+ * connection, and client processes that log in at set times from set client
+ * addresses.  The stand-in mechanism accounts the handshakes inside the AAA
+ * backend, so the test sees how many the agents let through at once.
+ *
+ *  - bound: more logins than slots all succeed, never more than the limit of
+ *    them inside the AAA backend at once.
+ *  - refusal: logins beyond the running and queued limits are refused with
+ *    SYS_MAX_CONNECT_COUNT_EXCEEDED without waiting for a slot.
+ *  - fairness: a login from a second client address, queued behind a burst
+ *    from the first, gets the next free slot and finishes before the burst.
+ *
+ * The queue lives in the shared memory of the plugin for this user, which the
+ * test removes before each scenario and when it is done.
+ *
+ * usage: gsseapAdmissionTest [-d AAA exchange ms]
+ */
+
+#include "gsseapHarness.hpp"
+#include "gsseapStandin.hpp"
+
+#include "rodsErrorTable.hpp"
+
+#include <vector>
+
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+static const long gsseap_admission_default_delay = 100;
+static const int gsseap_admission_max_logins = 16;
+static const char* const gsseap_admission_user = "alice";
+static const char* const gsseap_admission_zone = "tempZone";
+static const char* const gsseap_admission_addr_a = "192.0.2.1";
+static const char* const gsseap_admission_addr_b = "192.0.2.2";
+
+/// @brief A login of a scenario: when and where it comes from, and how it went
+typedef struct {
+    const char* addr;
+    long start_ms;                                  // after the start of the scenario
+    int status;
+    unsigned long long begin_us;
+    unsigned long long end_us;
+} gsseap_admission_login_t;
+
+/// @brief Logins and what the AAA backend saw, in memory shared with the clients and agents
+typedef struct {
+    gsseap_standin_aaa_t aaa;
+    int count;
+    gsseap_admission_login_t logins[gsseap_admission_max_logins];
+} gsseap_admission_run_t;
+
+static long gsseap_admission_delay = gsseap_admission_default_delay;
+
+static void gsseap_admission_unlink() {
+    char path[64];
+    snprintf( path, sizeof( path ), "/irods_gsseap_admission.%u", ( unsigned int ) geteuid() );
+    ( void ) shm_unlink( path );
+}
+
+static void gsseap_admission_client(
+    int _port,
+    unsigned long long _start_us,
+    gsseap_admission_login_t* _login ) {
+    gsseap_harness_load_plugin();
+
+    unsigned long long at = _start_us + _login->start_ms * 1000;
+    unsigned long long now = gsseap_harness_now_us();
+    if ( at > now ) {
+        usleep( at - now );
+    }
+
+    _login->begin_us = gsseap_harness_now_us();
+    _login->status = -1;
+    int fd = gsseap_harness_connect( _port );
+    if ( fd >= 0 ) {
+        _login->status = gsseap_harness_login( fd, gsseap_admission_user, gsseap_admission_zone, _login->addr );
+        close( fd );
+    }
+    _login->end_us = gsseap_harness_now_us();
+}
+
+/// @brief Run the logins of _run against a server with the given limits, 0 for the default queue; -1 if it could not run
+static int gsseap_admission_run(
+    long _max_handshakes,
+    long _max_queued,
+    gsseap_admission_run_t* _run ) {
+    char value[32];
+    int port;
+    std::vector<pid_t> pids;
+
+    gsseap_admission_unlink();
+    snprintf( value, sizeof( value ), "%ld", _max_handshakes );
+    setenv( "GSSEAP_MAX_HANDSHAKES", value, 1 );
+    if ( _max_queued > 0 ) {
+        snprintf( value, sizeof( value ), "%ld", _max_queued );
+        setenv( "GSSEAP_MAX_QUEUED_HANDSHAKES", value, 1 );
+    }
+    else {
+        unsetenv( "GSSEAP_MAX_QUEUED_HANDSHAKES" );
+    }
+
+    int listen_fd = gsseap_harness_listen( &port );
+    gsseap_harness_agent_stats_t* stats = ( gsseap_harness_agent_stats_t* ) gsseap_harness_shared( sizeof( *stats ) );
+    if ( listen_fd < 0 || stats == MAP_FAILED ) {
+        perror( "gsseapAdmissionTest: setting up" );
+        return -1;
+    }
+    gsseap_standin_track_aaa( &_run->aaa );
+    pid_t server = gsseap_harness_start_server( listen_fd, stats );
+    if ( server < 0 ) {
+        perror( "gsseapAdmissionTest: starting the server" );
+        return -1;
+    }
+
+    // the clients wait for a common start, so forking them does not spread the logins out
+    unsigned long long start_us = gsseap_harness_now_us() + 100000;
+    for ( int i = 0; i < _run->count; i++ ) {
+        pid_t pid = fork();
+        if ( pid == 0 ) {
+            close( listen_fd );
+            gsseap_admission_client( port, start_us, &_run->logins[i] );
+            _exit( 0 );
+        }
+        if ( pid < 0 ) {
+            perror( "gsseapAdmissionTest: forking a client" );
+            break;
+        }
+        pids.push_back( pid );
+    }
+    for ( size_t i = 0; i < pids.size(); i++ ) {
+        ( void ) waitpid( pids[i], NULL, 0 );
+    }
+
+    kill( server, SIGTERM );
+    ( void ) waitpid( server, NULL, 0 );
+    close( listen_fd );
+    gsseap_standin_track_aaa( NULL );
+    munmap( stats, sizeof( *stats ) );
+    gsseap_admission_unlink();
+    return pids.size() == ( size_t ) _run->count ? 0 : -1;
+}
+
+static gsseap_admission_run_t* gsseap_admission_new_run() {
+    gsseap_admission_run_t* run = ( gsseap_admission_run_t* ) gsseap_harness_shared( sizeof( gsseap_admission_run_t ) );
+    return run == MAP_FAILED ? NULL : run;
+}
+
+static void gsseap_admission_add(
+    gsseap_admission_run_t* _run,
+    const char* _addr,
+    long _start_ms,
+    int _count ) {
+    for ( int i = 0; i < _count && _run->count < gsseap_admission_max_logins; i++ ) {
+        _run->logins[_run->count].addr = _addr;
+        _run->logins[_run->count].start_ms = _start_ms;
+        _run->count++;
+    }
+}
+
+static double gsseap_admission_ms(
+    const gsseap_admission_login_t* _login ) {
+    return ( _login->end_us - _login->begin_us ) / 1000.0;
+}
+
+static int gsseap_admission_report(
+    const char* _scenario,
+    const char* _failure ) {
+    if ( _failure != NULL ) {
+        fprintf( stderr, "gsseapAdmissionTest: %s: %s\n", _scenario, _failure );
+        return 1;
+    }
+    printf( "%-10s ok\n", _scenario );
+    return 0;
+}
+
+/// @brief Six logins against two slots: all get in, two at a time
+static int gsseap_admission_bound() {
+    gsseap_admission_run_t* run = gsseap_admission_new_run();
+    if ( run == NULL ) {
+        return gsseap_admission_report( "bound", "no shared memory" );
+    }
+    gsseap_admission_add( run, gsseap_admission_addr_a, 0, 6 );
+    if ( gsseap_admission_run( 2, 0, run ) < 0 ) {
+        return gsseap_admission_report( "bound", "could not run" );
+    }
+
+    for ( int i = 0; i < run->count; i++ ) {
+        if ( run->logins[i].status < 0 ) {
+            fprintf( stderr, "gsseapAdmissionTest: bound: login %d failed, status %d\n", i, run->logins[i].status );
+            return gsseap_admission_report( "bound", "a login failed" );
+        }
+    }
+    printf( "bound: %d logins, at most %d in the AAA backend at once\n", run->count, run->aaa.peak );
+    if ( run->aaa.peak > 2 ) {
+        return gsseap_admission_report( "bound", "more handshakes reached the AAA backend than there are slots" );
+    }
+    if ( run->aaa.peak < 2 ) {
+        return gsseap_admission_report( "bound", "the handshakes ran one at a time" );
+    }
+    return gsseap_admission_report( "bound", NULL );
+}
+
+/// @brief Eight logins against two slots and two places in the queue: the rest are refused without waiting
+static int gsseap_admission_refusal() {
+    long handshake_ms = gsseap_admission_delay * 2;
+    int refused = 0;
+    int succeeded = 0;
+
+    gsseap_admission_run_t* run = gsseap_admission_new_run();
+    if ( run == NULL ) {
+        return gsseap_admission_report( "refusal", "no shared memory" );
+    }
+    gsseap_admission_add( run, gsseap_admission_addr_a, 0, 8 );
+    if ( gsseap_admission_run( 2, 2, run ) < 0 ) {
+        return gsseap_admission_report( "refusal", "could not run" );
+    }
+
+    for ( int i = 0; i < run->count; i++ ) {
+        gsseap_admission_login_t* login = &run->logins[i];
+        if ( login->status >= 0 ) {
+            succeeded++;
+            continue;
+        }
+        if ( login->status != SYS_MAX_CONNECT_COUNT_EXCEEDED ) {
+            fprintf( stderr, "gsseapAdmissionTest: refusal: login %d failed, status %d\n", i, login->status );
+            return gsseap_admission_report( "refusal", "a login failed other than by refusal" );
+        }
+        refused++;
+        // a queued login waits for a whole handshake at least
+        if ( gsseap_admission_ms( login ) >= handshake_ms ) {
+            fprintf( stderr, "gsseapAdmissionTest: refusal: login %d was refused after %.1f ms\n", i, gsseap_admission_ms( login ) );
+            return gsseap_admission_report( "refusal", "a refusal waited for a slot" );
+        }
+    }
+    printf( "refusal: %d logins, %d succeeded, %d refused\n", run->count, succeeded, refused );
+    if ( refused == 0 ) {
+        return gsseap_admission_report( "refusal", "nothing was refused" );
+    }
+    if ( succeeded < 4 ) {
+        return gsseap_admission_report( "refusal", "logins that fit the slots and the queue were refused" );
+    }
+    return gsseap_admission_report( "refusal", NULL );
+}
+
+/// @brief A burst of six logins from one address against two slots, and one login from another address after it:
+/// the latter is served next, before the burst is done
+static int gsseap_admission_fairness() {
+    gsseap_admission_run_t* run = gsseap_admission_new_run();
+    if ( run == NULL ) {
+        return gsseap_admission_report( "fairness", "no shared memory" );
+    }
+    gsseap_admission_add( run, gsseap_admission_addr_a, 0, 6 );
+    gsseap_admission_add( run, gsseap_admission_addr_b, gsseap_admission_delay / 2, 1 );
+    if ( gsseap_admission_run( 2, 0, run ) < 0 ) {
+        return gsseap_admission_report( "fairness", "could not run" );
+    }
+
+    unsigned long long last_a = 0;
+    unsigned long long end_b = 0;
+    for ( int i = 0; i < run->count; i++ ) {
+        gsseap_admission_login_t* login = &run->logins[i];
+        if ( login->status < 0 ) {
+            fprintf( stderr, "gsseapAdmissionTest: fairness: login %d failed, status %d\n", i, login->status );
+            return gsseap_admission_report( "fairness", "a login failed" );
+        }
+        if ( login->addr == gsseap_admission_addr_b ) {
+            end_b = login->end_us;
+        }
+        else if ( login->end_us > last_a ) {
+            last_a = login->end_us;
+        }
+    }
+    printf( "fairness: %s done %.1f ms before the last login from %s\n",
+            gsseap_admission_addr_b, ( ( double ) last_a - ( double ) end_b ) / 1000.0, gsseap_admission_addr_a );
+    if ( end_b >= last_a ) {
+        return gsseap_admission_report( "fairness", "the second address waited for the whole burst of the first" );
+    }
+    return gsseap_admission_report( "fairness", NULL );
+}
+
+int main(
+    int _argc,
+    char** _argv ) {
+    char value[32];
+    int opt;
+    int failed = 0;
+
+    while ( ( opt = getopt( _argc, _argv, "d:" ) ) != -1 ) {
+        switch ( opt ) {
+        case 'd':
+            gsseap_admission_delay = atol( optarg );
+            break;
+        default:
+            fprintf( stderr, "usage: %s [-d AAA exchange ms]\n", _argv[0] );
+            return 2;
+        }
+    }
+    if ( gsseap_admission_delay <= 0 ) {
+        fprintf( stderr, "gsseapAdmissionTest: -d must be positive\n" );
+        return 2;
+    }
+
+    // two AAA exchanges a handshake, and time enough in the queue for the longest wait
+    snprintf( value, sizeof( value ), "%ld", gsseap_admission_delay );
+    setenv( "GSSEAP_STANDIN_AAA_DELAY_MS", value, 1 );
+    setenv( "GSSEAP_STANDIN_ROUNDS", "3", 1 );
+    snprintf( value, sizeof( value ), "%ld", gsseap_admission_delay * 2 * gsseap_admission_max_logins );
+    setenv( "GSSEAP_HANDSHAKE_QUEUE_TIMEOUT", value, 1 );
+
+    failed += gsseap_admission_bound();
+    failed += gsseap_admission_refusal();
+    failed += gsseap_admission_fairness();
+    return failed > 0 ? 1 : 0;
+}
@@ -0,0 +1,278 @@
+/* -*- mode: c++; fill-column: 132; c-basic-offset: 4; indent-tabs-mode: nil -*- */
+/* gsseapAllocTest.cpp
+ * Counts the heap allocations of a successful login.  malloc and its family
+ * are interposed, allocations are counted while the thread making them runs a
+ * plugin operation, and the bytes in use are tracked for the whole process.
+ * The client runs on the main thread and the agent on a thread of its own,
+ * one login at a time over a new socket pair that reuses the descriptors of
+ * the last.  After a warm up every login must make the same number of
+ * allocations, no more than the budget, and leave the heap as it found it.
+ *
+ * The counts include the stand-ins' own allocations: the catalog's query
+ * results, the mechanism's tokens and names, and the frames of the harness.
+ *
+ * usage: gsseapAllocTest [-n logins] [-b allocations per login]
+ */
+
+#include "gsseapHarness.hpp"
+#include "gsseapStandin.hpp"
+
+#include <errno.h>
+#include <malloc.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+extern "C" {
+    void* __libc_malloc( size_t _size );
+    void* __libc_calloc( size_t _count, size_t _size );
+    void* __libc_realloc( void* _ptr, size_t _size );
+    void* __libc_memalign( size_t _alignment, size_t _size );
+    void __libc_free( void* _ptr );
+}
+
+static const int gsseap_alloc_warm_up = 5;
+static const int gsseap_alloc_default_logins = 20;
+static const long gsseap_alloc_default_budget = 64;
+static const char* const gsseap_alloc_user = "alice";
+static const char* const gsseap_alloc_zone = "tempZone";
+static const char* const gsseap_alloc_client_addr = "127.0.0.1";
+
+static const char* const gsseap_alloc_ops[] = {
+    "client_start", "client_request", "agent_request", "agent_start", "establish_context", "client_response", "agent_response"
+};
+static const int gsseap_alloc_op_count = sizeof( gsseap_alloc_ops ) / sizeof( gsseap_alloc_ops[0] );
+
+static __thread int gsseap_alloc_op = -1;                        // the operation this thread runs, -1 for none
+static volatile unsigned long gsseap_alloc_counts[gsseap_alloc_op_count];
+static volatile long gsseap_alloc_live_bytes;
+
+static void* gsseap_alloc_note(
+    void* _ptr ) {
+    if ( _ptr != NULL ) {
+        __sync_add_and_fetch( &gsseap_alloc_live_bytes, ( long ) malloc_usable_size( _ptr ) );
+        if ( gsseap_alloc_op >= 0 ) {
+            __sync_add_and_fetch( &gsseap_alloc_counts[gsseap_alloc_op], 1 );
+        }
+    }
+    return _ptr;
+}
+
+static void gsseap_alloc_forget(
+    void* _ptr ) {
+    if ( _ptr != NULL ) {
+        __sync_sub_and_fetch( &gsseap_alloc_live_bytes, ( long ) malloc_usable_size( _ptr ) );
+    }
+}
+
+extern "C" {
+
+    void* malloc(
+        size_t _size ) {
+        return gsseap_alloc_note( __libc_malloc( _size ) );
+    }
+
+    void* calloc(
+        size_t _count,
+        size_t _size ) {
+        return gsseap_alloc_note( __libc_calloc( _count, _size ) );
+    }
+
+    void* realloc(
+        void* _ptr,
+        size_t _size ) {
+        size_t old_size = _ptr != NULL ? malloc_usable_size( _ptr ) : 0;
+        void* ptr = __libc_realloc( _ptr, _size );
+        if ( ptr != NULL || _size == 0 ) {
+            __sync_sub_and_fetch( &gsseap_alloc_live_bytes, ( long ) old_size );
+        }
+        return gsseap_alloc_note( ptr );
+    }
+
+    void* memalign(
+        size_t _alignment,
+        size_t _size ) {
+        return gsseap_alloc_note( __libc_memalign( _alignment, _size ) );
+    }
+
+    int posix_memalign(
+        void** _rtn_ptr,
+        size_t _alignment,
+        size_t _size ) {
+        void* ptr = gsseap_alloc_note( __libc_memalign( _alignment, _size ) );
+        if ( ptr == NULL ) {
+            return ENOMEM;
+        }
+        *_rtn_ptr = ptr;
+        return 0;
+    }
+
+    void* aligned_alloc(
+        size_t _alignment,
+        size_t _size ) {
+        return gsseap_alloc_note( __libc_memalign( _alignment, _size ) );
+    }
+
+    void free(
+        void* _ptr ) {
+        gsseap_alloc_forget( _ptr );
+        __libc_free( _ptr );
+    }
+
+}
+
+static void gsseap_alloc_op_begin(
+    const char* _op ) {
+    for ( int i = 0; i < gsseap_alloc_op_count; i++ ) {
+        if ( strcmp( _op, gsseap_alloc_ops[i] ) == 0 ) {
+            gsseap_alloc_op = i;
+        }
+    }
+}
+
+static void gsseap_alloc_op_end(
+    const char* _op,
+    int _status ) {
+    gsseap_alloc_op = -1;
+}
+
+static const gsseap_harness_hooks_t gsseap_alloc_hooks = { gsseap_alloc_op_begin, gsseap_alloc_op_end };
+
+// the agent thread serves the descriptors written to its pipe, and writes to the done pipe when a connection is over
+static int gsseap_alloc_agent_pipe[2];
+static int gsseap_alloc_done_pipe[2];
+
+static void* gsseap_alloc_agent(
+    void* _arg ) {
+    int fd;
+    while ( read( gsseap_alloc_agent_pipe[0], &fd, sizeof( fd ) ) == sizeof( fd ) && fd >= 0 ) {
+        int status = gsseap_harness_serve( fd );
+        close( fd );
+        if ( write( gsseap_alloc_done_pipe[1], &status, sizeof( status ) ) != sizeof( status ) ) {
+            break;
+        }
+    }
+    return NULL;
+}
+
+/// @brief One login, 0 if both sides succeeded
+static int gsseap_alloc_login() {
+    int sv[2];
+    int agent_status;
+
+    if ( socketpair( AF_UNIX, SOCK_STREAM, 0, sv ) < 0 ) {
+        return -1;
+    }
+    if ( write( gsseap_alloc_agent_pipe[1], &sv[1], sizeof( sv[1] ) ) != sizeof( sv[1] ) ) {
+        close( sv[0] );
+        close( sv[1] );
+        return -1;
+    }
+    int status = gsseap_harness_login( sv[0], gsseap_alloc_user, gsseap_alloc_zone, gsseap_alloc_client_addr );
+    close( sv[0] );
+    if ( read( gsseap_alloc_done_pipe[0], &agent_status, sizeof( agent_status ) ) != sizeof( agent_status ) ) {
+        return -1;
+    }
+    return status < 0 ? status : agent_status;
+}
+
+static unsigned long gsseap_alloc_total(
+    unsigned long* _rtn_by_op ) {
+    unsigned long total = 0;
+    for ( int i = 0; i < gsseap_alloc_op_count; i++ ) {
+        _rtn_by_op[i] = gsseap_alloc_counts[i];
+        total += _rtn_by_op[i];
+    }
+    return total;
+}
+
+int main(
+    int _argc,
+    char** _argv ) {
+    int logins = gsseap_alloc_default_logins;
+    long budget = gsseap_alloc_default_budget;
+    unsigned long before[gsseap_alloc_op_count];
+    unsigned long after[gsseap_alloc_op_count];
+    unsigned long first[gsseap_alloc_op_count] = { 0 };
+    pthread_t agent;
+    int opt;
+    int failed = 0;
+
+    while ( ( opt = getopt( _argc, _argv, "n:b:" ) ) != -1 ) {
+        switch ( opt ) {
+        case 'n':
+            logins = atoi( optarg );
+            break;
+        case 'b':
+            budget = atol( optarg );
+            break;
+        default:
+            fprintf( stderr, "usage: %s [-n logins] [-b allocations per login]\n", _argv[0] );
+            return 2;
+        }
+    }
+
+    gsseap_harness_set_hooks( &gsseap_alloc_hooks );
+    gsseap_harness_load_plugin();
+    if ( pipe( gsseap_alloc_agent_pipe ) < 0 || pipe( gsseap_alloc_done_pipe ) < 0 ||
+            pthread_create( &agent, NULL, gsseap_alloc_agent, NULL ) != 0 ) {
+        perror( "gsseapAllocTest: starting the agent" );
+        return 1;
+    }
+
+    for ( int i = 0; i < gsseap_alloc_warm_up; i++ ) {
+        int status = gsseap_alloc_login();
+        if ( status < 0 ) {
+            fprintf( stderr, "gsseapAllocTest: warm up login %d failed, status %d\n", i, status );
+            return 1;
+        }
+    }
+
+    long live_before = gsseap_alloc_live_bytes;
+    unsigned long per_login = 0;
+    for ( int i = 0; i < logins; i++ ) {
+        unsigned long count = gsseap_alloc_total( before );
+        int status = gsseap_alloc_login();
+        count = gsseap_alloc_total( after ) - count;
+        if ( status < 0 ) {
+            fprintf( stderr, "gsseapAllocTest: login %d failed, status %d\n", i, status );
+            failed++;
+            continue;
+        }
+        if ( i == 0 ) {
+            per_login = count;
+            for ( int op = 0; op < gsseap_alloc_op_count; op++ ) {
+                first[op] = after[op] - before[op];
+            }
+        }
+        else if ( count != per_login ) {
+            fprintf( stderr, "gsseapAllocTest: login %d made %lu allocations, the first %lu\n", i, count, per_login );
+            failed++;
+        }
+    }
+    long leaked = gsseap_alloc_live_bytes - live_before;
+
+    int stop = -1;
+    if ( write( gsseap_alloc_agent_pipe[1], &stop, sizeof( stop ) ) == sizeof( stop ) ) {
+        pthread_join( agent, NULL );
+    }
+
+    printf( "allocations per login: %lu (budget %ld)\n", per_login, budget );
+    for ( int op = 0; op < gsseap_alloc_op_count; op++ ) {
+        printf( "  %-18s %lu\n", gsseap_alloc_ops[op], first[op] );
+    }
+    printf( "bytes left allocated by %d logins: %ld\n", logins, leaked );
+
+    if ( ( long ) per_login > budget ) {
+        fprintf( stderr, "gsseapAllocTest: %lu allocations per login exceed the budget of %ld\n", per_login, budget );
+        failed++;
+    }
+    if ( leaked != 0 ) {
+        fprintf( stderr, "gsseapAllocTest: logins leaked %ld bytes\n", leaked );
+        failed++;
+    }
+    return failed > 0 ? 1 : 0;
+}
@@ -0,0 +1,147 @@
+/* -*- mode: c++; fill-column: 132; c-basic-offset: 4; indent-tabs-mode: nil -*- */
+/* gsseapBreakerTest.cpp
+ * Tests which AAA failures the circuit breaker of a realm counts.  The realm
+ * is the one the initiator announces, so it proves nothing by itself.  The
+ * client runs on the main thread and the agent on a thread of its own, one
+ * login at a time, with GSSEAP_BREAKER_THRESHOLD at 3.
+ *
+ *  - foreign: a client claiming another realm, whose messages the AAA
+ *    backend never answers, fails as often as it likes; a user of that realm
+ *    still logs in.
+ *  - down: a backend that answers the first exchange and then fails opens
+ *    the breaker of its realm, and the next login of the realm is refused
+ *    before it reaches the backend.
+ *
+ * The breakers live in the shared memory of the plugin for this user, which
+ * the test removes before it starts and when it is done.
+ *
+ * usage: gsseapBreakerTest
+ */
+
+#include "gsseapHarness.hpp"
+#include "gsseapSession.hpp"
+#include "gsseapStandin.hpp"
+
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+static const int gsseap_breaker_threshold = 3;
+static const char* const gsseap_breaker_zone = "tempZone";
+static const char* const gsseap_breaker_client_addr = "127.0.0.1";
+static const char* const gsseap_breaker_down_realm = "down.example.org";
+
+static gsseap_standin_aaa_t gsseap_breaker_aaa;
+
+static void gsseap_breaker_unlink() {
+    char path[64];
+    snprintf( path, sizeof( path ), "/irods_gsseap_breakers.%u", ( unsigned int ) geteuid() );
+    ( void ) shm_unlink( path );
+}
+
+static void* gsseap_breaker_agent(
+    void* _arg ) {
+    int fd = *( int* ) _arg;
+
+    ( void ) gsseap_harness_serve( fd );
+    gsseap_session_end( fd );
+    close( fd );
+    return NULL;
+}
+
+/// @brief One login as _user with the initiator name _identity; 0 or the client's error, and the AAA exchanges it made
+static int gsseap_breaker_login(
+    const char* _user,
+    const char* _identity,
+    unsigned long* _rtn_exchanges ) {
+    pthread_t agent;
+    int sv[2];
+
+    if ( socketpair( AF_UNIX, SOCK_STREAM, 0, sv ) < 0 ) {
+        return -1;
+    }
+    if ( pthread_create( &agent, NULL, gsseap_breaker_agent, &sv[1] ) != 0 ) {
+        close( sv[0] );
+        close( sv[1] );
+        return -1;
+    }
+    unsigned long exchanges = gsseap_breaker_aaa.exchanges;
+    gsseap_standin_identity( _identity );
+    int status = gsseap_harness_login( sv[0], _user, gsseap_breaker_zone, gsseap_breaker_client_addr );
+    gsseap_standin_identity( NULL );
+    gsseap_session_end( sv[0] );
+    close( sv[0] );
+    pthread_join( agent, NULL );
+    *_rtn_exchanges = gsseap_breaker_aaa.exchanges - exchanges;
+    return status;
+}
+
+static int gsseap_breaker_foreign() {
+    unsigned long exchanges;
+    int failed = 0;
+
+    for ( int i = 0; i < gsseap_breaker_threshold * 2; i++ ) {
+        if ( gsseap_breaker_login( "mallory", "unanswered@victim.example.org", &exchanges ) == 0 ) {
+            fprintf( stderr, "gsseapBreakerTest: foreign: a login the AAA backend never answered succeeded\n" );
+            failed++;
+        }
+    }
+    int status = gsseap_breaker_login( "alice", "alice@victim.example.org", &exchanges );
+    if ( status != 0 || exchanges == 0 ) {
+        fprintf( stderr, "gsseapBreakerTest: foreign: a user of the claimed realm was refused, status %d, %lu AAA exchanges\n",
+                 status, exchanges );
+        failed++;
+    }
+
+    printf( "%-8s %s\n", "foreign", failed > 0 ? "FAILED" : "ok" );
+    return failed;
+}
+
+static int gsseap_breaker_down() {
+    char identity[128];
+    unsigned long exchanges;
+    int failed = 0;
+
+    snprintf( identity, sizeof( identity ), "bob@%s", gsseap_breaker_down_realm );
+    setenv( "GSSEAP_STANDIN_AAA_DOWN_REALM", gsseap_breaker_down_realm, 1 );
+    for ( int i = 0; i < gsseap_breaker_threshold; i++ ) {
+        if ( gsseap_breaker_login( "bob", identity, &exchanges ) == 0 || exchanges == 0 ) {
+            fprintf( stderr, "gsseapBreakerTest: down: login %d did not fail in the AAA backend\n", i );
+            failed++;
+        }
+    }
+    if ( gsseap_breaker_login( "bob", identity, &exchanges ) == 0 || exchanges != 0 ) {
+        fprintf( stderr, "gsseapBreakerTest: down: the breaker let a login through, %lu AAA exchanges\n", exchanges );
+        failed++;
+    }
+    unsetenv( "GSSEAP_STANDIN_AAA_DOWN_REALM" );
+
+    printf( "%-8s %s\n", "down", failed > 0 ? "FAILED" : "ok" );
+    return failed;
+}
+
+int main(
+    int _argc,
+    char** _argv ) {
+    char value[32];
+    int failed = 0;
+
+    snprintf( value, sizeof( value ), "%d", gsseap_breaker_threshold );
+    setenv( "GSSEAP_BREAKER_THRESHOLD", value, 1 );
+    // no probe gets through while the test runs
+    setenv( "GSSEAP_BREAKER_RESET", "3600", 1 );
+    setenv( "GSSEAP_STANDIN_ROUNDS", "3", 1 );
+    gsseap_breaker_unlink();
+    gsseap_standin_track_aaa( &gsseap_breaker_aaa );
+    gsseap_harness_load_plugin();
+
+    failed += gsseap_breaker_foreign();
+    failed += gsseap_breaker_down();
+
+    gsseap_breaker_unlink();
+    return failed > 0 ? 1 : 0;
+}
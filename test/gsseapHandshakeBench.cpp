@@ -0,0 +1,241 @@
+/* -*- mode: c++; fill-column: 132; c-basic-offset: 4; indent-tabs-mode: nil -*- */
+/* gsseapHandshakeBench.cpp
+ * End-to-end handshake benchmark with the real GSS-EAP mechanism.  Unlike the
+ * tests it links the system GSS-API library, so the client's
+ * gsseap_auth_establish_context and the agent's
+ * gsseap_establish_context_serverside run the Moonshot mechanism, and the
+ * acceptor talks to the AAA server named for the realm "gss-eap" in
+ * /etc/radsec.conf.  Only the catalog is a stand-in.  test/aaa/run-bench.sh
+ * sets up a local FreeRADIUS server behind gsseapImpairProxy.
+ *
+ * The client runs on the main thread and the agent on a thread of its own,
+ * one login at a time over a socket pair.  For every login the benchmark
+ * records the time of each plugin operation and the handshake breakdown both
+ * sides keep (gsseapStats.hpp): round trips, tokens and bytes on the wire,
+ * time in the mechanism, time waiting for the peer and the remainder, spent
+ * in the plugin.  On the agent the mechanism time includes the AAA exchange;
+ * on the client the wait includes the agent's mechanism time.
+ *
+ * The initiator's identity is Moonshot's to choose, ~/.gss_eap_id without an
+ * identity selector; the acceptor name is irodsServerDn, if set.
+ *
+ * usage: gsseapHandshakeBench [-n logins] [-u user]
+ */
+
+#include "gsseapHarness.hpp"
+#include "gsseapSession.hpp"
+#include "gsseapStats.hpp"
+
+#include <algorithm>
+#include <string>
+#include <vector>
+
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+static const int gsseap_bench_default_logins = 20;
+static const char* const gsseap_bench_default_user = "alice";
+static const char* const gsseap_bench_zone = "tempZone";
+static const char* const gsseap_bench_client_addr = "127.0.0.1";
+
+static const char* const gsseap_bench_ops[] = {
+    "client_start", "client_request", "agent_request", "agent_start", "establish_context", "client_response", "agent_response"
+};
+static const int gsseap_bench_op_count = sizeof( gsseap_bench_ops ) / sizeof( gsseap_bench_ops[0] );
+
+// the time of every operation of every login, added to by both threads
+static pthread_mutex_t gsseap_bench_mutex = PTHREAD_MUTEX_INITIALIZER;
+static std::vector<unsigned long long> gsseap_bench_op_us[gsseap_bench_op_count];
+static __thread unsigned long long gsseap_bench_op_start;
+
+static void gsseap_bench_op_begin(
+    const char* _op ) {
+    gsseap_bench_op_start = gsseap_harness_now_us();
+}
+
+static void gsseap_bench_op_end(
+    const char* _op,
+    int _status ) {
+    unsigned long long us = gsseap_harness_now_us() - gsseap_bench_op_start;
+    for ( int i = 0; i < gsseap_bench_op_count; i++ ) {
+        if ( strcmp( _op, gsseap_bench_ops[i] ) == 0 ) {
+            pthread_mutex_lock( &gsseap_bench_mutex );
+            gsseap_bench_op_us[i].push_back( us );
+            pthread_mutex_unlock( &gsseap_bench_mutex );
+        }
+    }
+}
+
+static const gsseap_harness_hooks_t gsseap_bench_hooks = { gsseap_bench_op_begin, gsseap_bench_op_end };
+
+/// @brief The connection the agent thread serves, and the breakdown of its handshake
+typedef struct {
+    int fd;
+    int status;
+    gsseap_handshake_stats_t handshake;
+} gsseap_bench_agent_t;
+
+static void* gsseap_bench_agent(
+    void* _arg ) {
+    gsseap_bench_agent_t* agent = ( gsseap_bench_agent_t* ) _arg;
+
+    agent->status = gsseap_harness_serve( agent->fd );
+    agent->handshake = gsseap_session_get( agent->fd )->handshake;
+    gsseap_session_end( agent->fd );
+    close( agent->fd );
+    return NULL;
+}
+
+/// @brief Totals of the handshakes of one side
+typedef struct {
+    unsigned long long round_trips;
+    unsigned long long tokens_sent;
+    unsigned long long bytes_sent;
+    unsigned long long bytes_received;
+    unsigned long long steps;
+    unsigned long long step_us;
+    unsigned long long max_step_us;
+    unsigned long long wait_us;
+    unsigned long long total_us;
+} gsseap_bench_side_t;
+
+static void gsseap_bench_add(
+    gsseap_bench_side_t* _side,
+    const gsseap_handshake_stats_t* _handshake ) {
+    _side->round_trips += _handshake->round_trips;
+    _side->tokens_sent += _handshake->tokens_sent;
+    _side->bytes_sent += _handshake->bytes_sent;
+    _side->bytes_received += _handshake->bytes_received;
+    _side->steps += _handshake->steps;
+    _side->step_us += _handshake->step_us;
+    _side->wait_us += _handshake->wait_us;
+    _side->total_us += _handshake->total_us;
+    if ( _handshake->max_step_us > _side->max_step_us ) {
+        _side->max_step_us = _handshake->max_step_us;
+    }
+}
+
+static void gsseap_bench_print_side(
+    const char* _side,
+    const gsseap_bench_side_t* _totals,
+    int _logins ) {
+    double n = _logins;
+    double plugin_us = ( double ) _totals->total_us - ( double ) _totals->step_us - ( double ) _totals->wait_us;
+    printf( "%-7s %7.1f %7.1f %9.0f %9.0f %6.1f %9.2f %9.2f %9.2f %9.2f %9.2f\n",
+            _side, _totals->round_trips / n, _totals->tokens_sent / n, _totals->bytes_sent / n, _totals->bytes_received / n,
+            _totals->steps / n, _totals->step_us / n / 1000.0, _totals->max_step_us / 1000.0, _totals->wait_us / n / 1000.0,
+            plugin_us / n / 1000.0, _totals->total_us / n / 1000.0 );
+}
+
+static double gsseap_bench_percentile(
+    const std::vector<unsigned long long>& _sorted,
+    double _p ) {
+    if ( _sorted.empty() ) {
+        return 0.0;
+    }
+    size_t i = ( size_t )( _p * ( _sorted.size() - 1 ) + 0.5 );
+    return _sorted[i] / 1000.0;
+}
+
+int main(
+    int _argc,
+    char** _argv ) {
+    int logins = gsseap_bench_default_logins;
+    const char* user = gsseap_bench_default_user;
+    gsseap_bench_side_t client_totals;
+    gsseap_bench_side_t server_totals;
+    std::vector<unsigned long long> login_us;
+    int opt;
+    int failed = 0;
+
+    while ( ( opt = getopt( _argc, _argv, "n:u:" ) ) != -1 ) {
+        switch ( opt ) {
+        case 'n':
+            logins = atoi( optarg );
+            break;
+        case 'u':
+            user = optarg;
+            break;
+        default:
+            fprintf( stderr, "usage: %s [-n logins] [-u user]\n", _argv[0] );
+            return 2;
+        }
+    }
+    if ( logins <= 0 ) {
+        fprintf( stderr, "gsseapHandshakeBench: -n must be positive\n" );
+        return 2;
+    }
+
+    memset( &client_totals, 0, sizeof( client_totals ) );
+    memset( &server_totals, 0, sizeof( server_totals ) );
+    gsseap_harness_set_hooks( &gsseap_bench_hooks );
+    gsseap_harness_load_plugin();
+
+    for ( int i = 0; i < logins; i++ ) {
+        gsseap_bench_agent_t agent;
+        pthread_t thread;
+        int sv[2];
+
+        if ( socketpair( AF_UNIX, SOCK_STREAM, 0, sv ) < 0 ) {
+            perror( "gsseapHandshakeBench: socketpair" );
+            return 1;
+        }
+        memset( &agent, 0, sizeof( agent ) );
+        agent.fd = sv[1];
+        if ( pthread_create( &thread, NULL, gsseap_bench_agent, &agent ) != 0 ) {
+            perror( "gsseapHandshakeBench: starting the agent" );
+            return 1;
+        }
+
+        unsigned long long start = gsseap_harness_now_us();
+        int status = gsseap_harness_login( sv[0], user, gsseap_bench_zone, gsseap_bench_client_addr );
+        unsigned long long us = gsseap_harness_now_us() - start;
+        gsseap_handshake_stats_t client_handshake = gsseap_session_get( sv[0] )->handshake;
+        gsseap_session_end( sv[0] );
+        close( sv[0] );
+        pthread_join( thread, NULL );
+
+        if ( status < 0 || agent.status < 0 ) {
+            fprintf( stderr, "gsseapHandshakeBench: login %d failed, client status %d, agent status %d\n", i, status, agent.status );
+            failed++;
+            continue;
+        }
+        login_us.push_back( us );
+        gsseap_bench_add( &client_totals, &client_handshake );
+        gsseap_bench_add( &server_totals, &agent.handshake );
+    }
+
+    int succeeded = ( int ) login_us.size();
+    std::sort( login_us.begin(), login_us.end() );
+    printf( "logins %d, failed %d, login p50 %.2f ms, p95 %.2f ms, max %.2f ms\n", logins, failed,
+            gsseap_bench_percentile( login_us, 0.50 ), gsseap_bench_percentile( login_us, 0.95 ),
+            gsseap_bench_percentile( login_us, 1.0 ) );
+    if ( succeeded == 0 ) {
+        return 1;
+    }
+
+    printf( "\nhandshake, mean per login (ms unless noted; mech on the server includes AAA)\n" );
+    printf( "%-7s %7s %7s %9s %9s %6s %9s %9s %9s %9s %9s\n",
+            "side", "rtts", "tokens", "bytes out", "bytes in", "steps", "mech", "max step", "wait", "plugin", "total" );
+    gsseap_bench_print_side( "client", &client_totals, succeeded );
+    gsseap_bench_print_side( "server", &server_totals, succeeded );
+
+    printf( "\nplugin operations (ms)\n" );
+    printf( "%-18s %7s %9s %9s %9s %9s\n", "operation", "calls", "mean", "p50", "p95", "max" );
+    for ( int op = 0; op < gsseap_bench_op_count; op++ ) {
+        std::vector<unsigned long long>& us = gsseap_bench_op_us[op];
+        unsigned long long sum = 0;
+        std::sort( us.begin(), us.end() );
+        for ( size_t i = 0; i < us.size(); i++ ) {
+            sum += us[i];
+        }
+        printf( "%-18s %7lu %9.2f %9.2f %9.2f %9.2f\n", gsseap_bench_ops[op], ( unsigned long ) us.size(),
+                us.empty() ? 0.0 : sum / 1000.0 / us.size(),
+                gsseap_bench_percentile( us, 0.50 ), gsseap_bench_percentile( us, 0.95 ), gsseap_bench_percentile( us, 1.0 ) );
+    }
+    return failed > 0 ? 1 : 0;
+}
@@ -0,0 +1,515 @@
+/* -*- mode: c++; fill-column: 132; c-basic-offset: 4; indent-tabs-mode: nil -*- */
+/* gsseapHarness.cpp
+ * Runs logins through the plugin's operations in the order clientLogin and the
+ * agent's API handler run them: client_start, client_request (answered by
+ * agent_request, followed by agent_start), establish_context and
+ * client_response (answered by agent_response).  The two API requests travel
+ * as small frames on the connection, everything else is the plugin's own
+ * traffic.  As in iRODS, the client uses one auth object for its operations
+ * and the agent a new one for each of its own.
+ */
+
+#include "rodsClient.hpp"
+#include "rcMisc.hpp"
+#include "irods_error.hpp"
+#include "irods_gsseap_object.hpp"
+#include "irods_auth_plugin.hpp"
+#include "authPluginRequest.hpp"
+#include "authResponse.hpp"
+
+#include "gsseapHarness.hpp"
+
+#include <string>
+
+#include <arpa/inet.h>
+#include <errno.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <poll.h>
+#include <signal.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/wait.h>
+#include <time.h>
+#include <unistd.h>
+
+extern "C" {
+    irods::error gsseap_auth_client_start( irods::auth_plugin_context& _ctx, rcComm_t* _comm, const char* _context );
+    irods::error gsseap_auth_client_request( irods::auth_plugin_context& _ctx, rcComm_t* _comm );
+    irods::error gsseap_auth_establish_context( irods::auth_plugin_context& _ctx );
+    irods::error gsseap_auth_client_response( irods::auth_plugin_context& _ctx, rcComm_t* _comm );
+    irods::error gsseap_auth_agent_request( irods::auth_plugin_context& _ctx );
+    irods::error gsseap_auth_agent_start( irods::auth_plugin_context& _ctx, const char* _context );
+    irods::error gsseap_auth_agent_response( irods::auth_plugin_context& _ctx, authResponseInp_t* _resp );
+    irods::auth* plugin_factory( const std::string& _inst_name, const std::string& _context );
+}
+
+// the frames carrying the API requests, a header of three network order words and the body
+enum {
+    GSSEAP_HARNESS_STARTUP = 1,        // user\0zone\0client address\0, the connection's startup pack
+    GSSEAP_HARNESS_REQUEST,            // the auth plugin request context
+    GSSEAP_HARNESS_REQUEST_REPLY,      // its status and result
+    GSSEAP_HARNESS_RESPONSE,           // response\0username\0
+    GSSEAP_HARNESS_RESPONSE_REPLY      // its status
+};
+
+static const uint32_t gsseap_harness_max_frame = 64 * 1024;
+static const int gsseap_harness_port = 1247;
+static const int gsseap_harness_backlog = 1024;
+static const int gsseap_harness_poll_ms = 100;
+
+static const gsseap_harness_hooks_t* gsseap_harness_hooks = NULL;
+static irods::auth* gsseap_harness_plugin = NULL;
+static volatile sig_atomic_t gsseap_harness_stopping = 0;
+
+void gsseap_harness_load_plugin() {
+    if ( gsseap_harness_plugin == NULL ) {
+        // a client writing to an agent that hung up gets EPIPE, as the iRODS client library arranges
+        signal( SIGPIPE, SIG_IGN );
+        gsseap_harness_plugin = plugin_factory( "gsseap", "" );
+    }
+}
+
+void gsseap_harness_set_hooks(
+    const gsseap_harness_hooks_t* _hooks ) {
+    gsseap_harness_hooks = _hooks;
+}
+
+unsigned long long gsseap_harness_now_us() {
+    struct timespec now;
+    clock_gettime( CLOCK_MONOTONIC, &now );
+    return ( unsigned long long ) now.tv_sec * 1000000ULL + now.tv_nsec / 1000;
+}
+
+void* gsseap_harness_shared(
+    size_t _size ) {
+    return mmap( NULL, _size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0 );
+}
+
+static void gsseap_harness_begin(
+    const char* _op ) {
+    if ( gsseap_harness_hooks != NULL && gsseap_harness_hooks->op_begin != NULL ) {
+        gsseap_harness_hooks->op_begin( _op );
+    }
+}
+
+/// @brief 0 or the code of _ret, reported to the hooks
+static int gsseap_harness_end(
+    const char* _op,
+    const irods::error& _ret ) {
+    int status = _ret.ok() ? 0 : _ret.code();
+    if ( status == 0 && !_ret.ok() ) {
+        status = SYS_INTERNAL_ERR;
+    }
+    if ( gsseap_harness_hooks != NULL && gsseap_harness_hooks->op_end != NULL ) {
+        gsseap_harness_hooks->op_end( _op, status );
+    }
+    return status;
+}
+
+static int gsseap_harness_write(
+    int _fd,
+    const void* _buf,
+    size_t _len ) {
+    const char* cp = ( const char* ) _buf;
+    while ( _len > 0 ) {
+        ssize_t n = send( _fd, cp, _len, MSG_NOSIGNAL );
+        if ( n < 0 && errno == EINTR ) {
+            continue;
+        }
+        if ( n <= 0 ) {
+            return SYS_HEADER_WRITE_LEN_ERR;
+        }
+        cp += n;
+        _len -= n;
+    }
+    return 0;
+}
+
+static int gsseap_harness_read(
+    int _fd,
+    void* _buf,
+    size_t _len ) {
+    char* cp = ( char* ) _buf;
+    while ( _len > 0 ) {
+        ssize_t n = read( _fd, cp, _len );
+        if ( n < 0 && errno == EINTR ) {
+            continue;
+        }
+        if ( n <= 0 ) {
+            return SYS_HEADER_READ_LEN_ERR;
+        }
+        cp += n;
+        _len -= n;
+    }
+    return 0;
+}
+
+static int gsseap_harness_send_frame(
+    int _fd,
+    uint32_t _type,
+    int _status,
+    const std::string& _body ) {
+    uint32_t header[3];
+    header[0] = htonl( _type );
+    header[1] = htonl( ( uint32_t ) _status );
+    header[2] = htonl( ( uint32_t ) _body.size() );
+    int status = gsseap_harness_write( _fd, header, sizeof( header ) );
+    if ( status == 0 && !_body.empty() ) {
+        status = gsseap_harness_write( _fd, _body.data(), _body.size() );
+    }
+    return status;
+}
+
+static int gsseap_harness_receive_frame(
+    int _fd,
+    uint32_t* _rtn_type,
+    int* _rtn_status,
+    std::string& _rtn_body ) {
+    uint32_t header[3];
+    int status = gsseap_harness_read( _fd, header, sizeof( header ) );
+    if ( status < 0 ) {
+        return status;
+    }
+    *_rtn_type = ntohl( header[0] );
+    *_rtn_status = ( int ) ntohl( header[1] );
+    uint32_t len = ntohl( header[2] );
+    if ( len > gsseap_harness_max_frame ) {
+        return SYS_HEADER_READ_LEN_ERR;
+    }
+    _rtn_body.assign( len, '\0' );
+    return len > 0 ? gsseap_harness_read( _fd, &_rtn_body[0], len ) : 0;
+}
+
+/// @brief The _index'th nul terminated field of _body, empty if there is none
+static std::string gsseap_harness_field(
+    const std::string& _body,
+    int _index ) {
+    size_t start = 0;
+    while ( _index-- > 0 ) {
+        start = _body.find( '\0', start );
+        if ( start == std::string::npos ) {
+            return "";
+        }
+        start++;
+    }
+    size_t end = _body.find( '\0', start );
+    return _body.substr( start, end == std::string::npos ? std::string::npos : end - start );
+}
+
+// =-=-=-=-=-=-=-
+// the client library's API calls, over the harness frames
+int rcAuthPluginRequest(
+    rcComm_t* _comm,
+    authPluginReqInp_t* _req_inp,
+    authPluginReqOut_t** _req_out ) {
+    uint32_t type;
+    int status;
+    std::string body;
+
+    *_req_out = NULL;
+    int ret = gsseap_harness_send_frame( _comm->sock, GSSEAP_HARNESS_REQUEST, 0, _req_inp->context_ );
+    if ( ret == 0 ) {
+        ret = gsseap_harness_receive_frame( _comm->sock, &type, &status, body );
+    }
+    if ( ret < 0 ) {
+        return ret;
+    }
+    if ( type != GSSEAP_HARNESS_REQUEST_REPLY ) {
+        return SYS_HEADER_READ_LEN_ERR;
+    }
+    if ( status < 0 ) {
+        return status;
+    }
+    *_req_out = ( authPluginReqOut_t* ) malloc( sizeof( authPluginReqOut_t ) );
+    if ( *_req_out == NULL ) {
+        return SYS_MALLOC_ERR;
+    }
+    snprintf( ( *_req_out )->result_, sizeof( ( *_req_out )->result_ ), "%s", body.c_str() );
+    return 0;
+}
+
+int rcAuthResponse(
+    rcComm_t* _comm,
+    authResponseInp_t* _resp ) {
+    uint32_t type;
+    int status;
+    std::string body = std::string( _resp->response ) + '\0' + _resp->username + '\0';
+
+    int ret = gsseap_harness_send_frame( _comm->sock, GSSEAP_HARNESS_RESPONSE, 0, body );
+    if ( ret == 0 ) {
+        ret = gsseap_harness_receive_frame( _comm->sock, &type, &status, body );
+    }
+    if ( ret < 0 ) {
+        return ret;
+    }
+    return type == GSSEAP_HARNESS_RESPONSE_REPLY ? status : SYS_HEADER_READ_LEN_ERR;
+}
+
+int gsseap_harness_login(
+    int _fd,
+    const char* _user,
+    const char* _zone,
+    const char* _client_addr ) {
+    rError_t errors;
+    rcComm_t comm;
+    irods::plugin_property_map prop_map;
+    int status;
+
+    status = gsseap_harness_send_frame( _fd, GSSEAP_HARNESS_STARTUP, 0,
+                                        std::string( _user ) + '\0' + _zone + '\0' + _client_addr + '\0' );
+    if ( status < 0 ) {
+        return status;
+    }
+
+    memset( &errors, 0, sizeof( errors ) );
+    memset( &comm, 0, sizeof( comm ) );
+    comm.sock = _fd;
+    comm.portNum = gsseap_harness_port;
+    comm.rError = &errors;
+    snprintf( comm.host, sizeof( comm.host ), "localhost" );
+    snprintf( comm.proxyUser.userName, sizeof( comm.proxyUser.userName ), "%s", _user );
+    snprintf( comm.proxyUser.rodsZone, sizeof( comm.proxyUser.rodsZone ), "%s", _zone );
+    comm.clientUser = comm.proxyUser;
+
+    irods::gsseap_auth_object_ptr auth_obj( new irods::gsseap_auth_object( &errors ) );
+    {
+        irods::auth_plugin_context ctx( NULL, prop_map, auth_obj, "" );
+        gsseap_harness_begin( "client_start" );
+        status = gsseap_harness_end( "client_start", gsseap_auth_client_start( ctx, &comm, "" ) );
+    }
+    if ( status == 0 ) {
+        irods::auth_plugin_context ctx( NULL, prop_map, auth_obj, "" );
+        gsseap_harness_begin( "client_request" );
+        status = gsseap_harness_end( "client_request", gsseap_auth_client_request( ctx, &comm ) );
+    }
+    if ( status == 0 ) {
+        irods::auth_plugin_context ctx( NULL, prop_map, auth_obj, "" );
+        gsseap_harness_begin( "establish_context" );
+        status = gsseap_harness_end( "establish_context", gsseap_auth_establish_context( ctx ) );
+    }
+    if ( status == 0 ) {
+        irods::auth_plugin_context ctx( NULL, prop_map, auth_obj, "" );
+        gsseap_harness_begin( "client_response" );
+        status = gsseap_harness_end( "client_response", gsseap_auth_client_response( ctx, &comm ) );
+    }
+
+    freeRErrorContent( &errors );
+    return status;
+}
+
+int gsseap_harness_serve(
+    int _fd ) {
+    rsComm_t comm;
+    irods::plugin_property_map prop_map;
+    int last_status = 0;
+    uint32_t type;
+    int status;
+    std::string body;
+
+    memset( &comm, 0, sizeof( comm ) );
+    comm.sock = _fd;
+
+    while ( gsseap_harness_receive_frame( _fd, &type, &status, body ) == 0 ) {
+        if ( type == GSSEAP_HARNESS_STARTUP ) {
+            snprintf( comm.proxyUser.userName, sizeof( comm.proxyUser.userName ), "%s", gsseap_harness_field( body, 0 ).c_str() );
+            snprintf( comm.proxyUser.rodsZone, sizeof( comm.proxyUser.rodsZone ), "%s", gsseap_harness_field( body, 1 ).c_str() );
+            snprintf( comm.clientAddr, sizeof( comm.clientAddr ), "%s", gsseap_harness_field( body, 2 ).c_str() );
+            snprintf( comm.myEnv.rodsZone, sizeof( comm.myEnv.rodsZone ), "%s", comm.proxyUser.rodsZone );
+            comm.clientUser = comm.proxyUser;
+        }
+        else if ( type == GSSEAP_HARNESS_REQUEST ) {
+            std::string result;
+            {
+                irods::gsseap_auth_object_ptr auth_obj( new irods::gsseap_auth_object( &comm.rError ) );
+                auth_obj->context( body.c_str() );
+                irods::auth_plugin_context ctx( &comm, prop_map, auth_obj, "" );
+                gsseap_harness_begin( "agent_request" );
+                status = gsseap_harness_end( "agent_request", gsseap_auth_agent_request( ctx ) );
+                result = auth_obj->request_result();
+            }
+            if ( status < 0 ) {
+                last_status = status;
+                result.clear();
+            }
+            if ( gsseap_harness_send_frame( _fd, GSSEAP_HARNESS_REQUEST_REPLY, status, result ) < 0 ) {
+                break;
+            }
+
+            // the API handler runs agent_start once the reply is out
+            if ( comm.gsiRequest == 1 ) {
+                comm.gsiRequest = 0;
+                irods::gsseap_auth_object_ptr auth_obj( new irods::gsseap_auth_object( &comm.rError ) );
+                irods::auth_plugin_context ctx( &comm, prop_map, auth_obj, "" );
+                gsseap_harness_begin( "agent_start" );
+                status = gsseap_harness_end( "agent_start", gsseap_auth_agent_start( ctx, "" ) );
+                if ( status < 0 ) {
+                    // the client may be waiting for a token that will not come, hanging up tells it
+                    last_status = status;
+                    break;
+                }
+            }
+        }
+        else if ( type == GSSEAP_HARNESS_RESPONSE ) {
+            std::string response = gsseap_harness_field( body, 0 );
+            std::string username = gsseap_harness_field( body, 1 );
+            authResponseInp_t resp;
+            resp.response = &response[0];
+            resp.username = &username[0];
+            {
+                irods::gsseap_auth_object_ptr auth_obj( new irods::gsseap_auth_object( &comm.rError ) );
+                irods::auth_plugin_context ctx( &comm, prop_map, auth_obj, "" );
+                gsseap_harness_begin( "agent_response" );
+                status = gsseap_harness_end( "agent_response", gsseap_auth_agent_response( ctx, &resp ) );
+            }
+            last_status = status;
+            if ( gsseap_harness_send_frame( _fd, GSSEAP_HARNESS_RESPONSE_REPLY, status, "" ) < 0 ) {
+                break;
+            }
+        }
+        else {
+            last_status = SYS_HEADER_READ_LEN_ERR;
+            break;
+        }
+    }
+
+    if ( comm.auth_scheme != NULL ) {
+        free( comm.auth_scheme );
+    }
+    freeRErrorContent( &comm.rError );
+    return last_status;
+}
+
+/// @brief Loopback sockets carry the small frames and tokens without waiting for more, as a latency-bound client would
+static void gsseap_harness_nodelay(
+    int _fd ) {
+    int on = 1;
+    ( void ) setsockopt( _fd, IPPROTO_TCP, TCP_NODELAY, &on, sizeof( on ) );
+}
+
+int gsseap_harness_listen(
+    int* _rtn_port ) {
+    struct sockaddr_in addr;
+    socklen_t len = sizeof( addr );
+    int on = 1;
+
+    int fd = socket( AF_INET, SOCK_STREAM, 0 );
+    if ( fd < 0 ) {
+        return -1;
+    }
+    memset( &addr, 0, sizeof( addr ) );
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl( INADDR_LOOPBACK );
+    addr.sin_port = 0;
+    ( void ) setsockopt( fd, SOL_SOCKET, SO_REUSEADDR, &on, sizeof( on ) );
+    if ( bind( fd, ( struct sockaddr* ) &addr, sizeof( addr ) ) < 0 || listen( fd, gsseap_harness_backlog ) < 0 ||
+            getsockname( fd, ( struct sockaddr* ) &addr, &len ) < 0 ) {
+        close( fd );
+        return -1;
+    }
+    *_rtn_port = ntohs( addr.sin_port );
+    return fd;
+}
+
+int gsseap_harness_connect(
+    int _port ) {
+    struct sockaddr_in addr;
+
+    int fd = socket( AF_INET, SOCK_STREAM, 0 );
+    if ( fd < 0 ) {
+        return -1;
+    }
+    memset( &addr, 0, sizeof( addr ) );
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl( INADDR_LOOPBACK );
+    addr.sin_port = htons( _port );
+    if ( connect( fd, ( struct sockaddr* ) &addr, sizeof( addr ) ) < 0 ) {
+        close( fd );
+        return -1;
+    }
+    gsseap_harness_nodelay( fd );
+    return fd;
+}
+
+static void gsseap_harness_stop(
+    int _signal ) {
+    gsseap_harness_stopping = 1;
+}
+
+/// @brief Reap agents into _stats, waiting for one if _block; false once there is none to reap
+static bool gsseap_harness_reap(
+    gsseap_harness_agent_stats_t* _stats,
+    bool _block ) {
+    struct rusage usage;
+    int wstatus;
+
+    pid_t pid = wait4( -1, &wstatus, _block ? 0 : WNOHANG, &usage );
+    if ( pid < 0 && errno == EINTR ) {
+        return true;
+    }
+    if ( pid <= 0 ) {
+        return false;
+    }
+    _stats->agents++;
+    if ( !WIFEXITED( wstatus ) || WEXITSTATUS( wstatus ) != 0 ) {
+        _stats->failures++;
+    }
+    _stats->cpu_us += ( unsigned long long )( usage.ru_utime.tv_sec + usage.ru_stime.tv_sec ) * 1000000ULL +
+                      usage.ru_utime.tv_usec + usage.ru_stime.tv_usec;
+    if ( usage.ru_maxrss > _stats->max_rss_kb ) {
+        _stats->max_rss_kb = usage.ru_maxrss;
+    }
+    return true;
+}
+
+pid_t gsseap_harness_start_server(
+    int _listen_fd,
+    gsseap_harness_agent_stats_t* _stats ) {
+    struct sigaction action;
+
+    pid_t server = fork();
+    if ( server != 0 ) {
+        return server;
+    }
+
+    memset( &action, 0, sizeof( action ) );
+    action.sa_handler = gsseap_harness_stop;
+    sigaction( SIGTERM, &action, NULL );
+
+    while ( !gsseap_harness_stopping ) {
+        struct pollfd pfd;
+        pfd.fd = _listen_fd;
+        pfd.events = POLLIN;
+        pfd.revents = 0;
+        if ( poll( &pfd, 1, gsseap_harness_poll_ms ) <= 0 ) {
+            while ( gsseap_harness_reap( _stats, false ) ) {
+            }
+            continue;
+        }
+        int fd = accept( _listen_fd, NULL, NULL );
+        if ( fd < 0 ) {
+            continue;
+        }
+        gsseap_harness_nodelay( fd );
+
+        // the agent of the connection, as irodsServer forks it; it loads the plugin itself
+        pid_t agent = fork();
+        if ( agent == 0 ) {
+            close( _listen_fd );
+            gsseap_harness_load_plugin();
+            int status = gsseap_harness_serve( fd );
+            close( fd );
+            _exit( status < 0 ? 1 : 0 );
+        }
+        close( fd );
+        while ( gsseap_harness_reap( _stats, false ) ) {
+        }
+    }
+
+    while ( gsseap_harness_reap( _stats, true ) ) {
+    }
+    _exit( 0 );
+}
@@ -0,0 +1,69 @@
+/* -*- mode: c++; fill-column: 132; c-basic-offset: 4; indent-tabs-mode: nil -*- */
+/* gsseapHarness.hpp
+ * Drives the plugin's operations the way the iRODS client library and agent
+ * call them, over a socket.  The catalog and the API requests that carry the
+ * auth request and response are replaced by the stand-ins of
+ * gsseapStandinCatalog.cpp, so no iRODS server is involved; the GSS mechanism
+ * is the stand-in of gsseapStandinGss.cpp or, for the benchmark, the real one.
+ */
+
+#ifndef GSSEAP_HARNESS_HPP
+#define GSSEAP_HARNESS_HPP
+
+#include <sys/resource.h>
+#include <sys/types.h>
+
+/// @brief Called around every plugin operation the harness runs, on the thread running it
+typedef struct {
+    void ( *op_begin )( const char* _op );
+    void ( *op_end )( const char* _op, int _status );
+} gsseap_harness_hooks_t;
+
+/// @brief Cost of the agents of a server started with gsseap_harness_start_server, in memory shared with its caller
+typedef struct {
+    volatile unsigned long agents;      // agents reaped so far
+    volatile unsigned long failures;    // agents whose last operation failed
+    volatile unsigned long long cpu_us; // user and system time of the reaped agents
+    volatile long max_rss_kb;           // largest peak RSS of a reaped agent
+} gsseap_harness_agent_stats_t;
+
+/// @brief Load the plugin in this process as iRODS does in every agent and client, once per process
+void gsseap_harness_load_plugin();
+
+/// @brief Set the hooks called around plugin operations, NULL for none; set before forking or starting threads
+void gsseap_harness_set_hooks(
+    const gsseap_harness_hooks_t* _hooks );
+
+/// @brief Serve the connection on _fd as an agent until the client closes it; 0 or the status of the last failed operation
+int gsseap_harness_serve(
+    int _fd );
+
+/// @brief Log in over _fd as _user#_zone, the agent sees the connection coming from _client_addr; 0 or the iRODS error
+int gsseap_harness_login(
+    int _fd,
+    const char* _user,
+    const char* _zone,
+    const char* _client_addr );
+
+/// @brief Listen on an ephemeral loopback port, returning the socket and the port in _rtn_port, -1 on error
+int gsseap_harness_listen(
+    int* _rtn_port );
+
+/// @brief Connect to the loopback _port, -1 on error
+int gsseap_harness_connect(
+    int _port );
+
+/// @brief Fork a server accepting connections on _listen_fd and forking an agent for each, as the iRODS server does;
+/// the agents it reaps are accounted in _stats.  Stop it with SIGTERM.
+pid_t gsseap_harness_start_server(
+    int _listen_fd,
+    gsseap_harness_agent_stats_t* _stats );
+
+/// @brief Shared memory for results of forked processes, zeroed, MAP_FAILED on error
+void* gsseap_harness_shared(
+    size_t _size );
+
+/// @brief Microseconds on a monotonic clock
+unsigned long long gsseap_harness_now_us();
+
+#endif  /* GSSEAP_HARNESS_HPP */
@@ -0,0 +1,246 @@
+/* -*- mode: c++; fill-column: 132; c-basic-offset: 4; indent-tabs-mode: nil -*- */
+/* gsseapImpairProxy.cpp
+ * A UDP relay that puts an impaired network between a RADIUS client and its
+ * server on loopback.  Every datagram, in either direction, is dropped with
+ * the given probability or delivered after the given delay plus a uniformly
+ * drawn jitter; jitter can reorder datagrams, as on a real path.  Each client
+ * address gets an upstream socket of its own, so replies find their way back.
+ *
+ * usage: gsseapImpairProxy -l listen port -u server host:port [-d delay ms] [-j jitter ms] [-p loss %] [-s seed]
+ */
+
+#include <queue>
+#include <string>
+#include <vector>
+
+#include <arpa/inet.h>
+#include <errno.h>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <poll.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <time.h>
+#include <unistd.h>
+
+static const size_t gsseap_impair_max_datagram = 65536;
+static const size_t gsseap_impair_max_clients = 256;
+
+/// @brief A datagram waiting out its delay
+typedef struct {
+    unsigned long long due_us;
+    unsigned long long seq;             // keeps datagrams due at the same time in arrival order
+    int fd;
+    struct sockaddr_in to;
+    std::string data;
+} gsseap_impair_datagram_t;
+
+struct gsseap_impair_later {
+    bool operator()(
+        const gsseap_impair_datagram_t* _a,
+        const gsseap_impair_datagram_t* _b ) const {
+        return _a->due_us != _b->due_us ? _a->due_us > _b->due_us : _a->seq > _b->seq;
+    }
+};
+
+static volatile sig_atomic_t gsseap_impair_stopping = 0;
+
+static void gsseap_impair_stop(
+    int _signal ) {
+    gsseap_impair_stopping = 1;
+}
+
+static unsigned long long gsseap_impair_now_us() {
+    struct timespec now;
+    clock_gettime( CLOCK_MONOTONIC, &now );
+    return ( unsigned long long ) now.tv_sec * 1000000 + now.tv_nsec / 1000;
+}
+
+static bool gsseap_impair_address(
+    const char* _host_port,
+    struct sockaddr_in* _rtn_addr ) {
+    std::string host = _host_port;
+    size_t colon = host.rfind( ':' );
+    struct addrinfo hints;
+    struct addrinfo* info;
+
+    if ( colon == std::string::npos ) {
+        return false;
+    }
+    memset( &hints, 0, sizeof( hints ) );
+    hints.ai_family = AF_INET;
+    hints.ai_socktype = SOCK_DGRAM;
+    if ( getaddrinfo( host.substr( 0, colon ).c_str(), host.substr( colon + 1 ).c_str(), &hints, &info ) != 0 ) {
+        return false;
+    }
+    memcpy( _rtn_addr, info->ai_addr, sizeof( *_rtn_addr ) );
+    freeaddrinfo( info );
+    return true;
+}
+
+static bool gsseap_impair_same(
+    const struct sockaddr_in& _a,
+    const struct sockaddr_in& _b ) {
+    return _a.sin_addr.s_addr == _b.sin_addr.s_addr && _a.sin_port == _b.sin_port;
+}
+
+int main(
+    int _argc,
+    char** _argv ) {
+    int listen_port = 0;
+    const char* server = NULL;
+    long delay_ms = 0;
+    long jitter_ms = 0;
+    double loss = 0.0;
+    unsigned int seed = ( unsigned int ) time( NULL );
+    int opt;
+
+    while ( ( opt = getopt( _argc, _argv, "l:u:d:j:p:s:" ) ) != -1 ) {
+        switch ( opt ) {
+        case 'l':
+            listen_port = atoi( optarg );
+            break;
+        case 'u':
+            server = optarg;
+            break;
+        case 'd':
+            delay_ms = atol( optarg );
+            break;
+        case 'j':
+            jitter_ms = atol( optarg );
+            break;
+        case 'p':
+            loss = atof( optarg ) / 100.0;
+            break;
+        case 's':
+            seed = ( unsigned int ) strtoul( optarg, NULL, 10 );
+            break;
+        default:
+            listen_port = 0;
+            break;
+        }
+    }
+    struct sockaddr_in server_addr;
+    if ( listen_port <= 0 || server == NULL || delay_ms < 0 || jitter_ms < 0 || !gsseap_impair_address( server, &server_addr ) ) {
+        fprintf( stderr, "usage: %s -l listen port -u server host:port [-d delay ms] [-j jitter ms] [-p loss %%] [-s seed]\n",
+                 _argv[0] );
+        return 2;
+    }
+    srand( seed );
+
+    int listen_fd = socket( AF_INET, SOCK_DGRAM, 0 );
+    struct sockaddr_in listen_addr;
+    memset( &listen_addr, 0, sizeof( listen_addr ) );
+    listen_addr.sin_family = AF_INET;
+    listen_addr.sin_addr.s_addr = htonl( INADDR_LOOPBACK );
+    listen_addr.sin_port = htons( listen_port );
+    if ( listen_fd < 0 || bind( listen_fd, ( struct sockaddr* ) &listen_addr, sizeof( listen_addr ) ) < 0 ) {
+        perror( "gsseapImpairProxy: binding the listening port" );
+        return 1;
+    }
+
+    signal( SIGTERM, gsseap_impair_stop );
+    signal( SIGINT, gsseap_impair_stop );
+
+    // the clients seen so far and the upstream socket relaying for each
+    std::vector<struct sockaddr_in> clients;
+    std::vector<int> upstream;
+    std::priority_queue<gsseap_impair_datagram_t*, std::vector<gsseap_impair_datagram_t*>, gsseap_impair_later> pending;
+    std::vector<char> buf( gsseap_impair_max_datagram );
+    unsigned long long seq = 0;
+    unsigned long long relayed = 0;
+    unsigned long long dropped = 0;
+
+    while ( !gsseap_impair_stopping ) {
+        std::vector<struct pollfd> pfds( 1 + upstream.size() );
+        pfds[0].fd = listen_fd;
+        pfds[0].events = POLLIN;
+        for ( size_t i = 0; i < upstream.size(); i++ ) {
+            pfds[i + 1].fd = upstream[i];
+            pfds[i + 1].events = POLLIN;
+        }
+
+        int timeout = -1;
+        if ( !pending.empty() ) {
+            unsigned long long now = gsseap_impair_now_us();
+            timeout = pending.top()->due_us > now ? ( int )( ( pending.top()->due_us - now + 999 ) / 1000 ) : 0;
+        }
+        if ( poll( &pfds[0], pfds.size(), timeout ) < 0 && errno != EINTR ) {
+            perror( "gsseapImpairProxy: poll" );
+            break;
+        }
+
+        for ( size_t i = 0; i < pfds.size(); i++ ) {
+            if ( !( pfds[i].revents & POLLIN ) ) {
+                continue;
+            }
+            struct sockaddr_in from;
+            socklen_t from_len = sizeof( from );
+            ssize_t len = recvfrom( pfds[i].fd, &buf[0], buf.size(), 0, ( struct sockaddr* ) &from, &from_len );
+            if ( len < 0 ) {
+                continue;
+            }
+
+            gsseap_impair_datagram_t* datagram = new gsseap_impair_datagram_t();
+            if ( i == 0 ) {
+                // from a client, relayed to the server over the client's own upstream socket
+                size_t c = 0;
+                while ( c < clients.size() && !gsseap_impair_same( clients[c], from ) ) {
+                    c++;
+                }
+                if ( c == clients.size() ) {
+                    int fd = clients.size() < gsseap_impair_max_clients ? socket( AF_INET, SOCK_DGRAM, 0 ) : -1;
+                    if ( fd < 0 ) {
+                        delete datagram;
+                        continue;
+                    }
+                    clients.push_back( from );
+                    upstream.push_back( fd );
+                }
+                datagram->fd = upstream[c];
+                datagram->to = server_addr;
+            }
+            else {
+                // from the server, back to the client the socket relays for
+                datagram->fd = listen_fd;
+                datagram->to = clients[i - 1];
+            }
+
+            if ( rand() < loss * ( ( double ) RAND_MAX + 1.0 ) ) {
+                dropped++;
+                delete datagram;
+                continue;
+            }
+            long jitter = jitter_ms > 0 ? rand() % ( jitter_ms + 1 ) : 0;
+            datagram->due_us = gsseap_impair_now_us() + ( delay_ms + jitter ) * 1000;
+            datagram->seq = seq++;
+            datagram->data.assign( &buf[0], len );
+            pending.push( datagram );
+        }
+
+        unsigned long long now = gsseap_impair_now_us();
+        while ( !pending.empty() && pending.top()->due_us <= now ) {
+            gsseap_impair_datagram_t* datagram = pending.top();
+            pending.pop();
+            if ( sendto( datagram->fd, datagram->data.data(), datagram->data.size(), 0, ( struct sockaddr* ) &datagram->to,
+                         sizeof( datagram->to ) ) >= 0 ) {
+                relayed++;
+            }
+            delete datagram;
+        }
+    }
+
+    fprintf( stderr, "gsseapImpairProxy: relayed %llu datagrams, dropped %llu\n", relayed, dropped );
+    while ( !pending.empty() ) {
+        delete pending.top();
+        pending.pop();
+    }
+    for ( size_t i = 0; i < upstream.size(); i++ ) {
+        close( upstream[i] );
+    }
+    close( listen_fd );
+    return 0;
+}
@@ -0,0 +1,191 @@
+/* -*- mode: c++; fill-column: 132; c-basic-offset: 4; indent-tabs-mode: nil -*- */
+/* gsseapLoadTest.cpp
+ * Load generator for server side logins.  For each concurrency level it starts
+ * a server that forks an agent per connection, as irodsServer does, and as
+ * many client processes, each logging in a number of times in a row over a
+ * new connection.  The catalog and the GSS mechanism are the stand-ins of
+ * gsseapStandin.hpp, so the figures are the plugin's and the agents' own.
+ *
+ * Unlike irodsServer, the harness forks its agents without exec'ing
+ * irodsAgent, so an agent starts with the harness mapped rather than the
+ * server binary; the plugin is loaded in each agent after the fork as in
+ * iRODS 4.1.
+ *
+ * usage: gsseapLoadTest [-c clients,clients,...] [-n logins per client]
+ */
+
+#include "gsseapHarness.hpp"
+#include "gsseapStandin.hpp"
+
+#include <algorithm>
+#include <string>
+#include <vector>
+
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+static const char* const gsseap_load_default_levels = "1,2,4,8,16,32";
+static const int gsseap_load_default_logins = 20;
+static const char* const gsseap_load_zone = "tempZone";
+static const char* const gsseap_load_client_addr = "127.0.0.1";
+
+/// @brief Run _logins logins in a row, recording each latency in _rtn_us, 0 for a failed one
+static int gsseap_load_client(
+    int _port,
+    int _client,
+    int _logins,
+    unsigned long long* _rtn_us ) {
+    char identity[64];
+    char user[64];
+    int failed = 0;
+
+    snprintf( user, sizeof( user ), "user%d", _client );
+    snprintf( identity, sizeof( identity ), "%s@example.org", user );
+    gsseap_standin_identity( identity );
+    gsseap_harness_load_plugin();
+
+    for ( int i = 0; i < _logins; i++ ) {
+        unsigned long long start = gsseap_harness_now_us();
+        int status = -1;
+        int fd = gsseap_harness_connect( _port );
+        if ( fd >= 0 ) {
+            status = gsseap_harness_login( fd, user, gsseap_load_zone, gsseap_load_client_addr );
+            close( fd );
+        }
+        if ( status < 0 ) {
+            fprintf( stderr, "gsseapLoadTest: client %d login %d failed, status %d\n", _client, i, status );
+            _rtn_us[i] = 0;
+            failed++;
+        }
+        else {
+            _rtn_us[i] = gsseap_harness_now_us() - start;
+        }
+    }
+    return failed;
+}
+
+static double gsseap_load_percentile(
+    const std::vector<unsigned long long>& _sorted,
+    double _p ) {
+    if ( _sorted.empty() ) {
+        return 0.0;
+    }
+    size_t i = ( size_t )( _p * ( _sorted.size() - 1 ) + 0.5 );
+    return _sorted[i] / 1000.0;
+}
+
+/// @brief Run one concurrency level and print its line; the number of failed logins, -1 if it could not run
+static int gsseap_load_level(
+    int _clients,
+    int _logins ) {
+    int port;
+    int failed = 0;
+    std::vector<pid_t> pids;
+
+    int listen_fd = gsseap_harness_listen( &port );
+    gsseap_harness_agent_stats_t* stats = ( gsseap_harness_agent_stats_t* ) gsseap_harness_shared( sizeof( *stats ) );
+    size_t latencies_size = sizeof( unsigned long long ) * _clients * _logins;
+    unsigned long long* latencies = ( unsigned long long* ) gsseap_harness_shared( latencies_size );
+    if ( listen_fd < 0 || stats == MAP_FAILED || latencies == MAP_FAILED ) {
+        perror( "gsseapLoadTest: setting up" );
+        return -1;
+    }
+
+    pid_t server = gsseap_harness_start_server( listen_fd, stats );
+    if ( server < 0 ) {
+        perror( "gsseapLoadTest: starting the server" );
+        return -1;
+    }
+
+    unsigned long long start = gsseap_harness_now_us();
+    for ( int c = 0; c < _clients; c++ ) {
+        pid_t pid = fork();
+        if ( pid == 0 ) {
+            close( listen_fd );
+            _exit( gsseap_load_client( port, c, _logins, latencies + c * _logins ) > 0 ? 1 : 0 );
+        }
+        if ( pid < 0 ) {
+            perror( "gsseapLoadTest: forking a client" );
+            break;
+        }
+        pids.push_back( pid );
+    }
+    for ( size_t i = 0; i < pids.size(); i++ ) {
+        ( void ) waitpid( pids[i], NULL, 0 );
+    }
+    unsigned long long wall_us = gsseap_harness_now_us() - start;
+
+    kill( server, SIGTERM );
+    ( void ) waitpid( server, NULL, 0 );
+    close( listen_fd );
+
+    std::vector<unsigned long long> sorted;
+    for ( int i = 0; i < _clients * _logins; i++ ) {
+        if ( latencies[i] > 0 ) {
+            sorted.push_back( latencies[i] );
+        }
+    }
+    std::sort( sorted.begin(), sorted.end() );
+    failed = _clients * _logins - ( int ) sorted.size();
+
+    printf( "%7d %7d %6d %9.1f %8.2f %8.2f %8.2f %12.3f %9ld\n",
+            _clients, _clients * _logins, failed,
+            wall_us > 0 ? sorted.size() * 1e6 / wall_us : 0.0,
+            gsseap_load_percentile( sorted, 0.50 ), gsseap_load_percentile( sorted, 0.95 ), gsseap_load_percentile( sorted, 0.99 ),
+            stats->agents > 0 ? stats->cpu_us / 1000.0 / stats->agents : 0.0,
+            stats->max_rss_kb );
+    fflush( stdout );
+
+    munmap( latencies, latencies_size );
+    munmap( stats, sizeof( *stats ) );
+    return failed;
+}
+
+int main(
+    int _argc,
+    char** _argv ) {
+    std::string levels = gsseap_load_default_levels;
+    int logins = gsseap_load_default_logins;
+    int opt;
+    int failed = 0;
+
+    while ( ( opt = getopt( _argc, _argv, "c:n:" ) ) != -1 ) {
+        switch ( opt ) {
+        case 'c':
+            levels = optarg;
+            break;
+        case 'n':
+            logins = atoi( optarg );
+            break;
+        default:
+            fprintf( stderr, "usage: %s [-c clients,clients,...] [-n logins per client]\n", _argv[0] );
+            return 2;
+        }
+    }
+    if ( logins <= 0 ) {
+        fprintf( stderr, "gsseapLoadTest: -n must be positive\n" );
+        return 2;
+    }
+
+    printf( "%7s %7s %6s %9s %8s %8s %8s %12s %9s\n",
+            "clients", "logins", "failed", "logins/s", "p50 ms", "p95 ms", "p99 ms", "cpu ms/login", "rss kB" );
+    size_t pos = 0;
+    while ( pos < levels.size() ) {
+        size_t comma = levels.find( ',', pos );
+        std::string level = levels.substr( pos, comma == std::string::npos ? std::string::npos : comma - pos );
+        pos = comma == std::string::npos ? levels.size() : comma + 1;
+        int clients = atoi( level.c_str() );
+        if ( clients <= 0 ) {
+            fprintf( stderr, "gsseapLoadTest: ignoring concurrency level \"%s\"\n", level.c_str() );
+            continue;
+        }
+        int level_failed = gsseap_load_level( clients, logins );
+        failed += level_failed != 0 ? 1 : 0;
+    }
+    return failed > 0 ? 1 : 0;
+}
@@ -0,0 +1,38 @@
+/* -*- mode: c++; fill-column: 132; c-basic-offset: 4; indent-tabs-mode: nil -*- */
+/* gsseapStandin.hpp
+ * Local stand-ins for what the plugin talks to in production.
+ *
+ * The catalog (gsseapStandinCatalog.cpp) knows every GSS-EAP name: the iRODS
+ * user of "user@realm" is "user", in the zone GSSEAP_STANDIN_ZONE (tempZone).
+ * Names starting with "unknown" have no user.  Catalog queries take
+ * GSSEAP_STANDIN_CATALOG_DELAY_MS.
+ *
+ * The GSS mechanism (gsseapStandinGss.cpp) completes a context after
+ * GSSEAP_STANDIN_ROUNDS accept steps (3), each after the first standing for an
+ * exchange with the AAA backend that takes GSSEAP_STANDIN_AAA_DELAY_MS.  The
+ * initiator is GSSEAP_STANDIN_IDENTITY (alice@example.org) unless its thread
+ * chose another; the AAA backend rejects names starting with "reject".  It
+ * never answers for names starting with "unanswered", and for the realm
+ * GSSEAP_STANDIN_AAA_DOWN_REALM it answers the first exchange only; a step
+ * the backend does not answer fails with GSS_S_UNAVAILABLE.
+ */
+
+#ifndef GSSEAP_STANDIN_HPP
+#define GSSEAP_STANDIN_HPP
+
+/// @brief Handshakes inside the AAA backend, in memory shared by the processes of a test
+typedef struct {
+    volatile int running;
+    volatile int peak;
+    volatile unsigned long exchanges;
+} gsseap_standin_aaa_t;
+
+/// @brief The initiator name of the contexts this thread initiates, NULL for the default
+void gsseap_standin_identity(
+    const char* _identity );
+
+/// @brief Account the AAA exchanges of the stand-in mechanism in _aaa, NULL to stop; set before forking
+void gsseap_standin_track_aaa(
+    gsseap_standin_aaa_t* _aaa );
+
+#endif  /* GSSEAP_STANDIN_HPP */
@@ -0,0 +1,238 @@
+/* -*- mode: c++; fill-column: 132; c-basic-offset: 4; indent-tabs-mode: nil -*- */
+/* gsseapStandinCatalog.cpp
+ * The server functions the plugin calls in the agent, standing in for the
+ * catalog of a zone, see gsseapStandin.hpp.  Every GSS-EAP name maps to the
+ * user named by its local part; the user "rods" is a rodsadmin.
+ */
+
+#include "authenticate.hpp"
+#include "reFuncDefs.hpp"
+#include "rodsErrorTable.hpp"
+#include "miscServerFunct.hpp"
+#include "authRequest.hpp"
+#include "authCheck.hpp"
+#include "genQuery.hpp"
+
+#include "gsseapStandin.hpp"
+#include "gsseapUtil.hpp"
+
+#include <errno.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+static const char* const gsseap_standin_default_zone = "tempZone";
+static const char* const gsseap_standin_user_id = "10001";
+
+static const char* gsseap_standin_zone() {
+    const char* zone = gsseap_env_string( "GSSEAP_STANDIN_ZONE" );
+    return zone != NULL ? zone : gsseap_standin_default_zone;
+}
+
+/// @brief The value of a condition "='value'", copied to _buf
+static void gsseap_standin_condition(
+    const char* _condition,
+    char* _buf,
+    size_t _size ) {
+    const char* value = _condition;
+    size_t len;
+
+    if ( strncmp( value, "='", 2 ) == 0 ) {
+        value += 2;
+    }
+    len = strlen( value );
+    if ( len > 0 && value[len - 1] == '\'' ) {
+        len--;
+    }
+    if ( len >= _size ) {
+        len = _size - 1;
+    }
+    memcpy( _buf, value, len );
+    _buf[len] = '\0';
+}
+
+int rsGenQuery(
+    rsComm_t* _comm,
+    genQueryInp_t* _inp,
+    genQueryOut_t** _out ) {
+    char dn[MAX_NAME_LEN] = "";
+    char user[NAME_LEN] = "";
+    char zone[NAME_LEN] = "";
+    char local[NAME_LEN];
+    const char* at;
+    long delay = gsseap_env_long( "GSSEAP_STANDIN_CATALOG_DELAY_MS", 0 );
+    int i;
+
+    *_out = NULL;
+    if ( delay > 0 ) {
+        struct timespec wait;
+        wait.tv_sec = delay / 1000;
+        wait.tv_nsec = ( delay % 1000 ) * 1000000;
+        while ( nanosleep( &wait, &wait ) != 0 && errno == EINTR ) {
+        }
+    }
+
+    for ( i = 0; i < _inp->sqlCondInp.len; i++ ) {
+        switch ( _inp->sqlCondInp.inx[i] ) {
+        case COL_USER_DN:
+            gsseap_standin_condition( _inp->sqlCondInp.value[i], dn, sizeof( dn ) );
+            break;
+        case COL_USER_NAME:
+            gsseap_standin_condition( _inp->sqlCondInp.value[i], user, sizeof( user ) );
+            break;
+        case COL_USER_ZONE:
+            gsseap_standin_condition( _inp->sqlCondInp.value[i], zone, sizeof( zone ) );
+            break;
+        default:
+            return CAT_NO_ROWS_FOUND;
+        }
+    }
+
+    // the user of a DN is its local part, a lookup by name finds every user of the zone
+    if ( dn[0] != '\0' ) {
+        at = strchr( dn, '@' );
+        snprintf( local, sizeof( local ), "%.*s", at != NULL ? ( int )( at - dn ) : ( int ) strlen( dn ), dn );
+        if ( strncmp( dn, "unknown", 7 ) == 0 || ( user[0] != '\0' && strcmp( user, local ) != 0 ) ) {
+            return CAT_NO_ROWS_FOUND;
+        }
+    }
+    else if ( user[0] != '\0' && strncmp( user, "unknown", 7 ) != 0 ) {
+        snprintf( local, sizeof( local ), "%s", user );
+    }
+    else {
+        return CAT_NO_ROWS_FOUND;
+    }
+    if ( zone[0] != '\0' && strcmp( zone, gsseap_standin_zone() ) != 0 ) {
+        return CAT_NO_ROWS_FOUND;
+    }
+
+    genQueryOut_t* out = ( genQueryOut_t* ) calloc( 1, sizeof( genQueryOut_t ) );
+    if ( out == NULL ) {
+        return SYS_MALLOC_ERR;
+    }
+    out->rowCnt = 1;
+    out->attriCnt = _inp->selectInp.len;
+    for ( i = 0; i < _inp->selectInp.len && i < MAX_SQL_ATTR; i++ ) {
+        const char* value;
+        switch ( _inp->selectInp.inx[i] ) {
+        case COL_USER_ID:
+            value = gsseap_standin_user_id;
+            break;
+        case COL_USER_TYPE:
+            value = strcmp( local, "rods" ) == 0 ? "rodsadmin" : "rodsuser";
+            break;
+        case COL_USER_NAME:
+            value = local;
+            break;
+        case COL_USER_ZONE:
+            value = gsseap_standin_zone();
+            break;
+        default:
+            value = "";
+            break;
+        }
+        out->sqlResult[i].attriInx = _inp->selectInp.inx[i];
+        out->sqlResult[i].len = strlen( value ) + 1;
+        out->sqlResult[i].value = strdup( value );
+        if ( out->sqlResult[i].value == NULL ) {
+            freeGenQueryOut( &out );
+            return SYS_MALLOC_ERR;
+        }
+    }
+    *_out = out;
+    return 0;
+}
+
+int rsAuthCheck(
+    rsComm_t* _comm,
+    authCheckInp_t* _inp,
+    authCheckOut_t** _out ) {
+    char user[NAME_LEN];
+    char zone[NAME_LEN];
+
+    // the response only stands for a client that agent_start authenticated
+    *_out = NULL;
+    if ( _comm->proxyUser.authInfo.authFlag == NO_USER_AUTH ) {
+        return CAT_INVALID_AUTHENTICATION;
+    }
+    *_out = ( authCheckOut_t* ) calloc( 1, sizeof( authCheckOut_t ) );
+    if ( *_out == NULL ) {
+        return SYS_MALLOC_ERR;
+    }
+    parseUserName( _inp->username, user, zone );
+    ( *_out )->privLevel = strcmp( user, "rods" ) == 0 ? LOCAL_PRIV_USER_AUTH : LOCAL_USER_AUTH;
+    ( *_out )->clientPrivLevel = ( *_out )->privLevel;
+    return 0;
+}
+
+int chkProxyUserPriv(
+    rsComm_t* _comm,
+    int _proxy_user_priv ) {
+    return 0;
+}
+
+int applyRuleArgPA(
+    const char* _action,
+    const char* _args[MAX_NUM_OF_ARGS_IN_ACTION],
+    int _argc,
+    msParamArray_t* _in_ms_param_array,
+    ruleExecInfo_t* _rei,
+    int _rei_save_flag ) {
+    return 0;
+}
+
+// the catalog is local, so there is no connection to make; agents on several threads share the host and the zone
+static pthread_once_t gsseap_standin_once = PTHREAD_ONCE_INIT;
+static rodsServerHost_t gsseap_standin_host;
+static zoneInfo_t gsseap_standin_zone_info;
+
+static void gsseap_standin_init() {
+    gsseap_standin_host.localFlag = LOCAL_HOST;
+    gsseap_standin_host.rcatEnabled = LOCAL_ICAT;
+    gsseap_standin_host.conn = NULL;
+    snprintf( gsseap_standin_zone_info.zoneName, sizeof( gsseap_standin_zone_info.zoneName ), "%s", gsseap_standin_zone() );
+}
+
+static rodsServerHost_t* gsseap_standin_rcat_host() {
+    pthread_once( &gsseap_standin_once, gsseap_standin_init );
+    return &gsseap_standin_host;
+}
+
+int getAndConnRcatHost(
+    rsComm_t* _comm,
+    int _rcat_type,
+    const char* _rcat_zone_hint,
+    rodsServerHost_t** _rtn_host ) {
+    *_rtn_host = gsseap_standin_rcat_host();
+    return LOCAL_HOST;
+}
+
+int getAndConnRcatHostNoLogin(
+    rsComm_t* _comm,
+    int _rcat_type,
+    const char* _rcat_zone_hint,
+    rodsServerHost_t** _rtn_host ) {
+    *_rtn_host = gsseap_standin_rcat_host();
+    return LOCAL_HOST;
+}
+
+int getLocalZoneInfo(
+    zoneInfo_t** _rtn_zone_info ) {
+    pthread_once( &gsseap_standin_once, gsseap_standin_init );
+    *_rtn_zone_info = &gsseap_standin_zone_info;
+    return 0;
+}
+
+int getZoneServerId(
+    char* _zone_name,
+    char* _rtn_zone_sid ) {
+    _rtn_zone_sid[0] = '\0';
+    return 0;
+}
+
+char* _rsAuthRequestGetChallenge() {
+    static char challenge[CHALLENGE_LEN + 2];
+    return challenge;
+}
@@ -0,0 +1,675 @@
+/* -*- mode: c++; fill-column: 132; c-basic-offset: 4; indent-tabs-mode: nil -*- */
+/* gsseapStandinGss.cpp
+ * The stand-in GSS mechanism of the tests, see gsseapStandin.hpp.  Its tokens
+ * are short text messages, its names plain strings and its message protection
+ * the identity transform.  It offers the GSS-EAP mechanism OIDs, so the plugin
+ * negotiates with it as it does with Moonshot.
+ */
+
+#include "gsseapStandin.hpp"
+#include "gsseapUtil.hpp"
+
+#include <gssapi.h>
+#include <gssapi_ext.h>
+
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+static const unsigned int gsseap_standin_name_size = 256;
+static const OM_uint32 gsseap_standin_lifetime = 3600;
+static const OM_uint32 gsseap_standin_flags = GSS_C_MUTUAL_FLAG | GSS_C_REPLAY_FLAG | GSS_C_SEQUENCE_FLAG | GSS_C_CONF_FLAG |
+                                              GSS_C_INTEG_FLAG;
+static const char* const gsseap_standin_default_identity = "alice@example.org";
+
+// eap-aes256 and eap-aes128, 1.3.6.1.5.5.15.1.1.18 and 1.3.6.1.5.5.15.1.1.17
+static unsigned char gsseap_standin_aes256_der[] = { 0x2b, 0x06, 0x01, 0x05, 0x05, 0x0f, 0x01, 0x01, 0x12 };
+static unsigned char gsseap_standin_aes128_der[] = { 0x2b, 0x06, 0x01, 0x05, 0x05, 0x0f, 0x01, 0x01, 0x11 };
+static gss_OID_desc gsseap_standin_mechs[] = {
+    { sizeof( gsseap_standin_aes256_der ), gsseap_standin_aes256_der },
+    { sizeof( gsseap_standin_aes128_der ), gsseap_standin_aes128_der }
+};
+
+struct gss_name_struct {
+    char value[gsseap_standin_name_size];
+};
+
+struct gss_cred_id_struct {
+    gss_cred_usage_t usage;
+};
+
+struct gss_ctx_id_struct {
+    int initiator;
+    int open;
+    unsigned int round;                  // of the last token
+    gss_OID mech;
+    char peer[gsseap_standin_name_size]; // the initiator, known to the acceptor from the first token
+};
+
+static __thread char gsseap_standin_thread_identity[gsseap_standin_name_size];
+static gsseap_standin_aaa_t* gsseap_standin_aaa = NULL;
+
+void gsseap_standin_identity(
+    const char* _identity ) {
+    snprintf( gsseap_standin_thread_identity, sizeof( gsseap_standin_thread_identity ), "%s", _identity != NULL ? _identity : "" );
+}
+
+void gsseap_standin_track_aaa(
+    gsseap_standin_aaa_t* _aaa ) {
+    gsseap_standin_aaa = _aaa;
+}
+
+static const char* gsseap_standin_initiator() {
+    if ( gsseap_standin_thread_identity[0] != '\0' ) {
+        return gsseap_standin_thread_identity;
+    }
+    const char* identity = gsseap_env_string( "GSSEAP_STANDIN_IDENTITY" );
+    return identity != NULL ? identity : gsseap_standin_default_identity;
+}
+
+/// @brief The exchange of round _round with the AAA backend for _peer, which takes GSSEAP_STANDIN_AAA_DELAY_MS; false if
+/// the backend did not answer
+static bool gsseap_standin_aaa_exchange(
+    const char* _peer,
+    unsigned int _round ) {
+    long delay = gsseap_env_long( "GSSEAP_STANDIN_AAA_DELAY_MS", 0 );
+    const char* down = gsseap_env_string( "GSSEAP_STANDIN_AAA_DOWN_REALM" );
+    const char* at = strrchr( _peer, '@' );
+    gsseap_standin_aaa_t* aaa = gsseap_standin_aaa;
+
+    if ( aaa != NULL ) {
+        int running = __sync_add_and_fetch( &aaa->running, 1 );
+        int peak = aaa->peak;
+        while ( running > peak && !__sync_bool_compare_and_swap( &aaa->peak, peak, running ) ) {
+            peak = aaa->peak;
+        }
+        __sync_add_and_fetch( &aaa->exchanges, 1 );
+    }
+    if ( delay > 0 ) {
+        struct timespec wait;
+        wait.tv_sec = delay / 1000;
+        wait.tv_nsec = ( delay % 1000 ) * 1000000;
+        while ( nanosleep( &wait, &wait ) != 0 && errno == EINTR ) {
+        }
+    }
+    if ( aaa != NULL ) {
+        __sync_sub_and_fetch( &aaa->running, 1 );
+    }
+
+    // the messages of an "unanswered" initiator are dropped, and the backend of the down realm stops after its first answer
+    if ( strncmp( _peer, "unanswered", 10 ) == 0 ) {
+        return false;
+    }
+    return _round <= 2 || down == NULL || at == NULL || strcmp( at + 1, down ) != 0;
+}
+
+/// @brief Copy _text into _rtn_buffer, allocated for the caller to release with gss_release_buffer
+static OM_uint32 gsseap_standin_buffer(
+    const char* _text,
+    gss_buffer_t _rtn_buffer ) {
+    _rtn_buffer->length = strlen( _text );
+    _rtn_buffer->value = NULL;
+    if ( _rtn_buffer->length > 0 ) {
+        _rtn_buffer->value = malloc( _rtn_buffer->length );
+        if ( _rtn_buffer->value == NULL ) {
+            _rtn_buffer->length = 0;
+            return GSS_S_FAILURE;
+        }
+        memcpy( _rtn_buffer->value, _text, _rtn_buffer->length );
+    }
+    return GSS_S_COMPLETE;
+}
+
+/// @brief Parse a token "<_kind> <round> <rest>"
+static bool gsseap_standin_parse(
+    gss_buffer_t _token,
+    char _kind,
+    unsigned int* _rtn_round,
+    char* _rtn_rest,
+    size_t _rest_size ) {
+    char text[gsseap_standin_name_size + 32];
+    char* end;
+
+    if ( _token == GSS_C_NO_BUFFER || _token->length < 3 || _token->length >= sizeof( text ) ) {
+        return false;
+    }
+    memcpy( text, _token->value, _token->length );
+    text[_token->length] = '\0';
+    if ( text[0] != _kind || text[1] != ' ' ) {
+        return false;
+    }
+    *_rtn_round = strtoul( text + 2, &end, 10 );
+    if ( end == text + 2 || *_rtn_round == 0 ) {
+        return false;
+    }
+    while ( *end == ' ' ) {
+        end++;
+    }
+    snprintf( _rtn_rest, _rest_size, "%s", end );
+    return true;
+}
+
+static gss_name_t gsseap_standin_name(
+    const char* _value,
+    size_t _length ) {
+    gss_name_t name = ( gss_name_t ) malloc( sizeof( *name ) );
+    if ( name != NULL ) {
+        if ( _length >= sizeof( name->value ) ) {
+            _length = sizeof( name->value ) - 1;
+        }
+        memcpy( name->value, _value, _length );
+        name->value[_length] = '\0';
+    }
+    return name;
+}
+
+extern "C" {
+
+    OM_uint32 gss_acquire_cred(
+        OM_uint32* _minor_status,
+        gss_name_t _desired_name,
+        OM_uint32 _time_req,
+        gss_OID_set _desired_mechs,
+        gss_cred_usage_t _cred_usage,
+        gss_cred_id_t* _output_cred,
+        gss_OID_set* _actual_mechs,
+        OM_uint32* _time_rec ) {
+        *_minor_status = 0;
+        *_output_cred = ( gss_cred_id_t ) malloc( sizeof( **_output_cred ) );
+        if ( *_output_cred == NULL ) {
+            return GSS_S_FAILURE;
+        }
+        ( *_output_cred )->usage = _cred_usage;
+        if ( _actual_mechs != NULL ) {
+            *_actual_mechs = GSS_C_NO_OID_SET;
+        }
+        if ( _time_rec != NULL ) {
+            *_time_rec = GSS_C_INDEFINITE;
+        }
+        return GSS_S_COMPLETE;
+    }
+
+    OM_uint32 gss_release_cred(
+        OM_uint32* _minor_status,
+        gss_cred_id_t* _cred ) {
+        *_minor_status = 0;
+        if ( _cred != NULL && *_cred != GSS_C_NO_CREDENTIAL ) {
+            free( *_cred );
+            *_cred = GSS_C_NO_CREDENTIAL;
+        }
+        return GSS_S_COMPLETE;
+    }
+
+    OM_uint32 gss_set_neg_mechs(
+        OM_uint32* _minor_status,
+        gss_cred_id_t _cred,
+        const gss_OID_set _mechs ) {
+        *_minor_status = 0;
+        return GSS_S_COMPLETE;
+    }
+
+    OM_uint32 gss_set_cred_option(
+        OM_uint32* _minor_status,
+        gss_cred_id_t* _cred,
+        const gss_OID _option,
+        const gss_buffer_t _value ) {
+        *_minor_status = 0;
+        return GSS_S_UNAVAILABLE;
+    }
+
+    OM_uint32 gss_import_name(
+        OM_uint32* _minor_status,
+        gss_buffer_t _input_name,
+        gss_OID _name_type,
+        gss_name_t* _output_name ) {
+        const char* value = ( const char* ) _input_name->value;
+        size_t length = 0;
+
+        *_minor_status = 0;
+        while ( length < _input_name->length && value[length] != '\0' ) {
+            length++;
+        }
+        *_output_name = gsseap_standin_name( value, length );
+        return *_output_name != GSS_C_NO_NAME ? GSS_S_COMPLETE : GSS_S_FAILURE;
+    }
+
+    OM_uint32 gss_display_name(
+        OM_uint32* _minor_status,
+        gss_name_t _name,
+        gss_buffer_t _output_name,
+        gss_OID* _output_name_type ) {
+        *_minor_status = 0;
+        if ( _name == GSS_C_NO_NAME ) {
+            return GSS_S_BAD_NAME;
+        }
+        if ( _output_name_type != NULL ) {
+            *_output_name_type = GSS_C_NO_OID;
+        }
+        return gsseap_standin_buffer( _name->value, _output_name );
+    }
+
+    OM_uint32 gss_release_name(
+        OM_uint32* _minor_status,
+        gss_name_t* _name ) {
+        *_minor_status = 0;
+        if ( _name != NULL && *_name != GSS_C_NO_NAME ) {
+            free( *_name );
+            *_name = GSS_C_NO_NAME;
+        }
+        return GSS_S_COMPLETE;
+    }
+
+    OM_uint32 gss_get_name_attribute(
+        OM_uint32* _minor_status,
+        gss_name_t _name,
+        gss_buffer_t _attr,
+        int* _authenticated,
+        int* _complete,
+        gss_buffer_t _value,
+        gss_buffer_t _display_value,
+        int* _more ) {
+        *_minor_status = 0;
+        *_more = 0;
+        return GSS_S_UNAVAILABLE;
+    }
+
+    OM_uint32 gss_init_sec_context(
+        OM_uint32* _minor_status,
+        gss_cred_id_t _claimant_cred,
+        gss_ctx_id_t* _context,
+        gss_name_t _target_name,
+        gss_OID _mech_type,
+        OM_uint32 _req_flags,
+        OM_uint32 _time_req,
+        gss_channel_bindings_t _bindings,
+        gss_buffer_t _input_token,
+        gss_OID* _actual_mech_type,
+        gss_buffer_t _output_token,
+        OM_uint32* _ret_flags,
+        OM_uint32* _time_rec ) {
+        gss_ctx_id_t context = *_context;
+        char text[gsseap_standin_name_size + 32];
+        char rest[gsseap_standin_name_size];
+        unsigned int round;
+
+        *_minor_status = 0;
+        _output_token->length = 0;
+        _output_token->value = NULL;
+        if ( context == GSS_C_NO_CONTEXT ) {
+            context = ( gss_ctx_id_t ) calloc( 1, sizeof( *context ) );
+            if ( context == NULL ) {
+                return GSS_S_FAILURE;
+            }
+            context->initiator = 1;
+            context->round = 1;
+            context->mech = _mech_type != GSS_C_NO_OID ? _mech_type : &gsseap_standin_mechs[0];
+            snprintf( context->peer, sizeof( context->peer ), "%s", gsseap_standin_initiator() );
+            *_context = context;
+            snprintf( text, sizeof( text ), "I 1 %s", context->peer );
+        }
+        else if ( !gsseap_standin_parse( _input_token, 'A', &round, rest, sizeof( rest ) ) || round != context->round ) {
+            return GSS_S_DEFECTIVE_TOKEN;
+        }
+        else if ( strcmp( rest, "1" ) == 0 ) {
+            context->open = 1;
+            text[0] = '\0';
+        }
+        else {
+            context->round++;
+            snprintf( text, sizeof( text ), "I %u", context->round );
+        }
+
+        if ( _actual_mech_type != NULL ) {
+            *_actual_mech_type = context->mech;
+        }
+        if ( _ret_flags != NULL ) {
+            *_ret_flags = _req_flags & gsseap_standin_flags;
+        }
+        if ( _time_rec != NULL ) {
+            *_time_rec = gsseap_standin_lifetime;
+        }
+        if ( gsseap_standin_buffer( text, _output_token ) != GSS_S_COMPLETE ) {
+            return GSS_S_FAILURE;
+        }
+        return context->open ? GSS_S_COMPLETE : GSS_S_CONTINUE_NEEDED;
+    }
+
+    OM_uint32 gss_accept_sec_context(
+        OM_uint32* _minor_status,
+        gss_ctx_id_t* _context,
+        gss_cred_id_t _acceptor_cred,
+        gss_buffer_t _input_token,
+        gss_channel_bindings_t _bindings,
+        gss_name_t* _src_name,
+        gss_OID* _mech_type,
+        gss_buffer_t _output_token,
+        OM_uint32* _ret_flags,
+        OM_uint32* _time_rec,
+        gss_cred_id_t* _delegated_cred ) {
+        gss_ctx_id_t context = *_context;
+        long rounds = gsseap_env_long( "GSSEAP_STANDIN_ROUNDS", 3 );
+        char text[32];
+        char rest[gsseap_standin_name_size];
+        unsigned int round;
+
+        *_minor_status = 0;
+        _output_token->length = 0;
+        _output_token->value = NULL;
+        if ( _src_name != NULL ) {
+            *_src_name = GSS_C_NO_NAME;
+        }
+        if ( _delegated_cred != NULL ) {
+            *_delegated_cred = GSS_C_NO_CREDENTIAL;
+        }
+        if ( !gsseap_standin_parse( _input_token, 'I', &round, rest, sizeof( rest ) ) ) {
+            return GSS_S_DEFECTIVE_TOKEN;
+        }
+        if ( context == GSS_C_NO_CONTEXT ) {
+            if ( round != 1 || rest[0] == '\0' ) {
+                return GSS_S_DEFECTIVE_TOKEN;
+            }
+            context = ( gss_ctx_id_t ) calloc( 1, sizeof( *context ) );
+            if ( context == NULL ) {
+                return GSS_S_FAILURE;
+            }
+            context->mech = &gsseap_standin_mechs[0];
+            snprintf( context->peer, sizeof( context->peer ), "%s", rest );
+            *_context = context;
+        }
+        else if ( context->open || round != context->round + 1 ) {
+            return GSS_S_DEFECTIVE_TOKEN;
+        }
+        context->round = round;
+
+        // past the identity every step is an exchange with the AAA backend
+        if ( round > 1 && !gsseap_standin_aaa_exchange( context->peer, round ) ) {
+            return GSS_S_UNAVAILABLE;
+        }
+        if ( ( long ) round >= rounds ) {
+            if ( strncmp( context->peer, "reject", 6 ) == 0 ) {
+                return GSS_S_DEFECTIVE_CREDENTIAL;
+            }
+            context->open = 1;
+        }
+
+        snprintf( text, sizeof( text ), "A %u %d", round, context->open );
+        if ( gsseap_standin_buffer( text, _output_token ) != GSS_S_COMPLETE ) {
+            return GSS_S_FAILURE;
+        }
+        if ( _mech_type != NULL ) {
+            *_mech_type = context->mech;
+        }
+        if ( _ret_flags != NULL ) {
+            *_ret_flags = gsseap_standin_flags;
+        }
+        if ( _time_rec != NULL ) {
+            *_time_rec = gsseap_standin_lifetime;
+        }
+        if ( !context->open ) {
+            return GSS_S_CONTINUE_NEEDED;
+        }
+        if ( _src_name != NULL ) {
+            *_src_name = gsseap_standin_name( context->peer, strlen( context->peer ) );
+        }
+        return GSS_S_COMPLETE;
+    }
+
+    OM_uint32 gss_inquire_context(
+        OM_uint32* _minor_status,
+        gss_ctx_id_t _context,
+        gss_name_t* _src_name,
+        gss_name_t* _targ_name,
+        OM_uint32* _lifetime_rec,
+        gss_OID* _mech_type,
+        OM_uint32* _ctx_flags,
+        int* _locally_initiated,
+        int* _open ) {
+        *_minor_status = 0;
+        if ( _context == GSS_C_NO_CONTEXT ) {
+            return GSS_S_NO_CONTEXT;
+        }
+        if ( _src_name != NULL ) {
+            *_src_name = _context->peer[0] != '\0' ? gsseap_standin_name( _context->peer, strlen( _context->peer ) ) : GSS_C_NO_NAME;
+        }
+        if ( _targ_name != NULL ) {
+            *_targ_name = GSS_C_NO_NAME;
+        }
+        if ( _lifetime_rec != NULL ) {
+            *_lifetime_rec = gsseap_standin_lifetime;
+        }
+        if ( _mech_type != NULL ) {
+            *_mech_type = _context->mech;
+        }
+        if ( _ctx_flags != NULL ) {
+            *_ctx_flags = gsseap_standin_flags;
+        }
+        if ( _locally_initiated != NULL ) {
+            *_locally_initiated = _context->initiator;
+        }
+        if ( _open != NULL ) {
+            *_open = _context->open;
+        }
+        return GSS_S_COMPLETE;
+    }
+
+    OM_uint32 gss_context_time(
+        OM_uint32* _minor_status,
+        gss_ctx_id_t _context,
+        OM_uint32* _time_rec ) {
+        *_minor_status = 0;
+        if ( _context == GSS_C_NO_CONTEXT ) {
+            return GSS_S_NO_CONTEXT;
+        }
+        *_time_rec = gsseap_standin_lifetime;
+        return GSS_S_COMPLETE;
+    }
+
+    OM_uint32 gss_delete_sec_context(
+        OM_uint32* _minor_status,
+        gss_ctx_id_t* _context,
+        gss_buffer_t _output_token ) {
+        *_minor_status = 0;
+        if ( _output_token != GSS_C_NO_BUFFER ) {
+            _output_token->length = 0;
+            _output_token->value = NULL;
+        }
+        if ( _context != NULL && *_context != GSS_C_NO_CONTEXT ) {
+            free( *_context );
+            *_context = GSS_C_NO_CONTEXT;
+        }
+        return GSS_S_COMPLETE;
+    }
+
+    OM_uint32 gss_export_sec_context(
+        OM_uint32* _minor_status,
+        gss_ctx_id_t* _context,
+        gss_buffer_t _interprocess_token ) {
+        *_minor_status = 0;
+        return GSS_S_UNAVAILABLE;
+    }
+
+    OM_uint32 gss_import_sec_context(
+        OM_uint32* _minor_status,
+        gss_buffer_t _interprocess_token,
+        gss_ctx_id_t* _context ) {
+        *_minor_status = 0;
+        return GSS_S_UNAVAILABLE;
+    }
+
+    OM_uint32 gss_wrap(
+        OM_uint32* _minor_status,
+        gss_ctx_id_t _context,
+        int _conf_req_flag,
+        OM_uint32 _qop_req,
+        gss_buffer_t _input_message,
+        int* _conf_state,
+        gss_buffer_t _output_message ) {
+        *_minor_status = 0;
+        if ( _context == GSS_C_NO_CONTEXT || !_context->open ) {
+            return GSS_S_NO_CONTEXT;
+        }
+        _output_message->length = _input_message->length;
+        _output_message->value = malloc( _input_message->length + 1 );
+        if ( _output_message->value == NULL ) {
+            _output_message->length = 0;
+            return GSS_S_FAILURE;
+        }
+        memcpy( _output_message->value, _input_message->value, _input_message->length );
+        if ( _conf_state != NULL ) {
+            *_conf_state = _conf_req_flag;
+        }
+        return GSS_S_COMPLETE;
+    }
+
+    OM_uint32 gss_unwrap(
+        OM_uint32* _minor_status,
+        gss_ctx_id_t _context,
+        gss_buffer_t _input_message,
+        gss_buffer_t _output_message,
+        int* _conf_state,
+        OM_uint32* _qop_state ) {
+        OM_uint32 major_status = gss_wrap( _minor_status, _context, 1, GSS_C_QOP_DEFAULT, _input_message, _conf_state,
+                                           _output_message );
+        if ( _qop_state != NULL ) {
+            *_qop_state = GSS_C_QOP_DEFAULT;
+        }
+        return major_status;
+    }
+
+    OM_uint32 gss_wrap_iov(
+        OM_uint32* _minor_status,
+        gss_ctx_id_t _context,
+        int _conf_req_flag,
+        OM_uint32 _qop_req,
+        int* _conf_state,
+        gss_iov_buffer_desc* _iov,
+        int _iov_count ) {
+        *_minor_status = 0;
+        return GSS_S_UNAVAILABLE;
+    }
+
+    OM_uint32 gss_unwrap_iov(
+        OM_uint32* _minor_status,
+        gss_ctx_id_t _context,
+        int* _conf_state,
+        OM_uint32* _qop_state,
+        gss_iov_buffer_desc* _iov,
+        int _iov_count ) {
+        *_minor_status = 0;
+        return GSS_S_UNAVAILABLE;
+    }
+
+    OM_uint32 gss_wrap_iov_length(
+        OM_uint32* _minor_status,
+        gss_ctx_id_t _context,
+        int _conf_req_flag,
+        OM_uint32 _qop_req,
+        int* _conf_state,
+        gss_iov_buffer_desc* _iov,
+        int _iov_count ) {
+        *_minor_status = 0;
+        return GSS_S_UNAVAILABLE;
+    }
+
+    OM_uint32 gss_indicate_mechs(
+        OM_uint32* _minor_status,
+        gss_OID_set* _mech_set ) {
+        size_t count = sizeof( gsseap_standin_mechs ) / sizeof( gsseap_standin_mechs[0] );
+
+        *_minor_status = 0;
+        *_mech_set = ( gss_OID_set ) malloc( sizeof( **_mech_set ) );
+        if ( *_mech_set == NULL ) {
+            return GSS_S_FAILURE;
+        }
+        ( *_mech_set )->elements = ( gss_OID ) malloc( sizeof( gsseap_standin_mechs ) );
+        if ( ( *_mech_set )->elements == NULL ) {
+            free( *_mech_set );
+            *_mech_set = GSS_C_NO_OID_SET;
+            return GSS_S_FAILURE;
+        }
+        memcpy( ( *_mech_set )->elements, gsseap_standin_mechs, sizeof( gsseap_standin_mechs ) );
+        ( *_mech_set )->count = count;
+        return GSS_S_COMPLETE;
+    }
+
+    OM_uint32 gss_release_oid_set(
+        OM_uint32* _minor_status,
+        gss_OID_set* _set ) {
+        *_minor_status = 0;
+        if ( _set != NULL && *_set != GSS_C_NO_OID_SET ) {
+            free( ( *_set )->elements );
+            free( *_set );
+            *_set = GSS_C_NO_OID_SET;
+        }
+        return GSS_S_COMPLETE;
+    }
+
+    OM_uint32 gss_oid_to_str(
+        OM_uint32* _minor_status,
+        gss_OID _oid,
+        gss_buffer_t _oid_str ) {
+        const unsigned char* der = ( const unsigned char* ) _oid->elements;
+        char text[256] = "{";
+        size_t len = 1;
+        unsigned long arc = 0;
+        bool first = true;
+
+        *_minor_status = 0;
+        for ( size_t i = 0; i < _oid->length && len < sizeof( text ) - 16; i++ ) {
+            arc = ( arc << 7 ) | ( der[i] & 0x7f );
+            if ( der[i] & 0x80 ) {
+                continue;
+            }
+            if ( first ) {
+                len += snprintf( text + len, sizeof( text ) - len, " %lu %lu", arc < 80 ? arc / 40 : 2, arc < 80 ? arc % 40 : arc - 80 );
+                first = false;
+            }
+            else {
+                len += snprintf( text + len, sizeof( text ) - len, " %lu", arc );
+            }
+            arc = 0;
+        }
+        snprintf( text + len, sizeof( text ) - len, " }" );
+        return gsseap_standin_buffer( text, _oid_str );
+    }
+
+    OM_uint32 gss_str_to_oid(
+        OM_uint32* _minor_status,
+        gss_buffer_t _oid_str,
+        gss_OID* _oid ) {
+        *_minor_status = 0;
+        *_oid = GSS_C_NO_OID;
+        return GSS_S_UNAVAILABLE;
+    }
+
+    OM_uint32 gss_display_status(
+        OM_uint32* _minor_status,
+        OM_uint32 _status_value,
+        int _status_type,
+        gss_OID _mech_type,
+        OM_uint32* _message_context,
+        gss_buffer_t _status_string ) {
+        char text[64];
+
+        *_minor_status = 0;
+        *_message_context = 0;
+        snprintf( text, sizeof( text ), "stand-in mechanism %s status %u", _status_type == GSS_C_GSS_CODE ? "major" : "minor",
+                  _status_value );
+        return gsseap_standin_buffer( text, _status_string );
+    }
+
+    OM_uint32 gss_release_buffer(
+        OM_uint32* _minor_status,
+        gss_buffer_t _buffer ) {
+        *_minor_status = 0;
+        if ( _buffer != GSS_C_NO_BUFFER ) {
+            free( _buffer->value );
+            _buffer->value = NULL;
+            _buffer->length = 0;
+        }
+        return GSS_S_COMPLETE;
+    }
+
+}
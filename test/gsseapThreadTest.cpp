@@ -0,0 +1,247 @@
+/* -*- mode: c++; fill-column: 132; c-basic-offset: 4; indent-tabs-mode: nil -*- */
+/* gsseapThreadTest.cpp
+ * Concurrent logins in one process, built with ThreadSanitizer.  Client
+ * threads log in over socket pairs at the same time, each as a user of its
+ * own, and a thread per connection serves it as the agent.  A context or a
+ * name leaking from one session into another fails the login: the catalog
+ * stand-in only maps a name to the user of its local part.  The agent's
+ * session must also name the client it served.  The threads start right
+ * after the plugin is loaded, so its first logins, and the settings they read
+ * once per process, run concurrently too.
+ *
+ * Descriptors are reused all the time here: the clients' sessions stay
+ * behind when a connection closes and are cleared by the next connection on
+ * the descriptor.  The test then checks that such a connection starts with a
+ * clean session on both sides, and that a finished login keeps no token
+ * buffer.
+ *
+ * usage: gsseapThreadTest [-t threads] [-n logins per thread]
+ */
+
+#include "gsseapHarness.hpp"
+#include "gsseapSession.hpp"
+#include "gsseapStandin.hpp"
+
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+static const int gsseap_thread_default_threads = 8;
+static const int gsseap_thread_default_logins = 20;
+static const int gsseap_thread_realms = 3;
+static const char* const gsseap_thread_zone = "tempZone";
+static const char* const gsseap_thread_client_addr = "127.0.0.1";
+
+/// @brief A connection handed to an agent thread, and what the agent made of it
+typedef struct {
+    int fd;
+    const char* identity;        // the name the client logs in with
+    int status;
+    int name_ok;                 // the agent's session holds the client's name once the login is done
+    int scratch_kept;            // the agent's session still holds its token buffer once the login is done
+    int keep_session;            // leave the session behind as a crashed agent would, rather than end it as agents do
+} gsseap_thread_conn_t;
+
+static void* gsseap_thread_agent(
+    void* _arg ) {
+    gsseap_thread_conn_t* conn = ( gsseap_thread_conn_t* ) _arg;
+
+    conn->status = gsseap_harness_serve( conn->fd );
+    conn->name_ok = strcmp( gsseap_session_get( conn->fd )->client_name, conn->identity ) == 0;
+    conn->scratch_kept = gsseap_session_get( conn->fd )->scratch != NULL;
+    // an agent process takes its sessions with it when it exits
+    if ( !conn->keep_session ) {
+        gsseap_session_end( conn->fd );
+    }
+    close( conn->fd );
+    return NULL;
+}
+
+/// @brief One login as _user with an agent thread serving it; 0, or why it failed
+static const char* gsseap_thread_login(
+    const char* _user,
+    const char* _identity ) {
+    pthread_t agent;
+    gsseap_thread_conn_t conn;
+    int sv[2];
+
+    if ( socketpair( AF_UNIX, SOCK_STREAM, 0, sv ) < 0 ) {
+        return "socketpair failed";
+    }
+    conn.fd = sv[1];
+    conn.identity = _identity;
+    conn.status = -1;
+    conn.name_ok = 0;
+    conn.keep_session = 0;
+    if ( pthread_create( &agent, NULL, gsseap_thread_agent, &conn ) != 0 ) {
+        close( sv[0] );
+        close( sv[1] );
+        return "starting the agent failed";
+    }
+    int status = gsseap_harness_login( sv[0], _user, gsseap_thread_zone, gsseap_thread_client_addr );
+    close( sv[0] );
+    pthread_join( agent, NULL );
+
+    if ( status < 0 ) {
+        return "the client failed";
+    }
+    if ( conn.status < 0 ) {
+        return "the agent failed";
+    }
+    if ( !conn.name_ok ) {
+        return "the agent's session names another client";
+    }
+    return NULL;
+}
+
+/// @brief A login leaves a context on the client's descriptor and a name on the agent's; new connections reusing both
+/// descriptors must see neither
+static int gsseap_thread_reuse() {
+    pthread_t agent;
+    gsseap_thread_conn_t conn;
+    int sv[2];
+    int sv2[2];
+    int failed = 0;
+
+    if ( socketpair( AF_UNIX, SOCK_STREAM, 0, sv ) < 0 ) {
+        perror( "gsseapThreadTest: socketpair" );
+        return 1;
+    }
+    conn.fd = sv[1];
+    conn.identity = "alice@example.org";
+    conn.keep_session = 1;
+    if ( pthread_create( &agent, NULL, gsseap_thread_agent, &conn ) != 0 ) {
+        perror( "gsseapThreadTest: starting the agent" );
+        return 1;
+    }
+    int status = gsseap_harness_login( sv[0], "alice", gsseap_thread_zone, gsseap_thread_client_addr );
+    bool had_context = gsseap_session_get( sv[0] )->context != GSS_C_NO_CONTEXT;
+    bool had_scratch = gsseap_session_get( sv[0] )->scratch != NULL;
+    close( sv[0] );
+    pthread_join( agent, NULL );
+    if ( status < 0 || conn.status < 0 || !conn.name_ok || !had_context ) {
+        fprintf( stderr, "gsseapThreadTest: reuse: the first login failed, status %d, agent %d\n", status, conn.status );
+        return 1;
+    }
+    if ( had_scratch || conn.scratch_kept ) {
+        fprintf( stderr, "gsseapThreadTest: reuse: a finished login kept its token buffer\n" );
+        failed++;
+    }
+
+    if ( socketpair( AF_UNIX, SOCK_STREAM, 0, sv2 ) < 0 ) {
+        perror( "gsseapThreadTest: socketpair" );
+        return 1;
+    }
+    if ( sv2[0] != sv[0] || sv2[1] != sv[1] ) {
+        fprintf( stderr, "gsseapThreadTest: reuse: the new connection did not reuse the descriptors\n" );
+        failed++;
+    }
+    else {
+        gsseap_session_t* client = gsseap_session_get( sv2[0] );
+        gsseap_session_t* server = gsseap_session_get( sv2[1] );
+        if ( client->context != GSS_C_NO_CONTEXT || server->context != GSS_C_NO_CONTEXT ) {
+            fprintf( stderr, "gsseapThreadTest: reuse: a new connection inherited a security context\n" );
+            failed++;
+        }
+        if ( server->client_name[0] != '\0' ) {
+            fprintf( stderr, "gsseapThreadTest: reuse: a new connection inherited the client name %s\n", server->client_name );
+            failed++;
+        }
+    }
+    close( sv2[0] );
+    close( sv2[1] );
+
+    printf( "%-8s %s\n", "reuse", failed > 0 ? "FAILED" : "ok" );
+    return failed;
+}
+
+static int gsseap_thread_logins = gsseap_thread_default_logins;
+
+// the clients wait here until all of them are started, so that their first logins collide
+static pthread_mutex_t gsseap_thread_start_mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t gsseap_thread_start_cond = PTHREAD_COND_INITIALIZER;
+static int gsseap_thread_started = 0;
+
+static void* gsseap_thread_client(
+    void* _arg ) {
+    long index = ( long ) _arg;
+    char user[64];
+    char identity[128];
+    long failed = 0;
+
+    snprintf( user, sizeof( user ), "user%ld", index );
+    snprintf( identity, sizeof( identity ), "%s@realm%ld.example.org", user, index % gsseap_thread_realms );
+    gsseap_standin_identity( identity );
+
+    pthread_mutex_lock( &gsseap_thread_start_mutex );
+    while ( !gsseap_thread_started ) {
+        pthread_cond_wait( &gsseap_thread_start_cond, &gsseap_thread_start_mutex );
+    }
+    pthread_mutex_unlock( &gsseap_thread_start_mutex );
+
+    for ( int i = 0; i < gsseap_thread_logins; i++ ) {
+        const char* failure = gsseap_thread_login( user, identity );
+        if ( failure != NULL ) {
+            fprintf( stderr, "gsseapThreadTest: %s login %d: %s\n", identity, i, failure );
+            failed++;
+        }
+    }
+    gsseap_standin_identity( NULL );
+    return ( void* ) failed;
+}
+
+int main(
+    int _argc,
+    char** _argv ) {
+    int threads = gsseap_thread_default_threads;
+    int opt;
+    int failed = 0;
+
+    while ( ( opt = getopt( _argc, _argv, "t:n:" ) ) != -1 ) {
+        switch ( opt ) {
+        case 't':
+            threads = atoi( optarg );
+            break;
+        case 'n':
+            gsseap_thread_logins = atoi( optarg );
+            break;
+        default:
+            fprintf( stderr, "usage: %s [-t threads] [-n logins per thread]\n", _argv[0] );
+            return 2;
+        }
+    }
+    if ( threads <= 0 || gsseap_thread_logins <= 0 ) {
+        fprintf( stderr, "gsseapThreadTest: -t and -n must be positive\n" );
+        return 2;
+    }
+
+    gsseap_harness_load_plugin();
+
+    pthread_t* clients = new pthread_t[threads];
+    int started = 0;
+    for ( ; started < threads; started++ ) {
+        if ( pthread_create( &clients[started], NULL, gsseap_thread_client, ( void* )( long ) started ) != 0 ) {
+            perror( "gsseapThreadTest: starting a client" );
+            failed++;
+            break;
+        }
+    }
+    pthread_mutex_lock( &gsseap_thread_start_mutex );
+    gsseap_thread_started = 1;
+    pthread_cond_broadcast( &gsseap_thread_start_cond );
+    pthread_mutex_unlock( &gsseap_thread_start_mutex );
+    long logins_failed = 0;
+    for ( int i = 0; i < started; i++ ) {
+        void* client_failed;
+        pthread_join( clients[i], &client_failed );
+        logins_failed += ( long ) client_failed;
+    }
+    delete[] clients;
+
+    printf( "%-8s %d threads, %d logins, %ld failed\n", "logins", started, started * gsseap_thread_logins, logins_failed );
+    failed += gsseap_thread_reuse();
+    return failed > 0 || logins_failed > 0 ? 1 : 0;
+}
@@ -0,0 +1,78 @@
+/* -*- mode: c++; fill-column: 132; c-basic-offset: 4; indent-tabs-mode: nil -*- */
+/* gsseapZoneTest.cpp
+ * Checks the privilege level rewriting of federated logins
+ * (gsseap_zone_priv) against the rewriting rsAuthResponse has always done
+ * for a catalog of another zone, written out here the way it reads there.
+ * Every view is checked with every level, and with values that are not
+ * levels, which must come back as they are.
+ *
+ * usage: gsseapZoneTest
+ */
+
+#include "gsseapZone.hpp"
+
+#include <stdio.h>
+
+/// @brief The level the strcmp chains of rsAuthResponse leave for _priv_level seen from _view
+static int gsseap_zone_expected(
+    gsseap_zone_view_t _view,
+    int _priv_level ) {
+    switch ( _view ) {
+    case GSSEAP_ZONE_REMOTE_ICAT:
+        /* proxy is easy because rodsServerHost is based on proxy user */
+        if ( _priv_level == LOCAL_PRIV_USER_AUTH ) {
+            return REMOTE_PRIV_USER_AUTH;
+        }
+        else if ( _priv_level == LOCAL_USER_AUTH ) {
+            return REMOTE_USER_AUTH;
+        }
+        return _priv_level;
+    case GSSEAP_ZONE_LOCAL_CLIENT:
+        /* client is from local zone */
+        if ( _priv_level == REMOTE_PRIV_USER_AUTH ) {
+            return LOCAL_PRIV_USER_AUTH;
+        }
+        else if ( _priv_level == REMOTE_USER_AUTH ) {
+            return LOCAL_USER_AUTH;
+        }
+        return _priv_level;
+    case GSSEAP_ZONE_REMOTE_CLIENT:
+        /* client is from remote zone */
+        if ( _priv_level == LOCAL_PRIV_USER_AUTH ) {
+            return REMOTE_USER_AUTH;
+        }
+        else if ( _priv_level == LOCAL_USER_AUTH ) {
+            return REMOTE_USER_AUTH;
+        }
+        return _priv_level;
+    }
+    return _priv_level;
+}
+
+int main(
+    int _argc,
+    char** _argv ) {
+    static const gsseap_zone_view_t views[] = { GSSEAP_ZONE_REMOTE_ICAT, GSSEAP_ZONE_LOCAL_CLIENT, GSSEAP_ZONE_REMOTE_CLIENT };
+    static const char* const view_names[] = { "remote icat", "local client", "remote client" };
+    // the levels, then values in between and around them
+    static const int levels[] = { NO_USER_AUTH, REMOTE_USER_AUTH, LOCAL_USER_AUTH, REMOTE_PRIV_USER_AUTH, LOCAL_PRIV_USER_AUTH,
+                                  4, -1, 6, 100
+                                };
+    int checked = 0;
+    int failed = 0;
+
+    for ( size_t v = 0; v < sizeof( views ) / sizeof( views[0] ); v++ ) {
+        for ( size_t l = 0; l < sizeof( levels ) / sizeof( levels[0] ); l++ ) {
+            int expected = gsseap_zone_expected( views[v], levels[l] );
+            int got = gsseap_zone_priv( views[v], levels[l] );
+            checked++;
+            if ( got != expected ) {
+                fprintf( stderr, "gsseapZoneTest: %s: level %d became %d, expected %d\n", view_names[v], levels[l], got, expected );
+                failed++;
+            }
+        }
+    }
+
+    printf( "%-8s %d levels checked, %d wrong\n", "priv", checked, failed );
+    return failed > 0 ? 1 : 0;
+}